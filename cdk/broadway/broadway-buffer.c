@@ -4,6 +4,10 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* This code is based on some code from weston with this license:
  *
  * Copyright © 2012 Intel Corporation
@@ -38,10 +42,19 @@ struct _BroadwayBuffer {
   guint8 *data;
   struct entry *table;
   int width, height, stride;
-  int encoded;
   int block_stride, length, block_count, shift;
   int stats[5];
   int clashes;
+
+  guint32 *block_hashes;        /* of the blocks on the grid */
+  gboolean have_block_hashes;
+  gboolean have_table;
+
+  /* Buffers made from another one only know what changed since */
+  guint32 serial;
+  guint32 base_serial;
+  cairo_region_t *damage;       /* %NULL if everything did */
+  gint64 encoded_pixels;
 };
 
 static const guint32 prime = 0x1f821e2d;
@@ -56,6 +69,276 @@ static const guint32 end_vprime = 0xcdb99001;	/* vprime^block_size */
 static const guint32 step = 0x0ac93019;
 static const int block_size = 32, block_mask = 31;
 
+/* The per-pixel work is done by these kernels, which have SSE2 versions
+ * where that is available. The plain C ones can be forced for comparing
+ * output and speed.
+ */
+static gboolean use_reference;
+
+static gboolean
+block_line_equal_c (const guint32 *a,
+                    const guint32 *b,
+                    int            n)
+{
+  return memcmp (a, b, n * 4) == 0;
+}
+
+/* Replaces block_hashes[j] by block_hashes[j] * vprime + add[j] -
+ * sub[j] * end_vprime, sliding the block hashes down by one line.
+ * @sub may be %NULL when adding the first lines.
+ */
+static void
+mix_block_hashes_c (guint32       *block_hashes,
+                    const guint32 *add,
+                    const guint32 *sub,
+                    int            n)
+{
+  int j;
+
+  if (sub)
+    for (j = 0; j < n; j++)
+      block_hashes[j] = block_hashes[j] * vprime + add[j] - sub[j] * end_vprime;
+  else
+    for (j = 0; j < n; j++)
+      block_hashes[j] = block_hashes[j] * vprime + add[j];
+}
+
+/* Per-channel difference to the previous frame, modulo 256 */
+static void
+compute_deltas_c (guint32       *deltas,
+                  const guint32 *line,
+                  const guint32 *prev_line,
+                  int            n)
+{
+  int j;
+
+  for (j = 0; j < n; j++)
+    {
+      guint32 color = line[j], prev_color = prev_line[j];
+
+      deltas[j] = (((color | 0x80808080) - (prev_color & 0x7f7f7f7f)) ^
+                   ((color ^ ~prev_color) & 0x80808080));
+    }
+}
+
+#if defined(__SSE2__)
+static gboolean
+block_line_equal_sse2 (const guint32 *a,
+                       const guint32 *b,
+                       int            n)
+{
+  int j;
+
+  for (j = 0; j + 4 <= n; j += 4)
+    {
+      __m128i eq = _mm_cmpeq_epi32 (_mm_loadu_si128 ((const __m128i *) (a + j)),
+                                    _mm_loadu_si128 ((const __m128i *) (b + j)));
+      if (_mm_movemask_epi8 (eq) != 0xffff)
+        return FALSE;
+    }
+
+  return block_line_equal_c (a + j, b + j, n - j);
+}
+
+/* SSE2 lacks a 32-bit multiply that keeps the low halves */
+static inline __m128i
+mullo_epi32 (__m128i a,
+             __m128i b)
+{
+  __m128i even = _mm_mul_epu32 (a, b);
+  __m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
+
+  return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+                             _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+}
+
+static void
+mix_block_hashes_sse2 (guint32       *block_hashes,
+                       const guint32 *add,
+                       const guint32 *sub,
+                       int            n)
+{
+  const __m128i v = _mm_set1_epi32 (vprime);
+  const __m128i end_v = _mm_set1_epi32 (end_vprime);
+  int j;
+
+  for (j = 0; j + 4 <= n; j += 4)
+    {
+      __m128i h = _mm_loadu_si128 ((const __m128i *) (block_hashes + j));
+
+      h = _mm_add_epi32 (mullo_epi32 (h, v), _mm_loadu_si128 ((const __m128i *) (add + j)));
+      if (sub)
+        h = _mm_sub_epi32 (h, mullo_epi32 (_mm_loadu_si128 ((const __m128i *) (sub + j)), end_v));
+      _mm_storeu_si128 ((__m128i *) (block_hashes + j), h);
+    }
+
+  mix_block_hashes_c (block_hashes + j, add + j, sub ? sub + j : NULL, n - j);
+}
+
+static void
+compute_deltas_sse2 (guint32       *deltas,
+                     const guint32 *line,
+                     const guint32 *prev_line,
+                     int            n)
+{
+  int j;
+
+  for (j = 0; j + 4 <= n; j += 4)
+    _mm_storeu_si128 ((__m128i *) (deltas + j),
+                      _mm_sub_epi8 (_mm_loadu_si128 ((const __m128i *) (line + j)),
+                                    _mm_loadu_si128 ((const __m128i *) (prev_line + j))));
+
+  compute_deltas_c (deltas + j, line + j, prev_line + j, n - j);
+}
+#endif
+
+static gboolean
+block_line_equal (const guint32 *a,
+                  const guint32 *b,
+                  int            n)
+{
+#if defined(__SSE2__)
+  if (!use_reference)
+    return block_line_equal_sse2 (a, b, n);
+#endif
+  return block_line_equal_c (a, b, n);
+}
+
+static void
+mix_block_hashes (guint32       *block_hashes,
+                  const guint32 *add,
+                  const guint32 *sub,
+                  int            n)
+{
+#if defined(__SSE2__)
+  if (!use_reference)
+    {
+      mix_block_hashes_sse2 (block_hashes, add, sub, n);
+      return;
+    }
+#endif
+  mix_block_hashes_c (block_hashes, add, sub, n);
+}
+
+static void
+compute_deltas (guint32       *deltas,
+                const guint32 *line,
+                const guint32 *prev_line,
+                int            n)
+{
+#if defined(__SSE2__)
+  if (!use_reference)
+    {
+      compute_deltas_sse2 (deltas, line, prev_line, n);
+      return;
+    }
+#endif
+  compute_deltas_c (deltas, line, prev_line, n);
+}
+
+static inline guint32
+hash_span_start (const guint32 *line,
+                 int            x,
+                 int            width)
+{
+  guint32 hash = 0;
+  int j;
+
+  for (j = x; j < x + block_size; j++)
+    {
+      hash = hash * prime;
+      if (j < width)
+        hash += line[j];
+    }
+
+  return hash;
+}
+
+static inline guint32
+hash_span_step (guint32        hash,
+                const guint32 *line,
+                int            x,
+                int            width)
+{
+  hash = hash * prime - line[x] * end_prime;
+  if (x + block_size < width)
+    hash += line[x + block_size];
+
+  return hash;
+}
+
+#define HASH_CHAINS 4
+
+/* Hashes of the block_size pixels starting at each x from @x0 to @x1
+ * in @line, with pixels past the end counting as 0. This is a rolling
+ * hash, so each step depends on the last; wide spans are cut into
+ * independent chains that the CPU can work on in parallel.
+ */
+static void
+hash_line (guint32       *hashes,
+           const guint32 *line,
+           int            x0,
+           int            x1,
+           int            width)
+{
+  guint32 hash[HASH_CHAINS];
+  int start[HASH_CHAINS];
+  int span, j, k;
+
+  if (x1 - x0 < HASH_CHAINS * block_size || use_reference)
+    {
+      hash[0] = hash_span_start (line, x0, width);
+      for (j = x0; j < x1; j++)
+        {
+          hashes[j] = hash[0];
+          hash[0] = hash_span_step (hash[0], line, j, width);
+        }
+      return;
+    }
+
+  span = (x1 - x0) / HASH_CHAINS;
+  for (k = 0; k < HASH_CHAINS; k++)
+    {
+      start[k] = x0 + k * span;
+      hash[k] = hash_span_start (line, start[k], width);
+    }
+
+  for (j = 0; j < span; j++)
+    for (k = 0; k < HASH_CHAINS; k++)
+      {
+        hashes[start[k] + j] = hash[k];
+        hash[k] = hash_span_step (hash[k], line, start[k] + j, width);
+      }
+
+  /* The last chain takes the rest */
+  for (j = x0 + HASH_CHAINS * span; j < x1; j++)
+    {
+      hashes[j] = hash[HASH_CHAINS - 1];
+      hash[HASH_CHAINS - 1] = hash_span_step (hash[HASH_CHAINS - 1], line, j, width);
+    }
+}
+
+/* The same as the sliding block hash at @x, @y, for blocks that the
+ * encoder didn't pass */
+static guint32
+hash_block (BroadwayBuffer *buffer,
+            int             x,
+            int             y)
+{
+  guint32 hash = 0;
+  int i;
+
+  for (i = y; i < y + block_size; i++)
+    {
+      hash = hash * vprime;
+      if (i < buffer->height)
+        hash += hash_span_start ((guint32 *) (buffer->data + i * buffer->stride),
+                                 x, buffer->width);
+    }
+
+  return hash;
+}
+
 static gboolean
 verify_block_match (BroadwayBuffer *buffer, int x, int y,
                     BroadwayBuffer *prev, struct entry *entry)
@@ -84,11 +367,11 @@ verify_block_match (BroadwayBuffer *buffer, int x, int y,
 
   for (i = 0; i < h1; i++)
     {
-      void *old, *match;
+      guint32 *old, *match;
 
-      match = buffer->data + (y + i) * buffer->stride + x * 4;
-      old = prev->data + (entry->y + i) * prev->stride + entry->x * 4;
-      if (memcmp (match, old, w1 * 4) != 0)
+      match = (guint32 *) (buffer->data + (y + i) * buffer->stride + x * 4);
+      old = (guint32 *) (prev->data + (entry->y + i) * prev->stride + entry->x * 4);
+      if (!block_line_equal (match, old, w1))
         {
           buffer->clashes++;
           return FALSE;
@@ -123,6 +406,42 @@ insert_block (BroadwayBuffer *buffer, guint32 h, int x, int y)
   buffer->stats[collision]++;
 }
 
+static void
+ensure_block_hashes (BroadwayBuffer *buffer)
+{
+  int x, y, k;
+
+  if (buffer->have_block_hashes)
+    return;
+
+  k = 0;
+  for (y = 0; y < buffer->height; y += block_size)
+    for (x = 0; x < buffer->width; x += block_size)
+      buffer->block_hashes[k++] = hash_block (buffer, x, y);
+
+  buffer->have_block_hashes = TRUE;
+}
+
+/* The table of the blocks of a buffer is only needed once the next
+ * buffer gets encoded against it */
+static void
+ensure_table (BroadwayBuffer *buffer)
+{
+  int x, y, k;
+
+  if (buffer->have_table)
+    return;
+
+  ensure_block_hashes (buffer);
+
+  k = 0;
+  for (y = 0; y < buffer->height; y += block_size)
+    for (x = 0; x < buffer->width; x += block_size)
+      insert_block (buffer, buffer->block_hashes[k++], x, y);
+
+  buffer->have_table = TRUE;
+}
+
 static struct entry *
 lookup_block (BroadwayBuffer *prev, guint32 h)
 {
@@ -141,6 +460,169 @@ lookup_block (BroadwayBuffer *prev, guint32 h)
   return NULL;
 }
 
+/* Whether the block on the grid at @x, @y is most likely the same as
+ * in @prev */
+static inline gboolean
+block_unchanged (BroadwayBuffer *buffer,
+                 BroadwayBuffer *prev,
+                 guint32         hash,
+                 int             x,
+                 int             y)
+{
+  return prev != NULL &&
+         prev->width == buffer->width && prev->height == buffer->height &&
+         prev->have_block_hashes &&
+         prev->block_hashes[(prev->block_stride * y + x) / block_size] == hash;
+}
+
+static gboolean
+block_is_solid (BroadwayBuffer *buffer,
+                int             x,
+                int             y)
+{
+  guint32 *line, color;
+  int i, j;
+
+  color = *(guint32 *) (buffer->data + y * buffer->stride + x * 4);
+  for (i = y; i < y + block_size; i++)
+    {
+      line = (guint32 *) (buffer->data + i * buffer->stride);
+      for (j = x; j < x + block_size; j++)
+        if (line[j] != color)
+          return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* The tile store keeps blocks that were sent before, in any window, so
+ * that content that comes back, like a page of a notebook or a dialog
+ * that is opened again, gets sent as a reference. The client keeps the
+ * same tiles in the same slots: the server picks the slot and tells the
+ * client to save the block there.
+ *
+ * Only whole blocks on the grid of a window are saved and looked up.
+ * When the store is full, a clock hand picks a tile that wasn't used
+ * since it last came by.
+ */
+
+struct tile {
+  guint32 hash;
+  gboolean in_use;
+  gboolean referenced;
+};
+
+struct _BroadwayTileStore {
+  GHashTable *slots;            /* hash => slot + 1 */
+  struct tile tiles[BROADWAY_TILE_STORE_SIZE];
+  guint32 *pixels;              /* block_size * block_size for each slot */
+  guint hand;
+};
+
+BroadwayTileStore *
+broadway_tile_store_new (void)
+{
+  BroadwayTileStore *tiles;
+
+  tiles = g_new0 (BroadwayTileStore, 1);
+  tiles->slots = g_hash_table_new (NULL, NULL);
+  tiles->pixels = g_new (guint32, BROADWAY_TILE_STORE_SIZE * block_size * block_size);
+
+  return tiles;
+}
+
+void
+broadway_tile_store_free (BroadwayTileStore *tiles)
+{
+  g_hash_table_unref (tiles->slots);
+  g_free (tiles->pixels);
+  g_free (tiles);
+}
+
+/* Forgets all tiles, for a client that doesn't have them */
+void
+broadway_tile_store_clear (BroadwayTileStore *tiles)
+{
+  g_hash_table_remove_all (tiles->slots);
+  memset (tiles->tiles, 0, sizeof tiles->tiles);
+  tiles->hand = 0;
+}
+
+static inline guint32 *
+tile_pixels (BroadwayTileStore *tiles,
+             int                slot)
+{
+  return tiles->pixels + slot * block_size * block_size;
+}
+
+/* Returns the slot of the tile that has the pixels of the block at
+ * @x, @y, or -1 */
+static int
+tile_store_lookup (BroadwayTileStore *tiles,
+                   BroadwayBuffer    *buffer,
+                   guint32            hash,
+                   int                x,
+                   int                y)
+{
+  gpointer value;
+  guint32 *pixels;
+  int slot, i;
+
+  value = g_hash_table_lookup (tiles->slots, GUINT_TO_POINTER (hash));
+  if (value == NULL)
+    return -1;
+
+  slot = GPOINTER_TO_INT (value) - 1;
+  pixels = tile_pixels (tiles, slot);
+  for (i = 0; i < block_size; i++)
+    if (!block_line_equal ((guint32 *) (buffer->data + (y + i) * buffer->stride) + x,
+                           pixels + i * block_size, block_size))
+      {
+        buffer->clashes++;
+        return -1;
+      }
+
+  tiles->tiles[slot].referenced = TRUE;
+
+  return slot;
+}
+
+static int
+tile_store_insert (BroadwayTileStore *tiles,
+                   BroadwayBuffer    *buffer,
+                   guint32            hash,
+                   int                x,
+                   int                y)
+{
+  struct tile *tile;
+  int slot, i;
+
+  while (tiles->tiles[tiles->hand].referenced)
+    {
+      tiles->tiles[tiles->hand].referenced = FALSE;
+      tiles->hand = (tiles->hand + 1) % BROADWAY_TILE_STORE_SIZE;
+    }
+
+  slot = tiles->hand;
+  tiles->hand = (tiles->hand + 1) % BROADWAY_TILE_STORE_SIZE;
+
+  tile = &tiles->tiles[slot];
+  if (tile->in_use)
+    g_hash_table_remove (tiles->slots, GUINT_TO_POINTER (tile->hash));
+
+  tile->hash = hash;
+  tile->in_use = TRUE;
+  tile->referenced = FALSE;
+  g_hash_table_insert (tiles->slots, GUINT_TO_POINTER (hash), GINT_TO_POINTER (slot + 1));
+
+  for (i = 0; i < block_size; i++)
+    memcpy (tile_pixels (tiles, slot) + i * block_size,
+            buffer->data + (y + i) * buffer->stride + x * 4,
+            block_size * 4);
+
+  return slot;
+}
+
 struct encoder {
   guint32 color;
   guint32 color_run;
@@ -148,6 +630,8 @@ struct encoder {
   guint32 delta_run;
   GString *dest;
   int bytes;
+  guint32 symbols[256];         /* not yet appended to dest */
+  int n_symbols;
 };
 
 /* Encoding:
@@ -164,13 +648,27 @@ struct encoder {
  *     - 0x00 2x xx xx 0x xxxx yyyy: block ref, block number x (20 bits) at x, y
  *     - 0x00 3x xx xx 0xaarrggbb : solid color run, length x
  *     - 0x00 4x xx xx 0xaarrggbb : delta run, length x
+ *     - 0x00 5x xx xx 0x xxxx yyyy: save the block at x, y of the
+ *       finished frame as tile x
+ *     - 0x00 6x xx xx 0x xxxx yyyy: tile ref, tile x at x, y
  *
  */
 
 static void
+encoder_flush_symbols (struct encoder *encoder)
+{
+  g_string_append_len (encoder->dest, (char *)encoder->symbols,
+                       encoder->n_symbols * sizeof (guint32));
+  encoder->n_symbols = 0;
+}
+
+static inline void
 emit (struct encoder *encoder, guint32 symbol)
 {
-  g_string_append_len (encoder->dest, (char *)&symbol, sizeof (guint32));
+  if (encoder->n_symbols == G_N_ELEMENTS (encoder->symbols))
+    encoder_flush_symbols (encoder);
+
+  encoder->symbols[encoder->n_symbols++] = symbol;
   encoder->bytes += sizeof (guint32);
 }
 
@@ -202,26 +700,12 @@ encode_run (struct encoder *encoder)
     }
 }
 
-static void
-encode_pixel (struct encoder *encoder, guint32 color, guint32 prev_color)
+/* @delta is the per-channel difference to the pixel in the previous
+ * frame, see compute_deltas().
+ */
+static inline void
+encode_pixel (struct encoder *encoder, guint32 color, guint32 delta)
 {
-  guint32 delta = 0;
-  guint32 a, r, g, b;
-
-  if (color == prev_color)
-    delta = 0;
-  else if (prev_color == 0)
-    delta = color;
-  else
-    {
-      a = ((color & 0xff000000) - (prev_color & 0xff000000)) & 0xff000000;
-      r = ((color & 0x00ff0000) - (prev_color & 0x00ff0000)) & 0x00ff0000;
-      g = ((color & 0x0000ff00) - (prev_color & 0x0000ff00)) & 0x0000ff00;
-      b = ((color & 0x000000ff) - (prev_color & 0x000000ff)) & 0x000000ff;
-
-      delta = a | r | g | b;
-    }
-
   if ((encoder->color != color &&
        encoder->color_run > encoder->delta_run) ||
 
@@ -258,10 +742,38 @@ encode_pixel (struct encoder *encoder, guint32 color, guint32 prev_color)
     }
 }
 
+/* Adds @n pixels that are the same as in the previous frame */
+static void
+encode_skip (struct encoder *encoder, guint32 n)
+{
+  if (n == 0)
+    return;
+
+  /* Only a pending delta 0 run can be extended */
+  if (encoder->delta != 0 || encoder->delta_run <= encoder->color_run)
+    {
+      encode_run (encoder);
+      encoder->delta = 0;
+      encoder->delta_run = 0;
+    }
+  encoder->color_run = 0;
+
+  while (encoder->delta_run + n > 0xFFFFF)
+    {
+      n -= 0xFFFFF - encoder->delta_run;
+      encoder->delta_run = 0xFFFFF;
+      encode_run (encoder);
+      encoder->delta_run = 0;
+    }
+
+  encoder->delta_run += n;
+}
+
 static void
 encoder_flush (struct encoder *encoder)
 {
   encode_run (encoder);
+  encoder_flush_symbols (encoder);
 }
 
 
@@ -278,11 +790,119 @@ encode_block (struct encoder *encoder, struct entry *entry, int x, int y)
   emit (encoder, (x << 16) | y);
 }
 
+/* Sends the block at @x, @y as a copy of pixels that the client has,
+ * if they are in @prev or @tiles */
+static inline gboolean
+encode_reference (struct encoder    *encoder,
+                  BroadwayBuffer    *buffer,
+                  BroadwayBuffer    *prev,
+                  BroadwayTileStore *tiles,
+                  guint32            hash,
+                  int                x,
+                  int                y)
+{
+  struct entry *entry;
+  int slot;
+
+  /* FIXME: Add back overlap exception
+   * for consecutive blocks */
+
+  /* The cheap checks go first, most pixels can't start a block */
+  if (prev != NULL &&
+      (entry = lookup_block (prev, hash)) != NULL &&
+      entry->count < 2 &&
+      verify_block_match (buffer, x, y, prev, entry) &&
+      (entry->x != x || entry->y != y))
+    {
+      encode_block (encoder, entry, x, y);
+      return TRUE;
+    }
+
+  if (tiles != NULL &&
+      ((x | y) & block_mask) == 0 &&
+      x + block_size <= buffer->width &&
+      y + block_size <= buffer->height &&
+      !block_unchanged (buffer, prev, hash, x, y) &&
+      (slot = tile_store_lookup (tiles, buffer, hash, x, y)) != -1)
+    {
+      emit (encoder, 0x00600000 | slot);
+      emit (encoder, (x << 16) | y);
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+save_tile (struct encoder    *encoder,
+           BroadwayBuffer    *buffer,
+           BroadwayBuffer    *prev,
+           BroadwayTileStore *tiles,
+           int                x,
+           int                y)
+{
+  guint32 hash;
+  int slot;
+
+  if (x + block_size > buffer->width || y + block_size > buffer->height)
+    return;
+
+  hash = buffer->block_hashes[(buffer->block_stride * y + x) / block_size];
+  if (block_unchanged (buffer, prev, hash, x, y) ||
+      g_hash_table_contains (tiles->slots, GUINT_TO_POINTER (hash)) ||
+      block_is_solid (buffer, x, y))
+    return;
+
+  slot = tile_store_insert (tiles, buffer, hash, x, y);
+  emit (encoder, 0x00500000 | slot);
+  emit (encoder, (x << 16) | y);
+}
+
+/* Puts the new blocks on the grid into @tiles, and has the client do
+ * the same once it has the whole frame. Only the blocks in @damage can
+ * be new, if it is given.
+ */
+static void
+encode_tile_saves (struct encoder       *encoder,
+                   BroadwayBuffer       *buffer,
+                   BroadwayBuffer       *prev,
+                   BroadwayTileStore    *tiles,
+                   const cairo_region_t *damage)
+{
+  cairo_rectangle_int_t rect;
+  int i, x, y;
+
+  encode_run (encoder);
+  encoder->color_run = 0;
+  encoder->delta_run = 0;
+
+  ensure_block_hashes (buffer);
+
+  if (damage == NULL)
+    {
+      for (y = 0; y < buffer->height; y += block_size)
+        for (x = 0; x < buffer->width; x += block_size)
+          save_tile (encoder, buffer, prev, tiles, x, y);
+      return;
+    }
+
+  for (i = 0; i < cairo_region_num_rectangles (damage); i++)
+    {
+      cairo_region_get_rectangle (damage, i, &rect);
+      for (y = rect.y & ~block_mask; y < rect.y + rect.height; y += block_size)
+        for (x = rect.x & ~block_mask; x < rect.x + rect.width; x += block_size)
+          save_tile (encoder, buffer, prev, tiles, x, y);
+    }
+}
+
 void
 broadway_buffer_destroy (BroadwayBuffer *buffer)
 {
   g_free (buffer->data);
   g_free (buffer->table);
+  g_free (buffer->block_hashes);
+  if (buffer->damage)
+    cairo_region_destroy (buffer->damage);
   g_free (buffer);
 }
 
@@ -298,12 +918,17 @@ broadway_buffer_get_height (BroadwayBuffer *buffer)
   return buffer->height;
 }
 
+/* Pixels that the last broadway_buffer_encode() looked at */
+gint64
+broadway_buffer_get_encoded_pixels (BroadwayBuffer *buffer)
+{
+  return buffer->encoded_pixels;
+}
+
 static void
-unpremultiply_line (void *destp, void *srcp, int width)
+unpremultiply_line_c (guint32 *dest, const guint32 *src, int width)
 {
-  guint32 *src = srcp;
-  guint32 *dest = destp;
-  guint32 *end = src + width;
+  const guint32 *end = src + width;
   while (src < end)
     {
       guint32 pixel;
@@ -327,16 +952,119 @@ unpremultiply_line (void *destp, void *srcp, int width)
     }
 }
 
-BroadwayBuffer *
-broadway_buffer_create (int width, int height, guint8 *data, int stride)
+#if defined(__SSE2__)
+/* 2^24 / alpha, rounded up. Multiplying by this and shifting gives
+ * exactly the same results as dividing by alpha for numerators below
+ * 2^16, which has been checked for all values.
+ */
+static guint32 reciprocals[256];
+
+static void
+init_reciprocals (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      guint32 a;
+
+      for (a = 1; a < 256; a++)
+        reciprocals[a] = ((1 << 24) + a - 1) / a;
+
+      g_once_init_leave (&initialized, 1);
+    }
+}
+
+static inline guint8
+unpremultiply_channel (guint32 c, guint32 alpha)
+{
+  return ((guint64) (c * 255 + alpha / 2) * reciprocals[alpha]) >> 24;
+}
+
+/* Most pixels of UI surfaces are opaque or fully transparent, so those
+ * are handled 4 at a time and only the rest is divided.
+ */
+static void
+unpremultiply_line_sse2 (guint32 *dest, const guint32 *src, int width)
+{
+  const __m128i alpha_mask = _mm_set1_epi32 (0xff000000);
+  const __m128i zero = _mm_setzero_si128 ();
+  int j = 0;
+
+  while (j < width)
+    {
+      guint32 pixel, alpha;
+
+      if (j + 4 <= width)
+        {
+          __m128i pixels = _mm_loadu_si128 ((const __m128i *) (src + j));
+          __m128i alphas = _mm_and_si128 (pixels, alpha_mask);
+
+          if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (alphas, alpha_mask)) == 0xffff)
+            {
+              _mm_storeu_si128 ((__m128i *) (dest + j), pixels);
+              j += 4;
+              continue;
+            }
+          if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (alphas, zero)) == 0xffff)
+            {
+              _mm_storeu_si128 ((__m128i *) (dest + j), zero);
+              j += 4;
+              continue;
+            }
+        }
+
+      pixel = src[j];
+      alpha = pixel >> 24;
+
+      if (alpha == 0xff)
+        dest[j] = pixel;
+      else if (alpha == 0)
+        dest[j] = 0;
+      else
+        dest[j] = alpha << 24 |
+                  (guint32) unpremultiply_channel ((pixel >> 16) & 0xff, alpha) << 16 |
+                  (guint32) unpremultiply_channel ((pixel >>  8) & 0xff, alpha) << 8 |
+                  (guint32) unpremultiply_channel ((pixel >>  0) & 0xff, alpha);
+      j++;
+    }
+}
+#endif
+
+static void
+unpremultiply_line (void *destp, void *srcp, int width)
+{
+#if defined(__SSE2__)
+  if (!use_reference)
+    {
+      unpremultiply_line_sse2 (destp, srcp, width);
+      return;
+    }
+#endif
+  unpremultiply_line_c (destp, srcp, width);
+}
+
+/* Makes all buffer code use the plain C kernels, for checking the
+ * output of the optimized ones and measuring their speedup.
+ */
+void
+broadway_buffer_set_reference (gboolean reference)
+{
+  use_reference = reference;
+}
+
+static BroadwayBuffer *
+buffer_new (int width, int height)
 {
+  static guint32 last_serial;
   BroadwayBuffer *buffer;
-  int y, bits_required;
+  int bits_required;
 
   buffer = g_new0 (BroadwayBuffer, 1);
   buffer->width = width;
   buffer->stride = width * 4;
   buffer->height = height;
+  buffer->serial = ++last_serial;
 
   buffer->block_stride = (width + block_size - 1) / block_size;
   buffer->block_count =
@@ -346,10 +1074,25 @@ broadway_buffer_create (int width, int height, guint8 *data, int stride)
   buffer->length = 1 << bits_required;
 
   buffer->table = g_malloc0 (buffer->length * sizeof buffer->table[0]);
+  buffer->block_hashes = g_malloc (buffer->block_count * sizeof buffer->block_hashes[0]);
 
   memset (buffer->stats, 0, sizeof buffer->stats);
   buffer->clashes = 0;
 
+#if defined(__SSE2__)
+  init_reciprocals ();
+#endif
+
+  return buffer;
+}
+
+BroadwayBuffer *
+broadway_buffer_create (int width, int height, guint8 *data, int stride)
+{
+  BroadwayBuffer *buffer;
+  int y;
+
+  buffer = buffer_new (width, height);
   buffer->data = g_malloc (buffer->stride * height);
 
   for (y = 0; y < height; y++)
@@ -358,19 +1101,307 @@ broadway_buffer_create (int width, int height, guint8 *data, int stride)
   return buffer;
 }
 
+static void
+copy_rectangle (BroadwayBuffer              *dest,
+                BroadwayBuffer              *src,
+                const cairo_rectangle_int_t *rect)
+{
+  int y;
+
+  for (y = rect->y; y < rect->y + rect->height; y++)
+    memcpy (dest->data + y * dest->stride + rect->x * 4,
+            src->data + y * src->stride + rect->x * 4,
+            rect->width * 4);
+}
+
+/**
+ * broadway_buffer_create_damaged:
+ * @prev: the previous contents of the window
+ * @reuse: (transfer full) (nullable): the buffer before @prev
+ * @data: the new contents, which only differ from @prev in @damage
+ * @stride: the stride of @data
+ * @damage: the region that changed since @prev
+ *
+ * Creates a buffer of the same size as @prev that only takes @damage
+ * from @data. When @reuse is the buffer that @prev was made from, its
+ * memory is brought up to date and used for the new buffer, so that
+ * neither copying nor encoding the new buffer touches the rest.
+ */
+BroadwayBuffer *
+broadway_buffer_create_damaged (BroadwayBuffer       *prev,
+                                BroadwayBuffer       *reuse,
+                                guint8               *data,
+                                int                   stride,
+                                const cairo_region_t *damage)
+{
+  BroadwayBuffer *buffer;
+  cairo_rectangle_int_t bounds, rect;
+  int i, n_rects, x, y;
+
+  buffer = buffer_new (prev->width, prev->height);
+
+  if (reuse != NULL &&
+      reuse->width == prev->width && reuse->height == prev->height &&
+      reuse->serial == prev->base_serial && prev->damage != NULL)
+    {
+      buffer->data = reuse->data;
+      reuse->data = NULL;
+
+      n_rects = cairo_region_num_rectangles (prev->damage);
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_region_get_rectangle (prev->damage, i, &rect);
+          copy_rectangle (buffer, prev, &rect);
+        }
+    }
+  else
+    buffer->data = g_memdup2 (prev->data, prev->stride * prev->height);
+
+  if (reuse != NULL)
+    broadway_buffer_destroy (reuse);
+
+  bounds.x = 0;
+  bounds.y = 0;
+  bounds.width = buffer->width;
+  bounds.height = buffer->height;
+
+  buffer->base_serial = prev->serial;
+  buffer->damage = cairo_region_copy (damage);
+  cairo_region_intersect_rectangle (buffer->damage, &bounds);
+
+  n_rects = cairo_region_num_rectangles (buffer->damage);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_region_get_rectangle (buffer->damage, i, &rect);
+      for (y = rect.y; y < rect.y + rect.height; y++)
+        unpremultiply_line (buffer->data + y * buffer->stride + rect.x * 4,
+                            data + y * stride + rect.x * 4,
+                            rect.width);
+    }
+
+  /* Only the blocks touching the damage have new hashes */
+  if (prev->have_block_hashes)
+    {
+      memcpy (buffer->block_hashes, prev->block_hashes,
+              buffer->block_count * sizeof buffer->block_hashes[0]);
+
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_region_get_rectangle (buffer->damage, i, &rect);
+          for (y = rect.y & ~block_mask; y < rect.y + rect.height; y += block_size)
+            for (x = rect.x & ~block_mask; x < rect.x + rect.width; x += block_size)
+              buffer->block_hashes[(buffer->block_stride * y + x) / block_size] =
+                hash_block (buffer, x, y);
+        }
+
+      buffer->have_block_hashes = TRUE;
+    }
+
+  return buffer;
+}
+
+/* Encodes the rows of one band of the damage region, the rectangles
+ * @first to @last - 1 of @buffer->damage. Returns where it stopped, in
+ * pixels from the start of the buffer.
+ */
+static gint64
+encode_band (BroadwayBuffer *buffer,
+             BroadwayBuffer *prev,
+             BroadwayTileStore *tiles,
+             struct encoder *encoder,
+             gint64          pos,
+             int             first,
+             int             last,
+             int            *skyline,
+             guint32        *block_hashes,
+             guint32       **line_hashes,
+             guint32        *bottom_hashes,
+             guint32        *deltas)
+{
+  cairo_rectangle_int_t band, rect;
+  guint32 *line, *prev_line, *tmp;
+  int width, height, x0, x1;
+  int skyline_pixels;
+  int i, j, k, r;
+
+  width = buffer->width;
+  height = buffer->height;
+
+  cairo_region_get_rectangle (buffer->damage, first, &band);
+  x0 = band.x;
+  cairo_region_get_rectangle (buffer->damage, last - 1, &rect);
+  x1 = rect.x + rect.width;
+
+  /* Block hashes for the first row of the band, over all its columns */
+  memset (block_hashes + x0, 0, (x1 - x0) * sizeof block_hashes[0]);
+  for (i = band.y; i < band.y + block_size; i++)
+    {
+      if (i < height)
+        {
+          line = (guint32 *) (buffer->data + i * buffer->stride);
+          hash_line (line_hashes[i & block_mask], line, x0, x1, width);
+          mix_block_hashes (block_hashes + x0, line_hashes[i & block_mask] + x0, NULL, x1 - x0);
+        }
+      else
+        for (j = x0; j < x1; j++)
+          block_hashes[j] = block_hashes[j] * vprime;
+    }
+
+  for (i = band.y; i < band.y + band.height; i++)
+    {
+      line = (guint32 *) (buffer->data + i * buffer->stride);
+      prev_line = (guint32 *) (prev->data + i * prev->stride);
+
+      for (r = first; r < last; r++)
+        {
+          cairo_region_get_rectangle (buffer->damage, r, &rect);
+
+          encode_skip (encoder, (gint64) i * width + rect.x - pos);
+          pos = (gint64) i * width + rect.x + rect.width;
+
+          compute_deltas (deltas + rect.x, line + rect.x, prev_line + rect.x, rect.width);
+
+          skyline_pixels = 0;
+          for (j = rect.x; j < rect.x + block_size; j++)
+            {
+              if (i < skyline[j])
+                skyline_pixels = 0;
+              else
+                skyline_pixels++;
+            }
+
+          for (j = rect.x; j < rect.x + rect.width; j++)
+            {
+              if (i < skyline[j])
+                encode_pixel (encoder, line[j], 0);
+              else if (skyline_pixels >= block_size &&
+                       encode_reference (encoder, buffer, prev, tiles, block_hashes[j], j, i))
+                {
+                  for (k = 0; k < block_size; k++)
+                    skyline[j + k] = i + block_size;
+
+                  encode_pixel (encoder, line[j], 0);
+                }
+              else
+                encode_pixel (encoder, line[j], deltas[j]);
+
+              if (i < skyline[j + block_size])
+                skyline_pixels = 0;
+              else
+                skyline_pixels++;
+            }
+        }
+
+      /* Update sliding block hashes */
+      if (i + block_size < height)
+        hash_line (bottom_hashes, (guint32 *) (buffer->data + (i + block_size) * buffer->stride),
+                   x0, x1, width);
+      else
+        memset (bottom_hashes + x0, 0, (x1 - x0) * sizeof bottom_hashes[0]);
+      mix_block_hashes (block_hashes + x0, bottom_hashes + x0, line_hashes[i & block_mask] + x0, x1 - x0);
+
+      tmp = line_hashes[i & block_mask];
+      line_hashes[i & block_mask] = bottom_hashes;
+      bottom_hashes = tmp;
+    }
+
+  return pos;
+}
+
+/* Like the full encoding, but everything outside the damage is sent
+ * as unchanged without looking at it */
+static void
+encode_damage (BroadwayBuffer    *buffer,
+               BroadwayBuffer    *prev,
+               BroadwayTileStore *tiles,
+               GString           *dest)
+{
+  cairo_rectangle_int_t band, rect;
+  guint32 *block_hashes, *hash_storage, *deltas;
+  guint32 *line_hashes[32]; /* block_size */
+  struct encoder encoder = { 0 };
+  int *skyline;
+  int width, n_rects, first, last, k;
+  gint64 pos;
+
+  width = buffer->width;
+
+  ensure_table (prev);
+
+  skyline = g_malloc0 ((width + block_size) * sizeof skyline[0]);
+  block_hashes = g_malloc (width * sizeof block_hashes[0]);
+  hash_storage = g_malloc ((block_size + 1) * width * sizeof hash_storage[0]);
+  deltas = g_malloc (width * sizeof deltas[0]);
+
+  encoder.dest = dest;
+  pos = 0;
+  buffer->encoded_pixels = 0;
+
+  n_rects = cairo_region_num_rectangles (buffer->damage);
+  for (first = 0; first < n_rects; first = last)
+    {
+      /* The rectangles of a band have the same rows, sorted by x */
+      cairo_region_get_rectangle (buffer->damage, first, &band);
+      for (last = first + 1; last < n_rects; last++)
+        {
+          cairo_region_get_rectangle (buffer->damage, last, &rect);
+          if (rect.y != band.y)
+            break;
+        }
+
+      for (k = 0; k < block_size; k++)
+        line_hashes[k] = hash_storage + k * width;
+
+      pos = encode_band (buffer, prev, tiles, &encoder, pos, first, last,
+                         skyline, block_hashes, line_hashes,
+                         hash_storage + block_size * width, deltas);
+    }
+
+  for (first = 0; first < n_rects; first++)
+    {
+      cairo_region_get_rectangle (buffer->damage, first, &rect);
+      buffer->encoded_pixels += (gint64) rect.width * rect.height;
+    }
+
+  encode_skip (&encoder, (gint64) width * buffer->height - pos);
+  if (tiles)
+    encode_tile_saves (&encoder, buffer, prev, tiles, buffer->damage);
+  encoder_flush (&encoder);
+
+  g_free (skyline);
+  g_free (block_hashes);
+  g_free (hash_storage);
+  g_free (deltas);
+}
+
+/* Encodes @buffer for a client that has @prev, and the tiles in @tiles
+ * if it is given */
 void
-broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *dest)
+broadway_buffer_encode (BroadwayBuffer    *buffer,
+                        BroadwayBuffer    *prev,
+                        BroadwayTileStore *tiles,
+                        GString           *dest)
 {
-  struct entry *entry;
   int i, j, k;
   int x0, x1, y0, y1;
-  guint32 *block_hashes;
-  guint32 hash, bottom_hash, h, *line, *bottom, *prev_line;
-  int width, height;
+  guint32 *block_hashes, *hash_storage, *bottom_hashes, *deltas, *tmp;
+  guint32 *line_hashes[32]; /* block_size */
+  guint32 *line, *bottom, *prev_line;
+  int width, height, prev_width;
   struct encoder encoder = { 0 };
   int *skyline, skyline_pixels;
   int matches;
 
+  if (prev != NULL && buffer->damage != NULL &&
+      buffer->base_serial == prev->serial)
+    {
+      encode_damage (buffer, prev, tiles, dest);
+      return;
+    }
+
+  if (prev != NULL)
+    ensure_table (prev);
+
   width = buffer->width;
   height = buffer->height;
   x0 = 0;
@@ -381,6 +1412,13 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
   skyline = g_malloc0 ((width + block_size) * sizeof skyline[0]);
 
   block_hashes = g_malloc0 (width * sizeof block_hashes[0]);
+  /* The line hashes of the block_size lines starting at the current
+   * one, each line is only hashed once */
+  hash_storage = g_malloc ((block_size + 1) * width * sizeof hash_storage[0]);
+  for (k = 0; k < block_size; k++)
+    line_hashes[k] = hash_storage + k * width;
+  bottom_hashes = hash_storage + block_size * width;
+  deltas = g_malloc (width * sizeof deltas[0]);
 
   matches = 0;
   encoder.dest = dest;
@@ -389,20 +1427,8 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
   for (i = y0; i < MIN(y1, y0 + block_size); i++)
     {
       line = (guint32 *)(buffer->data + i * buffer->stride);
-      hash = 0;
-      for (j = x0; j < MIN(x1, x0 + block_size); j++)
-        hash = hash * prime + line[j];
-      for (; j < x0 + block_size; j++)
-        hash = hash * prime;
-
-      for (j = x0; j < x1; j++)
-        {
-          block_hashes[j] = block_hashes[j] * vprime + hash;
-
-          hash = hash * prime - line[j] * end_prime;
-          if (j + block_size < width)
-            hash += line[j + block_size];
-        }
+      hash_line (line_hashes[i & block_mask], line, 0, width, width);
+      mix_block_hashes (block_hashes, line_hashes[i & block_mask], NULL, width);
     }
   // Do the last rows if height < block_size
   for (; i < y0 + block_size; i++)
@@ -415,26 +1441,21 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
     {
       line = (guint32 *) (buffer->data + i * buffer->stride);
       bottom = (guint32 *) (buffer->data + (i + block_size) * buffer->stride);
-      bottom_hash = 0;
-      hash = 0;
       skyline_pixels = 0;
 
+      /* Pixels without a previous one are sent as their delta to 0 */
       if (prev && i < prev->height)
-        prev_line = (guint32 *) (prev->data + i * prev->stride);
+        {
+          prev_line = (guint32 *) (prev->data + i * prev->stride);
+          prev_width = MIN (width, prev->width);
+          compute_deltas (deltas, line, prev_line, prev_width);
+        }
       else
-        prev_line = NULL;
+        prev_width = 0;
+      memcpy (deltas + prev_width, line + prev_width, (width - prev_width) * sizeof deltas[0]);
 
       for (j = x0; j < x0 + block_size; j++)
         {
-          hash = hash * prime;
-          if (j < width)
-            hash += line[j];
-          if (i + block_size < height)
-            {
-              bottom_hash = bottom_hash * prime;
-              if (j < width)
-                bottom_hash += bottom[j];
-            }
           if (i < skyline[j])
             skyline_pixels = 0;
           else
@@ -444,66 +1465,48 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
       for (j = x0; j < x1; j++)
         {
           if (i < skyline[j])
-            encode_pixel (&encoder, line[j], line[j]);
-          else if (prev)
+            encode_pixel (&encoder, line[j], 0);
+          else if (skyline_pixels >= block_size &&
+                   encode_reference (&encoder, buffer, prev, tiles, block_hashes[j], j, i))
             {
-              /* FIXME: Add back overlap exception
-               * for consecutive blocks */
-
-              h = block_hashes[j];
-              entry = lookup_block (prev, h);
-              if (entry && entry->count < 2 &&
-                  skyline_pixels >= block_size &&
-                  verify_block_match (buffer, j, i, prev, entry) &&
-                  (entry->x != j || entry->y != i))
-                {
-                  matches++;
-                  encode_block (&encoder, entry, j, i);
+              matches++;
 
-                  for (k = 0; k < block_size; k++)
-                    skyline[j + k] = i + block_size;
+              for (k = 0; k < block_size; k++)
+                skyline[j + k] = i + block_size;
 
-                  encode_pixel (&encoder, line[j], line[j]);
-                }
-              else
-                {
-                  if (prev_line && j < prev->width)
-                    encode_pixel (&encoder, line[j],
-                                  prev_line[j]);
-                  else
-                    encode_pixel (&encoder, line[j], 0);
-                }
+              encode_pixel (&encoder, line[j], 0);
             }
           else
-            encode_pixel (&encoder, line[j], 0);
+            encode_pixel (&encoder, line[j], deltas[j]);
 
           if (i < skyline[j + block_size])
             skyline_pixels = 0;
           else
             skyline_pixels++;
 
-          /* Insert block in hash table if we're on a
-           * grid point. */
-          if (((i | j) & block_mask) == 0 && !buffer->encoded)
-            insert_block (buffer, block_hashes[j], j, i);
+          /* Keep the hashes of the blocks on the grid for the
+           * table */
+          if (((i | j) & block_mask) == 0)
+            buffer->block_hashes[(buffer->block_stride * i + j) / block_size] = block_hashes[j];
+        }
 
-          /* Update sliding block hash */
-          block_hashes[j] =
-            block_hashes[j] * vprime + bottom_hash -
-            hash * end_vprime;
+      /* Update sliding block hashes */
+      if (i + block_size < height)
+        hash_line (bottom_hashes, bottom, 0, width, width);
+      else
+        memset (bottom_hashes, 0, width * sizeof bottom_hashes[0]);
+      mix_block_hashes (block_hashes, bottom_hashes, line_hashes[i & block_mask], width);
 
-          if (i + block_size < height)
-            {
-              bottom_hash = bottom_hash * prime - bottom[j] * end_prime;
-              if (j + block_size < width)
-                bottom_hash += bottom[j + block_size];
-            }
-          hash = hash * prime - line[j] * end_prime;
-          if  (j + block_size < width)
-            hash += line[j + block_size] ;
-        }
+      /* The bottom line is block_size lines ahead */
+      tmp = line_hashes[i & block_mask];
+      line_hashes[i & block_mask] = bottom_hashes;
+      bottom_hashes = tmp;
     }
 
+  buffer->have_block_hashes = TRUE;
+
+  if (tiles)
+    encode_tile_saves (&encoder, buffer, prev, tiles, NULL);
   encoder_flush (&encoder);
 
 #if 0
@@ -523,6 +1526,8 @@ broadway_buffer_encode (BroadwayBuffer *buffer, BroadwayBuffer *prev, GString *d
 
   g_free (skyline);
   g_free (block_hashes);
+  g_free (hash_storage);
+  g_free (deltas);
 
-  buffer->encoded = TRUE;
+  buffer->encoded_pixels = (gint64) width * height;
 }
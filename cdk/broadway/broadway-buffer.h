@@ -3,18 +3,36 @@
 
 #include "broadway-protocol.h"
 #include <glib-object.h>
+#include <cairo.h>
 
 typedef struct _BroadwayBuffer BroadwayBuffer;
+typedef struct _BroadwayTileStore BroadwayTileStore;
+
+/* The number of tiles that the client keeps, see broadway.js */
+#define BROADWAY_TILE_STORE_SIZE 4096
 
 BroadwayBuffer *broadway_buffer_create     (int             width,
                                             int             height,
                                             guint8         *data,
                                             int             stride);
+BroadwayBuffer *broadway_buffer_create_damaged (BroadwayBuffer       *prev,
+                                                BroadwayBuffer       *reuse,
+                                                guint8               *data,
+                                                int                   stride,
+                                                const cairo_region_t *damage);
 void            broadway_buffer_destroy    (BroadwayBuffer *buffer);
-void            broadway_buffer_encode     (BroadwayBuffer *buffer,
-                                            BroadwayBuffer *prev,
-                                            GString        *dest);
+void            broadway_buffer_encode     (BroadwayBuffer    *buffer,
+                                            BroadwayBuffer    *prev,
+                                            BroadwayTileStore *tiles,
+                                            GString           *dest);
 int             broadway_buffer_get_width  (BroadwayBuffer *buffer);
 int             broadway_buffer_get_height (BroadwayBuffer *buffer);
+gint64          broadway_buffer_get_encoded_pixels (BroadwayBuffer *buffer);
+
+void            broadway_buffer_set_reference (gboolean     reference);
+
+BroadwayTileStore *broadway_tile_store_new   (void);
+void               broadway_tile_store_free  (BroadwayTileStore *tiles);
+void               broadway_tile_store_clear (BroadwayTileStore *tiles);
 
 #endif /* __BROADWAY_BUFFER__ */
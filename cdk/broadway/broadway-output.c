@@ -11,27 +11,135 @@
  *                Basic I/O primitives                                  *
  ************************************************************************/
 
-struct BroadwayOutput {
+/* The output is built once and fanned out to every browser that looks
+ * at the display. Each of these viewers has a thread of its own that
+ * compresses the messages and writes them to its socket, so a slow
+ * connection only holds up itself.
+ *
+ * A viewer that falls too far behind has its queue dropped. Once it
+ * wrote what it was busy with, the main thread gets woken up to send it
+ * the current state of all windows, and it continues from there.
+ */
+
+#define MAX_QUEUED_BYTES (8 * 1024 * 1024)
+#define MAX_QUEUE_DELAY (2 * G_USEC_PER_SEC)
+
+typedef struct {
+  BroadwayWSOpCode code;
+  GBytes *data;
+  gint64 queue_time;
+} BroadwayMessage;
+
+struct BroadwayViewer {
   GOutputStream *out;
+  GThread *thread;
+  GCancellable *cancellable;
+  GSource *wakeup;              /* dispatched in the main thread */
+
+  /* Protected by the mutex */
+  GMutex mutex;
+  GCond cond;
+  GQueue queue;
+  gsize queued_bytes;
+  gboolean dropping;            /* until it gets resynced */
+  gboolean resync_requested;
+  gboolean error;
+  gboolean closing;
+  BroadwayOutputStats stats;
+
+  /* Only used by the thread. The compressor lives as long as the
+   * connection. With permessage-deflate and context takeover it keeps
+   * its dictionary between messages, otherwise it is reset after every
+   * message.
+   */
+  int compression_level;
+  gboolean deflate_messages;
+  gboolean context_takeover;
+  GConverter *compressor;
+  GByteArray *compressed;
+};
+
+struct BroadwayOutput {
   GString *buf;
-  int error;
   guint32 serial;
+  GPtrArray *viewers;
+  BroadwayViewer *target;       /* the only one to get messages, while resyncing it */
+  BroadwayTileStore *tiles;     /* what all viewers have */
 };
 
+/* Runs @len bytes of @data through @converter, appending the result to
+ * @dest. With %G_CONVERTER_FLUSH everything is flushed out, with
+ * %G_CONVERTER_INPUT_AT_END the stream is finished.
+ */
+gboolean
+broadway_zlib_convert (GConverter      *converter,
+                       const guchar    *data,
+                       gsize            len,
+                       GConverterFlags  flags,
+                       GByteArray      *dest)
+{
+  GConverterResult res;
+  GError *error = NULL;
+
+  do
+    {
+      gsize pos, bytes_read = 0, bytes_written = 0;
+
+      pos = dest->len;
+      g_byte_array_set_size (dest, pos + MAX (len, 4096));
+      res = g_converter_convert (converter,
+                                 data, len,
+                                 dest->data + pos, dest->len - pos,
+                                 flags, &bytes_read, &bytes_written, &error);
+      g_byte_array_set_size (dest, pos + bytes_written);
+
+      if (res == G_CONVERTER_ERROR)
+        {
+          if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+            {
+              g_clear_error (&error);
+              continue;
+            }
+
+          g_warning ("compression failed: %s", error->message);
+          g_error_free (error);
+          return FALSE;
+        }
+
+      data += bytes_read;
+      len -= bytes_read;
+    }
+  while (res != G_CONVERTER_FINISHED &&
+         !(res == G_CONVERTER_FLUSHED && len == 0));
+
+  return TRUE;
+}
+
 static void
-broadway_output_send_cmd (BroadwayOutput *output,
-			  gboolean fin, BroadwayWSOpCode code,
-			  const void *buf, gsize count)
+broadway_message_free (BroadwayMessage *message)
+{
+  g_bytes_unref (message->data);
+  g_free (message);
+}
+
+static gboolean
+broadway_viewer_write_frame (BroadwayViewer *viewer,
+                             BroadwayWSOpCode code,
+                             gboolean compressed,
+                             const void *buf, gsize count,
+                             gsize *bytes_sent)
 {
   gboolean mask = FALSE;
   guchar header[16];
+  GOutputVector vectors[2];
+  GError *error = NULL;
   size_t p;
 
   gboolean mid_header = count > 125 && count <= 65535;
   gboolean long_header = count > 65535;
 
   /* NB. big-endian spec => bit 0 == MSB */
-  header[0] = ( (fin ? 0x80 : 0) | (code & 0x0f) );
+  header[0] = ( 0x80 | (compressed ? 0x40 : 0) | (code & 0x0f) );
   header[1] = ( (mask ? 0x80 : 0) |
                 (mid_header ? 126 : long_header ? 127 : count) );
   p = 2;
@@ -46,41 +154,335 @@ broadway_output_send_cmd (BroadwayOutput *output,
       p += 8;
     }
   // FIXME: if we are paranoid we should 'mask' the data
-  // FIXME: we should really emit these as a single write
-  g_output_stream_write_all (output->out, header, p, NULL, NULL, NULL);
-  g_output_stream_write_all (output->out, buf, count, NULL, NULL, NULL);
+
+  vectors[0].buffer = header;
+  vectors[0].size = p;
+  vectors[1].buffer = buf;
+  vectors[1].size = count;
+
+  if (!g_output_stream_writev_all (viewer->out, vectors, G_N_ELEMENTS (vectors),
+                                   NULL, viewer->cancellable, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("client write error: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  *bytes_sent = p + count;
+
+  return TRUE;
+}
+
+static gboolean
+broadway_viewer_send_message (BroadwayViewer *viewer,
+                              BroadwayMessage *message,
+                              gsize *bytes_sent,
+                              gint64 *compress_time)
+{
+  const guchar *data;
+  gsize len;
+  gboolean ok;
+
+  data = g_bytes_get_data (message->data, &len);
+
+  if (message->code != BROADWAY_WS_BINARY)
+    return broadway_viewer_write_frame (viewer, message->code, FALSE,
+                                        data, len, bytes_sent);
+
+  if (viewer->compressor == NULL)
+    viewer->compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW,
+                                                             viewer->compression_level));
+
+  *compress_time = g_get_monotonic_time ();
+
+  g_byte_array_set_size (viewer->compressed, 0);
+  if (viewer->deflate_messages)
+    {
+      /* RFC 7692: flush to a byte boundary and drop the 00 00 ff ff
+       * that ends up at the end */
+      ok = broadway_zlib_convert (viewer->compressor, data, len,
+                                  G_CONVERTER_FLUSH, viewer->compressed);
+      if (ok && viewer->compressed->len >= 4)
+        g_byte_array_set_size (viewer->compressed, viewer->compressed->len - 4);
+      if (!viewer->context_takeover)
+        g_converter_reset (viewer->compressor);
+    }
+  else
+    {
+      /* The client inflates every message on its own */
+      ok = broadway_zlib_convert (viewer->compressor, data, len,
+                                  G_CONVERTER_INPUT_AT_END, viewer->compressed);
+      g_converter_reset (viewer->compressor);
+    }
+
+  *compress_time = g_get_monotonic_time () - *compress_time;
+
+  if (!ok)
+    return FALSE;
+
+  return broadway_viewer_write_frame (viewer, BROADWAY_WS_BINARY, viewer->deflate_messages,
+                                      viewer->compressed->data, viewer->compressed->len,
+                                      bytes_sent);
 }
 
-void broadway_output_pong (BroadwayOutput *output)
+static gpointer
+broadway_viewer_thread (gpointer data)
 {
-  broadway_output_send_cmd (output, TRUE, BROADWAY_WS_CNX_PONG, NULL, 0);
+  BroadwayViewer *viewer = data;
+  BroadwayMessage *message;
+  gsize bytes_sent;
+  gint64 compress_time, latency;
+  gboolean ok;
+
+  g_mutex_lock (&viewer->mutex);
+
+  while (TRUE)
+    {
+      message = g_queue_pop_head (&viewer->queue);
+      if (message == NULL)
+        {
+          if (viewer->closing)
+            break;
+
+          if (viewer->dropping && !viewer->resync_requested)
+            {
+              viewer->resync_requested = TRUE;
+              g_source_set_ready_time (viewer->wakeup, 0);
+            }
+
+          g_cond_wait (&viewer->cond, &viewer->mutex);
+          continue;
+        }
+
+      viewer->queued_bytes -= g_bytes_get_size (message->data);
+      g_mutex_unlock (&viewer->mutex);
+
+      bytes_sent = 0;
+      compress_time = 0;
+      ok = broadway_viewer_send_message (viewer, message, &bytes_sent, &compress_time);
+      latency = g_get_monotonic_time () - message->queue_time;
+
+      g_mutex_lock (&viewer->mutex);
+
+      if (!ok)
+        {
+          broadway_message_free (message);
+          viewer->error = TRUE;
+          g_source_set_ready_time (viewer->wakeup, 0);
+          break;
+        }
+
+      viewer->stats.bytes_encoded += g_bytes_get_size (message->data);
+      viewer->stats.bytes_sent += bytes_sent;
+      viewer->stats.compress_time += compress_time;
+      if (message->code == BROADWAY_WS_BINARY)
+        {
+          viewer->stats.messages_sent++;
+          viewer->stats.latency_total += latency;
+          viewer->stats.latency_max = MAX (viewer->stats.latency_max, latency);
+        }
+
+      broadway_message_free (message);
+    }
+
+  g_mutex_unlock (&viewer->mutex);
+
+  return NULL;
 }
 
-int
-broadway_output_flush (BroadwayOutput *output)
+static void
+broadway_viewer_queue (BroadwayViewer *viewer,
+                       BroadwayWSOpCode code,
+                       GBytes *data)
 {
-  if (output->buf->len == 0)
-    return TRUE;
+  BroadwayMessage *message, *oldest;
+  gsize size = g_bytes_get_size (data);
+  gint64 now = g_get_monotonic_time ();
 
-  broadway_output_send_cmd (output, TRUE, BROADWAY_WS_BINARY,
-                            output->buf->str, output->buf->len);
+  g_mutex_lock (&viewer->mutex);
 
-  g_string_set_size (output->buf, 0);
+  if (viewer->error)
+    {
+      g_mutex_unlock (&viewer->mutex);
+      return;
+    }
 
-  return !output->error;
+  /* Nothing in the queue is worth waiting for when a newer state of
+   * the windows can be sent instead */
+  oldest = g_queue_peek_head (&viewer->queue);
+  if (code == BROADWAY_WS_BINARY && !viewer->dropping && oldest != NULL &&
+      (viewer->queued_bytes + size > MAX_QUEUED_BYTES ||
+       now - oldest->queue_time > MAX_QUEUE_DELAY))
+    {
+      viewer->stats.messages_dropped += g_queue_get_length (&viewer->queue);
+      g_queue_clear_full (&viewer->queue, (GDestroyNotify) broadway_message_free);
+      viewer->queued_bytes = 0;
+      viewer->dropping = TRUE;
+      g_cond_signal (&viewer->cond);
+    }
 
+  if (code == BROADWAY_WS_BINARY && viewer->dropping)
+    {
+      viewer->stats.messages_dropped++;
+      g_mutex_unlock (&viewer->mutex);
+      return;
+    }
+
+  message = g_new (BroadwayMessage, 1);
+  message->code = code;
+  message->data = g_bytes_ref (data);
+  message->queue_time = now;
+
+  g_queue_push_tail (&viewer->queue, message);
+  viewer->queued_bytes += size;
+  g_cond_signal (&viewer->cond);
+
+  g_mutex_unlock (&viewer->mutex);
+}
+
+static gboolean
+broadway_viewer_wakeup_dispatch (GSource     *source,
+                                 GSourceFunc  callback,
+                                 gpointer     user_data)
+{
+  g_source_set_ready_time (source, -1);
+
+  return callback (user_data);
+}
+
+static GSourceFuncs broadway_viewer_wakeup_funcs = {
+  NULL, NULL,
+  broadway_viewer_wakeup_dispatch,
+  NULL
+};
+
+/* Starts sending to @out. @deflate_messages means that the client
+ * negotiated the permessage-deflate extension, and @context_takeover
+ * that it lets us keep the dictionary between messages.
+ *
+ * @wakeup_func gets called in the main context when the connection
+ * failed, or when the viewer needs a resync after dropping messages.
+ */
+BroadwayViewer *
+broadway_viewer_new (GOutputStream *out,
+                     int            level,
+                     gboolean       deflate_messages,
+                     gboolean       context_takeover,
+                     GSourceFunc    wakeup_func,
+                     gpointer       user_data)
+{
+  BroadwayViewer *viewer;
+
+  viewer = g_new0 (BroadwayViewer, 1);
+
+  viewer->out = g_object_ref (out);
+  viewer->cancellable = g_cancellable_new ();
+  viewer->compression_level = level;
+  viewer->deflate_messages = deflate_messages;
+  viewer->context_takeover = context_takeover;
+  viewer->compressed = g_byte_array_new ();
+
+  viewer->wakeup = g_source_new (&broadway_viewer_wakeup_funcs, sizeof (GSource));
+  g_source_set_name (viewer->wakeup, "[broadway] viewer wakeup");
+  g_source_set_callback (viewer->wakeup, wakeup_func, user_data, NULL);
+  g_source_attach (viewer->wakeup, NULL);
+
+  g_mutex_init (&viewer->mutex);
+  g_cond_init (&viewer->cond);
+  g_queue_init (&viewer->queue);
+
+  viewer->thread = g_thread_new ("broadway viewer", broadway_viewer_thread, viewer);
+
+  return viewer;
+}
+
+void
+broadway_viewer_free (BroadwayViewer *viewer)
+{
+  g_mutex_lock (&viewer->mutex);
+  viewer->closing = TRUE;
+  g_cond_signal (&viewer->cond);
+  g_mutex_unlock (&viewer->mutex);
+
+  /* Don't wait for a stalled connection */
+  g_cancellable_cancel (viewer->cancellable);
+  g_thread_join (viewer->thread);
+
+  g_debug ("client output: %" G_GUINT64_FORMAT " bytes, %" G_GUINT64_FORMAT " bytes sent, "
+           "%.1f ms compressing, %" G_GUINT64_FORMAT " messages sent, %" G_GUINT64_FORMAT " dropped, "
+           "latency %.1f ms average, %.1f ms max",
+           viewer->stats.bytes_encoded, viewer->stats.bytes_sent,
+           viewer->stats.compress_time / 1000.,
+           viewer->stats.messages_sent, viewer->stats.messages_dropped,
+           viewer->stats.messages_sent ? viewer->stats.latency_total / 1000. / viewer->stats.messages_sent : 0,
+           viewer->stats.latency_max / 1000.);
+
+  g_source_destroy (viewer->wakeup);
+  g_source_unref (viewer->wakeup);
+  g_queue_clear_full (&viewer->queue, (GDestroyNotify) broadway_message_free);
+  g_cond_clear (&viewer->cond);
+  g_mutex_clear (&viewer->mutex);
+  g_object_unref (viewer->cancellable);
+  g_object_unref (viewer->out);
+  g_clear_object (&viewer->compressor);
+  g_byte_array_unref (viewer->compressed);
+  g_free (viewer);
+}
+
+gboolean
+broadway_viewer_has_error (BroadwayViewer *viewer)
+{
+  gboolean error;
+
+  g_mutex_lock (&viewer->mutex);
+  error = viewer->error;
+  g_mutex_unlock (&viewer->mutex);
+
+  return error;
+}
+
+gboolean
+broadway_viewer_needs_resync (BroadwayViewer *viewer)
+{
+  gboolean needs_resync;
+
+  g_mutex_lock (&viewer->mutex);
+  needs_resync = viewer->resync_requested;
+  g_mutex_unlock (&viewer->mutex);
+
+  return needs_resync;
+}
+
+void
+broadway_viewer_get_stats (BroadwayViewer      *viewer,
+                           BroadwayOutputStats *stats)
+{
+  g_mutex_lock (&viewer->mutex);
+  *stats = viewer->stats;
+  g_mutex_unlock (&viewer->mutex);
+}
+
+void
+broadway_viewer_pong (BroadwayViewer *viewer)
+{
+  GBytes *empty = g_bytes_new (NULL, 0);
+
+  broadway_viewer_queue (viewer, BROADWAY_WS_CNX_PONG, empty);
+  g_bytes_unref (empty);
 }
 
 BroadwayOutput *
-broadway_output_new (GOutputStream *out, guint32 serial)
+broadway_output_new (guint32 serial)
 {
   BroadwayOutput *output;
 
   output = g_new0 (BroadwayOutput, 1);
 
-  output->out = g_object_ref (out);
   output->buf = g_string_new ("");
   output->serial = serial;
+  output->viewers = g_ptr_array_new ();
+  output->tiles = broadway_tile_store_new ();
 
   return output;
 }
@@ -88,8 +490,75 @@ broadway_output_new (GOutputStream *out, guint32 serial)
 void
 broadway_output_free (BroadwayOutput *output)
 {
-  g_object_unref (output->out);
-  free (output);
+  g_string_free (output->buf, TRUE);
+  g_ptr_array_unref (output->viewers);
+  broadway_tile_store_free (output->tiles);
+  g_free (output);
+}
+
+void
+broadway_output_add_viewer (BroadwayOutput *output,
+                            BroadwayViewer *viewer)
+{
+  g_ptr_array_add (output->viewers, viewer);
+}
+
+void
+broadway_output_remove_viewer (BroadwayOutput *output,
+                               BroadwayViewer *viewer)
+{
+  g_ptr_array_remove (output->viewers, viewer);
+  if (output->target == viewer)
+    output->target = NULL;
+}
+
+/* Until broadway_output_end_resync(), messages only go to @viewer. They
+ * don't use up serials: the state they bring it to is what the others
+ * had at the last one. Tiles aren't used, and the ones from before are
+ * forgotten, as @viewer doesn't have them.
+ */
+void
+broadway_output_begin_resync (BroadwayOutput *output,
+                              BroadwayViewer *viewer)
+{
+  broadway_output_flush (output);
+
+  g_mutex_lock (&viewer->mutex);
+  viewer->dropping = FALSE;
+  viewer->resync_requested = FALSE;
+  g_mutex_unlock (&viewer->mutex);
+
+  output->target = viewer;
+  broadway_tile_store_clear (output->tiles);
+}
+
+void
+broadway_output_end_resync (BroadwayOutput *output)
+{
+  broadway_output_flush (output);
+  output->target = NULL;
+}
+
+void
+broadway_output_flush (BroadwayOutput *output)
+{
+  GBytes *message;
+  guint i;
+
+  if (output->buf->len == 0)
+    return;
+
+  message = g_string_free_to_bytes (output->buf);
+  output->buf = g_string_new ("");
+
+  if (output->target)
+    broadway_viewer_queue (output->target, BROADWAY_WS_BINARY, message);
+  else
+    for (i = 0; i < output->viewers->len; i++)
+      broadway_viewer_queue (g_ptr_array_index (output->viewers, i),
+                             BROADWAY_WS_BINARY, message);
+
+  g_bytes_unref (message);
 }
 
 guint32
@@ -158,7 +627,7 @@ static void
 write_header(BroadwayOutput *output, char op)
 {
   append_char (output, op);
-  append_uint32 (output, output->serial++);
+  append_uint32 (output, output->target ? output->serial - 1 : output->serial++);
 }
 
 void
@@ -202,6 +671,13 @@ broadway_output_disconnected (BroadwayOutput *output)
   write_header (output, BROADWAY_OP_DISCONNECTED);
 }
 
+/* Makes the client forget all surfaces */
+void
+broadway_output_reset (BroadwayOutput *output)
+{
+  write_header (output, BROADWAY_OP_RESET);
+}
+
 void
 broadway_output_show_surface(BroadwayOutput *output,  int id)
 {
@@ -292,10 +768,7 @@ broadway_output_put_buffer (BroadwayOutput *output,
                             BroadwayBuffer *prev_buffer,
                             BroadwayBuffer *buffer)
 {
-  gsize len;
   int w, h;
-  GZlibCompressor *compressor;
-  GOutputStream *out, *out_mem;
   GString *encoded;
 
   write_header (output, BROADWAY_OP_PUT_BUFFER);
@@ -308,25 +781,12 @@ broadway_output_put_buffer (BroadwayOutput *output,
   append_uint16 (output, h);
 
   encoded = g_string_new ("");
-  broadway_buffer_encode (buffer, prev_buffer, encoded);
-
-  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, -1);
-  out_mem = g_memory_output_stream_new_resizable ();
-  out = g_converter_output_stream_new (out_mem, G_CONVERTER (compressor));
-  g_object_unref (compressor);
-
-  if (!g_output_stream_write_all (out, encoded->str, encoded->len,
-                                  NULL, NULL, NULL) ||
-      !g_output_stream_close (out, NULL, NULL))
-    g_warning ("compression failed");
-
-
-  len = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (out_mem));
-  append_uint32 (output, len);
+  broadway_buffer_encode (buffer, prev_buffer,
+                          output->target ? NULL : output->tiles,
+                          encoded);
 
-  g_string_append_len (output->buf, g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (out_mem)), len);
+  append_uint32 (output, encoded->len);
+  g_string_append_len (output->buf, encoded->str, encoded->len);
 
   g_string_free (encoded, TRUE);
-  g_object_unref (out);
-  g_object_unref (out_mem);
 }
@@ -7,6 +7,7 @@
 #include "broadway-buffer.h"
 
 typedef struct BroadwayOutput BroadwayOutput;
+typedef struct BroadwayViewer BroadwayViewer;
 
 typedef enum {
   BROADWAY_WS_CONTINUATION = 0,
@@ -17,11 +18,39 @@ typedef enum {
   BROADWAY_WS_CNX_PONG = 0xa
 } BroadwayWSOpCode;
 
-BroadwayOutput *broadway_output_new             (GOutputStream  *out,
-						 guint32         serial);
+typedef struct {
+  guint64 bytes_encoded;        /* messages before compression */
+  guint64 bytes_sent;           /* on the wire, with frame headers */
+  gint64  compress_time;        /* in microseconds */
+  guint64 messages_sent;
+  guint64 messages_dropped;     /* because the client fell behind */
+  gint64  latency_total;        /* from queueing to written, in microseconds */
+  gint64  latency_max;
+} BroadwayOutputStats;
+
+BroadwayViewer *broadway_viewer_new             (GOutputStream  *out,
+                                                 int             level,
+                                                 gboolean        deflate_messages,
+                                                 gboolean        context_takeover,
+                                                 GSourceFunc     wakeup_func,
+                                                 gpointer        user_data);
+void            broadway_viewer_free            (BroadwayViewer *viewer);
+gboolean        broadway_viewer_has_error       (BroadwayViewer *viewer);
+gboolean        broadway_viewer_needs_resync    (BroadwayViewer *viewer);
+void            broadway_viewer_get_stats       (BroadwayViewer      *viewer,
+                                                 BroadwayOutputStats *stats);
+void            broadway_viewer_pong            (BroadwayViewer *viewer);
+
+BroadwayOutput *broadway_output_new             (guint32         serial);
 void            broadway_output_free            (BroadwayOutput *output);
-int             broadway_output_flush           (BroadwayOutput *output);
-int             broadway_output_has_error       (BroadwayOutput *output);
+void            broadway_output_add_viewer      (BroadwayOutput *output,
+                                                 BroadwayViewer *viewer);
+void            broadway_output_remove_viewer   (BroadwayOutput *output,
+                                                 BroadwayViewer *viewer);
+void            broadway_output_begin_resync    (BroadwayOutput *output,
+                                                 BroadwayViewer *viewer);
+void            broadway_output_end_resync      (BroadwayOutput *output);
+void            broadway_output_flush           (BroadwayOutput *output);
 void            broadway_output_set_next_serial (BroadwayOutput *output,
 						 guint32         serial);
 guint32         broadway_output_get_next_serial (BroadwayOutput *output);
@@ -33,6 +62,7 @@ void            broadway_output_new_surface     (BroadwayOutput *output,
 						 int             h,
 						 gboolean        is_temp);
 void            broadway_output_disconnected    (BroadwayOutput *output);
+void            broadway_output_reset           (BroadwayOutput *output);
 void            broadway_output_show_surface    (BroadwayOutput *output,
 						 int             id);
 void            broadway_output_hide_surface    (BroadwayOutput *output,
@@ -62,8 +92,14 @@ void            broadway_output_grab_pointer    (BroadwayOutput *output,
 						 int id,
 						 gboolean owner_event);
 guint32         broadway_output_ungrab_pointer  (BroadwayOutput *output);
-void            broadway_output_pong            (BroadwayOutput *output);
 void            broadway_output_set_show_keyboard (BroadwayOutput *output,
                                                    gboolean show);
 
+
+gboolean        broadway_zlib_convert           (GConverter      *converter,
+                                                 const guchar    *data,
+                                                 gsize            len,
+                                                 GConverterFlags  flags,
+                                                 GByteArray      *dest);
+
 #endif /* __BROADWAY_H__ */
@@ -43,6 +43,7 @@ typedef enum {
   BROADWAY_OP_DISCONNECTED = 'D',
   BROADWAY_OP_PUT_BUFFER = 'b',
   BROADWAY_OP_SET_SHOW_KEYBOARD = 'k',
+  BROADWAY_OP_RESET = 'X',
 } BroadwayOpType;
 
 typedef struct {
@@ -157,7 +158,8 @@ typedef enum {
   BROADWAY_REQUEST_GRAB_POINTER,
   BROADWAY_REQUEST_UNGRAB_POINTER,
   BROADWAY_REQUEST_FOCUS_WINDOW,
-  BROADWAY_REQUEST_SET_SHOW_KEYBOARD
+  BROADWAY_REQUEST_SET_SHOW_KEYBOARD,
+  BROADWAY_REQUEST_DESTROY_BUFFER
 } BroadwayRequestType;
 
 typedef struct {
@@ -186,14 +188,32 @@ typedef struct {
   BroadwayRect rects[1];
 } BroadwayRequestTranslate;
 
+/* Window surfaces live in shared memory buffers that the client reuses.
+ * The daemon keeps a buffer mapped until the client destroys it, and
+ * sends a release reply once it has read an update, after which the
+ * client may draw into the buffer again.
+ *
+ * The rectangles are what changed since the last update of the window.
+ * Without any, all of it may have.
+ */
+#define BROADWAY_MAX_DAMAGE_RECTS 64
+
 typedef struct {
   BroadwayRequestBase base;
   guint32 id;
   char name[36];
   guint32 width;
   guint32 height;
+  guint32 size;                 /* of the whole buffer */
+  guint32 n_rects;
+  BroadwayRect rects[1];
 } BroadwayRequestUpdate;
 
+typedef struct {
+  BroadwayRequestBase base;
+  char name[36];
+} BroadwayRequestDestroyBuffer;
+
 typedef struct {
   BroadwayRequestBase base;
   guint32 id;
@@ -248,6 +268,7 @@ typedef union {
   BroadwayRequestTranslate translate;
   BroadwayRequestFocusWindow focus_window;
   BroadwayRequestSetShowKeyboard set_show_keyboard;
+  BroadwayRequestDestroyBuffer destroy_buffer;
 } BroadwayRequest;
 
 typedef enum {
@@ -256,7 +277,8 @@ typedef enum {
   BROADWAY_REPLY_QUERY_MOUSE,
   BROADWAY_REPLY_NEW_WINDOW,
   BROADWAY_REPLY_GRAB_POINTER,
-  BROADWAY_REPLY_UNGRAB_POINTER
+  BROADWAY_REPLY_UNGRAB_POINTER,
+  BROADWAY_REPLY_RELEASE_BUFFER
 } BroadwayReplyType;
 
 typedef struct {
@@ -288,6 +310,11 @@ typedef struct {
   BroadwayInputMsg msg;
 } BroadwayReplyEvent;
 
+typedef struct {
+  BroadwayReplyBase base;
+  char name[36];
+} BroadwayReplyReleaseBuffer;
+
 typedef union {
   BroadwayReplyBase base;
   BroadwayReplyEvent event;
@@ -295,6 +322,7 @@ typedef union {
   BroadwayReplyNewWindow new_window;
   BroadwayReplyGrabPointer grab_pointer;
   BroadwayReplyUngrabPointer ungrab_pointer;
+  BroadwayReplyReleaseBuffer release_buffer;
 } BroadwayReply;
 
 #endif /* __BROADWAY_PROTOCOL_H__ */
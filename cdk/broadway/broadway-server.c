@@ -49,11 +49,12 @@ struct _BroadwayServer {
   guint32 id_counter;
   guint32 saved_serial;
   guint64 last_seen_time;
-  BroadwayInput *input;
+  GList *inputs; /* one for every browser looking at the display */
   GList *input_messages;
   guint process_input_idle;
 
   GHashTable *id_ht;
+  GHashTable *shm_buffers; /* name => ShmSurfaceData, mapped until the client destroys them */
   GList *toplevels;
   BroadwayWindow *root;
   gint32 focused_window_id; /* -1 => none */
@@ -78,6 +79,8 @@ struct _BroadwayServer {
   int future_root_y;
   guint32 future_state;
   int future_mouse_in_toplevel;
+
+  int compression_level;
 };
 
 struct _BroadwayServerClass
@@ -95,13 +98,15 @@ typedef struct HttpRequest {
 
 struct BroadwayInput {
   BroadwayServer *server;
-  BroadwayOutput *output;
+  BroadwayViewer *viewer;
   GIOStream *connection;
   GByteArray *buffer;
   GSource *source;
   gboolean seen_time;
   gint64 time_base;
   gboolean active;
+  GConverter *decompressor; /* if permessage-deflate was negotiated */
+  GByteArray *inflated;
 };
 
 struct BroadwayWindow {
@@ -115,13 +120,15 @@ struct BroadwayWindow {
   gint32 transient_for;
 
   BroadwayBuffer *buffer;
+  BroadwayBuffer *prev_buffer; /* what @buffer was made from, to reuse */
   gboolean buffer_synced;
 
-  char *cached_surface_name;
-  cairo_surface_t *cached_surface;
+  BroadwayWindowStats stats;
 };
 
-static void broadway_server_resync_windows (BroadwayServer *server);
+static void broadway_server_resync_windows (BroadwayServer *server,
+                                            BroadwayViewer *viewer);
+static void shm_data_unmap (void *_data);
 
 static GType broadway_server_get_type (void);
 
@@ -137,7 +144,10 @@ broadway_server_init (BroadwayServer *server)
   server->saved_serial = 1;
   server->last_seen_time = 1;
   server->id_ht = g_hash_table_new (NULL, NULL);
+  server->shm_buffers = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, shm_data_unmap);
   server->id_counter = 0;
+  server->compression_level = -1;
 
   root = g_new0 (BroadwayWindow, 1);
   root->id = server->id_counter++;
@@ -160,6 +170,7 @@ broadway_server_finalize (GObject *object)
   g_free (server->address);
   g_free (server->ssl_cert);
   g_free (server->ssl_key);
+  g_hash_table_destroy (server->shm_buffers);
 
   G_OBJECT_CLASS (broadway_server_parent_class)->finalize (object);
 }
@@ -187,9 +198,29 @@ http_request_free (HttpRequest *request)
 static void
 broadway_input_free (BroadwayInput *input)
 {
+  BroadwayServer *server = input->server;
+
+  server->inputs = g_list_remove (server->inputs, input);
+
+  if (server->output)
+    {
+      broadway_output_remove_viewer (server->output, input->viewer);
+
+      if (server->inputs == NULL)
+        {
+          server->saved_serial = broadway_output_get_next_serial (server->output);
+          broadway_output_free (server->output);
+          server->output = NULL;
+        }
+    }
+
+  broadway_viewer_free (input->viewer);
   g_object_unref (input->connection);
   g_byte_array_free (input->buffer, FALSE);
   g_source_destroy (input->source);
+  g_clear_object (&input->decompressor);
+  if (input->inflated)
+    g_byte_array_unref (input->inflated);
   g_free (input);
 }
 
@@ -447,6 +478,9 @@ parse_input_message (BroadwayInput *input, const unsigned char *message)
       input->time_base = time_ - (server->last_seen_time + 5000);
     }
     time_ = time_ - input->time_base;
+
+    /* Don't go back in time when several browsers send events */
+    time_ = MAX (time_, (gint64) server->last_seen_time);
   }
 
   server->last_seen_time = time_;
@@ -563,7 +597,7 @@ parse_input (BroadwayInput *input)
     {
       gsize len, payload_len;
       BroadwayWSOpCode code;
-      gboolean is_mask, fin;
+      gboolean is_mask, fin, compressed;
       guchar *buf, *data, *mask;
 
       buf = input->buffer->data;
@@ -574,6 +608,7 @@ parse_input (BroadwayInput *input)
 #endif
 
       fin = buf[0] & 0x80;
+      compressed = buf[0] & 0x40;
       code = buf[0] & 0x0f;
       payload_len = buf[1] & 0x7f;
       is_mask = buf[1] & 0x80;
@@ -623,13 +658,27 @@ parse_input (BroadwayInput *input)
             g_warning ("can't yet accept fragmented input");
 #endif
           }
+        else if (compressed && input->decompressor)
+          {
+            static const guchar tail[] = { 0x00, 0x00, 0xff, 0xff };
+
+            /* Every message is compressed on its own, we asked for
+             * client_no_context_takeover */
+            g_byte_array_set_size (input->inflated, 0);
+            if (broadway_zlib_convert (input->decompressor, data, payload_len,
+                                       G_CONVERTER_FLUSH, input->inflated) &&
+                broadway_zlib_convert (input->decompressor, tail, sizeof tail,
+                                       G_CONVERTER_FLUSH, input->inflated))
+              parse_input_message (input, input->inflated->data);
+            g_converter_reset (input->decompressor);
+          }
         else
           {
             parse_input_message (input, data);
           }
         break;
       case BROADWAY_WS_CNX_PING:
-        broadway_output_pong (input->output);
+        broadway_viewer_pong (input->viewer);
         break;
       case BROADWAY_WS_CNX_PONG:
         break; /* we never send pings, but tolerate pongs */
@@ -688,8 +737,6 @@ broadway_server_read_all_input_nonblocking (BroadwayInput *input)
 	  return TRUE;
 	}
 
-      if (input->server->input == input)
-	input->server->input = NULL;
       broadway_input_free (input);
       if (res < 0)
 	{
@@ -708,7 +755,13 @@ broadway_server_read_all_input_nonblocking (BroadwayInput *input)
 static void
 broadway_server_consume_all_input (BroadwayServer *server)
 {
-  broadway_server_read_all_input_nonblocking (server->input);
+  GList *l, *next;
+
+  for (l = server->inputs; l != NULL; l = next)
+    {
+      next = l->next;
+      broadway_server_read_all_input_nonblocking (l->data);
+    }
 
   /* Since we're parsing input but not processing the resulting messages
      we might not get a readable callback on the stream, so queue an idle to
@@ -754,13 +807,8 @@ broadway_server_get_screen_size (BroadwayServer   *server,
 void
 broadway_server_flush (BroadwayServer *server)
 {
-  if (server->output &&
-      !broadway_output_flush (server->output))
-    {
-      server->saved_serial = broadway_output_get_next_serial (server->output);
-      broadway_output_free (server->output);
-      server->output = NULL;
-    }
+  if (server->output)
+    broadway_output_flush (server->output);
 }
 
 #if 0
@@ -779,10 +827,10 @@ broadway_server_block_for_input (BroadwayServer *server, char op,
 
   broadway_server_flush (server);
 
-  if (server->input == NULL)
+  if (server->inputs == NULL)
     return NULL;
 
-  input = server->input;
+  input = server->inputs->data;
 
   while (TRUE) {
     /* Check for existing reply in queue */
@@ -968,6 +1016,67 @@ generate_handshake_response_wsietf_v7 (const gchar *key)
   return g_base64_encode (digest, digest_len);
 }
 
+/* Looks for an acceptable permessage-deflate offer (RFC 7692) in a
+ * Sec-WebSocket-Extensions header. We can't use a smaller window than
+ * the default, and don't understand any other extensions.
+ */
+static gboolean
+parse_deflate_offer (const char *extensions,
+                     gboolean   *context_takeover)
+{
+  char **offers;
+  gboolean found = FALSE;
+  int i, j;
+
+  offers = g_strsplit (extensions, ",", 0);
+  for (i = 0; offers[i] != NULL && !found; i++)
+    {
+      char **params = g_strsplit (offers[i], ";", 0);
+      gboolean acceptable;
+
+      acceptable = g_strcmp0 (g_strstrip (params[0]), "permessage-deflate") == 0;
+      *context_takeover = TRUE;
+
+      for (j = 1; params[j] != NULL && acceptable; j++)
+        {
+          char *param = g_strstrip (params[j]);
+
+          if (strcmp (param, "server_no_context_takeover") == 0)
+            *context_takeover = FALSE;
+          else if (strcmp (param, "client_no_context_takeover") == 0 ||
+                   g_str_has_prefix (param, "client_max_window_bits"))
+            ;
+          else if (g_str_has_prefix (param, "server_max_window_bits="))
+            acceptable = atoi (param + strlen ("server_max_window_bits=")) == 15;
+          else
+            acceptable = FALSE;
+        }
+
+      found = acceptable;
+      g_strfreev (params);
+    }
+  g_strfreev (offers);
+
+  return found;
+}
+
+/* The viewer's thread failed to write, or it dropped messages and
+ * wants to catch up */
+static gboolean
+viewer_wakeup_cb (BroadwayInput *input)
+{
+  if (broadway_viewer_has_error (input->viewer))
+    {
+      broadway_input_free (input);
+      return G_SOURCE_REMOVE;
+    }
+
+  if (broadway_viewer_needs_resync (input->viewer))
+    broadway_server_resync_windows (input->server, input->viewer);
+
+  return G_SOURCE_CONTINUE;
+}
+
 static void
 start_input (HttpRequest *request)
 {
@@ -981,6 +1090,8 @@ start_input (HttpRequest *request)
   gsize data_buffer_size;
   GInputStream *in;
   char *key;
+  char *extensions;
+  gboolean deflate, context_takeover;
   GSocket *socket;
   int flag = 1;
 
@@ -992,10 +1103,13 @@ start_input (HttpRequest *request)
   key = NULL;
   origin = NULL;
   host = NULL;
+  extensions = NULL;
   for (i = 0; lines[i] != NULL; i++)
     {
       if ((p = parse_line (lines[i], "Sec-WebSocket-Key")))
         key = p;
+      else if ((p = parse_line (lines[i], "Sec-WebSocket-Extensions")))
+        extensions = p;
       else if ((p = parse_line (lines[i], "Origin")))
         origin = p;
       else if ((p = parse_line (lines[i], "Host")))
@@ -1011,6 +1125,11 @@ start_input (HttpRequest *request)
       return;
     }
 
+  deflate = FALSE;
+  context_takeover = FALSE;
+  if (extensions != NULL && request->server->compression_level != 0)
+    deflate = parse_deflate_offer (extensions, &context_takeover);
+
   if (key != NULL)
     {
       char* accept = generate_handshake_response_wsietf_v7 (key);
@@ -1021,9 +1140,12 @@ start_input (HttpRequest *request)
 			     "%s%s%s"
 			     "Sec-WebSocket-Location: ws://%s/socket\r\n"
 			     "Sec-WebSocket-Protocol: broadway\r\n"
+			     "%s%s"
 			     "\r\n", accept,
 			     origin?"Sec-WebSocket-Origin: ":"", origin?origin:"", origin?"\r\n":"",
-			     host);
+			     host,
+			     deflate ? "Sec-WebSocket-Extensions: permessage-deflate; client_no_context_takeover" : "",
+			     deflate ? (context_takeover ? "\r\n" : "; server_no_context_takeover\r\n") : "");
       g_free (accept);
 
 #ifdef DEBUG_WEBSOCKETS
@@ -1053,8 +1175,16 @@ start_input (HttpRequest *request)
   input->buffer = g_byte_array_sized_new (data_buffer_size);
   g_byte_array_append (input->buffer, data_buffer, data_buffer_size);
 
-  input->output =
-    broadway_output_new (g_io_stream_get_output_stream (request->connection), 0);
+  input->viewer =
+    broadway_viewer_new (g_io_stream_get_output_stream (request->connection),
+                         request->server->compression_level,
+                         deflate, context_takeover,
+                         (GSourceFunc) viewer_wakeup_cb, input);
+  if (deflate)
+    {
+      input->decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+      input->inflated = g_byte_array_new ();
+    }
 
   /* This will free and close the data input stream, but we got all the buffered content already */
   http_request_free (request);
@@ -1082,36 +1212,17 @@ start (BroadwayInput *input)
 
   server = BROADWAY_SERVER (input->server);
 
-  if (server->output)
-    {
-      broadway_output_disconnected (server->output);
-      broadway_output_flush (server->output);
-    }
-
-  if (server->input != NULL)
-    {
-      broadway_input_free (server->input);
-      server->input = NULL;
-    }
-
-  server->input = input;
+  server->inputs = g_list_append (server->inputs, input);
 
-  if (server->output)
-    {
-      server->saved_serial = broadway_output_get_next_serial (server->output);
-      broadway_output_free (server->output);
-    }
-  server->output = input->output;
+  /* Other browsers may be looking already, they keep going */
+  if (server->output == NULL)
+    server->output = broadway_output_new (server->saved_serial);
 
-  broadway_output_set_next_serial (server->output, server->saved_serial);
+  /* Pending ops refer to surfaces the new browser doesn't know yet */
   broadway_output_flush (server->output);
+  broadway_output_add_viewer (server->output, input->viewer);
 
-  broadway_server_resync_windows (server);
-
-  if (server->pointer_grab_window_id != -1)
-    broadway_output_grab_pointer (server->output,
-				  server->pointer_grab_window_id,
-				  server->pointer_grab_owner_events);
+  broadway_server_resync_windows (server, input->viewer);
 
   process_input_messages (server);
 }
@@ -1460,10 +1571,16 @@ broadway_server_destroy_window (BroadwayServer *server,
       g_hash_table_remove (server->id_ht,
 			   GINT_TO_POINTER (id));
 
-      g_free (window->cached_surface_name);
-      if (window->cached_surface != NULL)
-	cairo_surface_destroy (window->cached_surface);
+      if (window->stats.updates > 0)
+        g_debug ("window %d: %" G_GUINT64_FORMAT " updates, %" G_GUINT64_FORMAT " pixels damaged, "
+                 "%" G_GUINT64_FORMAT " encoded, of %" G_GUINT64_FORMAT,
+                 window->id, window->stats.updates, window->stats.damaged_pixels,
+                 window->stats.encoded_pixels, window->stats.window_pixels);
 
+      if (window->buffer)
+        broadway_buffer_destroy (window->buffer);
+      if (window->prev_buffer)
+        broadway_buffer_destroy (window->prev_buffer);
       g_free (window);
     }
 }
@@ -1591,19 +1708,33 @@ broadway_server_window_set_transient_for (BroadwayServer *server,
     }
 }
 
+/* Sets the zlib level for window contents sent to new clients,
+ * -1 for the default. 0 turns off permessage-deflate.
+ */
+void
+broadway_server_set_compression_level (BroadwayServer *server,
+                                       int             level)
+{
+  server->compression_level = level;
+}
+
 gboolean
 broadway_server_has_client (BroadwayServer *server)
 {
   return server->output != NULL;
 }
 
+/* @damage is what changed since the last update, or %NULL if it
+ * isn't known */
 void
 broadway_server_window_update (BroadwayServer *server,
 			       gint id,
-			       cairo_surface_t *surface)
+			       cairo_surface_t *surface,
+			       const cairo_region_t *damage)
 {
   BroadwayWindow *window;
   BroadwayBuffer *buffer;
+  gint64 window_pixels;
 
   if (surface == NULL)
     return;
@@ -1616,23 +1747,68 @@ broadway_server_window_update (BroadwayServer *server,
   g_assert (window->width == cairo_image_surface_get_width (surface));
   g_assert (window->height == cairo_image_surface_get_height (surface));
 
-  buffer = broadway_buffer_create (window->width, window->height,
-                                   cairo_image_surface_get_data (surface),
-                                   cairo_image_surface_get_stride (surface));
+  window_pixels = (gint64) window->width * window->height;
+  window->stats.updates++;
+  window->stats.window_pixels += window_pixels;
+
+  if (damage != NULL && window->buffer != NULL &&
+      broadway_buffer_get_width (window->buffer) == window->width &&
+      broadway_buffer_get_height (window->buffer) == window->height)
+    {
+      cairo_rectangle_int_t rect;
+      int i;
+
+      for (i = 0; i < cairo_region_num_rectangles (damage); i++)
+        {
+          cairo_region_get_rectangle (damage, i, &rect);
+          window->stats.damaged_pixels += (gint64) rect.width * rect.height;
+        }
+
+      buffer = broadway_buffer_create_damaged (window->buffer, window->prev_buffer,
+                                               cairo_image_surface_get_data (surface),
+                                               cairo_image_surface_get_stride (surface),
+                                               damage);
+    }
+  else
+    {
+      window->stats.damaged_pixels += window_pixels;
+
+      buffer = broadway_buffer_create (window->width, window->height,
+                                       cairo_image_surface_get_data (surface),
+                                       cairo_image_surface_get_stride (surface));
+      if (window->prev_buffer)
+        broadway_buffer_destroy (window->prev_buffer);
+    }
 
   if (server->output != NULL)
     {
       window->buffer_synced = TRUE;
       broadway_output_put_buffer (server->output, window->id,
                                   window->buffer, buffer);
+      window->stats.encoded_pixels += broadway_buffer_get_encoded_pixels (buffer);
     }
 
-  if (window->buffer)
-    broadway_buffer_destroy (window->buffer);
-
+  window->prev_buffer = window->buffer;
   window->buffer = buffer;
 }
 
+gboolean
+broadway_server_window_get_stats (BroadwayServer *server,
+				  gint id,
+				  BroadwayWindowStats *stats)
+{
+  BroadwayWindow *window;
+
+  window = g_hash_table_lookup (server->id_ht,
+				GINT_TO_POINTER (id));
+  if (window == NULL)
+    return FALSE;
+
+  *stats = window->stats;
+
+  return TRUE;
+}
+
 gboolean
 broadway_server_window_move_resize (BroadwayServer *server,
 				    gint id,
@@ -1758,8 +1934,6 @@ broadway_server_ungrab_pointer (BroadwayServer *server,
   return serial;
 }
 
-static const cairo_user_data_key_t shm_cairo_key;
-
 typedef struct {
   void *data;
   gsize data_size;
@@ -1777,17 +1951,19 @@ shm_data_unmap (void *_data)
   g_free (data);
 }
 
+/* The client reuses its buffers for many updates, so they stay mapped
+ * until it destroys them. The surface returned only borrows the memory.
+ */
 cairo_surface_t *
 broadway_server_open_surface (BroadwayServer *server,
 			      guint32 id,
 			      char *name,
 			      int width,
-			      int height)
+			      int height,
+			      gsize size)
 {
   BroadwayWindow *window;
   ShmSurfaceData *data;
-  cairo_surface_t *surface;
-  gsize size;
   void *ptr;
 
   window = g_hash_table_lookup (server->id_ht,
@@ -1795,39 +1971,38 @@ broadway_server_open_surface (BroadwayServer *server,
   if (window == NULL)
     return NULL;
 
-  if (window->cached_surface_name != NULL &&
-      strcmp (name, window->cached_surface_name) == 0)
-    return cairo_surface_reference (window->cached_surface);
-
-  size = width * height * sizeof (guint32);
-
-  ptr = map_named_shm (name, size);
-
-  if (ptr == NULL)
+  if ((gsize) width * height * sizeof (guint32) > size)
     return NULL;
 
-  data = g_new0 (ShmSurfaceData, 1);
+  data = g_hash_table_lookup (server->shm_buffers, name);
+  if (data == NULL)
+    {
+      ptr = map_named_shm (name, size);
 
-  data->data = ptr;
-  data->data_size = size;
+      if (ptr == NULL)
+	return NULL;
 
-  surface = cairo_image_surface_create_for_data ((guchar *)data->data,
-						 CAIRO_FORMAT_ARGB32,
-						 width, height,
-						 width * sizeof (guint32));
-  g_assert (surface != NULL);
+      data = g_new0 (ShmSurfaceData, 1);
 
-  cairo_surface_set_user_data (surface, &shm_cairo_key,
-			       data, shm_data_unmap);
+      data->data = ptr;
+      data->data_size = size;
 
-  g_free (window->cached_surface_name);
-  window->cached_surface_name = g_strdup (name);
+      g_hash_table_insert (server->shm_buffers, g_strdup (name), data);
+    }
+  else if (data->data_size < size)
+    return NULL;
 
-  if (window->cached_surface != NULL)
-    cairo_surface_destroy (window->cached_surface);
-  window->cached_surface = cairo_surface_reference (surface);
+  return cairo_image_surface_create_for_data ((guchar *)data->data,
+					      CAIRO_FORMAT_ARGB32,
+					      width, height,
+					      width * sizeof (guint32));
+}
 
-  return surface;
+void
+broadway_server_destroy_buffer (BroadwayServer *server,
+				const char *name)
+{
+  g_hash_table_remove (server->shm_buffers, name);
 }
 
 guint32
@@ -1874,14 +2049,22 @@ broadway_server_new_window (BroadwayServer *server,
   return window->id;
 }
 
+/* Brings @viewer up to date with everything, without bothering the
+ * other viewers */
 static void
-broadway_server_resync_windows (BroadwayServer *server)
+broadway_server_resync_windows (BroadwayServer *server,
+                                BroadwayViewer *viewer)
 {
   GList *l;
 
   if (server->output == NULL)
     return;
 
+  broadway_output_begin_resync (server->output, viewer);
+
+  /* It may have missed some of the last changes */
+  broadway_output_reset (server->output);
+
   /* First create all windows */
   for (l = server->toplevels; l != NULL; l = l->next)
     {
@@ -1926,5 +2109,10 @@ broadway_server_resync_windows (BroadwayServer *server)
   if (server->show_keyboard)
     broadway_output_set_show_keyboard (server->output, TRUE);
 
-  broadway_server_flush (server);
+  if (server->pointer_grab_window_id != -1)
+    broadway_output_grab_pointer (server->output,
+				  server->pointer_grab_window_id,
+				  server->pointer_grab_owner_events);
+
+  broadway_output_end_resync (server->output);
 }
@@ -11,6 +11,13 @@ void broadway_events_got_input (BroadwayInputMsg *message,
 typedef struct _BroadwayServer BroadwayServer;
 typedef struct _BroadwayServerClass BroadwayServerClass;
 
+typedef struct {
+  guint64 updates;
+  guint64 damaged_pixels;       /* as the client reported them */
+  guint64 encoded_pixels;       /* that the encoder had to look at */
+  guint64 window_pixels;        /* the window size, summed over the updates */
+} BroadwayWindowStats;
+
 #define BROADWAY_TYPE_SERVER              (broadway_server_get_type())
 #define BROADWAY_SERVER(object)           (G_TYPE_CHECK_INSTANCE_CAST ((object), BROADWAY_TYPE_SERVER, BroadwayServer))
 #define BROADWAY_SERVER_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), BROADWAY_TYPE_SERVER, BroadwayServerClass))
@@ -26,6 +33,8 @@ BroadwayServer     *broadway_server_new                      (char             *
 							      GError          **error);
 BroadwayServer     *broadway_server_on_unix_socket_new       (char             *address,
 							      GError          **error);
+void                broadway_server_set_compression_level    (BroadwayServer   *server,
+                                                              int               level);
 gboolean            broadway_server_has_client               (BroadwayServer   *server);
 void                broadway_server_flush                    (BroadwayServer   *server);
 void                broadway_server_sync                     (BroadwayServer   *server);
@@ -80,7 +89,11 @@ cairo_surface_t   * broadway_server_create_surface           (int
 							      int               height);
 void                broadway_server_window_update            (BroadwayServer   *server,
 							      gint              id,
-							      cairo_surface_t  *surface);
+							      cairo_surface_t  *surface,
+							      const cairo_region_t *damage);
+gboolean            broadway_server_window_get_stats         (BroadwayServer   *server,
+							      gint              id,
+							      BroadwayWindowStats *stats);
 gboolean            broadway_server_window_move_resize       (BroadwayServer   *server,
 							      gint              id,
 							      gboolean          with_move,
@@ -94,6 +107,9 @@ cairo_surface_t * broadway_server_open_surface (BroadwayServer *server,
 						guint32 id,
 						char *name,
 						int width,
-						int height);
+						int height,
+						gsize size);
+void              broadway_server_destroy_buffer (BroadwayServer *server,
+						  const char *name);
 
 #endif /* __BROADWAY_SERVER__ */
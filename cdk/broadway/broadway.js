@@ -99,10 +99,12 @@ var lastTimeStamp = 0;
 var realWindowWithMouse = 0;
 var windowWithMouse = 0;
 var surfaces = {};
+var tiles = []; // Blocks the server can refer to, BROADWAY_TILE_STORE_SIZE of them
 var stackingOrder = [];
 var outstandingCommands = new Array();
 var inputSocket = null;
 var debugDecoding = false;
+var deflateMessages = false;
 var fakeInput = null;
 var showKeyboard = false;
 var showKeyboardChanged = false;
@@ -272,6 +274,18 @@ function cmdDeleteSurface(id)
     delete surfaces[id];
 }
 
+function cmdReset()
+{
+    for (var id in surfaces)
+	cmdDeleteSurface(id);
+    tiles = [];
+
+    if (showKeyboard) {
+	showKeyboard = false;
+	showKeyboardChanged = true;
+    }
+}
+
 function cmdMoveResizeSurface(id, has_pos, x, y, has_size, w, h)
 {
     var surface = surfaces[id];
@@ -454,6 +468,30 @@ function decodeBuffer(context, oldData, w, h, data, debug)
 
                 break;
 
+            case 0x50: // Save a block as a tile
+            case 0x60: // Tile reference
+                var tileId = (r & 0xf) << 16 | g << 8 | b;
+
+                b = data[src++];
+                g = data[src++];
+                r = data[src++];
+                alpha = data[src++];
+
+                var tileX = alpha << 8 | r;
+                var tileY = g << 8 | b;
+
+                if (cmd == 0x50) {
+                    // The frame is complete when this comes
+                    if (tiles[tileId] == undefined)
+                        tiles[tileId] = context.createImageData(32, 32);
+                    copyRect(imageData, tileX, tileY, tiles[tileId], 0, 0, 32, 32);
+                } else {
+                    copyRect(tiles[tileId], 0, 0, imageData, tileX, tileY, 32, 32);
+                    if (debug) // tiles are blue
+                        markRect(tiles[tileId], 0, 0, imageData, tileX, tileY, 32, 32, 0x00, 0x00, 128);
+                }
+                break;
+
             case 0x30: // Color run
                 len = (r & 0xf) << 16 | g << 8 | b;
                 //log("Got color run, len: " + len);
@@ -511,14 +549,11 @@ function decodeBuffer(context, oldData, w, h, data, debug)
     return imageData;
 }
 
-function cmdPutBuffer(id, w, h, compressed)
+function cmdPutBuffer(id, w, h, data)
 {
     var surface = surfaces[id];
     var context = surface.canvas.getContext("2d");
 
-    var inflate = new Zlib.RawInflate(compressed);
-    var data = inflate.decompress();
-
     var imageData = decodeBuffer (context, surface.imageData, w, h, data, debugDecoding);
     context.putImageData(imageData, 0, 0);
 
@@ -559,6 +594,10 @@ function handleCommands(cmd)
 	    inputSocket = null;
 	    break;
 
+	case 'X': // Reset, everything gets sent again
+	    cmdReset();
+	    break;
+
 	case 's': // create new surface
 	    id = cmd.get_16();
 	    x = cmd.get_16s();
@@ -706,6 +745,12 @@ BinCommands.prototype.get_data = function() {
 
 function handleMessage(message)
 {
+    // Without permessage-deflate every message is deflated on its own
+    if (!deflateMessages) {
+        var inflated = new Zlib.RawInflate(new Uint8Array(message)).decompress();
+        message = inflated.buffer.slice(inflated.byteOffset, inflated.byteOffset + inflated.length);
+    }
+
     var cmd = new BinCommands(message);
     outstandingCommands.push(cmd);
     if (outstandingCommands.length == 1) {
@@ -2619,6 +2664,7 @@ function connect()
 
     ws.onopen = function() {
 	inputSocket = ws;
+	deflateMessages = ws.extensions.indexOf("permessage-deflate") != -1;
     };
     ws.onclose = function() {
 	if (inputSocket != null)
@@ -43,7 +43,10 @@ struct _CdkBroadwayServer {
 
   guint process_input_idle;
   GList *incomming;
-  
+
+  GHashTable *buffers; /* name => BroadwayShmSurfaceData */
+  GQueue free_buffers;
+  gsize free_buffer_bytes;
 };
 
 struct _CdkBroadwayServerClass
@@ -52,6 +55,7 @@ struct _CdkBroadwayServerClass
 };
 
 static gboolean input_available_cb (gpointer stream, gpointer user_data);
+static void release_buffer (CdkBroadwayServer *server, const char *name);
 
 static GType cdk_broadway_server_get_type (void);
 
@@ -61,6 +65,8 @@ static void
 cdk_broadway_server_init (CdkBroadwayServer *server)
 {
   server->next_serial = 1;
+  server->buffers = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&server->free_buffers);
 }
 
 static void
@@ -222,6 +228,15 @@ parse_all_input (CdkBroadwayServer *server)
       reply = g_memdup2 (p, size);
       p += size;
 
+      /* Not an event, and nobody waits for it */
+      if (reply->base.type == BROADWAY_REPLY_RELEASE_BUFFER)
+	{
+	  reply->release_buffer.name[sizeof (reply->release_buffer.name) - 1] = 0;
+	  release_buffer (server, reply->release_buffer.name);
+	  g_free (reply);
+	  continue;
+	}
+
       server->incomming = g_list_append (server->incomming, reply);
     }
 
@@ -664,6 +679,17 @@ create_random_shm (char *name, gsize size, gboolean *is_shm)
     }
 }
 
+/* Window surfaces live in shared memory buffers that the daemon maps
+ * once and reads on every update. After an update, a buffer is busy
+ * until the daemon replies that it has copied the contents. Buffers
+ * that no surface uses anymore are kept for the next surface of about
+ * the same size, a few of them, so that resizing a window doesn't
+ * create a new mapping on both sides for every step.
+ */
+#define MAX_FREE_BUFFERS 4
+#define MAX_FREE_BUFFER_BYTES (64 * 1024 * 1024)
+#define BUFFER_SIZE_ALIGN (64 * 1024)
+
 static const cairo_user_data_key_t cdk_broadway_shm_cairo_key;
 
 typedef struct {
@@ -671,6 +697,11 @@ typedef struct {
   void *data;
   gsize data_size;
   gboolean is_shm;
+
+  CdkBroadwayServer *server;
+  gboolean mapped;      /* the daemon has seen it */
+  gboolean busy;        /* the daemon may still read it */
+  gboolean in_use;      /* a surface draws into it */
 } BroadwayShmSurfaceData;
 
 static void
@@ -708,34 +739,162 @@ shm_data_destroy (void *_data)
   g_free (data);
 }
 
+static void
+destroy_buffer (CdkBroadwayServer      *server,
+		BroadwayShmSurfaceData *data)
+{
+  BroadwayRequestDestroyBuffer msg;
+
+  if (data->mapped)
+    {
+      memcpy (msg.name, data->name, 36);
+      cdk_broadway_server_send_message (server, msg,
+					BROADWAY_REQUEST_DESTROY_BUFFER);
+    }
+
+  g_hash_table_remove (server->buffers, data->name);
+  shm_data_destroy (data);
+}
+
+/* Called when the buffer is neither drawn to nor read anymore */
+static void
+free_buffer (CdkBroadwayServer      *server,
+	     BroadwayShmSurfaceData *data)
+{
+  g_queue_push_tail (&server->free_buffers, data);
+  server->free_buffer_bytes += data->data_size;
+
+  while (server->free_buffers.length > MAX_FREE_BUFFERS ||
+	 server->free_buffer_bytes > MAX_FREE_BUFFER_BYTES)
+    {
+      data = g_queue_pop_head (&server->free_buffers);
+      server->free_buffer_bytes -= data->data_size;
+      destroy_buffer (server, data);
+    }
+}
+
+/* Finds the smallest free buffer that fits @size without wasting
+ * more than the same again */
+static BroadwayShmSurfaceData *
+take_free_buffer (CdkBroadwayServer *server,
+		  gsize              size)
+{
+  BroadwayShmSurfaceData *best = NULL;
+  GList *l;
+
+  for (l = server->free_buffers.head; l != NULL; l = l->next)
+    {
+      BroadwayShmSurfaceData *data = l->data;
+
+      if (data->data_size >= size && data->data_size <= 2 * size &&
+	  (best == NULL || data->data_size < best->data_size))
+	best = data;
+    }
+
+  if (best != NULL)
+    {
+      g_queue_remove (&server->free_buffers, best);
+      server->free_buffer_bytes -= best->data_size;
+    }
+
+  return best;
+}
+
+static void
+release_buffer (CdkBroadwayServer *server,
+		const char        *name)
+{
+  BroadwayShmSurfaceData *data;
+
+  data = g_hash_table_lookup (server->buffers, name);
+  if (data == NULL || !data->busy)
+    return;
+
+  data->busy = FALSE;
+  if (!data->in_use)
+    free_buffer (server, data);
+}
+
+static void
+surface_destroyed (void *_data)
+{
+  BroadwayShmSurfaceData *data = _data;
+
+  data->in_use = FALSE;
+  if (!data->busy)
+    free_buffer (data->server, data);
+}
+
+/* The contents of the surface are undefined */
 cairo_surface_t *
-_cdk_broadway_server_create_surface (int                 width,
+_cdk_broadway_server_create_surface (CdkBroadwayServer  *server,
+				     int                 width,
 				     int                 height)
 {
   BroadwayShmSurfaceData *data;
   cairo_surface_t *surface;
+  gsize size;
+
+  size = width * height * sizeof (guint32);
+
+  data = take_free_buffer (server, size);
+  if (data == NULL)
+    {
+      data = g_new0 (BroadwayShmSurfaceData, 1);
+      data->server = server;
+      /* Leave some room for the window to grow */
+      data->data_size = MAX (size + size / 8, 1);
+      data->data_size = (data->data_size + BUFFER_SIZE_ALIGN - 1) & ~(gsize) (BUFFER_SIZE_ALIGN - 1);
+      data->data = create_random_shm (data->name, data->data_size, &data->is_shm);
+      g_hash_table_insert (server->buffers, data->name, data);
+    }
 
-  data = g_new (BroadwayShmSurfaceData, 1);
-  data->data_size = width * height * sizeof (guint32);
-  data->data = create_random_shm (data->name, data->data_size, &data->is_shm);
+  data->in_use = TRUE;
 
   surface = cairo_image_surface_create_for_data ((guchar *)data->data,
 						 CAIRO_FORMAT_ARGB32, width, height, width * sizeof (guint32));
   g_assert (surface != NULL);
   
   cairo_surface_set_user_data (surface, &cdk_broadway_shm_cairo_key,
-			       data, shm_data_destroy);
+			       data, surface_destroyed);
 
   return surface;
 }
 
+/* Whether the daemon may still be reading from @surface, because it
+ * hasn't acknowledged the last update from it yet */
+gboolean
+_cdk_broadway_server_surface_is_busy (CdkBroadwayServer *server,
+				      cairo_surface_t   *surface)
+{
+  BroadwayShmSurfaceData *data;
+
+  data = cairo_surface_get_user_data (surface, &cdk_broadway_shm_cairo_key);
+  if (data == NULL || !data->busy)
+    return FALSE;
+
+  /* The release might be waiting to be read */
+  read_some_input_nonblocking (server);
+  parse_all_input (server);
+  if (server->incomming)
+    queue_process_input_at_idle (server);
+
+  return data->busy;
+}
+
+/* @damage is what changed since the last update, or %NULL if that
+ * isn't known */
 void
 _cdk_broadway_server_window_update (CdkBroadwayServer *server,
 				    gint id,
-				    cairo_surface_t *surface)
+				    cairo_surface_t *surface,
+				    const cairo_region_t *damage)
 {
-  BroadwayRequestUpdate msg;
+  BroadwayRequestUpdate *msg;
   BroadwayShmSurfaceData *data;
+  cairo_rectangle_int_t rect;
+  gsize size;
+  int i, n_rects;
 
   if (surface == NULL)
     return;
@@ -743,13 +902,46 @@ _cdk_broadway_server_window_update (CdkBroadwayServer *server,
   data = cairo_surface_get_user_data (surface, &cdk_broadway_shm_cairo_key);
   g_assert (data != NULL);
 
-  msg.id = id;
-  memcpy (msg.name, data->name, 36);
-  msg.width = cairo_image_surface_get_width (surface);
-  msg.height = cairo_image_surface_get_height (surface);
+  data->mapped = TRUE;
+  data->busy = TRUE;
 
-  cdk_broadway_server_send_message (server, msg,
-				    BROADWAY_REQUEST_UPDATE);
+  n_rects = damage ? cairo_region_num_rectangles (damage) : 0;
+  /* Too many rectangles are sent as their extents */
+  if (n_rects > BROADWAY_MAX_DAMAGE_RECTS)
+    n_rects = 1;
+
+  size = G_STRUCT_OFFSET (BroadwayRequestUpdate, rects) + MAX (n_rects, 1) * sizeof (BroadwayRect);
+  msg = g_alloca (size);
+
+  msg->id = id;
+  memcpy (msg->name, data->name, 36);
+  msg->width = cairo_image_surface_get_width (surface);
+  msg->height = cairo_image_surface_get_height (surface);
+  msg->size = data->data_size;
+  msg->n_rects = n_rects;
+
+  if (damage && n_rects < cairo_region_num_rectangles (damage))
+    {
+      cairo_region_get_extents (damage, &rect);
+      msg->rects[0].x = rect.x;
+      msg->rects[0].y = rect.y;
+      msg->rects[0].width = rect.width;
+      msg->rects[0].height = rect.height;
+    }
+  else
+    {
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_region_get_rectangle (damage, i, &rect);
+          msg->rects[i].x = rect.x;
+          msg->rects[i].y = rect.y;
+          msg->rects[i].width = rect.width;
+          msg->rects[i].height = rect.height;
+        }
+    }
+
+  cdk_broadway_server_send_message_with_size (server, (BroadwayRequestBase *) msg, size,
+					      BROADWAY_REQUEST_UPDATE);
 }
 
 gboolean
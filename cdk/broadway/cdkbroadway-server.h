@@ -59,11 +59,15 @@ gboolean           _cdk_broadway_server_window_translate         (CdkBroadwaySer
 								  cairo_region_t     *area,
 								  gint                dx,
 								  gint                dy);
-cairo_surface_t   *_cdk_broadway_server_create_surface           (int                 width,
+cairo_surface_t   *_cdk_broadway_server_create_surface           (CdkBroadwayServer  *server,
+								  int                 width,
 								  int                 height);
+gboolean           _cdk_broadway_server_surface_is_busy          (CdkBroadwayServer  *server,
+								  cairo_surface_t    *surface);
 void               _cdk_broadway_server_window_update            (CdkBroadwayServer  *server,
 								  gint                id,
-								  cairo_surface_t    *surface);
+								  cairo_surface_t    *surface,
+								  const cairo_region_t *damage);
 gboolean           _cdk_broadway_server_window_move_resize       (CdkBroadwayServer  *server,
 								  gint                id,
 								  gboolean            with_move,
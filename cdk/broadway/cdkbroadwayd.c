@@ -51,6 +51,7 @@ typedef struct  {
   GBufferedInputStream *in;
   GSList *serial_mappings;
   GList *windows;
+  GHashTable *buffers; /* names of the shm buffers the server has mapped */
   guint disconnect_idle;
 } BroadwayClient;
 
@@ -63,12 +64,15 @@ client_free (BroadwayClient *client)
   g_object_unref (client->connection);
   g_object_unref (client->in);
   g_slist_free_full (client->serial_mappings, g_free);
+  g_hash_table_destroy (client->buffers);
   g_free (client);
 }
 
 static void
 client_disconnected (BroadwayClient *client)
 {
+  GHashTableIter iter;
+  const char *name;
   GList *l;
 
   if (client->disconnect_idle != 0)
@@ -83,6 +87,11 @@ client_disconnected (BroadwayClient *client)
   g_list_free (client->windows);
   client->windows = NULL;
 
+  g_hash_table_iter_init (&iter, client->buffers);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&name, NULL))
+    broadway_server_destroy_buffer (server, name);
+  g_hash_table_remove_all (client->buffers);
+
   broadway_server_flush (server);
 
   client_free (client);
@@ -198,7 +207,11 @@ client_handle_request (BroadwayClient *client,
   BroadwayReplyQueryMouse reply_query_mouse;
   BroadwayReplyGrabPointer reply_grab_pointer;
   BroadwayReplyUngrabPointer reply_ungrab_pointer;
+  BroadwayReplyReleaseBuffer reply_release_buffer;
   cairo_surface_t *surface;
+  cairo_rectangle_int_t rect;
+  char *name;
+  guint32 i;
   guint32 before_serial, now_serial;
 
   before_serial = broadway_server_get_next_serial (server);
@@ -255,18 +268,54 @@ client_handle_request (BroadwayClient *client,
 						request->set_transient_for.parent);
       break;
     case BROADWAY_REQUEST_UPDATE:
+      request->update.name[sizeof (request->update.name) - 1] = 0;
       surface = broadway_server_open_surface (server,
 					      request->update.id,
 					      request->update.name,
 					      request->update.width,
-					      request->update.height);
+					      request->update.height,
+					      request->update.size);
       if (surface != NULL)
 	{
+	  cairo_region_t *damage = NULL;
+
+	  if (request->update.n_rects > 0 &&
+	      request->update.n_rects <= BROADWAY_MAX_DAMAGE_RECTS &&
+	      request->base.size >= G_STRUCT_OFFSET (BroadwayRequestUpdate, rects) +
+	                            request->update.n_rects * sizeof (BroadwayRect))
+	    {
+	      damage = cairo_region_create ();
+	      for (i = 0; i < request->update.n_rects; i++)
+		{
+		  rect.x = request->update.rects[i].x;
+		  rect.y = request->update.rects[i].y;
+		  rect.width = request->update.rects[i].width;
+		  rect.height = request->update.rects[i].height;
+		  cairo_region_union_rectangle (damage, &rect);
+		}
+	    }
+
+	  g_hash_table_add (client->buffers, g_strdup (request->update.name));
 	  broadway_server_window_update (server,
 					 request->update.id,
-					 surface);
+					 surface,
+					 damage);
 	  cairo_surface_destroy (surface);
+	  if (damage)
+	    cairo_region_destroy (damage);
 	}
+      /* The contents are copied now, so the client can draw again */
+      memcpy (reply_release_buffer.name, request->update.name,
+	      sizeof (reply_release_buffer.name));
+      send_reply (client, request, (BroadwayReply *)&reply_release_buffer, sizeof (reply_release_buffer),
+		  BROADWAY_REPLY_RELEASE_BUFFER);
+      break;
+    case BROADWAY_REQUEST_DESTROY_BUFFER:
+      name = g_strndup (request->destroy_buffer.name, sizeof (request->destroy_buffer.name));
+      /* Only the client that sent updates from a buffer may destroy it */
+      if (g_hash_table_remove (client->buffers, name))
+	broadway_server_destroy_buffer (server, name);
+      g_free (name);
       break;
     case BROADWAY_REQUEST_MOVE_RESIZE:
       broadway_server_window_move_resize (server,
@@ -350,6 +399,8 @@ client_fill_cb (GObject *source_object G_GNUC_UNUSED,
 	      remaining -= size;
 	      buffer += size;
 	    }
+	  else
+	    break;
 	}
       
       /* This is guaranteed not to block */
@@ -380,6 +431,7 @@ incoming_client (GSocketService    *service G_GNUC_UNUSED,
   client = g_new0 (BroadwayClient, 1);
   client->id = client_id_count++;
   client->connection = g_object_ref (connection);
+  client->buffers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   input = g_io_stream_get_input_stream (G_IO_STREAM (client->connection));
   client->in = (GBufferedInputStream *)g_buffered_input_stream_new (input);
@@ -423,6 +475,7 @@ main (int argc, char *argv[])
   char *ssl_key = NULL;
   char *display;
   int port = 0;
+  int compression_level = -1;
   const GOptionEntry entries[] = {
     { "port", 'p', 0, G_OPTION_ARG_INT, &http_port, "Httpd port", "PORT" },
     { "address", 'a', 0, G_OPTION_ARG_STRING, &http_address, "Ip address to bind to ", "ADDRESS" },
@@ -431,6 +484,7 @@ main (int argc, char *argv[])
 #endif
     { "cert", 'c', 0, G_OPTION_ARG_STRING, &ssl_cert, "SSL certificate path", "PATH" },
     { "key", 'k', 0, G_OPTION_ARG_STRING, &ssl_key, "SSL key path", "PATH" },
+    { "compression", 0, 0, G_OPTION_ARG_INT, &compression_level, "Compression level (0-9)", "LEVEL" },
     { NULL }
   };
 
@@ -514,6 +568,8 @@ main (int argc, char *argv[])
       return 1;
     }
 
+  broadway_server_set_compression_level (server, CLAMP (compression_level, -1, 9));
+
   listener = g_socket_service_new ();
   if (!g_socket_listener_add_address (G_SOCKET_LISTENER (listener),
 				      address,
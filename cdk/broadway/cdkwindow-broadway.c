@@ -110,12 +110,10 @@ update_dirty_windows_and_sync (void)
 {
   GList *l;
   CdkBroadwayDisplay *display;
-  gboolean updated_surface;
 
   display = CDK_BROADWAY_DISPLAY (find_broadway_display ());
   g_assert (display != NULL);
 
-  updated_surface = FALSE;
   for (l = display->toplevels; l != NULL; l = l->next)
     {
       CdkWindowImplBroadway *impl = l->data;
@@ -123,19 +121,18 @@ update_dirty_windows_and_sync (void)
       if (impl->dirty)
 	{
 	  impl->dirty = FALSE;
-	  updated_surface = TRUE;
 	  _cdk_broadway_server_window_update (display->server,
 					      impl->id,
-					      impl->surface);
+					      impl->surface,
+					      impl->damage);
+	  g_clear_pointer (&impl->damage, cairo_region_destroy);
+	  impl->damage = cairo_region_create ();
 	}
     }
 
-  /* We sync here to ensure all references to the impl->surface memory
-     is done, as we may later paint new data in them. */
-  if (updated_surface)
-    cdk_display_sync (CDK_DISPLAY (display));
-  else
-    cdk_display_flush (CDK_DISPLAY (display));
+  /* No need to wait for the daemon to read the surfaces, the next
+     paint goes to another buffer if it hasn't yet. */
+  cdk_display_flush (CDK_DISPLAY (display));
 }
 
 static guint flush_id = 0;
@@ -194,6 +191,7 @@ cdk_window_impl_broadway_finalize (GObject *object)
     g_object_unref (impl->cursor);
 
   g_hash_table_destroy (impl->device_cursor);
+  g_clear_pointer (&impl->damage, cairo_region_destroy);
 
   broadway_display->toplevels = g_list_remove (broadway_display->toplevels, impl);
 
@@ -302,7 +300,8 @@ _cdk_broadway_window_resize_surface (CdkWindow *window)
     {
       cairo_surface_destroy (impl->surface);
 
-      impl->surface = _cdk_broadway_server_create_surface (cdk_window_get_width (impl->wrapper),
+      impl->surface = _cdk_broadway_server_create_surface (CDK_BROADWAY_DISPLAY (cdk_window_get_display (window))->server,
+							   cdk_window_get_width (impl->wrapper),
 							   cdk_window_get_height (impl->wrapper));
     }
 
@@ -313,6 +312,8 @@ _cdk_broadway_window_resize_surface (CdkWindow *window)
       impl->ref_surface = NULL;
     }
 
+  g_clear_pointer (&impl->damage, cairo_region_destroy);
+
   cdk_window_invalidate_rect (window, NULL, TRUE);
 }
 
@@ -324,10 +325,35 @@ ref_surface_destroyed (void *data)
   impl->ref_surface = NULL;
 }
 
+/* Moves the contents of the window to a new buffer, leaving the old
+ * one to the daemon */
+static void
+swap_surface (CdkWindow *window)
+{
+  CdkWindowImplBroadway *impl = CDK_WINDOW_IMPL_BROADWAY (window->impl);
+  CdkBroadwayDisplay *display;
+  cairo_surface_t *surface;
+
+  display = CDK_BROADWAY_DISPLAY (cdk_window_get_display (window));
+  surface = _cdk_broadway_server_create_surface (display->server,
+						 cairo_image_surface_get_width (impl->surface),
+						 cairo_image_surface_get_height (impl->surface));
+
+  cairo_surface_flush (impl->surface);
+  memcpy (cairo_image_surface_get_data (surface),
+	  cairo_image_surface_get_data (impl->surface),
+	  cairo_image_surface_get_stride (impl->surface) * cairo_image_surface_get_height (impl->surface));
+  cairo_surface_mark_dirty (surface);
+
+  cairo_surface_destroy (impl->surface);
+  impl->surface = surface;
+}
+
 static cairo_surface_t *
 cdk_window_broadway_ref_cairo_surface (CdkWindow *window)
 {
   CdkWindowImplBroadway *impl = CDK_WINDOW_IMPL_BROADWAY (window->impl);
+  CdkBroadwayDisplay *display;
   int w, h;
 
   if (CDK_IS_WINDOW_IMPL_BROADWAY (window) &&
@@ -337,9 +363,18 @@ cdk_window_broadway_ref_cairo_surface (CdkWindow *window)
   w = cdk_window_get_width (impl->wrapper);
   h = cdk_window_get_height (impl->wrapper);
 
+  display = CDK_BROADWAY_DISPLAY (cdk_window_get_display (window));
+
   /* Create actual backing store if missing */
   if (!impl->surface)
-    impl->surface = _cdk_broadway_server_create_surface (w, h);
+    impl->surface = _cdk_broadway_server_create_surface (display->server, w, h);
+
+  /* Don't draw where the daemon may still be reading the last update.
+     Someone that still holds the old surface draws to the old buffer,
+     but that is sent with the next update anyway. */
+  if (!impl->ref_surface &&
+      _cdk_broadway_server_surface_is_busy (display->server, impl->surface))
+    swap_surface (window);
 
   /* Create a destroyable surface referencing the real one */
   if (!impl->ref_surface)
@@ -1050,6 +1085,10 @@ cdk_broadway_window_end_paint (CdkWindow *window)
   CdkWindowImplBroadway *impl;
   impl = CDK_WINDOW_IMPL_BROADWAY (window->impl);
   impl->dirty = TRUE;
+
+  /* Only this changed for the daemon to diff */
+  if (impl->damage)
+    cairo_region_union (impl->damage, window->current_paint.region);
 }
 
 typedef struct _MoveResizeData MoveResizeData;
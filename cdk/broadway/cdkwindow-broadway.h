@@ -70,6 +70,7 @@ struct _CdkWindowImplBroadway
   gint8 toplevel_window_type;
   gboolean dirty;
   gboolean last_synced;
+  cairo_region_t *damage;       /* since the last update, NULL for all */
 
   CdkGeometry geometry_hints;
   CdkWindowHints geometry_hints_mask;
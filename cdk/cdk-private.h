@@ -66,6 +66,15 @@ typedef struct {
   gboolean (* cdk_profiler_is_running) (void);
   void     (* cdk_profiler_start)      (int fd);
   void     (* cdk_profiler_stop)       (void);
+  void     (* cdk_profiler_add_mark)   (gint64      start,
+                                        guint64     duration,
+                                        const char *name,
+                                        const char *message);
+  guint    (* cdk_profiler_define_int_counter) (const char *name,
+                                                const char *description);
+  void     (* cdk_profiler_set_int_counter)    (guint       id,
+                                                gint64      time,
+                                                gint64      value);
 } CdkPrivateVTable;
 
 CDK_AVAILABLE_IN_ALL
@@ -349,6 +349,8 @@ cdk_pre_parse (void)
         _cdk_rendering_mode = CDK_RENDERING_MODE_IMAGE;
       else if (g_str_equal (rendering_mode, "recording"))
         _cdk_rendering_mode = CDK_RENDERING_MODE_RECORDING;
+      else if (g_str_equal (rendering_mode, "tiled"))
+        _cdk_rendering_mode = CDK_RENDERING_MODE_TILED;
     }
 }
 
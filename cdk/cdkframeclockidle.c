@@ -28,6 +28,7 @@
 #include "cdkframeclockprivate.h"
 #include "cdkframeclockidle.h"
 #include "cdkprofilerprivate.h"
+#include "cdkframestatsprivate.h"
 #include "cdk.h"
 
 #ifdef G_OS_WIN32
@@ -68,6 +69,8 @@ struct _CdkFrameClockIdlePrivate
   CdkFrameClockPhase requested;
   CdkFrameClockPhase phase;
 
+  CdkFrameStats *stats;                /* NULL unless collecting frame statistics */
+
   guint in_paint_idle : 1;
   guint paint_is_thaw : 1;
 #ifdef G_OS_WIN32
@@ -131,6 +134,29 @@ get_sleep_serial (void)
   return sleep_serial;
 }
 
+/* Starts timing a phase for the frame statistics, returns 0 if
+ * they aren't collected */
+static gint64
+frame_stats_begin (CdkFrameClockIdlePrivate *priv)
+{
+  if (priv->stats == NULL)
+    return 0;
+
+  return g_get_monotonic_time ();
+}
+
+static void
+frame_stats_end (CdkFrameClockIdlePrivate *priv,
+                 CdkFrameStatsPhase        phase,
+                 gint64                    start_time)
+{
+  if (priv->stats == NULL || start_time == 0)
+    return;
+
+  cdk_frame_stats_add (priv->stats, phase, start_time,
+                       g_get_monotonic_time () - start_time);
+}
+
 static void
 cdk_frame_clock_idle_init (CdkFrameClockIdle *frame_clock_idle)
 {
@@ -141,6 +167,9 @@ cdk_frame_clock_idle_init (CdkFrameClockIdle *frame_clock_idle)
 
   priv->freeze_count = 0;
   priv->smoothed_frame_time_period = FRAME_INTERVAL;
+
+  if (cdk_frame_stats_enabled ())
+    priv->stats = cdk_frame_stats_new ();
 }
 
 static void
@@ -168,6 +197,12 @@ cdk_frame_clock_idle_dispose (GObject *object)
     }
 #endif
 
+  if (priv->stats)
+    {
+      cdk_frame_stats_release (priv->stats);
+      priv->stats = NULL;
+    }
+
   G_OBJECT_CLASS (cdk_frame_clock_idle_parent_class)->dispose (object);
 }
 
@@ -353,6 +388,7 @@ cdk_frame_clock_flush_idle (void *data)
   CdkFrameClock *clock = CDK_FRAME_CLOCK (data);
   CdkFrameClockIdle *clock_idle = CDK_FRAME_CLOCK_IDLE (clock);
   CdkFrameClockIdlePrivate *priv = clock_idle->priv;
+  gint64 stats_time;
 
   priv->flush_idle_id = 0;
 
@@ -362,7 +398,9 @@ cdk_frame_clock_flush_idle (void *data)
   priv->phase = CDK_FRAME_CLOCK_PHASE_FLUSH_EVENTS;
   priv->requested &= ~CDK_FRAME_CLOCK_PHASE_FLUSH_EVENTS;
 
+  stats_time = frame_stats_begin (priv);
   _cdk_frame_clock_emit_flush_events (clock);
+  frame_stats_end (priv, CDK_FRAME_STATS_FLUSH_EVENTS, stats_time);
 
   if ((priv->requested & ~CDK_FRAME_CLOCK_PHASE_FLUSH_EVENTS) != 0 ||
       priv->updating_count > 0)
@@ -400,6 +438,8 @@ cdk_frame_clock_paint_idle (void *data)
   CdkFrameClockIdlePrivate *priv = clock_idle->priv;
   gboolean skip_to_resume_events;
   CdkFrameTimings *timings = NULL;
+  gint64 frame_start_time = 0;
+  gint64 stats_time;
 
   priv->paint_idle_id = 0;
   priv->in_paint_idle = TRUE;
@@ -532,7 +572,9 @@ cdk_frame_clock_paint_idle (void *data)
                * in them.
                */
               priv->requested &= ~CDK_FRAME_CLOCK_PHASE_BEFORE_PAINT;
+              frame_start_time = frame_stats_begin (priv);
               _cdk_frame_clock_emit_before_paint (clock);
+              frame_stats_end (priv, CDK_FRAME_STATS_BEFORE_PAINT, frame_start_time);
               priv->phase = CDK_FRAME_CLOCK_PHASE_UPDATE;
             }
           /* fallthrough */
@@ -543,7 +585,9 @@ cdk_frame_clock_paint_idle (void *data)
                   priv->updating_count > 0)
                 {
                   priv->requested &= ~CDK_FRAME_CLOCK_PHASE_UPDATE;
+                  stats_time = frame_stats_begin (priv);
                   _cdk_frame_clock_emit_update (clock);
+                  frame_stats_end (priv, CDK_FRAME_STATS_UPDATE, stats_time);
                 }
             }
           /* fallthrough */
@@ -567,12 +611,15 @@ cdk_frame_clock_paint_idle (void *data)
 	       * resizes and natural size changes.
 	       */
 	      iter = 0;
+              stats_time = frame_stats_begin (priv);
               while ((priv->requested & CDK_FRAME_CLOCK_PHASE_LAYOUT) &&
 		     priv->freeze_count == 0 && iter++ < 4)
                 {
                   priv->requested &= ~CDK_FRAME_CLOCK_PHASE_LAYOUT;
                   _cdk_frame_clock_emit_layout (clock);
                 }
+              if (iter > 0)
+                frame_stats_end (priv, CDK_FRAME_STATS_LAYOUT, stats_time);
 	      if (iter == 5)
 		g_warning ("cdk-frame-clock: layout continuously requested, giving up after 4 tries");
             }
@@ -593,7 +640,9 @@ cdk_frame_clock_paint_idle (void *data)
               if (priv->requested & CDK_FRAME_CLOCK_PHASE_PAINT)
                 {
                   priv->requested &= ~CDK_FRAME_CLOCK_PHASE_PAINT;
+                  stats_time = frame_stats_begin (priv);
                   _cdk_frame_clock_emit_paint (clock);
+                  frame_stats_end (priv, CDK_FRAME_STATS_PAINT, stats_time);
                 }
             }
           /* fallthrough */
@@ -601,7 +650,11 @@ cdk_frame_clock_paint_idle (void *data)
           if (priv->freeze_count == 0)
             {
               priv->requested &= ~CDK_FRAME_CLOCK_PHASE_AFTER_PAINT;
+              stats_time = frame_stats_begin (priv);
               _cdk_frame_clock_emit_after_paint (clock);
+              frame_stats_end (priv, CDK_FRAME_STATS_AFTER_PAINT, stats_time);
+              /* Only whole frames, not ones continued after a thaw */
+              frame_stats_end (priv, CDK_FRAME_STATS_FRAME, frame_start_time);
               /* the ::after-paint phase doesn't get repeated on freeze/thaw,
                */
               priv->phase = CDK_FRAME_CLOCK_PHASE_NONE;
@@ -795,6 +848,17 @@ cdk_frame_clock_idle_class_init (CdkFrameClockIdleClass *klass)
   frame_clock_class->thaw = cdk_frame_clock_idle_thaw;
 }
 
+/* Names the window in the frame statistics */
+void
+_cdk_frame_clock_idle_set_name (CdkFrameClockIdle *clock_idle,
+                                const char        *name)
+{
+  CdkFrameClockIdlePrivate *priv = clock_idle->priv;
+
+  if (priv->stats)
+    cdk_frame_stats_set_name (priv->stats, name);
+}
+
 CdkFrameClock *
 _cdk_frame_clock_idle_new (void)
 {
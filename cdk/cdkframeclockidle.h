@@ -61,6 +61,8 @@ GType           cdk_frame_clock_idle_get_type       (void) G_GNUC_CONST;
 CdkFrameClock *_cdk_frame_clock_idle_new            (void);
 void           _cdk_frame_clock_idle_freeze_updates (CdkFrameClockIdle *clock_idle);
 void           _cdk_frame_clock_idle_thaw_updates   (CdkFrameClockIdle *clock_idle);
+void           _cdk_frame_clock_idle_set_name       (CdkFrameClockIdle *clock_idle,
+                                                     const char        *name);
 
 G_END_DECLS
 
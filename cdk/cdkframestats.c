@@ -0,0 +1,308 @@
+/* CDK - The GIMP Drawing Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "cdkframestatsprivate.h"
+
+#include "cdkprofilerprivate.h"
+
+#include <stdlib.h>
+
+/* Durations of the frame clock phases, collected per frame clock, that
+ * is per toplevel window, into histograms.
+ *
+ * The histograms have 16 buckets for every power of two, so percentiles
+ * are off by at most 1/16. Durations are in microseconds; below 32µs
+ * every value has its own bucket, and everything above two minutes
+ * ends up in the last one.
+ *
+ * Setting CDK_FRAME_STATS to a filename writes the statistics of all
+ * windows there as JSON when the program exits. While the profiler
+ * runs, the phase durations of every frame are added as counters.
+ */
+
+#define SUB_BUCKET_BITS 4
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define MAX_SHIFT 22
+#define N_BUCKETS ((MAX_SHIFT + 2) * SUB_BUCKETS)
+#define MAX_VALUE (((gint64) 2 * SUB_BUCKETS << MAX_SHIFT) - 1)
+
+typedef struct {
+  guint32 buckets[N_BUCKETS];
+  guint64 count;
+  gint64 sum;
+  gint64 max;
+} CdkFrameStatsHistogram;
+
+struct _CdkFrameStats
+{
+  guint id;
+  char *name;
+
+  CdkFrameStatsHistogram phases[CDK_FRAME_STATS_N_PHASES];
+};
+
+static const char *phase_names[CDK_FRAME_STATS_N_PHASES] = {
+  "flush-events",
+  "before-paint",
+  "update",
+  "layout",
+  "paint",
+  "after-paint",
+  "frame"
+};
+
+static const char *stats_filename;
+static GPtrArray *all_stats;
+static guint profiler_counters[CDK_FRAME_STATS_N_PHASES];
+
+gboolean
+cdk_frame_stats_enabled (void)
+{
+  static int enabled = -1;
+
+  if (enabled == -1)
+    {
+      stats_filename = g_getenv ("CDK_FRAME_STATS");
+      if (stats_filename != NULL && stats_filename[0] == '\0')
+        stats_filename = NULL;
+      enabled = stats_filename != NULL;
+    }
+
+  return enabled || cdk_profiler_is_running ();
+}
+
+static guint
+bucket_for_value (gint64 value)
+{
+  guint shift;
+
+  value = CLAMP (value, 0, MAX_VALUE);
+  shift = MAX ((int) g_bit_storage (value) - 1 - SUB_BUCKET_BITS, 0);
+
+  return shift * SUB_BUCKETS + (value >> shift);
+}
+
+/* The largest value in the bucket, so percentiles err on the slow side */
+static gint64
+bucket_max_value (guint bucket)
+{
+  guint shift;
+
+  shift = MAX ((int) (bucket / SUB_BUCKETS) - 1, 0);
+
+  return ((gint64) (bucket - shift * SUB_BUCKETS + 1) << shift) - 1;
+}
+
+static void
+write_stats_file (void)
+{
+  GString *string;
+  GError *error = NULL;
+
+  string = g_string_new (NULL);
+  cdk_frame_stats_print_json (string);
+
+  if (!g_file_set_contents (stats_filename, string->str, string->len, &error))
+    {
+      g_warning ("Failed to write frame statistics: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_string_free (string, TRUE);
+}
+
+CdkFrameStats *
+cdk_frame_stats_new (void)
+{
+  static guint last_id;
+  CdkFrameStats *stats;
+
+  if (all_stats == NULL)
+    {
+      all_stats = g_ptr_array_new ();
+
+      if (cdk_frame_stats_enabled () && stats_filename != NULL)
+        atexit (write_stats_file);
+    }
+
+  stats = g_new0 (CdkFrameStats, 1);
+  stats->id = ++last_id;
+  g_ptr_array_add (all_stats, stats);
+
+  return stats;
+}
+
+/* Called when the frame clock goes away. Statistics of windows that
+ * were shown are kept for the report, if there is one to write.
+ */
+void
+cdk_frame_stats_release (CdkFrameStats *stats)
+{
+  if (stats_filename != NULL &&
+      stats->phases[CDK_FRAME_STATS_FRAME].count > 0)
+    return;
+
+  g_ptr_array_remove (all_stats, stats);
+  g_free (stats->name);
+  g_free (stats);
+}
+
+void
+cdk_frame_stats_set_name (CdkFrameStats *stats,
+                          const char    *name)
+{
+  g_free (stats->name);
+  stats->name = g_strdup (name);
+}
+
+void
+cdk_frame_stats_add (CdkFrameStats      *stats,
+                     CdkFrameStatsPhase  phase,
+                     gint64              start_time,
+                     gint64              duration)
+{
+  CdkFrameStatsHistogram *histogram = &stats->phases[phase];
+
+  histogram->buckets[bucket_for_value (duration)]++;
+  histogram->count++;
+  histogram->sum += duration;
+  histogram->max = MAX (histogram->max, duration);
+
+  if (cdk_profiler_is_running ())
+    {
+      if (profiler_counters[phase] == 0)
+        {
+          char *name, *description;
+
+          name = g_strdup_printf ("%s time", phase_names[phase]);
+          description = g_strdup_printf ("Time spent in the %s phase of a frame in ms", phase_names[phase]);
+          profiler_counters[phase] = cdk_profiler_define_counter (name, description);
+          g_free (description);
+          g_free (name);
+        }
+
+      cdk_profiler_set_counter (profiler_counters[phase],
+                                (start_time + duration) * 1000,
+                                duration / 1000.);
+    }
+}
+
+guint64
+cdk_frame_stats_get_count (CdkFrameStats      *stats,
+                           CdkFrameStatsPhase  phase)
+{
+  return stats->phases[phase].count;
+}
+
+/* Returns the duration that @percentile percent of the samples
+ * don't exceed, in microseconds */
+gint64
+cdk_frame_stats_get_percentile (CdkFrameStats      *stats,
+                                CdkFrameStatsPhase  phase,
+                                double              percentile)
+{
+  CdkFrameStatsHistogram *histogram = &stats->phases[phase];
+  guint64 rank, seen;
+  guint i;
+
+  if (histogram->count == 0)
+    return 0;
+
+  rank = MAX (1, (guint64) (percentile / 100. * histogram->count + 0.5));
+
+  seen = 0;
+  for (i = 0; i < N_BUCKETS; i++)
+    {
+      seen += histogram->buckets[i];
+      if (seen >= rank)
+        return MIN (bucket_max_value (i), histogram->max);
+    }
+
+  return histogram->max;
+}
+
+static void
+print_json_string (GString    *string,
+                   const char *str)
+{
+  const char *p;
+
+  g_string_append_c (string, '"');
+  for (p = str; *p; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        g_string_append_printf (string, "\\%c", *p);
+      else if ((guchar) *p < 0x20)
+        g_string_append_printf (string, "\\u%04x", *p);
+      else
+        g_string_append_c (string, *p);
+    }
+  g_string_append_c (string, '"');
+}
+
+/*< private >
+ * cdk_frame_stats_print_json:
+ * @string: the string to append to
+ *
+ * Prints the statistics of all windows as a JSON object. Durations
+ * are in microseconds.
+ */
+void
+cdk_frame_stats_print_json (GString *string)
+{
+  guint i, phase;
+
+  g_string_append (string, "{\n  \"program\": ");
+  print_json_string (string, g_get_prgname () ? g_get_prgname () : "");
+  g_string_append (string, ",\n  \"unit\": \"us\",\n  \"windows\": [");
+
+  for (i = 0; all_stats && i < all_stats->len; i++)
+    {
+      CdkFrameStats *stats = g_ptr_array_index (all_stats, i);
+
+      g_string_append_printf (string, "%s\n    {\n      \"id\": %u,\n      \"name\": ",
+                              i > 0 ? "," : "", stats->id);
+      print_json_string (string, stats->name ? stats->name : "");
+      g_string_append (string, ",\n      \"phases\": {");
+
+      for (phase = 0; phase < CDK_FRAME_STATS_N_PHASES; phase++)
+        {
+          CdkFrameStatsHistogram *histogram = &stats->phases[phase];
+
+          g_string_append_printf (string,
+                                  "%s\n        \"%s\": { \"count\": %" G_GUINT64_FORMAT ", "
+                                  "\"mean\": %" G_GINT64_FORMAT ", "
+                                  "\"p50\": %" G_GINT64_FORMAT ", "
+                                  "\"p95\": %" G_GINT64_FORMAT ", "
+                                  "\"p99\": %" G_GINT64_FORMAT ", "
+                                  "\"max\": %" G_GINT64_FORMAT " }",
+                                  phase > 0 ? "," : "",
+                                  phase_names[phase],
+                                  histogram->count,
+                                  histogram->count ? histogram->sum / (gint64) histogram->count : 0,
+                                  cdk_frame_stats_get_percentile (stats, phase, 50),
+                                  cdk_frame_stats_get_percentile (stats, phase, 95),
+                                  cdk_frame_stats_get_percentile (stats, phase, 99),
+                                  histogram->max);
+        }
+
+      g_string_append (string, "\n      }\n    }");
+    }
+
+  g_string_append (string, "\n  ]\n}\n");
+}
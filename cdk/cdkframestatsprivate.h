@@ -0,0 +1,59 @@
+/* CDK - The GIMP Drawing Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CDK_FRAME_STATS_PRIVATE_H__
+#define __CDK_FRAME_STATS_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  CDK_FRAME_STATS_FLUSH_EVENTS,
+  CDK_FRAME_STATS_BEFORE_PAINT,
+  CDK_FRAME_STATS_UPDATE,
+  CDK_FRAME_STATS_LAYOUT,
+  CDK_FRAME_STATS_PAINT,
+  CDK_FRAME_STATS_AFTER_PAINT,
+  CDK_FRAME_STATS_FRAME,        /* from ::before-paint to the end of ::after-paint */
+  CDK_FRAME_STATS_N_PHASES
+} CdkFrameStatsPhase;
+
+typedef struct _CdkFrameStats CdkFrameStats;
+
+gboolean        cdk_frame_stats_enabled         (void);
+
+CdkFrameStats * cdk_frame_stats_new             (void);
+void            cdk_frame_stats_release         (CdkFrameStats      *stats);
+void            cdk_frame_stats_set_name        (CdkFrameStats      *stats,
+                                                 const char         *name);
+
+void            cdk_frame_stats_add             (CdkFrameStats      *stats,
+                                                 CdkFrameStatsPhase  phase,
+                                                 gint64              start_time,
+                                                 gint64              duration);
+
+guint64         cdk_frame_stats_get_count       (CdkFrameStats      *stats,
+                                                 CdkFrameStatsPhase  phase);
+gint64          cdk_frame_stats_get_percentile  (CdkFrameStats      *stats,
+                                                 CdkFrameStatsPhase  phase,
+                                                 double              percentile);
+
+void            cdk_frame_stats_print_json      (GString            *string);
+
+G_END_DECLS
+
+#endif /* __CDK_FRAME_STATS_PRIVATE_H__ */
@@ -91,7 +91,8 @@ typedef enum {
 typedef enum {
   CDK_RENDERING_MODE_SIMILAR = 0,
   CDK_RENDERING_MODE_IMAGE,
-  CDK_RENDERING_MODE_RECORDING
+  CDK_RENDERING_MODE_RECORDING,
+  CDK_RENDERING_MODE_TILED
 } CdkRenderingMode;
 
 typedef enum {
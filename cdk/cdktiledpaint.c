@@ -0,0 +1,235 @@
+/* CDK - The GIMP Drawing Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "cdktiledpaintprivate.h"
+
+#include "cdkinternals.h"
+
+/* With CDK_RENDERING=tiled, window paints are recorded instead of drawn.
+ * The recording is rasterized in tiles by a pool of threads, and the
+ * tiles are then copied to the window, so that drawing large windows
+ * uses all cores.
+ *
+ * Replaying a recording surface changes some of its state, so every
+ * thread needs its own copy. Painting a recording surface onto another
+ * one takes a snapshot, which copies the commands; flushing the
+ * original drops that snapshot again, so the next copy gets its own.
+ */
+
+#define TILE_SIZE 256           /* in application pixels */
+#define MIN_TILES_PER_JOB 2     /* making a copy has its cost, too */
+
+typedef struct _CdkPaintTile CdkPaintTile;
+typedef struct _CdkPaintJob CdkPaintJob;
+typedef struct _CdkPaintJobs CdkPaintJobs;
+
+struct _CdkPaintTile
+{
+  cairo_rectangle_int_t area;
+  cairo_surface_t *surface;
+};
+
+struct _CdkPaintJobs
+{
+  GMutex mutex;
+  GCond cond;
+  guint n_pending;
+
+  CdkPaintTile *tiles;
+  guint n_tiles;
+  guint n_jobs;
+  cairo_format_t format;
+  int scale;
+};
+
+struct _CdkPaintJob
+{
+  CdkPaintJobs *jobs;
+  guint index;                  /* does every n_jobs-th tile from here */
+  cairo_surface_t *recording;   /* private copy */
+};
+
+static GThreadPool *paint_pool;
+
+static cairo_surface_t *
+copy_recording (cairo_surface_t *recording)
+{
+  cairo_surface_t *copy;
+  cairo_t *cr;
+
+  copy = cairo_recording_surface_create (cairo_surface_get_content (recording), NULL);
+
+  cr = cairo_create (copy);
+  cairo_set_source_surface (cr, recording, 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  cairo_surface_flush (recording);
+
+  return copy;
+}
+
+static void
+cdk_paint_job_run (CdkPaintJob *job)
+{
+  CdkPaintJobs *jobs = job->jobs;
+  guint i;
+
+  for (i = job->index; i < jobs->n_tiles; i += jobs->n_jobs)
+    {
+      CdkPaintTile *tile = &jobs->tiles[i];
+      cairo_t *cr;
+
+      tile->surface = cairo_image_surface_create (jobs->format,
+                                                  tile->area.width * jobs->scale,
+                                                  tile->area.height * jobs->scale);
+      cairo_surface_set_device_scale (tile->surface, jobs->scale, jobs->scale);
+      cairo_surface_set_device_offset (tile->surface,
+                                       - tile->area.x * jobs->scale,
+                                       - tile->area.y * jobs->scale);
+
+      cr = cairo_create (tile->surface);
+      cairo_set_source_surface (cr, job->recording, 0, 0);
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+    }
+}
+
+static void
+cdk_paint_job_thread_func (gpointer data,
+                           gpointer user_data G_GNUC_UNUSED)
+{
+  CdkPaintJob *job = data;
+  CdkPaintJobs *jobs = job->jobs;
+
+  cdk_paint_job_run (job);
+
+  g_mutex_lock (&jobs->mutex);
+  jobs->n_pending--;
+  g_cond_signal (&jobs->cond);
+  g_mutex_unlock (&jobs->mutex);
+}
+
+/*< private >
+ * cdk_tiled_paint:
+ * @cr: the context to paint to, with clip and operator set up
+ * @recording: a recording surface
+ * @region: the region to paint, in user space of @cr
+ *
+ * Paints @recording to @cr like cairo_set_source_surface() and
+ * cairo_paint() would, but does the rasterization on multiple threads.
+ */
+void
+cdk_tiled_paint (cairo_t              *cr,
+                 cairo_surface_t      *recording,
+                 const cairo_region_t *region)
+{
+  CdkPaintJobs jobs;
+  CdkPaintJob *job;
+  GArray *tiles;
+  cairo_rectangle_int_t extents;
+  double sx, sy;
+  guint i;
+  int x, y;
+
+  cairo_region_get_extents (region, &extents);
+
+  tiles = g_array_new (FALSE, FALSE, sizeof (CdkPaintTile));
+  for (y = extents.y; y < extents.y + extents.height; y += TILE_SIZE)
+    for (x = extents.x; x < extents.x + extents.width; x += TILE_SIZE)
+      {
+        CdkPaintTile tile;
+
+        tile.area.x = x;
+        tile.area.y = y;
+        tile.area.width = MIN (TILE_SIZE, extents.x + extents.width - x);
+        tile.area.height = MIN (TILE_SIZE, extents.y + extents.height - y);
+        tile.surface = NULL;
+
+        /* Damage is often scattered over the window */
+        if (cairo_region_contains_rectangle (region, &tile.area) != CAIRO_REGION_OVERLAP_OUT)
+          g_array_append_val (tiles, tile);
+      }
+
+  jobs.n_jobs = MIN (g_get_num_processors (), tiles->len / MIN_TILES_PER_JOB);
+  if (jobs.n_jobs < 2)
+    {
+      g_array_free (tiles, TRUE);
+
+      cairo_set_source_surface (cr, recording, 0, 0);
+      cairo_paint (cr);
+      return;
+    }
+
+  if (paint_pool == NULL)
+    paint_pool = g_thread_pool_new (cdk_paint_job_thread_func, NULL,
+                                    g_get_num_processors () - 1, FALSE,
+                                    NULL);
+
+  cairo_surface_get_device_scale (recording, &sx, &sy);
+
+  g_mutex_init (&jobs.mutex);
+  g_cond_init (&jobs.cond);
+  jobs.n_pending = jobs.n_jobs - 1;
+  jobs.tiles = (CdkPaintTile *) tiles->data;
+  jobs.n_tiles = tiles->len;
+  jobs.format = cairo_surface_get_content (recording) == CAIRO_CONTENT_COLOR
+                ? CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32;
+  jobs.scale = sx;
+
+  CDK_NOTE (DRAW, g_message ("painting %u tiles on %u threads", jobs.n_tiles, jobs.n_jobs));
+
+  job = g_new (CdkPaintJob, jobs.n_jobs);
+  for (i = 0; i < jobs.n_jobs; i++)
+    {
+      job[i].jobs = &jobs;
+      job[i].index = i;
+      job[i].recording = copy_recording (recording);
+
+      if (i > 0)
+        g_thread_pool_push (paint_pool, &job[i], NULL);
+    }
+
+  /* Take a share instead of waiting idly */
+  cdk_paint_job_run (&job[0]);
+
+  g_mutex_lock (&jobs.mutex);
+  while (jobs.n_pending > 0)
+    g_cond_wait (&jobs.cond, &jobs.mutex);
+  g_mutex_unlock (&jobs.mutex);
+
+  for (i = 0; i < jobs.n_tiles; i++)
+    {
+      CdkPaintTile *tile = &jobs.tiles[i];
+
+      cairo_set_source_surface (cr, tile->surface, 0, 0);
+      cdk_cairo_rectangle (cr, &tile->area);
+      cairo_fill (cr);
+
+      cairo_surface_destroy (tile->surface);
+    }
+
+  for (i = 0; i < jobs.n_jobs; i++)
+    cairo_surface_destroy (job[i].recording);
+  g_free (job);
+
+  g_array_free (tiles, TRUE);
+  g_cond_clear (&jobs.cond);
+  g_mutex_clear (&jobs.mutex);
+}
@@ -0,0 +1,31 @@
+/* CDK - The GIMP Drawing Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CDK_TILED_PAINT_PRIVATE_H__
+#define __CDK_TILED_PAINT_PRIVATE_H__
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+void     cdk_tiled_paint                 (cairo_t              *cr,
+                                          cairo_surface_t      *recording,
+                                          const cairo_region_t *region);
+
+G_END_DECLS
+
+#endif /* __CDK_TILED_PAINT_PRIVATE_H__ */
@@ -42,6 +42,7 @@
 #include "cdkglcontextprivate.h"
 #include "cdkdrawingcontextprivate.h"
 #include "cdk-private.h"
+#include "cdktiledpaintprivate.h"
 
 #include <math.h>
 
@@ -2926,6 +2927,31 @@ cdk_window_create_gl_context (CdkWindow    *window,
                                                                       error);
 }
 
+/* The surface to record a paint in, for rasterizing it in tiles */
+static cairo_surface_t *
+cdk_window_create_paint_recording (CdkWindow       *window,
+                                   cairo_content_t  content,
+                                   int              width,
+                                   int              height)
+{
+  cairo_surface_t *window_surface, *surface;
+  cairo_rectangle_t rect;
+  double sx, sy;
+
+  window_surface = cdk_window_ref_impl_surface (window);
+  sx = sy = 1;
+  cairo_surface_get_device_scale (window_surface, &sx, &sy);
+  cairo_surface_destroy (window_surface);
+
+  rect.x = rect.y = 0;
+  rect.width = width * sx;
+  rect.height = height * sy;
+  surface = cairo_recording_surface_create (content, &rect);
+  cairo_surface_set_device_scale (surface, sx, sy);
+
+  return surface;
+}
+
 static void
 cdk_window_begin_paint_internal (CdkWindow            *window,
 			         const cairo_region_t *region)
@@ -2998,10 +3024,17 @@ cdk_window_begin_paint_internal (CdkWindow            *window,
 
   if (needs_surface)
     {
-      window->current_paint.surface = cdk_window_create_similar_surface (window,
-                                                                         surface_content,
-                                                                         MAX (clip_box.width, 1),
-                                                                         MAX (clip_box.height, 1));
+      if (!window->current_paint.use_gl &&
+          cdk_display_get_rendering_mode (cdk_window_get_display (window)) == CDK_RENDERING_MODE_TILED)
+        window->current_paint.surface = cdk_window_create_paint_recording (window,
+                                                                           surface_content,
+                                                                           MAX (clip_box.width, 1),
+                                                                           MAX (clip_box.height, 1));
+      else
+        window->current_paint.surface = cdk_window_create_similar_surface (window,
+                                                                           surface_content,
+                                                                           MAX (clip_box.width, 1),
+                                                                           MAX (clip_box.height, 1));
       sx = sy = 1;
       cairo_surface_get_device_scale (window->current_paint.surface, &sx, &sy);
       cairo_surface_set_device_offset (window->current_paint.surface, -clip_box.x*sx, -clip_box.y*sy);
@@ -3078,12 +3111,21 @@ cdk_window_end_paint_internal (CdkWindow *window)
           surface = cdk_window_ref_impl_surface (window);
           cr = cairo_create (surface);
 
-          cairo_set_source_surface (cr, window->current_paint.surface, 0, 0);
           cdk_cairo_region (cr, window->current_paint.region);
           cairo_clip (cr);
 
           cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-          cairo_paint (cr);
+
+          if (cairo_surface_get_type (window->current_paint.surface) == CAIRO_SURFACE_TYPE_RECORDING &&
+              cdk_display_get_rendering_mode (cdk_window_get_display (window)) == CDK_RENDERING_MODE_TILED)
+            {
+              cdk_tiled_paint (cr, window->current_paint.surface, window->current_paint.region);
+            }
+          else
+            {
+              cairo_set_source_surface (cr, window->current_paint.surface, 0, 0);
+              cairo_paint (cr);
+            }
 
           cairo_destroy (cr);
 
@@ -10168,6 +10210,7 @@ cdk_window_create_similar_surface (CdkWindow *     window,
       cairo_surface_set_device_scale (surface, sx, sy);
       break;
     case CDK_RENDERING_MODE_SIMILAR:
+    case CDK_RENDERING_MODE_TILED: /* only paints are recorded */
     default:
       surface = cairo_surface_create_similar (window_surface,
                                               content,
@@ -10461,6 +10504,9 @@ cdk_window_set_title (CdkWindow   *window,
 		      const gchar *title)
 {
   CDK_WINDOW_IMPL_GET_CLASS (window->impl)->set_title (window, title);
+
+  if (window->frame_clock && CDK_IS_FRAME_CLOCK_IDLE (window->frame_clock))
+    _cdk_frame_clock_idle_set_name (CDK_FRAME_CLOCK_IDLE (window->frame_clock), title);
 }
 
 /**
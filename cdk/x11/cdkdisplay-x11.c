@@ -69,6 +69,11 @@
 #include <X11/extensions/Xdamage.h>
 #endif
 
+#ifdef HAVE_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
 #ifdef HAVE_RANDR
 #include <X11/extensions/Xrandr.h>
 #endif
@@ -1679,6 +1684,16 @@ _cdk_x11_display_open (const gchar *display_name)
 #endif
     display_x11->have_xdamage = FALSE;
 
+#ifdef HAVE_XSHM
+  /* This can't tell whether we share memory with the server, that is
+   * only found out when attaching the first segment
+   */
+  if (XShmQueryExtension (display_x11->xdisplay))
+    display_x11->have_shm = TRUE;
+  else
+#endif
+    display_x11->have_shm = FALSE;
+
   display_x11->have_shapes = FALSE;
   display_x11->have_input_shapes = FALSE;
 
@@ -2054,6 +2069,122 @@ cdk_x11_display_ungrab (CdkDisplay *display)
     }
 }
 
+#ifdef HAVE_XSHM
+
+/* Segments are only ever grown, and in big steps: attaching one
+ * needs a roundtrip to find out whether it worked.
+ */
+#define SHM_SEGMENT_GRANULARITY (1024 * 1024)
+
+static void
+cdk_x11_display_free_shm_segment (CdkX11Display *display_x11)
+{
+  XShmSegmentInfo *segment = &display_x11->shm_segment;
+
+  if (segment->shmaddr == NULL)
+    return;
+
+  /* The server handles this after all requests still using the segment */
+  XShmDetach (display_x11->xdisplay, segment);
+  shmdt (segment->shmaddr);
+
+  segment->shmaddr = NULL;
+  display_x11->shm_size = 0;
+}
+
+/*< private >
+ * _cdk_x11_display_get_shm_segment:
+ * @display: a #CdkDisplay
+ * @size: the number of bytes needed
+ *
+ * Returns the shared memory segment of @display, making sure it holds
+ * at least @size bytes and is attached to the X server. The server may
+ * still be reading from the segment, see _cdk_x11_display_wait_shm_segment().
+ *
+ * Returns: the segment, or %NULL if MIT-SHM can't be used
+ */
+XShmSegmentInfo *
+_cdk_x11_display_get_shm_segment (CdkDisplay *display,
+                                  gsize       size)
+{
+  CdkX11Display *display_x11 = CDK_X11_DISPLAY (display);
+  XShmSegmentInfo *segment = &display_x11->shm_segment;
+  gboolean attached;
+
+  if (!display_x11->have_shm)
+    return NULL;
+
+  if (segment->shmaddr != NULL && display_x11->shm_size >= size)
+    return segment;
+
+  cdk_x11_display_free_shm_segment (display_x11);
+
+  size = (size + SHM_SEGMENT_GRANULARITY - 1) & ~(gsize) (SHM_SEGMENT_GRANULARITY - 1);
+
+  /* Running out of segments or hitting the size limit only affects
+   * this request, the next paint may well be smaller
+   */
+  segment->shmid = shmget (IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (segment->shmid == -1)
+    {
+      CDK_NOTE (MISC, g_message ("shmget of %" G_GSIZE_FORMAT " bytes failed: %s",
+                                 size, g_strerror (errno)));
+      return NULL;
+    }
+
+  segment->shmaddr = shmat (segment->shmid, NULL, 0);
+  if (segment->shmaddr == (char *) -1)
+    {
+      CDK_NOTE (MISC, g_message ("shmat failed: %s", g_strerror (errno)));
+      shmctl (segment->shmid, IPC_RMID, NULL);
+      segment->shmaddr = NULL;
+      return NULL;
+    }
+
+  segment->readOnly = True;
+
+  cdk_x11_display_error_trap_push (display);
+  XShmAttach (display_x11->xdisplay, segment);
+  XSync (display_x11->xdisplay, False);
+  attached = cdk_x11_display_error_trap_pop (display) == Success;
+
+  /* Gets the segment freed once both sides detached, even if we crash */
+  shmctl (segment->shmid, IPC_RMID, NULL);
+
+  if (!attached)
+    {
+      CDK_NOTE (MISC, g_message ("Attaching a shared memory segment failed, not using MIT-SHM"));
+      shmdt (segment->shmaddr);
+      segment->shmaddr = NULL;
+      display_x11->have_shm = FALSE;
+      return NULL;
+    }
+
+  display_x11->shm_size = size;
+  display_x11->shm_serial = 0;
+
+  return segment;
+}
+
+/*< private >
+ * _cdk_x11_display_wait_shm_segment:
+ * @display: a #CdkDisplay
+ *
+ * Blocks until the X server is done with the requests reading from the
+ * shared memory segment, so that it can be written to again. Usually
+ * the server has long caught up and this doesn't need a roundtrip.
+ */
+void
+_cdk_x11_display_wait_shm_segment (CdkDisplay *display)
+{
+  CdkX11Display *display_x11 = CDK_X11_DISPLAY (display);
+
+  if ((glong) (display_x11->shm_serial - LastKnownRequestProcessed (display_x11->xdisplay)) > 0)
+    XSync (display_x11->xdisplay, False);
+}
+
+#endif /* HAVE_XSHM */
+
 static void
 cdk_x11_display_dispose (GObject *object)
 {
@@ -2092,6 +2223,10 @@ cdk_x11_display_finalize (GObject *object)
   /* Leader Window */
   XDestroyWindow (display_x11->xdisplay, display_x11->leader_window);
 
+#ifdef HAVE_XSHM
+  cdk_x11_display_free_shm_segment (display_x11);
+#endif
+
   /* List of event window extraction functions */
   g_slist_free_full (display_x11->event_types, g_free);
 
@@ -31,6 +31,10 @@
 #include <X11/X.h>
 #include <X11/Xlib.h>
 
+#ifdef HAVE_XSHM
+#include <X11/extensions/XShm.h>
+#endif
+
 G_BEGIN_DECLS
 
 
@@ -65,6 +69,16 @@ struct _CdkX11Display
   gboolean have_xdamage;
   gint xdamage_event_base;
 
+  /* MIT-SHM, turned off again when attaching a segment fails,
+   * e.g. because the server runs on another machine
+   */
+  gboolean have_shm;
+#ifdef HAVE_XSHM
+  XShmSegmentInfo shm_segment;
+  gsize shm_size;
+  gulong shm_serial;   /* of the last request reading from the segment */
+#endif
+
   gboolean have_randr12;
   gboolean have_randr13;
   gboolean have_randr15;
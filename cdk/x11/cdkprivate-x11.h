@@ -179,6 +179,12 @@ void _cdk_x11_display_update_grab_info_ungrab (CdkDisplay *display,
                                                gulong      serial);
 void _cdk_x11_display_queue_events            (CdkDisplay *display);
 
+#ifdef HAVE_XSHM
+XShmSegmentInfo * _cdk_x11_display_get_shm_segment  (CdkDisplay *display,
+                                                     gsize       size);
+void              _cdk_x11_display_wait_shm_segment (CdkDisplay *display);
+#endif
+
 
 CdkAppLaunchContext *_cdk_x11_display_get_app_launch_context (CdkDisplay *display);
 Window      _cdk_x11_display_get_drag_protocol     (CdkDisplay      *display,
@@ -72,6 +72,10 @@
 #include <X11/extensions/Xdamage.h>
 #endif
 
+#ifdef HAVE_XSHM
+#include <X11/extensions/XShm.h>
+#endif
+
 const int _cdk_x11_event_mask_table[21] =
 {
   ExposureMask,
@@ -509,6 +513,149 @@ cdk_x11_ref_cairo_surface (CdkWindow *window)
   return impl->cairo_surface;
 }
 
+#ifdef HAVE_XSHM
+/* With client-side rendering (CDK_RENDERING=image) the generic code
+ * would have cairo send the whole paint over the connection. Instead
+ * copy it into a segment shared with the server and let the server
+ * read it from there.
+ */
+static gboolean
+cdk_x11_window_put_paint_shm (CdkWindow *window)
+{
+  CdkWindowImplX11 *impl = CDK_WINDOW_IMPL_X11 (window->impl);
+  CdkDisplay *display = cdk_window_get_display (window);
+  Display *xdisplay = CDK_DISPLAY_XDISPLAY (display);
+  cairo_surface_t *surface = window->current_paint.surface;
+  cairo_region_t *region = window->current_paint.region;
+  CdkWindow *w;
+  CdkVisual *visual;
+  Visual *xvisual;
+  gint depth;
+  cairo_format_t format;
+  cairo_rectangle_int_t extents, rect;
+  XShmSegmentInfo *segment;
+  XImage *image;
+  XRectangle *rects;
+  GC gc;
+  guchar *data;
+  double offset_x, offset_y;
+  int scale, width, height, stride, n_rects, i, y;
+
+  if (window->current_paint.use_gl ||
+      !window->current_paint.surface_needs_composite ||
+      cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+      cairo_region_is_empty (region))
+    return FALSE;
+
+  /* The generic code also has to invalidate the parents of those */
+  for (w = window; w->parent; w = w->parent)
+    {
+      if (w->composited)
+        return FALSE;
+    }
+
+  /* The pixels are sent as they are, so they must match the visual */
+  visual = cdk_window_get_visual (window);
+  xvisual = CDK_VISUAL_XVISUAL (visual);
+  depth = cdk_visual_get_depth (visual);
+  format = cairo_image_surface_get_format (surface);
+  if (!((format == CAIRO_FORMAT_ARGB32 && depth == 32) ||
+        (format == CAIRO_FORMAT_RGB24 && depth == 24)) ||
+      xvisual->red_mask != 0xff0000 ||
+      xvisual->green_mask != 0xff00 ||
+      xvisual->blue_mask != 0xff ||
+      ImageByteOrder (xdisplay) != (G_BYTE_ORDER == G_LITTLE_ENDIAN ? LSBFirst : MSBFirst))
+    return FALSE;
+
+  scale = impl->window_scale;
+  cairo_region_get_extents (region, &extents);
+  width = extents.width * scale;
+  height = extents.height * scale;
+
+  segment = _cdk_x11_display_get_shm_segment (display, (gsize) width * height * 4);
+  if (segment == NULL)
+    return FALSE;
+
+  image = XShmCreateImage (xdisplay, xvisual, depth, ZPixmap,
+                           segment->shmaddr, segment,
+                           width, height);
+  if (image == NULL)
+    return FALSE;
+
+  if (image->bits_per_pixel != 32 || image->bytes_per_line != width * 4)
+    {
+      image->data = NULL;
+      XDestroyImage (image);
+      return FALSE;
+    }
+
+  /* Don't overwrite what the server may still be reading */
+  _cdk_x11_display_wait_shm_segment (display);
+
+  cairo_surface_flush (surface);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+  /* maps window pixels to surface pixels */
+  cairo_surface_get_device_offset (surface, &offset_x, &offset_y);
+
+  n_rects = cairo_region_num_rectangles (region);
+  rects = g_new (XRectangle, n_rects);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_region_get_rectangle (region, i, &rect);
+      rect.x *= scale;
+      rect.y *= scale;
+      rect.width *= scale;
+      rect.height *= scale;
+
+      for (y = 0; y < rect.height; y++)
+        memcpy (image->data + (rect.y - extents.y * scale + y) * image->bytes_per_line + (rect.x - extents.x * scale) * 4,
+                data + (rect.y + (int) offset_y + y) * stride + (rect.x + (int) offset_x) * 4,
+                rect.width * 4);
+
+      rects[i].x = rect.x;
+      rects[i].y = rect.y;
+      rects[i].width = rect.width;
+      rects[i].height = rect.height;
+    }
+
+  /* What cairo would do to the window surface on drawing */
+  if (impl->tracking_damage)
+    window_pre_damage (window);
+  if (impl->cairo_surface)
+    cairo_surface_flush (impl->cairo_surface);
+
+  gc = XCreateGC (xdisplay, impl->xid, 0, NULL);
+  XSetClipRectangles (xdisplay, gc, 0, 0, rects, n_rects, Unsorted);
+
+  CDK_X11_DISPLAY (display)->shm_serial = NextRequest (xdisplay);
+  XShmPutImage (xdisplay, impl->xid, gc, image,
+                0, 0,
+                extents.x * scale, extents.y * scale,
+                width, height,
+                False);
+
+  XFreeGC (xdisplay, gc);
+  g_free (rects);
+
+  /* The data belongs to the segment */
+  image->data = NULL;
+  XDestroyImage (image);
+
+  return TRUE;
+}
+
+static void
+cdk_x11_window_end_paint (CdkWindow *window)
+{
+  if (CDK_WINDOW_DESTROYED (window))
+    return;
+
+  if (cdk_x11_window_put_paint_shm (window))
+    window->current_paint.surface_needs_composite = FALSE;
+}
+#endif /* HAVE_XSHM */
+
 static void
 cdk_window_impl_x11_finalize (GObject *object)
 {
@@ -5807,6 +5954,9 @@ cdk_window_impl_x11_class_init (CdkWindowImplX11Class *klass)
   object_class->finalize = cdk_window_impl_x11_finalize;
   
   impl_class->ref_cairo_surface = cdk_x11_ref_cairo_surface;
+#ifdef HAVE_XSHM
+  impl_class->end_paint = cdk_x11_window_end_paint;
+#endif
   impl_class->show = cdk_window_x11_show;
   impl_class->hide = cdk_window_x11_hide;
   impl_class->withdraw = cdk_window_x11_withdraw;
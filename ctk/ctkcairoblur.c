@@ -25,6 +25,21 @@
 #include <math.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* AVX2 is not part of the x86-64 baseline, so it is compiled in with
+ * the target attribute and only used when the CPU supports it.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+
 /*
  * Gets the size for a single box blur.
  *
@@ -156,6 +171,440 @@ blur_rows (guchar *dst_buffer,
     }
 }
 
+/* Vertical blur passes handle a whole row of columns at a time: every
+ * column keeps its own running sum, so many columns are summed in
+ * parallel with SIMD instructions. The division by the filter size is
+ * done as a multiplication with a multiplier that has been checked to
+ * give the same results as the division in blur_xspan() for all sums
+ * that can occur, so both paths produce identical output.
+ */
+typedef struct {
+  int     d;
+  guint32 multiplier;
+  int     shift;
+} BlurDivisor;
+
+/* Sums are kept in 16 bits, which limits the filter size */
+#define MAX_COLUMN_FILTER_SIZE 256
+
+static gboolean
+blur_divisor_init (BlurDivisor *divisor,
+                   int          d)
+{
+  guint32 n, max_n, m;
+  int s;
+
+  if (d > MAX_COLUMN_FILTER_SIZE)
+    return FALSE;
+
+  max_n = 255 * d + d / 2;
+
+  for (s = g_bit_nth_msf (d, -1); s >= 0; s--)
+    {
+      m = ((1u << (16 + s)) + d - 1) / d;
+      if (m > G_MAXUINT16)
+        continue;
+
+      for (n = d / 2; n <= max_n; n++)
+        {
+          if ((n * m) >> (16 + s) != n / d)
+            break;
+        }
+
+      if (n > max_n)
+        {
+          divisor->d = d;
+          divisor->multiplier = m;
+          divisor->shift = s;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static const BlurDivisor *
+blur_divisor_get (int d)
+{
+  static BlurDivisor divisors[MAX_COLUMN_FILTER_SIZE + 1];
+  static gboolean checked[MAX_COLUMN_FILTER_SIZE + 1];
+  static gboolean valid[MAX_COLUMN_FILTER_SIZE + 1];
+
+  if (d > MAX_COLUMN_FILTER_SIZE)
+    return NULL;
+
+  if (!checked[d])
+    {
+      valid[d] = blur_divisor_init (&divisors[d], d);
+      checked[d] = TRUE;
+    }
+
+  return valid[d] ? &divisors[d] : NULL;
+}
+
+/* Adds the @add row to the column sums, removes the @sub row and
+ * writes the averages to @dst.
+ */
+typedef void (* BlurColumnsStepFunc) (guint16           *sums,
+                                      const guchar      *add,
+                                      const guchar      *sub,
+                                      guchar            *dst,
+                                      int                n,
+                                      const BlurDivisor *divisor);
+
+static void
+blur_columns_step_c (guint16           *sums,
+                     const guchar      *add,
+                     const guchar      *sub,
+                     guchar            *dst,
+                     int                n,
+                     const BlurDivisor *divisor)
+{
+  guint16 half = divisor->d / 2;
+  int x;
+
+  for (x = 0; x < n; x++)
+    {
+      guint16 sum = sums[x] + add[x] - sub[x];
+
+      sums[x] = sum;
+      dst[x] = ((guint16) (sum + half) * divisor->multiplier) >> (16 + divisor->shift);
+    }
+}
+
+#if defined(__SSE2__)
+static void
+blur_columns_step_sse2 (guint16           *sums,
+                        const guchar      *add,
+                        const guchar      *sub,
+                        guchar            *dst,
+                        int                n,
+                        const BlurDivisor *divisor)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i half = _mm_set1_epi16 (divisor->d / 2);
+  const __m128i multiplier = _mm_set1_epi16 ((short) divisor->multiplier);
+  const __m128i shift = _mm_cvtsi32_si128 (divisor->shift);
+  int x;
+
+  for (x = 0; x + 16 <= n; x += 16)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (add + x));
+      __m128i s = _mm_loadu_si128 ((const __m128i *) (sub + x));
+      __m128i lo = _mm_loadu_si128 ((const __m128i *) (sums + x));
+      __m128i hi = _mm_loadu_si128 ((const __m128i *) (sums + x + 8));
+
+      lo = _mm_sub_epi16 (_mm_add_epi16 (lo, _mm_unpacklo_epi8 (a, zero)), _mm_unpacklo_epi8 (s, zero));
+      hi = _mm_sub_epi16 (_mm_add_epi16 (hi, _mm_unpackhi_epi8 (a, zero)), _mm_unpackhi_epi8 (s, zero));
+      _mm_storeu_si128 ((__m128i *) (sums + x), lo);
+      _mm_storeu_si128 ((__m128i *) (sums + x + 8), hi);
+
+      lo = _mm_srl_epi16 (_mm_mulhi_epu16 (_mm_add_epi16 (lo, half), multiplier), shift);
+      hi = _mm_srl_epi16 (_mm_mulhi_epu16 (_mm_add_epi16 (hi, half), multiplier), shift);
+      _mm_storeu_si128 ((__m128i *) (dst + x), _mm_packus_epi16 (lo, hi));
+    }
+
+  blur_columns_step_c (sums + x, add + x, sub + x, dst + x, n - x, divisor);
+}
+#endif
+
+#if defined(HAVE_AVX2_DISPATCH)
+__attribute__ ((target ("avx2")))
+static void
+blur_columns_step_avx2 (guint16           *sums,
+                        const guchar      *add,
+                        const guchar      *sub,
+                        guchar            *dst,
+                        int                n,
+                        const BlurDivisor *divisor)
+{
+  const __m256i half = _mm256_set1_epi16 (divisor->d / 2);
+  const __m256i multiplier = _mm256_set1_epi16 ((short) divisor->multiplier);
+  const __m128i shift = _mm_cvtsi32_si128 (divisor->shift);
+  int x;
+
+  for (x = 0; x + 32 <= n; x += 32)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) (add + x));
+      __m256i s = _mm256_loadu_si256 ((const __m256i *) (sub + x));
+      __m256i lo = _mm256_loadu_si256 ((const __m256i *) (sums + x));
+      __m256i hi = _mm256_loadu_si256 ((const __m256i *) (sums + x + 16));
+
+      lo = _mm256_add_epi16 (lo, _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (a)));
+      lo = _mm256_sub_epi16 (lo, _mm256_cvtepu8_epi16 (_mm256_castsi256_si128 (s)));
+      hi = _mm256_add_epi16 (hi, _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (a, 1)));
+      hi = _mm256_sub_epi16 (hi, _mm256_cvtepu8_epi16 (_mm256_extracti128_si256 (s, 1)));
+      _mm256_storeu_si256 ((__m256i *) (sums + x), lo);
+      _mm256_storeu_si256 ((__m256i *) (sums + x + 16), hi);
+
+      lo = _mm256_srl_epi16 (_mm256_mulhi_epu16 (_mm256_add_epi16 (lo, half), multiplier), shift);
+      hi = _mm256_srl_epi16 (_mm256_mulhi_epu16 (_mm256_add_epi16 (hi, half), multiplier), shift);
+      /* packus works per 128-bit lane, so put the quadwords back in order */
+      _mm256_storeu_si256 ((__m256i *) (dst + x),
+                           _mm256_permute4x64_epi64 (_mm256_packus_epi16 (lo, hi), _MM_SHUFFLE (3, 1, 2, 0)));
+    }
+
+  blur_columns_step_c (sums + x, add + x, sub + x, dst + x, n - x, divisor);
+}
+#endif
+
+#if defined(__ARM_NEON)
+static void
+blur_columns_step_neon (guint16           *sums,
+                        const guchar      *add,
+                        const guchar      *sub,
+                        guchar            *dst,
+                        int                n,
+                        const BlurDivisor *divisor)
+{
+  const uint16x8_t half = vdupq_n_u16 (divisor->d / 2);
+  const uint16_t multiplier = divisor->multiplier;
+  const int32x4_t shift = vdupq_n_s32 (-(16 + divisor->shift));
+  int x;
+
+  for (x = 0; x + 16 <= n; x += 16)
+    {
+      uint8x16_t a = vld1q_u8 (add + x);
+      uint8x16_t s = vld1q_u8 (sub + x);
+      uint16x8_t lo = vld1q_u16 (sums + x);
+      uint16x8_t hi = vld1q_u16 (sums + x + 8);
+      uint32x4_t q0, q1, q2, q3;
+
+      lo = vsubw_u8 (vaddw_u8 (lo, vget_low_u8 (a)), vget_low_u8 (s));
+      hi = vsubw_u8 (vaddw_u8 (hi, vget_high_u8 (a)), vget_high_u8 (s));
+      vst1q_u16 (sums + x, lo);
+      vst1q_u16 (sums + x + 8, hi);
+
+      lo = vaddq_u16 (lo, half);
+      hi = vaddq_u16 (hi, half);
+      q0 = vshlq_u32 (vmull_n_u16 (vget_low_u16 (lo), multiplier), shift);
+      q1 = vshlq_u32 (vmull_n_u16 (vget_high_u16 (lo), multiplier), shift);
+      q2 = vshlq_u32 (vmull_n_u16 (vget_low_u16 (hi), multiplier), shift);
+      q3 = vshlq_u32 (vmull_n_u16 (vget_high_u16 (hi), multiplier), shift);
+
+      vst1q_u8 (dst + x, vcombine_u8 (vmovn_u16 (vcombine_u16 (vmovn_u32 (q0), vmovn_u32 (q1))),
+                                      vmovn_u16 (vcombine_u16 (vmovn_u32 (q2), vmovn_u32 (q3)))));
+    }
+
+  blur_columns_step_c (sums + x, add + x, sub + x, dst + x, n - x, divisor);
+}
+#endif
+
+static BlurColumnsStepFunc
+get_blur_columns_step (void)
+{
+  static BlurColumnsStepFunc step = NULL;
+
+  if (step == NULL)
+    {
+#if defined(HAVE_AVX2_DISPATCH)
+      if (__builtin_cpu_supports ("avx2"))
+        step = blur_columns_step_avx2;
+#endif
+#if defined(__SSE2__)
+      if (step == NULL)
+        step = blur_columns_step_sse2;
+#elif defined(__ARM_NEON)
+      step = blur_columns_step_neon;
+#endif
+      if (step == NULL)
+        step = blur_columns_step_c;
+    }
+
+  return step;
+}
+
+/* Scratch memory for blurring columns @x0 to @x1 */
+typedef struct {
+  guint16 *sums;
+  guchar  *zeros;
+  guchar  *scratch;
+} BlurColumns;
+
+/* The same as blur_xspan() applied to every column between
+ * @x0 and @x1, reading from @src and writing to @dst.
+ */
+static void
+blur_columns_pass (const guchar      *src,
+                   guchar            *dst,
+                   int                stride,
+                   int                height,
+                   int                x0,
+                   int                x1,
+                   const BlurDivisor *divisor,
+                   int                shift,
+                   BlurColumns       *columns)
+{
+  BlurColumnsStepFunc step = get_blur_columns_step ();
+  int d = divisor->d;
+  int n = x1 - x0;
+  int offset;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  memset (columns->sums, 0, n * sizeof (guint16));
+
+  for (i = 0; i < height + offset; i++)
+    {
+      step (columns->sums,
+            i < height ? src + i * stride + x0 : columns->zeros,
+            i >= d ? src + (i - d) * stride + x0 : columns->zeros,
+            i >= offset ? dst + (i - offset) * stride + x0 : columns->scratch,
+            n,
+            divisor);
+    }
+}
+
+/* The same as blur_rows() on the flipped buffer: blurs the columns
+ * between @x0 and @x1 of @buffer, using @tmp_buffer of the same size.
+ */
+static void
+blur_columns (guchar            *buffer,
+              guchar            *tmp_buffer,
+              int                stride,
+              int                height,
+              int                x0,
+              int                x1,
+              const BlurDivisor *divisor,
+              const BlurDivisor *divisor_plus_one)
+{
+  BlurColumns columns;
+  int n = x1 - x0;
+  int i;
+
+  columns.sums = g_new (guint16, n);
+  columns.zeros = g_malloc0 (n);
+  columns.scratch = g_malloc (n);
+
+  if (divisor->d % 2 == 1)
+    {
+      blur_columns_pass (buffer, tmp_buffer, stride, height, x0, x1, divisor, 0, &columns);
+      blur_columns_pass (tmp_buffer, buffer, stride, height, x0, x1, divisor, 0, &columns);
+      blur_columns_pass (buffer, tmp_buffer, stride, height, x0, x1, divisor, 0, &columns);
+    }
+  else
+    {
+      blur_columns_pass (buffer, tmp_buffer, stride, height, x0, x1, divisor, 1, &columns);
+      blur_columns_pass (tmp_buffer, buffer, stride, height, x0, x1, divisor, -1, &columns);
+      blur_columns_pass (buffer, tmp_buffer, stride, height, x0, x1, divisor_plus_one, 0, &columns);
+    }
+
+  for (i = 0; i < height; i++)
+    memcpy (buffer + i * stride + x0, tmp_buffer + i * stride + x0, n);
+
+  g_free (columns.sums);
+  g_free (columns.zeros);
+  g_free (columns.scratch);
+}
+
+/* Large surfaces are split into strips of columns that are blurred
+ * on a thread pool.
+ */
+#define MIN_PIXELS_PER_THREAD (256 * 256)
+#define STRIP_ALIGNMENT 32
+
+typedef struct {
+  guchar            *buffer;
+  guchar            *tmp_buffer;
+  int                stride;
+  int                height;
+  const BlurDivisor *divisor;
+  const BlurDivisor *divisor_plus_one;
+
+  int                strip_width;
+  int                n_strips;
+  int                next_strip;      /* atomic */
+
+  GMutex             mutex;
+  GCond              cond;
+  int                n_running;
+} BlurJob;
+
+static void
+blur_job_run (BlurJob *job)
+{
+  int strip, x0, x1;
+
+  while ((strip = g_atomic_int_add (&job->next_strip, 1)) < job->n_strips)
+    {
+      x0 = strip * job->strip_width;
+      x1 = MIN (x0 + job->strip_width, job->stride);
+
+      blur_columns (job->buffer, job->tmp_buffer, job->stride, job->height,
+                    x0, x1, job->divisor, job->divisor_plus_one);
+    }
+}
+
+static void
+blur_job_thread_func (gpointer data,
+                      gpointer user_data G_GNUC_UNUSED)
+{
+  BlurJob *job = data;
+
+  blur_job_run (job);
+
+  g_mutex_lock (&job->mutex);
+  job->n_running--;
+  if (job->n_running == 0)
+    g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->mutex);
+}
+
+static void
+blur_columns_parallel (guchar            *buffer,
+                       guchar            *tmp_buffer,
+                       int                stride,
+                       int                height,
+                       const BlurDivisor *divisor,
+                       const BlurDivisor *divisor_plus_one)
+{
+  static GThreadPool *pool = NULL;
+  BlurJob job;
+  int n_threads, i;
+
+  n_threads = MIN (g_get_num_processors (), (stride * height) / MIN_PIXELS_PER_THREAD);
+  n_threads = MIN (n_threads, stride / STRIP_ALIGNMENT);
+
+  if (n_threads <= 1)
+    {
+      blur_columns (buffer, tmp_buffer, stride, height, 0, stride, divisor, divisor_plus_one);
+      return;
+    }
+
+  if (pool == NULL)
+    pool = g_thread_pool_new (blur_job_thread_func, NULL, g_get_num_processors () - 1, FALSE, NULL);
+
+  job.buffer = buffer;
+  job.tmp_buffer = tmp_buffer;
+  job.stride = stride;
+  job.height = height;
+  job.divisor = divisor;
+  job.divisor_plus_one = divisor_plus_one;
+  job.strip_width = (stride / n_threads + STRIP_ALIGNMENT - 1) / STRIP_ALIGNMENT * STRIP_ALIGNMENT;
+  job.n_strips = (stride + job.strip_width - 1) / job.strip_width;
+  job.next_strip = 0;
+  job.n_running = n_threads - 1;
+  g_mutex_init (&job.mutex);
+  g_cond_init (&job.cond);
+
+  for (i = 1; i < n_threads; i++)
+    g_thread_pool_push (pool, &job, NULL);
+
+  blur_job_run (&job);
+
+  g_mutex_lock (&job.mutex);
+  while (job.n_running > 0)
+    g_cond_wait (&job.cond, &job.mutex);
+  g_mutex_unlock (&job.mutex);
+
+  g_mutex_clear (&job.mutex);
+  g_cond_clear (&job.cond);
+}
+
 /* Swaps width and height.
  */
 static void
@@ -192,11 +641,43 @@ _boxblur (guchar      *buffer,
           int          radius,
           CtkBlurFlags flags)
 {
+  const BlurDivisor *divisor, *divisor_plus_one;
   guchar *flipped_buffer;
   int d = get_box_filter_size (radius);
 
   flipped_buffer = g_malloc (width * height);
 
+  if (flags & CTK_BLUR_REFERENCE)
+    {
+      divisor = NULL;
+      divisor_plus_one = NULL;
+    }
+  else
+    {
+      divisor = blur_divisor_get (d);
+      divisor_plus_one = blur_divisor_get (d + 1);
+    }
+
+  if (divisor && divisor_plus_one)
+    {
+      if (flags & CTK_BLUR_Y)
+        blur_columns_parallel (buffer, flipped_buffer, width, height, divisor, divisor_plus_one);
+
+      if (flags & CTK_BLUR_X)
+        {
+          guchar *tmp_buffer = g_malloc (width * height);
+
+          flip_buffer (flipped_buffer, buffer, width, height);
+          blur_columns_parallel (flipped_buffer, tmp_buffer, height, width, divisor, divisor_plus_one);
+          flip_buffer (buffer, flipped_buffer, height, width);
+
+          g_free (tmp_buffer);
+        }
+
+      g_free (flipped_buffer);
+      return;
+    }
+
   if (flags & CTK_BLUR_Y)
     {
       /* Step 1: swap rows and columns */
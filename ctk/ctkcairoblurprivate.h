@@ -33,7 +33,9 @@ typedef enum {
   CTK_BLUR_NONE = 0,
   CTK_BLUR_X = 1<<0,
   CTK_BLUR_Y = 1<<1,
-  CTK_BLUR_REPEAT = 1<<2
+  CTK_BLUR_REPEAT = 1<<2,
+  /* Use the scalar implementation, for comparing results */
+  CTK_BLUR_REFERENCE = 1<<3
 } CtkBlurFlags;
 
 void            _ctk_cairo_blur_surface         (cairo_surface_t *surface,
@@ -152,6 +152,29 @@ ctk_css_animated_style_get_intrinsic_value (CtkCssAnimatedStyle *style,
   return ctk_css_style_get_value (style->style, id);
 }
 
+/* Adds the ids of all properties with an animated value to @mask.
+ * All other properties have the value of the base style.
+ */
+CtkBitmask *
+ctk_css_animated_style_add_animated_properties (CtkCssAnimatedStyle *style,
+                                                CtkBitmask          *mask)
+{
+  guint i;
+
+  ctk_internal_return_val_if_fail (CTK_IS_CSS_ANIMATED_STYLE (style), mask);
+
+  if (style->animated_values == NULL)
+    return mask;
+
+  for (i = 0; i < style->animated_values->len; i++)
+    {
+      if (g_ptr_array_index (style->animated_values, i))
+        mask = _ctk_bitmask_set (mask, i, TRUE);
+    }
+
+  return mask;
+}
+
 /* TRANSITIONS */
 
 typedef struct _TransitionInfo TransitionInfo;
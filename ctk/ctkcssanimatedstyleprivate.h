@@ -67,6 +67,9 @@ void                    ctk_css_animated_style_set_animated_value(CtkCssAnimated
                                                                         
 CtkCssValue *           ctk_css_animated_style_get_intrinsic_value (CtkCssAnimatedStyle *style,
                                                                  guint                   id);
+CtkBitmask *            ctk_css_animated_style_add_animated_properties
+                                                                (CtkCssAnimatedStyle    *style,
+                                                                 CtkBitmask             *mask);
 
 G_END_DECLS
 
@@ -97,6 +97,18 @@ ctk_css_value_array_equal (const CtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+ctk_css_value_array_hash (const CtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->n_values;
+  for (i = 0; i < value->n_values; i++)
+    hash = (hash << 5) - hash + _ctk_css_value_hash (value->values[i]);
+
+  return hash;
+}
+
 static guint
 gcd (guint a, guint b)
 {
@@ -325,7 +337,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_ARRAY = {
   ctk_css_value_array_compute,
   ctk_css_value_array_equal,
   ctk_css_value_array_transition,
-  ctk_css_value_array_print
+  ctk_css_value_array_print,
+  ctk_css_value_array_hash
 };
 
 CtkCssValue *
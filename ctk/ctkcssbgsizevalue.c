@@ -88,6 +88,17 @@ ctk_css_value_bg_size_equal (const CtkCssValue *value1,
            _ctk_css_value_equal (value1->y, value2->y)));
 }
 
+static guint
+ctk_css_value_bg_size_hash (const CtkCssValue *value)
+{
+  guint hash;
+
+  hash = value->x ? _ctk_css_value_hash (value->x) : 0;
+  hash = (hash << 5) - hash + (value->y ? _ctk_css_value_hash (value->y) : 0);
+
+  return hash << 2 | value->cover << 1 | value->contain;
+}
+
 static CtkCssValue *
 ctk_css_value_bg_size_transition (CtkCssValue *start,
                                   CtkCssValue *end,
@@ -157,7 +168,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_BG_SIZE = {
   ctk_css_value_bg_size_compute,
   ctk_css_value_bg_size_equal,
   ctk_css_value_bg_size_transition,
-  ctk_css_value_bg_size_print
+  ctk_css_value_bg_size_print,
+  ctk_css_value_bg_size_hash
 };
 
 static CtkCssValue auto_singleton = { &CTK_CSS_VALUE_BG_SIZE, 1, FALSE, FALSE, NULL, NULL };
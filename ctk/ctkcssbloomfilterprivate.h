@@ -0,0 +1,89 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CTK_CSS_BLOOM_FILTER_PRIVATE_H__
+#define __CTK_CSS_BLOOM_FILTER_PRIVATE_H__
+
+#include <glib.h>
+#include <string.h>
+
+#include "ctk/ctkcsstypesprivate.h"
+
+G_BEGIN_DECLS
+
+#define CTK_CSS_BLOOM_FILTER_BITS 512
+
+typedef struct _CtkCssBloomFilter CtkCssBloomFilter;
+
+/* A Bloom filter of the names, classes and ids of a node and all its
+ * ancestors. It answers "definitely not an ancestor" for the children
+ * of @node, which lets selector matching skip descendant combinators
+ * without walking up the tree.
+ *
+ * It is small enough to be copied for every level of the tree.
+ */
+struct _CtkCssBloomFilter {
+  CtkCssNode *node;
+  guint32     bits[CTK_CSS_BLOOM_FILTER_BITS / 32];
+};
+
+static inline guint32
+ctk_css_bloom_filter_hash (gsize key)
+{
+  /* Fibonacci hashing, interned strings and quarks are badly distributed */
+  return (guint32) (((guint64) key * G_GUINT64_CONSTANT (0x9E3779B97F4A7C15)) >> 32);
+}
+
+static inline void
+ctk_css_bloom_filter_init (CtkCssBloomFilter       *filter,
+                           const CtkCssBloomFilter *parent,
+                           CtkCssNode              *node)
+{
+  if (parent)
+    memcpy (filter->bits, parent->bits, sizeof (filter->bits));
+  else
+    memset (filter->bits, 0, sizeof (filter->bits));
+
+  filter->node = node;
+}
+
+static inline void
+ctk_css_bloom_filter_add (CtkCssBloomFilter *filter,
+                          gsize              key)
+{
+  guint32 hash = ctk_css_bloom_filter_hash (key);
+  guint bit1 = hash % CTK_CSS_BLOOM_FILTER_BITS;
+  guint bit2 = (hash >> 16) % CTK_CSS_BLOOM_FILTER_BITS;
+
+  filter->bits[bit1 / 32] |= 1u << (bit1 % 32);
+  filter->bits[bit2 / 32] |= 1u << (bit2 % 32);
+}
+
+static inline gboolean
+ctk_css_bloom_filter_may_contain (const CtkCssBloomFilter *filter,
+                                  gsize                    key)
+{
+  guint32 hash = ctk_css_bloom_filter_hash (key);
+  guint bit1 = hash % CTK_CSS_BLOOM_FILTER_BITS;
+  guint bit2 = (hash >> 16) % CTK_CSS_BLOOM_FILTER_BITS;
+
+  return (filter->bits[bit1 / 32] & (1u << (bit1 % 32))) &&
+         (filter->bits[bit2 / 32] & (1u << (bit2 % 32)));
+}
+
+G_END_DECLS
+
+#endif /* __CTK_CSS_BLOOM_FILTER_PRIVATE_H__ */
@@ -100,6 +100,23 @@ ctk_css_value_border_equal (const CtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+ctk_css_value_border_hash (const CtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->fill;
+  for (i = 0; i < 4; i++)
+    {
+      if (value->values[i])
+        hash = (hash << 5) - hash + _ctk_css_value_hash (value->values[i]);
+      else
+        hash = (hash << 5) - hash;
+    }
+
+  return hash;
+}
+
 static CtkCssValue *
 ctk_css_value_border_transition (CtkCssValue *start G_GNUC_UNUSED,
                                  CtkCssValue *end G_GNUC_UNUSED,
@@ -144,7 +161,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_BORDER = {
   ctk_css_value_border_compute,
   ctk_css_value_border_equal,
   ctk_css_value_border_transition,
-  ctk_css_value_border_print
+  ctk_css_value_border_print,
+  ctk_css_value_border_hash
 };
 
 CtkCssValue *
@@ -0,0 +1,195 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ctkcsscacheprivate.h"
+
+#include <string.h>
+
+#include "ctkversion.h"
+
+/* Helpers for the on-disk cache of parsed style sheets that CtkCssProvider
+ * keeps for themes. Like the compose table cache, all integers are stored
+ * big-endian so a cache directory shared between machines stays valid, and
+ * the header carries the CTK+ version so caches never survive an upgrade:
+ * the format mirrors internal data structures that may change at any time.
+ */
+
+#define CTK_CSS_CACHE_MAGIC "CTKCSSC"
+#define CTK_CSS_CACHE_VERSION 1
+
+char *
+ctk_css_cache_get_path (GFile *file)
+{
+  char *uri, *checksum, *basename, *dir, *path;
+
+  uri = g_file_get_uri (file);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+  g_free (uri);
+
+  basename = g_strconcat (checksum, ".cache", NULL);
+  g_free (checksum);
+
+  dir = g_build_filename (g_get_user_cache_dir (), "ctk-3.0", "css", NULL);
+  if (g_mkdir_with_parents (dir, 0755) == 0)
+    path = g_build_filename (dir, basename, NULL);
+  else
+    path = NULL;
+
+  g_free (dir);
+  g_free (basename);
+
+  return path;
+}
+
+char *
+ctk_css_cache_checksum (GBytes *bytes)
+{
+  return g_compute_checksum_for_bytes (G_CHECKSUM_SHA1, bytes);
+}
+
+void
+ctk_css_cache_write_uint32 (GByteArray *bytes,
+                            guint32     value)
+{
+  value = GUINT32_TO_BE (value);
+  g_byte_array_append (bytes, (guint8 *) &value, sizeof (guint32));
+}
+
+void
+ctk_css_cache_write_int64 (GByteArray *bytes,
+                           gint64      value)
+{
+  value = GINT64_TO_BE (value);
+  g_byte_array_append (bytes, (guint8 *) &value, sizeof (gint64));
+}
+
+void
+ctk_css_cache_write_string (GByteArray *bytes,
+                            const char *string)
+{
+  gsize len = strlen (string);
+
+  /* Keep the terminating NUL so strings can be used straight from
+   * the mapped file, the CSS parser wants NUL-terminated input.
+   */
+  ctk_css_cache_write_uint32 (bytes, len);
+  g_byte_array_append (bytes, (guint8 *) string, len + 1);
+}
+
+void
+ctk_css_cache_write_header (GByteArray *bytes)
+{
+  g_byte_array_append (bytes, (guint8 *) CTK_CSS_CACHE_MAGIC, sizeof (CTK_CSS_CACHE_MAGIC));
+  ctk_css_cache_write_uint32 (bytes, CTK_CSS_CACHE_VERSION);
+  ctk_css_cache_write_uint32 (bytes, CTK_MAJOR_VERSION);
+  ctk_css_cache_write_uint32 (bytes, CTK_MINOR_VERSION);
+  ctk_css_cache_write_uint32 (bytes, CTK_MICRO_VERSION);
+}
+
+void
+ctk_css_cache_reader_init (CtkCssCacheReader *reader,
+                           const guint8      *data,
+                           gsize              size)
+{
+  reader->data = data;
+  reader->end = data + size;
+  reader->failed = FALSE;
+}
+
+static gboolean
+ctk_css_cache_reader_has (CtkCssCacheReader *reader,
+                          gsize              size)
+{
+  if (reader->failed)
+    return FALSE;
+
+  if ((gsize) (reader->end - reader->data) < size)
+    {
+      reader->failed = TRUE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+guint32
+ctk_css_cache_read_uint32 (CtkCssCacheReader *reader)
+{
+  guint32 value;
+
+  if (!ctk_css_cache_reader_has (reader, sizeof (guint32)))
+    return 0;
+
+  memcpy (&value, reader->data, sizeof (guint32));
+  reader->data += sizeof (guint32);
+
+  return GUINT32_FROM_BE (value);
+}
+
+gint64
+ctk_css_cache_read_int64 (CtkCssCacheReader *reader)
+{
+  gint64 value;
+
+  if (!ctk_css_cache_reader_has (reader, sizeof (gint64)))
+    return 0;
+
+  memcpy (&value, reader->data, sizeof (gint64));
+  reader->data += sizeof (gint64);
+
+  return GINT64_FROM_BE (value);
+}
+
+const char *
+ctk_css_cache_read_string (CtkCssCacheReader *reader)
+{
+  const char *string;
+  guint32 len;
+
+  len = ctk_css_cache_read_uint32 (reader);
+  if (!ctk_css_cache_reader_has (reader, (gsize) len + 1))
+    return NULL;
+
+  string = (const char *) reader->data;
+  if (string[len] != '\0')
+    {
+      reader->failed = TRUE;
+      return NULL;
+    }
+
+  reader->data += len + 1;
+
+  return string;
+}
+
+gboolean
+ctk_css_cache_read_header (CtkCssCacheReader *reader)
+{
+  if (!ctk_css_cache_reader_has (reader, sizeof (CTK_CSS_CACHE_MAGIC)))
+    return FALSE;
+
+  if (memcmp (reader->data, CTK_CSS_CACHE_MAGIC, sizeof (CTK_CSS_CACHE_MAGIC)) != 0)
+    return FALSE;
+  reader->data += sizeof (CTK_CSS_CACHE_MAGIC);
+
+  return ctk_css_cache_read_uint32 (reader) == CTK_CSS_CACHE_VERSION &&
+         ctk_css_cache_read_uint32 (reader) == CTK_MAJOR_VERSION &&
+         ctk_css_cache_read_uint32 (reader) == CTK_MINOR_VERSION &&
+         ctk_css_cache_read_uint32 (reader) == CTK_MICRO_VERSION &&
+         !reader->failed;
+}
@@ -0,0 +1,53 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CTK_CSS_CACHE_PRIVATE_H__
+#define __CTK_CSS_CACHE_PRIVATE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _CtkCssCacheReader CtkCssCacheReader;
+
+struct _CtkCssCacheReader {
+  const guint8 *data;
+  const guint8 *end;
+  guint         failed : 1;
+};
+
+char *          ctk_css_cache_get_path          (GFile                  *file);
+char *          ctk_css_cache_checksum          (GBytes                 *bytes);
+
+void            ctk_css_cache_write_header      (GByteArray             *bytes);
+void            ctk_css_cache_write_uint32      (GByteArray             *bytes,
+                                                 guint32                 value);
+void            ctk_css_cache_write_int64       (GByteArray             *bytes,
+                                                 gint64                  value);
+void            ctk_css_cache_write_string      (GByteArray             *bytes,
+                                                 const char             *string);
+
+void            ctk_css_cache_reader_init       (CtkCssCacheReader      *reader,
+                                                 const guint8           *data,
+                                                 gsize                   size);
+gboolean        ctk_css_cache_read_header       (CtkCssCacheReader      *reader);
+guint32         ctk_css_cache_read_uint32       (CtkCssCacheReader      *reader);
+gint64          ctk_css_cache_read_int64        (CtkCssCacheReader      *reader);
+const char *    ctk_css_cache_read_string       (CtkCssCacheReader      *reader);
+
+G_END_DECLS
+
+#endif /* __CTK_CSS_CACHE_PRIVATE_H__ */
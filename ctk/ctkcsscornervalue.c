@@ -65,6 +65,14 @@ ctk_css_value_corner_equal (const CtkCssValue *corner1,
       && _ctk_css_value_equal (corner1->y, corner2->y);
 }
 
+static guint
+ctk_css_value_corner_hash (const CtkCssValue *corner)
+{
+  guint hash = _ctk_css_value_hash (corner->x);
+
+  return (hash << 5) - hash + _ctk_css_value_hash (corner->y);
+}
+
 static CtkCssValue *
 ctk_css_value_corner_transition (CtkCssValue *start,
                                  CtkCssValue *end,
@@ -103,7 +111,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_CORNER = {
   ctk_css_value_corner_compute,
   ctk_css_value_corner_equal,
   ctk_css_value_corner_transition,
-  ctk_css_value_corner_print
+  ctk_css_value_corner_print,
+  ctk_css_value_corner_hash
 };
 
 CtkCssValue *
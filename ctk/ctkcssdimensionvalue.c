@@ -167,6 +167,12 @@ ctk_css_value_dimension_equal (const CtkCssValue *number1,
          number1->value == number2->value;
 }
 
+static guint
+ctk_css_value_dimension_hash (const CtkCssValue *number)
+{
+  return _ctk_css_hash_double (number->value) ^ number->unit;
+}
+
 static void
 ctk_css_value_dimension_print (const CtkCssValue *number,
                             GString           *string)
@@ -276,7 +282,8 @@ static const CtkCssNumberValueClass CTK_CSS_VALUE_DIMENSION = {
     ctk_css_value_dimension_compute,
     ctk_css_value_dimension_equal,
     ctk_css_number_value_transition,
-    ctk_css_value_dimension_print
+    ctk_css_value_dimension_print,
+    ctk_css_value_dimension_hash
   },
   ctk_css_value_dimension_get,
   ctk_css_value_dimension_get_dimension,
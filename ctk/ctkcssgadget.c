@@ -30,6 +30,7 @@
 #include "ctkcsswidgetnodeprivate.h"
 #include "ctkrenderbackgroundprivate.h"
 #include "ctkrenderborderprivate.h"
+#include "ctkrenderboxprivate.h"
 #include "ctkdebug.h"
 #include "ctkprivate.h"
 
@@ -860,21 +861,13 @@ ctk_css_gadget_draw (CtkCssGadget *gadget,
   get_box_border (style, &border);
   get_box_padding (style, &padding);
 
-  ctk_css_style_render_background (style,
-                                   cr,
-                                   x + margin.left,
-                                   y + margin.top,
-                                   width - margin.left - margin.right,
-                                   height - margin.top - margin.bottom,
-                                   ctk_css_node_get_junction_sides (priv->node));
-  ctk_css_style_render_border (style,
-                               cr,
-                               x + margin.left,
-                               y + margin.top,
-                               width - margin.left - margin.right,
-                               height - margin.top - margin.bottom,
-                               0,
-                               ctk_css_node_get_junction_sides (priv->node));
+  ctk_css_style_render_box (style,
+                            cr,
+                            x + margin.left,
+                            y + margin.top,
+                            width - margin.left - margin.right,
+                            height - margin.top - margin.bottom,
+                            ctk_css_node_get_junction_sides (priv->node));
 
   contents_x = x + margin.left + border.left + padding.left;
   contents_y = y + margin.top + border.top + padding.top;
@@ -22,6 +22,9 @@
 #include "ctkcssimageprivate.h"
 
 #include "ctkcssstyleprivate.h"
+#include "ctkrendercacheprivate.h"
+
+#include <math.h>
 
 /* for the types only */
 #include "ctk/ctkcssimagecrossfadeprivate.h"
@@ -241,6 +244,144 @@ _ctk_css_image_draw (CtkCssImage        *image,
   cairo_restore (cr);
 }
 
+/* Rasterized gradients, shared by all images */
+#define IMAGE_CACHE_SIZE (4 * 1024 * 1024)
+#define IMAGE_CACHE_MAX_ENTRY_SIZE (IMAGE_CACHE_SIZE / 16)
+
+typedef struct {
+  CtkCssImage *image;
+  int          width;
+  int          height;
+  int          scale;
+} CtkCssImageCacheKey;
+
+static CtkRenderCache *image_cache;
+
+static guint
+ctk_css_image_cache_key_hash (gconstpointer item)
+{
+  const CtkCssImageCacheKey *key = item;
+  guint hash;
+
+  hash = g_direct_hash (key->image);
+  hash = (hash << 5) - hash + key->width;
+  hash = (hash << 5) - hash + key->height;
+  hash = (hash << 5) - hash + key->scale;
+
+  return hash;
+}
+
+static gboolean
+ctk_css_image_cache_key_equal (gconstpointer item1,
+                               gconstpointer item2)
+{
+  const CtkCssImageCacheKey *key1 = item1;
+  const CtkCssImageCacheKey *key2 = item2;
+
+  return key1->image == key2->image &&
+         key1->width == key2->width &&
+         key1->height == key2->height &&
+         key1->scale == key2->scale;
+}
+
+static void
+ctk_css_image_cache_key_free (gpointer data)
+{
+  CtkCssImageCacheKey *key = data;
+
+  g_object_unref (key->image);
+  g_slice_free (CtkCssImageCacheKey, key);
+}
+
+/**
+ * _ctk_css_image_draw_cached:
+ * @image: a computed image that never changes its contents
+ * @cr: the cairo context to draw to
+ * @width: the width to draw the image at
+ * @height: the height to draw the image at
+ * @ramp: the direction @image doesn't change in, if any
+ * @draw_func: the function drawing @image without the cache
+ *
+ * Draws @image like its draw vfunc, from a surface kept for its size
+ * and the device scale. Images that look the same along one of the
+ * axes only keep a single row or column, which gets repeated.
+ *
+ * Returns: %FALSE if the size isn't integral or the image can't be
+ *   copied to @cr pixel by pixel and needs to be drawn by the caller
+ */
+gboolean
+_ctk_css_image_draw_cached (CtkCssImage         *image,
+                            cairo_t             *cr,
+                            double               width,
+                            double               height,
+                            CtkCssImageRamp      ramp,
+                            CtkCssImageDrawFunc  draw_func)
+{
+  CtkCssImageCacheKey key;
+  cairo_surface_t *surface;
+  cairo_pattern_t *pattern;
+  int scale;
+
+  /* The key stores the size in whole units, fractional sizes would
+   * draw a truncated image */
+  if (width != floor (width) || height != floor (height))
+    return FALSE;
+
+  if (!ctk_render_cache_is_pixel_aligned (cr, 0, 0, width, height, &scale))
+    return FALSE;
+
+  key.image = image;
+  key.width = ramp == CTK_CSS_IMAGE_RAMP_VERTICAL ? 1 : width;
+  key.height = ramp == CTK_CSS_IMAGE_RAMP_HORIZONTAL ? 1 : height;
+  key.scale = scale;
+
+  if ((gsize) key.width * key.height * scale * scale * 4 > IMAGE_CACHE_MAX_ENTRY_SIZE)
+    return FALSE;
+
+  if (image_cache == NULL)
+    image_cache = ctk_render_cache_new ("Gradients",
+                                        IMAGE_CACHE_SIZE,
+                                        ctk_css_image_cache_key_hash,
+                                        ctk_css_image_cache_key_equal,
+                                        ctk_css_image_cache_key_free);
+
+  surface = ctk_render_cache_lookup (image_cache, &key);
+  if (surface)
+    {
+      cairo_surface_reference (surface);
+    }
+  else
+    {
+      cairo_t *surface_cr;
+
+      surface = cairo_surface_create_similar_image (cairo_get_group_target (cr),
+                                                    CAIRO_FORMAT_ARGB32,
+                                                    key.width * scale,
+                                                    key.height * scale);
+      cairo_surface_set_device_scale (surface, scale, scale);
+
+      surface_cr = cairo_create (surface);
+      draw_func (image, surface_cr, key.width, key.height);
+      cairo_destroy (surface_cr);
+
+      key.image = g_object_ref (image);
+      ctk_render_cache_insert (image_cache, g_slice_dup (CtkCssImageCacheKey, &key), surface);
+    }
+
+  pattern = cairo_pattern_create_for_surface (surface);
+  if (ramp != CTK_CSS_IMAGE_RAMP_NONE)
+    cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
+
+  cairo_rectangle (cr, 0, 0, width, height);
+  cairo_set_source (cr, pattern);
+  cairo_fill (cr);
+
+  cairo_pattern_destroy (pattern);
+  cairo_surface_destroy (surface);
+
+  return TRUE;
+}
+
 void
 _ctk_css_image_print (CtkCssImage *image,
                       GString     *string)
@@ -127,20 +127,13 @@ ctk_css_image_linear_compute_start_point (double angle_in_degrees,
   *y = perpendicular * *x + c;
 }
                                          
-static void
-ctk_css_image_linear_draw (CtkCssImage        *image,
-                           cairo_t            *cr,
-                           double              width,
-                           double              height)
+/* Returns the actual angle of the gradient line in degrees */
+static double
+ctk_css_image_linear_get_angle (CtkCssImageLinear *linear,
+                                double             width,
+                                double             height)
 {
-  CtkCssImageLinear *linear = CTK_CSS_IMAGE_LINEAR (image);
-  cairo_pattern_t *pattern;
-  double angle; /* actual angle of the gradiant line in degrees */
-  double x, y; /* coordinates of start point */
-  double length; /* distance in pixels for 100% */
-  double start, end; /* position of first/last point on gradient line - with gradient line being [0, 1] */
-  double offset;
-  int i, last;
+  double angle;
 
   if (linear->side)
     {
@@ -171,6 +164,26 @@ ctk_css_image_linear_draw (CtkCssImage        *image,
       angle = _ctk_css_number_value_get (linear->angle, 100);
     }
 
+  return angle;
+}
+
+static void
+ctk_css_image_linear_draw_pattern (CtkCssImage        *image,
+                                   cairo_t            *cr,
+                                   double              width,
+                                   double              height)
+{
+  CtkCssImageLinear *linear = CTK_CSS_IMAGE_LINEAR (image);
+  cairo_pattern_t *pattern;
+  double angle; /* actual angle of the gradiant line in degrees */
+  double x, y; /* coordinates of start point */
+  double length; /* distance in pixels for 100% */
+  double start, end; /* position of first/last point on gradient line - with gradient line being [0, 1] */
+  double offset;
+  int i, last;
+
+  angle = ctk_css_image_linear_get_angle (linear, width, height);
+
   ctk_css_image_linear_compute_start_point (angle,
                                             width, height,
                                             &x, &y);
@@ -236,6 +249,38 @@ ctk_css_image_linear_draw (CtkCssImage        *image,
   cairo_pattern_destroy (pattern);
 }
 
+static void
+ctk_css_image_linear_draw (CtkCssImage        *image,
+                           cairo_t            *cr,
+                           double              width,
+                           double              height)
+{
+  CtkCssImageLinear *linear = CTK_CSS_IMAGE_LINEAR (image);
+  CtkCssImageRamp ramp;
+  double angle;
+
+  if (linear->cacheable)
+    {
+      /* Gradients along an axis look the same all along the other one */
+      angle = fmod (ctk_css_image_linear_get_angle (linear, width, height), 180);
+      if (angle < 0)
+        angle += 180;
+
+      if (angle == 0)
+        ramp = CTK_CSS_IMAGE_RAMP_VERTICAL;
+      else if (angle == 90)
+        ramp = CTK_CSS_IMAGE_RAMP_HORIZONTAL;
+      else
+        ramp = CTK_CSS_IMAGE_RAMP_NONE;
+
+      if (_ctk_css_image_draw_cached (image, cr, width, height, ramp,
+                                      ctk_css_image_linear_draw_pattern))
+        return;
+    }
+
+  ctk_css_image_linear_draw_pattern (image, cr, width, height);
+}
+
 
 static gboolean
 ctk_css_image_linear_parse (CtkCssImage  *image,
@@ -441,6 +486,7 @@ ctk_css_image_linear_compute (CtkCssImage             *image,
   copy = g_object_new (CTK_TYPE_CSS_IMAGE_LINEAR, NULL);
   copy->repeating = linear->repeating;
   copy->side = linear->side;
+  copy->cacheable = TRUE;
 
   if (linear->angle)
     copy->angle = _ctk_css_value_compute (linear->angle, property_id, provider, style, parent_style);
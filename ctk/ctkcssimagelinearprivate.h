@@ -49,6 +49,7 @@ struct _CtkCssImageLinear
   CtkCssValue *angle;
   GArray *stops;
   guint repeating :1;
+  guint cacheable :1;   /* computed, so never changes */
 };
 
 struct _CtkCssImageLinearClass
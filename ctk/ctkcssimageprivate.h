@@ -38,6 +38,18 @@ G_BEGIN_DECLS
 typedef struct _CtkCssImage           CtkCssImage;
 typedef struct _CtkCssImageClass      CtkCssImageClass;
 
+/* Directions a gradient may not change in, see _ctk_css_image_draw_cached() */
+typedef enum {
+  CTK_CSS_IMAGE_RAMP_NONE,
+  CTK_CSS_IMAGE_RAMP_HORIZONTAL,        /* only changes along the x axis */
+  CTK_CSS_IMAGE_RAMP_VERTICAL           /* only changes along the y axis */
+} CtkCssImageRamp;
+
+typedef void (* CtkCssImageDrawFunc) (CtkCssImage *image,
+                                      cairo_t     *cr,
+                                      double       width,
+                                      double       height);
+
 struct _CtkCssImage
 {
   GObject parent;
@@ -107,6 +119,12 @@ void           _ctk_css_image_draw                 (CtkCssImage                *
                                                     cairo_t                    *cr,
                                                     double                      width,
                                                     double                      height);
+gboolean       _ctk_css_image_draw_cached          (CtkCssImage                *image,
+                                                    cairo_t                    *cr,
+                                                    double                      width,
+                                                    double                      height,
+                                                    CtkCssImageRamp             ramp,
+                                                    CtkCssImageDrawFunc         draw_func);
 void           _ctk_css_image_print                (CtkCssImage                *image,
                                                     GString                    *string);
 
@@ -74,10 +74,10 @@ ctk_css_image_radial_get_start_end (CtkCssImageRadial *radial,
 }
 
 static void
-ctk_css_image_radial_draw (CtkCssImage *image,
-                           cairo_t     *cr,
-                           double       width,
-                           double       height)
+ctk_css_image_radial_draw_pattern (CtkCssImage *image,
+                                   cairo_t     *cr,
+                                   double       width,
+                                   double       height)
 {
   CtkCssImageRadial *radial = CTK_CSS_IMAGE_RADIAL (image);
   cairo_pattern_t *pattern;
@@ -227,6 +227,23 @@ ctk_css_image_radial_draw (CtkCssImage *image,
   cairo_pattern_destroy (pattern);
 }
 
+static void
+ctk_css_image_radial_draw (CtkCssImage *image,
+                           cairo_t     *cr,
+                           double       width,
+                           double       height)
+{
+  CtkCssImageRadial *radial = CTK_CSS_IMAGE_RADIAL (image);
+
+  if (radial->cacheable &&
+      _ctk_css_image_draw_cached (image, cr, width, height,
+                                  CTK_CSS_IMAGE_RAMP_NONE,
+                                  ctk_css_image_radial_draw_pattern))
+    return;
+
+  ctk_css_image_radial_draw_pattern (image, cr, width, height);
+}
+
 static gboolean
 ctk_css_image_radial_parse (CtkCssImage  *image,
                             CtkCssParser *parser)
@@ -471,6 +488,7 @@ ctk_css_image_radial_compute (CtkCssImage             *image,
   copy = g_object_new (CTK_TYPE_CSS_IMAGE_RADIAL, NULL);
   copy->repeating = radial->repeating;
   copy->circle = radial->circle;
+  copy->cacheable = TRUE;
   copy->size = radial->size;
 
   copy->position = _ctk_css_value_compute (radial->position, property_id, provider, style, parent_style);
@@ -59,6 +59,7 @@ struct _CtkCssImageRadial
   CtkCssRadialSize size;
   guint circle : 1;
   guint repeating :1;
+  guint cacheable :1;   /* computed, so never changes */
 };
 
 struct _CtkCssImageRadialClass
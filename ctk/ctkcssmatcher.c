@@ -327,6 +327,12 @@ _ctk_css_matcher_node_init (CtkCssMatcher *matcher,
   matcher->node.node = node;
 }
 
+gboolean
+_ctk_css_matcher_is_node (const CtkCssMatcher *matcher)
+{
+  return matcher->klass == &CTK_CSS_MATCHER_NODE;
+}
+
 /* CTK_CSS_MATCHER_WIDGET_ANY */
 
 static gboolean
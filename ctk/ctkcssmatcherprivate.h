@@ -80,6 +80,7 @@ gboolean          _ctk_css_matcher_init           (CtkCssMatcher          *match
                                                    const CtkCssNodeDeclaration *decl) G_GNUC_WARN_UNUSED_RESULT;
 void              _ctk_css_matcher_node_init      (CtkCssMatcher          *matcher,
                                                    CtkCssNode             *node);
+gboolean          _ctk_css_matcher_is_node        (const CtkCssMatcher    *matcher);
 void              _ctk_css_matcher_any_init       (CtkCssMatcher          *matcher);
 void              _ctk_css_matcher_superset_init  (CtkCssMatcher          *matcher,
                                                    const CtkCssMatcher    *subset,
@@ -19,12 +19,17 @@
 
 #include "ctkcssnodeprivate.h"
 
+#include "cdk/cdk-private.h"
+
 #include "ctkcssanimatedstyleprivate.h"
+#include "ctkcsslookupprivate.h"
 #include "ctkcsssectionprivate.h"
+#include "ctkcssselectorprivate.h"
 #include "ctkcssstylepropertyprivate.h"
 #include "ctkintl.h"
 #include "ctkmarshalers.h"
 #include "ctksettingsprivate.h"
+#include "ctkstyleproviderprivate.h"
 #include "ctktypebuiltins.h"
 
 /*
@@ -121,6 +126,44 @@ ctk_css_node_get_style_provider_or_null (CtkCssNode *cssnode)
   return CTK_CSS_NODE_GET_CLASS (cssnode)->get_style_provider (cssnode);
 }
 
+/* When a lot of nodes need new styles, matching their selectors can be
+ * spread over multiple threads before validation starts, see
+ * ctk_css_node_prefetch_lookups(). Computing and applying the styles
+ * stays on the main thread. The lookups are only used as long as nothing
+ * selectors can match on has changed since, which tree_serial and the
+ * style provider generation keep track of.
+ */
+#define MIN_PARALLEL_LOOKUPS 64
+#define LOOKUP_CHUNK_SIZE 16
+
+struct _CtkCssNodeLookup {
+  CtkCssNode              *node;
+  CtkStyleProviderPrivate *provider;
+  CtkCssLookup            *lookup;
+  CtkCssChange             change;
+};
+
+typedef struct {
+  CtkCssNodeLookup *lookups;
+  guint             n_lookups;
+  gint              next_lookup;        /* atomic */
+  guint             tree_serial;
+  guint             generation;
+
+  GMutex            mutex;
+  GCond             cond;
+  guint             n_running;
+} CtkCssLookupBatch;
+
+static guint tree_serial;
+static CtkCssLookupBatch *current_batch;
+
+static void
+ctk_css_node_tree_changed (void)
+{
+  tree_serial++;
+}
+
 static void
 ctk_css_node_set_invalid (CtkCssNode *node,
                           gboolean    invalid)
@@ -352,29 +395,113 @@ store_in_global_parent_cache (CtkCssNode                  *node,
                                                  style);
 }
 
+static CtkCssStyle *
+ctk_css_node_create_prefetched_style (CtkCssNode              *cssnode,
+                                      CtkStyleProviderPrivate *provider,
+                                      const CtkCssMatcher     *matcher,
+                                      CtkCssStyle             *parent)
+{
+  CtkCssNodeLookup *prefetched;
+  CtkCssLookup *lookup;
+
+  prefetched = cssnode->prefetched_lookup;
+  cssnode->prefetched_lookup = NULL;
+
+  lookup = prefetched->lookup;
+  prefetched->lookup = NULL;
+
+  if (current_batch == NULL ||
+      current_batch->tree_serial != tree_serial ||
+      current_batch->generation != _ctk_style_provider_private_get_generation () ||
+      prefetched->provider != provider ||
+      !_ctk_css_matcher_is_node (matcher))
+    {
+      _ctk_css_lookup_free (lookup);
+      return NULL;
+    }
+
+  return ctk_css_static_style_new_from_lookup (provider, lookup, prefetched->change, parent);
+}
+
+/* Restyle statistics for the profiler, ctk_css_node_validate() reports
+ * the ones that happened while it ran.
+ */
+static guint64 n_restyles;
+static guint64 n_style_cache_hits;
+static CtkCssChange restyle_changes;
+
+static CtkCssStyle *
+ctk_css_node_style_cache_hit (CtkCssNode  *cssnode,
+                              CtkCssStyle *style)
+{
+  cssnode->n_style_cache_hits++;
+  n_style_cache_hits++;
+
+  return g_object_ref (style);
+}
+
 static CtkCssStyle *
 ctk_css_node_create_style (CtkCssNode *cssnode)
 {
   const CtkCssNodeDeclaration *decl;
+  CtkStyleProviderPrivate *provider;
   CtkCssMatcher matcher;
   CtkCssStyle *parent;
   CtkCssStyle *style;
+  gboolean shareable;
 
   decl = ctk_css_node_get_declaration (cssnode);
   parent = cssnode->parent ? cssnode->parent->style : NULL;
 
+  cssnode->n_restyles++;
+  n_restyles++;
+
   style = lookup_in_global_parent_cache (cssnode, decl);
   if (style)
-    return g_object_ref (style);
+    return ctk_css_node_style_cache_hit (cssnode, style);
 
-  if (ctk_css_node_init_matcher (cssnode, &matcher))
-    style = ctk_css_static_style_new_compute (ctk_css_node_get_style_provider (cssnode),
-                                              &matcher,
-                                              parent);
-  else
-    style = ctk_css_static_style_new_compute (ctk_css_node_get_style_provider (cssnode),
-                                              NULL,
-                                              parent);
+  provider = ctk_css_node_get_style_provider (cssnode);
+
+  if (!ctk_css_node_init_matcher (cssnode, &matcher))
+    {
+      style = ctk_css_static_style_new_compute (provider, NULL, parent);
+      store_in_global_parent_cache (cssnode, decl, style);
+      return style;
+    }
+
+  /* Only nodes matched by their node tree can share styles with
+   * other subtrees, widget paths carry information of their own.
+   */
+  shareable = parent != NULL && provider != NULL && _ctk_css_matcher_is_node (&matcher);
+
+  if (shareable)
+    {
+      style = ctk_css_node_style_cache_lookup_shared (provider,
+                                                      parent,
+                                                      decl,
+                                                      ctk_css_node_is_first_child (cssnode),
+                                                      ctk_css_node_is_last_child (cssnode));
+      if (style)
+        {
+          style = ctk_css_node_style_cache_hit (cssnode, style);
+          store_in_global_parent_cache (cssnode, decl, style);
+          return style;
+        }
+    }
+
+  style = NULL;
+  if (cssnode->prefetched_lookup)
+    style = ctk_css_node_create_prefetched_style (cssnode, provider, &matcher, parent);
+  if (style == NULL)
+    style = ctk_css_static_style_new_compute (provider, &matcher, parent);
+
+  if (shareable)
+    ctk_css_node_style_cache_insert_shared (provider,
+                                            parent,
+                                            (CtkCssNodeDeclaration *) decl,
+                                            ctk_css_node_is_first_child (cssnode),
+                                            ctk_css_node_is_last_child (cssnode),
+                                            style);
 
   store_in_global_parent_cache (cssnode, decl, style);
 
@@ -746,6 +873,8 @@ ctk_css_node_reposition (CtkCssNode *node,
   /* Take a reference here so the whole function has a reference */
   g_object_ref (node);
 
+  ctk_css_node_tree_changed ();
+
   if (node->visible)
     {
       if (node->next_sibling)
@@ -1004,6 +1133,9 @@ ctk_css_node_ensure_style (CtkCssNode *cssnode,
 
       g_clear_pointer (&cssnode->cache, ctk_css_node_style_cache_unref);
 
+      cssnode->last_change = cssnode->pending_changes;
+      restyle_changes |= cssnode->pending_changes;
+
       new_style = CTK_CSS_NODE_GET_CLASS (cssnode)->update_style (cssnode,
                                                                   cssnode->pending_changes,
                                                                   current_time,
@@ -1047,6 +1179,7 @@ ctk_css_node_set_visible (CtkCssNode *cssnode,
 
   cssnode->visible = visible;
   g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_VISIBLE]);
+  ctk_css_node_tree_changed ();
 
   if (cssnode->invalid)
     {
@@ -1109,6 +1242,7 @@ ctk_css_node_set_name (CtkCssNode              *cssnode,
 {
   if (ctk_css_node_declaration_set_name (&cssnode->decl, name))
     {
+      ctk_css_node_tree_changed ();
       ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_NAME);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_NAME]);
     }
@@ -1126,6 +1260,7 @@ ctk_css_node_set_widget_type (CtkCssNode *cssnode,
 {
   if (ctk_css_node_declaration_set_type (&cssnode->decl, widget_type))
     {
+      ctk_css_node_tree_changed ();
       ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_NAME);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_WIDGET_TYPE]);
     }
@@ -1143,6 +1278,7 @@ ctk_css_node_set_id (CtkCssNode                *cssnode,
 {
   if (ctk_css_node_declaration_set_id (&cssnode->decl, id))
     {
+      ctk_css_node_tree_changed ();
       ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_ID);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_ID]);
     }
@@ -1160,6 +1296,7 @@ ctk_css_node_set_state (CtkCssNode    *cssnode,
 {
   if (ctk_css_node_declaration_set_state (&cssnode->decl, state_flags))
     {
+      ctk_css_node_tree_changed ();
       ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_STATE);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_STATE]);
     }
@@ -1189,6 +1326,7 @@ ctk_css_node_clear_classes (CtkCssNode *cssnode)
 {
   if (ctk_css_node_declaration_clear_classes (&cssnode->decl))
     {
+      ctk_css_node_tree_changed ();
       ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
@@ -1240,6 +1378,7 @@ ctk_css_node_add_class (CtkCssNode *cssnode,
 {
   if (ctk_css_node_declaration_add_class (&cssnode->decl, style_class))
     {
+      ctk_css_node_tree_changed ();
       ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
@@ -1251,6 +1390,7 @@ ctk_css_node_remove_class (CtkCssNode *cssnode,
 {
   if (ctk_css_node_declaration_remove_class (&cssnode->decl, style_class))
     {
+      ctk_css_node_tree_changed ();
       ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
@@ -1322,6 +1462,38 @@ ctk_css_node_invalidate_style_provider (CtkCssNode *cssnode)
     }
 }
 
+/* Like ctk_css_node_invalidate_style_provider(), but the provider only
+ * changed the rules with selectors in @selectors, so nodes that can't
+ * match any of them in any state keep their style.
+ */
+void
+ctk_css_node_invalidate_style_provider_selectors (CtkCssNode               *cssnode,
+                                                  const CtkCssSelectorTree *selectors)
+{
+  CtkCssMatcher matcher, superset;
+  CtkCssNode *child;
+
+  /* Cached styles may have been computed with the old rules */
+  g_clear_pointer (&cssnode->cache, ctk_css_node_style_cache_unref);
+
+  if (selectors != NULL &&
+      ctk_css_node_init_matcher (cssnode, &matcher))
+    {
+      _ctk_css_matcher_superset_init (&superset, &matcher, CTK_CSS_CHANGE_NAME | CTK_CSS_CHANGE_CLASS);
+
+      if (_ctk_css_selector_tree_may_match (selectors, &superset))
+        ctk_css_node_invalidate (cssnode, CTK_CSS_CHANGE_SOURCE);
+    }
+
+  for (child = cssnode->first_child;
+       child;
+       child = child->next_sibling)
+    {
+      if (ctk_css_node_get_style_provider_or_null (child) == NULL)
+        ctk_css_node_invalidate_style_provider_selectors (child, selectors);
+    }
+}
+
 static void
 ctk_css_node_invalidate_timestamp (CtkCssNode *cssnode)
 {
@@ -1372,15 +1544,51 @@ ctk_css_node_invalidate (CtkCssNode   *cssnode,
   ctk_css_node_invalidate_style (cssnode);
 }
 
-void
-ctk_css_node_validate_internal (CtkCssNode *cssnode,
-                                gint64      timestamp)
+static gboolean
+ctk_css_node_init_ancestor_filter (CtkCssNode              *cssnode,
+                                   const CtkCssBloomFilter *parent_filter,
+                                   CtkCssBloomFilter       *filter)
+{
+  CtkCssMatcher matcher;
+  const GQuark *classes;
+  guint i, n_classes;
+
+  /* Children of nodes that match via widget paths don't see their
+   * ancestors as CSS nodes, so the filter would not describe them. */
+  if (parent_filter == NULL && cssnode->parent != NULL)
+    return FALSE;
+  if (!ctk_css_node_init_matcher (cssnode, &matcher) ||
+      !_ctk_css_matcher_is_node (&matcher))
+    return FALSE;
+
+  ctk_css_bloom_filter_init (filter, parent_filter, cssnode);
+
+  if (ctk_css_node_get_name (cssnode))
+    ctk_css_bloom_filter_add (filter, GPOINTER_TO_SIZE (ctk_css_node_get_name (cssnode)));
+  if (ctk_css_node_get_id (cssnode))
+    ctk_css_bloom_filter_add (filter, GPOINTER_TO_SIZE (ctk_css_node_get_id (cssnode)));
+
+  classes = ctk_css_node_declaration_get_classes (cssnode->decl, &n_classes);
+  for (i = 0; i < n_classes; i++)
+    ctk_css_bloom_filter_add (filter, classes[i]);
+
+  return TRUE;
+}
+
+static void
+ctk_css_node_validate_internal (CtkCssNode              *cssnode,
+                                const CtkCssBloomFilter *parent_filter,
+                                gint64                   timestamp)
 {
+  CtkCssBloomFilter filter;
+  const CtkCssBloomFilter *child_filter;
   CtkCssNode *child;
 
   if (!cssnode->invalid)
     return;
 
+  _ctk_css_selector_tree_set_ancestor_filter (parent_filter);
+
   ctk_css_node_ensure_style (cssnode, timestamp);
 
   /* need to set to FALSE then to TRUE here to make it chain up */
@@ -1390,23 +1598,351 @@ ctk_css_node_validate_internal (CtkCssNode *cssnode,
 
   CTK_CSS_NODE_GET_CLASS (cssnode)->validate (cssnode);
 
+  if (ctk_css_node_get_first_child (cssnode) == NULL)
+    return;
+
+  if (ctk_css_node_init_ancestor_filter (cssnode, parent_filter, &filter))
+    child_filter = &filter;
+  else
+    child_filter = NULL;
+
   for (child = ctk_css_node_get_first_child (cssnode);
        child;
        child = ctk_css_node_get_next_sibling (child))
     {
       if (child->visible)
-        ctk_css_node_validate_internal (child, timestamp);
+        ctk_css_node_validate_internal (child, child_filter, timestamp);
+    }
+}
+
+enum {
+  COUNTER_RESTYLES,
+  COUNTER_STYLE_CACHE_HITS,
+  COUNTER_SHARED_STYLE_HITS,
+  COUNTER_SHARED_STYLE_MISSES,
+  COUNTER_INTERNED_VALUES,
+  COUNTER_UNIQUE_VALUES,
+  COUNTER_DESCENDANT_CHECKS,
+  COUNTER_DESCENDANT_REJECTS,
+  N_COUNTERS
+};
+
+static void
+ctk_css_node_update_profiler_counters (void)
+{
+  static const struct {
+    const char *name;
+    const char *description;
+  } counter_info[N_COUNTERS] = {
+    { "css-restyles", "Styles that had to be recreated" },
+    { "css-style-cache-hits", "Recreated styles found in a style cache" },
+    { "css-shared-style-hits", "Styles shared with an identical subtree" },
+    { "css-shared-style-misses", "Shareable styles that had to be computed" },
+    { "css-interned-values", "Computed values looked up in the intern table" },
+    { "css-unique-values", "Distinct computed values in the intern table" },
+    { "css-descendant-checks", "Descendant selectors checked against the ancestor filter" },
+    { "css-descendant-rejects", "Descendant selectors rejected by the ancestor filter" },
+  };
+  static guint counters[N_COUNTERS];
+  guint64 values[N_COUNTERS];
+  guint shared_hits, shared_misses, n_interned, n_unique;
+  gint64 now;
+  guint i;
+
+  if (counters[0] == 0)
+    {
+      for (i = 0; i < N_COUNTERS; i++)
+        counters[i] = CDK_PRIVATE_CALL (cdk_profiler_define_int_counter) (counter_info[i].name,
+                                                                          counter_info[i].description);
+    }
+
+  ctk_css_node_style_cache_get_shared_stats (&shared_hits, &shared_misses);
+  _ctk_css_value_get_intern_counts (&n_interned, &n_unique);
+
+  values[COUNTER_RESTYLES] = n_restyles;
+  values[COUNTER_STYLE_CACHE_HITS] = n_style_cache_hits;
+  values[COUNTER_SHARED_STYLE_HITS] = shared_hits;
+  values[COUNTER_SHARED_STYLE_MISSES] = shared_misses;
+  values[COUNTER_INTERNED_VALUES] = n_interned;
+  values[COUNTER_UNIQUE_VALUES] = n_unique;
+  _ctk_css_selector_tree_get_filter_counts (&values[COUNTER_DESCENDANT_CHECKS],
+                                            &values[COUNTER_DESCENDANT_REJECTS]);
+
+  now = g_get_monotonic_time () * 1000;
+
+  for (i = 0; i < N_COUNTERS; i++)
+    CDK_PRIVATE_CALL (cdk_profiler_set_int_counter) (counters[i], now, values[i]);
+}
+
+/* Adds a mark for a validation that restyled nodes, naming the changes
+ * that caused it, so slow frames can be attributed.
+ */
+static void
+ctk_css_node_add_validate_mark (gint64  start,
+                                guint64 restyles,
+                                guint64 cache_hits)
+{
+  char *changes, *message;
+  gint64 end;
+
+  if (restyles == 0)
+    return;
+
+  end = g_get_monotonic_time ();
+  changes = ctk_css_change_to_string (restyle_changes);
+  message = g_strdup_printf ("%" G_GUINT64_FORMAT " restyles, %" G_GUINT64_FORMAT " cache hits, changes: %s",
+                             restyles, cache_hits, changes);
+
+  CDK_PRIVATE_CALL (cdk_profiler_add_mark) (start * 1000, (end - start) * 1000, "css validation", message);
+
+  g_free (message);
+  g_free (changes);
+}
+
+static guint
+ctk_css_node_get_n_lookup_threads (void)
+{
+  static gboolean initialized = FALSE;
+  static guint n_threads = 0;
+
+  if (!initialized)
+    {
+      const char *env = g_getenv ("CTK_CSS_THREADS");
+
+      if (env)
+        n_threads = MIN (g_ascii_strtoull (env, NULL, 10), 64);
+
+      initialized = TRUE;
     }
+
+  return n_threads;
+}
+
+static gboolean
+ctk_css_node_has_node_matcher (CtkCssNode *cssnode)
+{
+  CtkCssMatcher matcher;
+
+  return ctk_css_node_init_matcher (cssnode, &matcher) &&
+         _ctk_css_matcher_is_node (&matcher);
+}
+
+/* Collects the nodes below @cssnode that will need their selectors
+ * matched. Matching must not run into widget paths on other threads,
+ * so only families where all ancestors and their siblings use node
+ * matchers are considered.
+ */
+static void
+ctk_css_node_collect_lookups (CtkCssNode *cssnode,
+                              GArray     *lookups)
+{
+  CtkCssNode *child;
+
+  for (child = ctk_css_node_get_first_child (cssnode);
+       child;
+       child = ctk_css_node_get_next_sibling (child))
+    {
+      if (child->visible && !ctk_css_node_has_node_matcher (child))
+        return;
+    }
+
+  for (child = ctk_css_node_get_first_child (cssnode);
+       child;
+       child = ctk_css_node_get_next_sibling (child))
+    {
+      if (!child->visible || !child->invalid)
+        continue;
+
+      if (child->style_is_invalid &&
+          child->prefetched_lookup == NULL &&
+          ctk_css_style_needs_recreation (child->style, child->pending_changes))
+        {
+          CtkCssNodeLookup lookup = { NULL, };
+
+          lookup.node = g_object_ref (child);
+          lookup.provider = ctk_css_node_get_style_provider (child);
+          g_array_append_val (lookups, lookup);
+        }
+
+      ctk_css_node_collect_lookups (child, lookups);
+    }
+}
+
+static void
+ctk_css_lookup_batch_run (CtkCssLookupBatch *batch)
+{
+  guint start, end, i;
+
+  for (;;)
+    {
+      start = g_atomic_int_add (&batch->next_lookup, LOOKUP_CHUNK_SIZE);
+      if (start >= batch->n_lookups)
+        break;
+
+      end = MIN (start + LOOKUP_CHUNK_SIZE, batch->n_lookups);
+      for (i = start; i < end; i++)
+        {
+          CtkCssNodeLookup *lookup = &batch->lookups[i];
+          CtkCssMatcher matcher;
+
+          _ctk_css_matcher_node_init (&matcher, lookup->node);
+          lookup->lookup = ctk_css_static_style_lookup (lookup->provider,
+                                                        &matcher,
+                                                        &lookup->change);
+        }
+    }
+}
+
+static void
+ctk_css_lookup_batch_thread_func (gpointer data,
+                                  gpointer user_data G_GNUC_UNUSED)
+{
+  CtkCssLookupBatch *batch = data;
+
+  ctk_css_lookup_batch_run (batch);
+
+  g_mutex_lock (&batch->mutex);
+  batch->n_running--;
+  if (batch->n_running == 0)
+    g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->mutex);
+}
+
+static void
+ctk_css_lookup_batch_free (CtkCssLookupBatch *batch)
+{
+  guint i;
+
+  for (i = 0; i < batch->n_lookups; i++)
+    {
+      CtkCssNodeLookup *lookup = &batch->lookups[i];
+
+      if (lookup->node->prefetched_lookup == lookup)
+        lookup->node->prefetched_lookup = NULL;
+      if (lookup->lookup)
+        _ctk_css_lookup_free (lookup->lookup);
+      g_object_unref (lookup->node);
+    }
+
+  g_free (batch->lookups);
+  g_mutex_clear (&batch->mutex);
+  g_cond_clear (&batch->cond);
+  g_slice_free (CtkCssLookupBatch, batch);
+}
+
+/* Matches selectors for the invalid nodes below @cssnode on a thread
+ * pool while the main thread waits, so theme changes and large new
+ * windows scale with the number of cores. This is opt-in via the
+ * CTK_CSS_THREADS environment variable.
+ */
+static CtkCssLookupBatch *
+ctk_css_node_prefetch_lookups (CtkCssNode *cssnode)
+{
+  static GThreadPool *pool = NULL;
+  CtkCssLookupBatch *batch;
+  GArray *lookups;
+  guint i, n_threads;
+  gint64 before;
+
+  n_threads = ctk_css_node_get_n_lookup_threads ();
+  if (n_threads == 0 || current_batch != NULL)
+    return NULL;
+
+  if (cssnode->parent != NULL ||
+      !ctk_css_node_has_node_matcher (cssnode))
+    return NULL;
+
+  before = g_get_monotonic_time ();
+
+  lookups = g_array_new (FALSE, FALSE, sizeof (CtkCssNodeLookup));
+  ctk_css_node_collect_lookups (cssnode, lookups);
+
+  batch = g_slice_new0 (CtkCssLookupBatch);
+  batch->n_lookups = lookups->len;
+  batch->lookups = (CtkCssNodeLookup *) g_array_free (lookups, FALSE);
+  batch->tree_serial = tree_serial;
+  batch->generation = _ctk_style_provider_private_get_generation ();
+  g_mutex_init (&batch->mutex);
+  g_cond_init (&batch->cond);
+
+  if (batch->n_lookups < MIN_PARALLEL_LOOKUPS)
+    {
+      ctk_css_lookup_batch_free (batch);
+      return NULL;
+    }
+
+  if (pool == NULL)
+    pool = g_thread_pool_new (ctk_css_lookup_batch_thread_func, NULL, n_threads, FALSE, NULL);
+
+  batch->n_running = n_threads;
+  for (i = 0; i < n_threads; i++)
+    g_thread_pool_push (pool, batch, NULL);
+
+  ctk_css_lookup_batch_run (batch);
+
+  g_mutex_lock (&batch->mutex);
+  while (batch->n_running > 0)
+    g_cond_wait (&batch->cond, &batch->mutex);
+  g_mutex_unlock (&batch->mutex);
+
+  for (i = 0; i < batch->n_lookups; i++)
+    batch->lookups[i].node->prefetched_lookup = &batch->lookups[i];
+
+  if (CDK_PRIVATE_CALL (cdk_profiler_is_running) ())
+    {
+      gint64 after = g_get_monotonic_time ();
+      char *message = g_strdup_printf ("%u nodes", batch->n_lookups);
+
+      CDK_PRIVATE_CALL (cdk_profiler_add_mark) (before * 1000, (after - before) * 1000, "css lookups", message);
+      g_free (message);
+    }
+
+  return batch;
 }
 
 void
 ctk_css_node_validate (CtkCssNode *cssnode)
 {
-  gint64 timestamp;
+  CtkCssLookupBatch *batch;
+  CtkCssChange changes_before;
+  guint64 restyles_before, cache_hits_before;
+  gint64 timestamp, start;
+
+  start = g_get_monotonic_time ();
+  restyles_before = n_restyles;
+  cache_hits_before = n_style_cache_hits;
+  changes_before = restyle_changes;
+  restyle_changes = 0;
 
   timestamp = ctk_css_node_get_timestamp (cssnode);
 
-  ctk_css_node_validate_internal (cssnode, timestamp);
+  /* Validation can re-enter, e.g. when a style-updated handler shows a
+   * window. Only the outermost call owns the batch. */
+  batch = ctk_css_node_prefetch_lookups (cssnode);
+  if (batch)
+    current_batch = batch;
+
+  /* Validation may start in the middle of the tree, when the node is the
+   * root of a widget without a parent, so there is no filter to start with. */
+  ctk_css_node_validate_internal (cssnode, NULL, timestamp);
+  _ctk_css_selector_tree_set_ancestor_filter (NULL);
+
+  if (batch)
+    {
+      ctk_css_lookup_batch_free (batch);
+      current_batch = NULL;
+    }
+
+  if (CDK_PRIVATE_CALL (cdk_profiler_is_running) ())
+    {
+      ctk_css_node_add_validate_mark (start,
+                                      n_restyles - restyles_before,
+                                      n_style_cache_hits - cache_hits_before);
+      ctk_css_node_update_profiler_counters ();
+    }
+
+  /* A nested validation's changes are part of the one it runs in */
+  restyle_changes |= changes_before;
 }
 
 gboolean
@@ -1448,6 +1984,24 @@ ctk_css_node_get_style_provider (CtkCssNode *cssnode)
   return CTK_STYLE_PROVIDER_PRIVATE (_ctk_settings_get_style_cascade (settings, 1));
 }
 
+guint
+ctk_css_node_get_n_restyles (CtkCssNode *cssnode)
+{
+  return cssnode->n_restyles;
+}
+
+guint
+ctk_css_node_get_n_style_cache_hits (CtkCssNode *cssnode)
+{
+  return cssnode->n_style_cache_hits;
+}
+
+CtkCssChange
+ctk_css_node_get_last_change (CtkCssNode *cssnode)
+{
+  return cssnode->last_change;
+}
+
 void
 ctk_css_node_print (CtkCssNode                *cssnode,
                     CtkStyleContextPrintFlags  flags,
@@ -20,6 +20,7 @@
 
 #include "ctkcssnodedeclarationprivate.h"
 #include "ctkcssnodestylecacheprivate.h"
+#include "ctkcssselectorprivate.h"
 #include "ctkcssstylechangeprivate.h"
 #include "ctkbitmaskprivate.h"
 #include "ctkcsstypesprivate.h"
@@ -34,6 +35,7 @@ G_BEGIN_DECLS
 #define CTK_CSS_NODE_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), CTK_TYPE_CSS_NODE, CtkCssNodeClass))
 
 typedef struct _CtkCssNodeClass         CtkCssNodeClass;
+typedef struct _CtkCssNodeLookup        CtkCssNodeLookup;
 
 struct _CtkCssNode
 {
@@ -48,8 +50,12 @@ struct _CtkCssNode
   CtkCssNodeDeclaration *decl;
   CtkCssStyle           *style;
   CtkCssNodeStyleCache  *cache;                 /* cache for children to look up styles */
+  CtkCssNodeLookup      *prefetched_lookup;     /* selectors matched ahead of time on another thread */
 
   CtkCssChange           pending_changes;       /* changes that accumulated since the style was last computed */
+  CtkCssChange           last_change;           /* changes that caused the last style update */
+  guint                  n_restyles;            /* number of style updates, for the inspector */
+  guint                  n_style_cache_hits;    /* number of new styles that were found in a cache */
 
   guint                  visible :1;            /* node will be skipped when validating or computing styles */
   guint                  invalid :1;            /* node or a child needs to be validated (even if just for animation) */
@@ -160,6 +166,9 @@ CtkCssStyle *           ctk_css_node_get_style          (CtkCssNode            *
 
 void                    ctk_css_node_invalidate_style_provider
                                                         (CtkCssNode            *cssnode);
+void                    ctk_css_node_invalidate_style_provider_selectors
+                                                        (CtkCssNode               *cssnode,
+                                                         const CtkCssSelectorTree *selectors);
 void                    ctk_css_node_invalidate_frame_clock
                                                         (CtkCssNode            *cssnode,
                                                          gboolean               just_timestamp);
@@ -173,6 +182,11 @@ CtkWidgetPath *         ctk_css_node_create_widget_path (CtkCssNode            *
 const CtkWidgetPath *   ctk_css_node_get_widget_path    (CtkCssNode            *cssnode);
 CtkStyleProviderPrivate *ctk_css_node_get_style_provider(CtkCssNode            *cssnode);
 
+guint                   ctk_css_node_get_n_restyles     (CtkCssNode            *cssnode);
+guint                   ctk_css_node_get_n_style_cache_hits
+                                                        (CtkCssNode            *cssnode);
+CtkCssChange            ctk_css_node_get_last_change    (CtkCssNode            *cssnode);
+
 void                    ctk_css_node_print              (CtkCssNode                *cssnode,
                                                          CtkStyleContextPrintFlags  flags,
                                                          GString                   *string,
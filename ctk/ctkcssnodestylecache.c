@@ -22,12 +22,36 @@
 #include "ctkdebug.h"
 #include "ctkcssstaticstyleprivate.h"
 
+/* Number of styles kept in the shared style cache */
+#define SHARED_STYLE_CACHE_SIZE 1024
+
 struct _CtkCssNodeStyleCache {
   guint        ref_count;
   CtkCssStyle *style;
   GHashTable  *children;
 };
 
+typedef struct _CtkCssSharedStyle CtkCssSharedStyle;
+
+/* An entry in the shared style cache. The parent style is part of the
+ * key for the inherited values. Nothing else about the ancestors is,
+ * so styles depending on them are never shared.
+ */
+struct _CtkCssSharedStyle {
+  CtkCssNodeDeclaration   *decl;
+  CtkCssStyle             *parent;
+  CtkStyleProviderPrivate *provider;
+  guint                    flags;
+  CtkCssStyle             *style;
+  GList                    link;
+};
+
+static GHashTable *shared_styles;
+static GQueue shared_styles_lru = G_QUEUE_INIT;
+static guint shared_styles_generation;
+static guint shared_styles_hits;
+static guint shared_styles_misses;
+
 #define UNPACK_DECLARATION(packed) ((CtkCssNodeDeclaration *) (GPOINTER_TO_SIZE (packed) & ~0x3))
 #define UNPACK_FLAGS(packed) (GPOINTER_TO_SIZE (packed) & 0x3)
 #define PACK(decl, first_child, last_child) GSIZE_TO_POINTER (GPOINTER_TO_SIZE (decl) | ((first_child) ? 0x2 : 0) | ((last_child) ? 0x1 : 0))
@@ -180,3 +204,173 @@ ctk_css_node_style_cache_lookup (CtkCssNodeStyleCache        *parent,
   return ctk_css_node_style_cache_ref (result);
 }
 
+
+static guint
+ctk_css_shared_style_hash (gconstpointer item)
+{
+  const CtkCssSharedStyle *shared = item;
+  guint hash;
+
+  hash = ctk_css_node_declaration_hash (shared->decl);
+  hash = (hash << 5) - hash + g_direct_hash (shared->parent);
+  hash = (hash << 5) - hash + g_direct_hash (shared->provider);
+
+  return hash << 2 | shared->flags;
+}
+
+static gboolean
+ctk_css_shared_style_equal (gconstpointer item1,
+                            gconstpointer item2)
+{
+  const CtkCssSharedStyle *shared1 = item1;
+  const CtkCssSharedStyle *shared2 = item2;
+
+  return shared1->parent == shared2->parent &&
+         shared1->provider == shared2->provider &&
+         shared1->flags == shared2->flags &&
+         ctk_css_node_declaration_equal (shared1->decl, shared2->decl);
+}
+
+static void
+ctk_css_shared_style_free (gpointer item)
+{
+  CtkCssSharedStyle *shared = item;
+
+  g_queue_unlink (&shared_styles_lru, &shared->link);
+
+  ctk_css_node_declaration_unref (shared->decl);
+  g_object_unref (shared->parent);
+  g_object_unref (shared->provider);
+  g_object_unref (shared->style);
+
+  g_slice_free (CtkCssSharedStyle, shared);
+}
+
+static gboolean
+may_be_shared (CtkCssStyle *style)
+{
+  CtkCssChange change;
+
+  if (!may_be_stored_in_cache (style))
+    return FALSE;
+
+  change = ctk_css_static_style_get_change (CTK_CSS_STATIC_STYLE (style));
+
+  /* Ancestors can change their state or position without getting a
+   * new style, e.g. with ".box:hover label" and no rule for the box.
+   */
+  if (change & CTK_CSS_CHANGE_ANY_PARENT)
+    return FALSE;
+
+  return TRUE;
+}
+
+static GHashTable *
+get_shared_styles (void)
+{
+  guint generation;
+
+  /* Any change to any provider may change computed styles */
+  generation = _ctk_style_provider_private_get_generation ();
+  if (shared_styles != NULL && shared_styles_generation != generation)
+    {
+      CTK_NOTE (MISC, g_message ("Dropping %u shared styles, %u hits, %u misses",
+                                 g_hash_table_size (shared_styles),
+                                 shared_styles_hits, shared_styles_misses));
+      g_hash_table_remove_all (shared_styles);
+    }
+  shared_styles_generation = generation;
+
+  if (shared_styles == NULL)
+    shared_styles = g_hash_table_new_full (ctk_css_shared_style_hash,
+                                           ctk_css_shared_style_equal,
+                                           ctk_css_shared_style_free,
+                                           NULL);
+
+  return shared_styles;
+}
+
+/* The shared style cache complements the per-parent caches above: it
+ * lets structurally identical subtrees below different parents, like
+ * the rows of different lists, reuse each other's styles.
+ */
+CtkCssStyle *
+ctk_css_node_style_cache_lookup_shared (CtkStyleProviderPrivate     *provider,
+                                        CtkCssStyle                 *parent,
+                                        const CtkCssNodeDeclaration *decl,
+                                        gboolean                     is_first,
+                                        gboolean                     is_last)
+{
+  CtkCssSharedStyle key, *shared;
+  GHashTable *table;
+
+#ifdef G_ENABLE_DEBUG
+  if (CTK_DEBUG_CHECK (NO_CSS_CACHE))
+    return NULL;
+#endif
+
+  table = get_shared_styles ();
+
+  key.decl = (CtkCssNodeDeclaration *) decl;
+  key.parent = parent;
+  key.provider = provider;
+  key.flags = (is_first ? 0x2 : 0) | (is_last ? 0x1 : 0);
+
+  shared = g_hash_table_lookup (table, &key);
+  if (shared == NULL)
+    {
+      shared_styles_misses++;
+      return NULL;
+    }
+
+  shared_styles_hits++;
+
+  g_queue_unlink (&shared_styles_lru, &shared->link);
+  g_queue_push_head_link (&shared_styles_lru, &shared->link);
+
+  return shared->style;
+}
+
+void
+ctk_css_node_style_cache_insert_shared (CtkStyleProviderPrivate *provider,
+                                        CtkCssStyle             *parent,
+                                        CtkCssNodeDeclaration   *decl,
+                                        gboolean                 is_first,
+                                        gboolean                 is_last,
+                                        CtkCssStyle             *style)
+{
+  CtkCssSharedStyle *shared;
+  GHashTable *table;
+
+  if (!may_be_shared (style))
+    return;
+
+  table = get_shared_styles ();
+
+  while (g_hash_table_size (table) >= SHARED_STYLE_CACHE_SIZE)
+    {
+      CtkCssSharedStyle *oldest = g_queue_peek_tail (&shared_styles_lru);
+
+      g_hash_table_remove (table, oldest);
+    }
+
+  shared = g_slice_new0 (CtkCssSharedStyle);
+  shared->decl = ctk_css_node_declaration_ref (decl);
+  shared->parent = g_object_ref (parent);
+  shared->provider = g_object_ref (provider);
+  shared->flags = (is_first ? 0x2 : 0) | (is_last ? 0x1 : 0);
+  shared->style = g_object_ref (style);
+  shared->link.data = shared;
+
+  /* Replaces any entry with the same key, which unlinks it */
+  g_hash_table_replace (table, shared, shared);
+  g_queue_push_head_link (&shared_styles_lru, &shared->link);
+}
+
+void
+ctk_css_node_style_cache_get_shared_stats (guint *hits,
+                                           guint *misses)
+{
+  *hits = shared_styles_hits;
+  *misses = shared_styles_misses;
+}
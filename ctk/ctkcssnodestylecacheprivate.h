@@ -20,6 +20,7 @@
 
 #include "ctkcssnodedeclarationprivate.h"
 #include "ctkcssstyleprivate.h"
+#include "ctkstyleproviderprivate.h"
 
 G_BEGIN_DECLS
 
@@ -41,6 +42,20 @@ CtkCssNodeStyleCache *  ctk_css_node_style_cache_lookup         (CtkCssNodeStyle
                                                                  gboolean                     is_first,
                                                                  gboolean                     is_last);
 
+CtkCssStyle *           ctk_css_node_style_cache_lookup_shared  (CtkStyleProviderPrivate     *provider,
+                                                                 CtkCssStyle                 *parent,
+                                                                 const CtkCssNodeDeclaration *decl,
+                                                                 gboolean                     is_first,
+                                                                 gboolean                     is_last);
+void                    ctk_css_node_style_cache_insert_shared  (CtkStyleProviderPrivate     *provider,
+                                                                 CtkCssStyle                 *parent,
+                                                                 CtkCssNodeDeclaration       *decl,
+                                                                 gboolean                     is_first,
+                                                                 gboolean                     is_last,
+                                                                 CtkCssStyle                 *style);
+void                    ctk_css_node_style_cache_get_shared_stats (guint                     *hits,
+                                                                   guint                     *misses);
+
 G_END_DECLS
 
 #endif /* __CTK_CSS_NODE_STYLE_CACHE_PRIVATE_H__ */
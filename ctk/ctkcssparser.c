@@ -29,9 +29,14 @@
 
 #define NEWLINE_CHARS "\r\n"
 #define WHITESPACE_CHARS "\f \t"
-#define NMSTART "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
-#define NMCHAR NMSTART "01234567890-_"
-#define URLCHAR NMCHAR "!#$%&*~"
+
+/* Identifiers are scanned in place and only copied once their end is
+ * known. A GString is only needed when they contain escapes or non-ASCII
+ * characters.
+ */
+#define IS_NMSTART(c) (g_ascii_isalpha (c))
+#define IS_NMCHAR(c) (g_ascii_isalnum (c) || (c) == '-' || (c) == '_')
+#define NEEDS_UNESCAPE(c) ((c) == '\\' || (c) >= 127)
 
 #define CTK_IS_CSS_PARSER(parser) ((parser) != NULL)
 
@@ -124,6 +129,17 @@ _ctk_css_parser_get_position (CtkCssParser *parser)
   return parser->data - parser->line_start;
 }
 
+/* Returns the unparsed remainder of the input. Only useful to
+ * remember where a construct started or ended in the source text.
+ */
+const char *
+_ctk_css_parser_get_data (CtkCssParser *parser)
+{
+  g_return_val_if_fail (CTK_IS_CSS_PARSER (parser), NULL);
+
+  return parser->data;
+}
+
 static GFile *
 ctk_css_parser_get_base_file (CtkCssParser *parser)
 {
@@ -294,13 +310,16 @@ _ctk_css_parser_try (CtkCssParser *parser,
                      const char   *string,
                      gboolean      skip_whitespace)
 {
+  gsize len;
+
   g_return_val_if_fail (CTK_IS_CSS_PARSER (parser), FALSE);
   g_return_val_if_fail (string != NULL, FALSE);
 
-  if (g_ascii_strncasecmp (parser->data, string, strlen (string)) != 0)
+  len = strlen (string);
+  if (g_ascii_strncasecmp (parser->data, string, len) != 0)
     return FALSE;
 
-  parser->data += strlen (string);
+  parser->data += len;
 
   if (skip_whitespace)
     _ctk_css_parser_skip_whitespace (parser);
@@ -362,12 +381,12 @@ _ctk_css_parser_unescape (CtkCssParser *parser,
 static gboolean
 _ctk_css_parser_read_char (CtkCssParser *parser,
                            GString *     str,
-                           const char *  allowed)
+                           gboolean      nmstart)
 {
   if (*parser->data == 0)
     return FALSE;
 
-  if (strchr (allowed, *parser->data))
+  if (nmstart ? IS_NMSTART (*parser->data) : IS_NMCHAR (*parser->data))
     {
       g_string_append_c (str, *parser->data);
       parser->data++;
@@ -390,23 +409,72 @@ _ctk_css_parser_read_char (CtkCssParser *parser,
   return FALSE;
 }
 
+static const char *
+ctk_css_parser_skip_nmchars (const char *data)
+{
+  while (IS_NMCHAR (*data))
+    data++;
+
+  return data;
+}
+
+/* Reads the remaining characters of a name that started at @start.
+ * Everything up to the current position must have been plain characters.
+ */
+static char *
+ctk_css_parser_finish_name (CtkCssParser *parser,
+                            const char   *start)
+{
+  GString *name;
+
+  parser->data = ctk_css_parser_skip_nmchars (parser->data);
+  if (!NEEDS_UNESCAPE (*parser->data))
+    return g_strndup (start, parser->data - start);
+
+  name = g_string_new_len (start, parser->data - start);
+
+  while (_ctk_css_parser_read_char (parser, name, FALSE))
+    ;
+
+  return g_string_free (name, FALSE);
+}
+
+/* Returns the length of the identifier at the current position if it
+ * can be used straight from the input, or 0 if there is no identifier
+ * or it needs to be unescaped.
+ */
+static gsize
+ctk_css_parser_get_plain_ident_length (CtkCssParser *parser)
+{
+  const char *end = parser->data;
+
+  if (*end == '-')
+    end++;
+
+  if (!IS_NMSTART (*end))
+    return 0;
+
+  end = ctk_css_parser_skip_nmchars (end + 1);
+  if (NEEDS_UNESCAPE (*end))
+    return 0;
+
+  return end - parser->data;
+}
+
 char *
 _ctk_css_parser_try_name (CtkCssParser *parser,
                           gboolean      skip_whitespace)
 {
-  GString *name;
+  char *name;
 
   g_return_val_if_fail (CTK_IS_CSS_PARSER (parser), NULL);
 
-  name = g_string_new (NULL);
-
-  while (_ctk_css_parser_read_char (parser, name, NMCHAR))
-    ;
+  name = ctk_css_parser_finish_name (parser, parser->data);
 
   if (skip_whitespace)
     _ctk_css_parser_skip_whitespace (parser);
 
-  return g_string_free (name, FALSE);
+  return name;
 }
 
 char *
@@ -414,34 +482,42 @@ _ctk_css_parser_try_ident (CtkCssParser *parser,
                            gboolean      skip_whitespace)
 {
   const char *start;
-  GString *ident;
+  GString *str;
+  char *ident;
 
   g_return_val_if_fail (CTK_IS_CSS_PARSER (parser), NULL);
 
   start = parser->data;
-  
-  ident = g_string_new (NULL);
 
   if (*parser->data == '-')
+    parser->data++;
+
+  if (IS_NMSTART (*parser->data))
     {
-      g_string_append_c (ident, '-');
       parser->data++;
+      ident = ctk_css_parser_finish_name (parser, start);
     }
-
-  if (!_ctk_css_parser_read_char (parser, ident, NMSTART))
+  else
     {
-      parser->data = start;
-      g_string_free (ident, TRUE);
-      return NULL;
-    }
+      str = g_string_new_len (start, parser->data - start);
 
-  while (_ctk_css_parser_read_char (parser, ident, NMCHAR))
-    ;
+      if (!_ctk_css_parser_read_char (parser, str, TRUE))
+        {
+          parser->data = start;
+          g_string_free (str, TRUE);
+          return NULL;
+        }
+
+      while (_ctk_css_parser_read_char (parser, str, FALSE))
+        ;
+
+      ident = g_string_free (str, FALSE);
+    }
 
   if (skip_whitespace)
     _ctk_css_parser_skip_whitespace (parser);
 
-  return g_string_free (ident, FALSE);
+  return ident;
 }
 
 gboolean
@@ -457,6 +533,7 @@ _ctk_css_parser_read_string (CtkCssParser *parser)
 {
   GString *str;
   char quote;
+  gsize len;
 
   g_return_val_if_fail (CTK_IS_CSS_PARSER (parser), NULL);
 
@@ -469,11 +546,23 @@ _ctk_css_parser_read_string (CtkCssParser *parser)
     }
   
   parser->data++;
+
+  /* Most strings have nothing to unescape */
+  len = strcspn (parser->data, "\\'\"\n\r\f");
+  if (parser->data[len] == quote)
+    {
+      char *result = g_strndup (parser->data, len);
+
+      parser->data += len + 1;
+      _ctk_css_parser_skip_whitespace (parser);
+      return result;
+    }
+
   str = g_string_new (NULL);
 
   while (TRUE)
     {
-      gsize len = strcspn (parser->data, "\\'\"\n\r\f");
+      len = strcspn (parser->data, "\\'\"\n\r\f");
 
       g_string_append_len (str, parser->data, len);
 
@@ -638,6 +727,7 @@ ctk_css_dimension_value_parse (CtkCssParser           *parser,
   char *end, *unit_name;
   double value;
   CtkCssUnit unit;
+  gsize len;
 
   g_return_val_if_fail (CTK_IS_CSS_PARSER (parser), NULL);
 
@@ -663,21 +753,38 @@ ctk_css_dimension_value_parse (CtkCssParser           *parser,
       return NULL;
     }
 
-  unit_name = _ctk_css_parser_try_ident (parser, FALSE);
+  len = ctk_css_parser_get_plain_ident_length (parser);
+  if (len > 0)
+    unit_name = NULL;
+  else
+    unit_name = _ctk_css_parser_try_ident (parser, FALSE);
 
-  if (unit_name)
+  if (len > 0 || unit_name)
     {
       guint i;
 
       for (i = 0; i < G_N_ELEMENTS (units); i++)
         {
-          if (flags & units[i].required_flags &&
-              g_ascii_strcasecmp (unit_name, units[i].name) == 0)
+          if (!(flags & units[i].required_flags))
+            continue;
+
+          if (unit_name == NULL)
+            {
+              if (strlen (units[i].name) == len &&
+                  g_ascii_strncasecmp (parser->data, units[i].name, len) == 0)
+                break;
+            }
+          else if (g_ascii_strcasecmp (unit_name, units[i].name) == 0)
             break;
         }
 
       if (i >= G_N_ELEMENTS (units))
         {
+          if (unit_name == NULL)
+            {
+              unit_name = g_strndup (parser->data, len);
+              parser->data += len;
+            }
           _ctk_css_parser_error (parser, "'%s' is not a valid unit.", unit_name);
           g_free (unit_name);
           return NULL;
@@ -685,6 +792,7 @@ ctk_css_dimension_value_parse (CtkCssParser           *parser,
 
       unit = units[i].unit;
 
+      parser->data += len;
       g_free (unit_name);
     }
   else
@@ -756,19 +864,32 @@ _ctk_css_parser_try_enum (CtkCssParser *parser,
   gboolean result;
   const char *start;
   char *str;
+  gsize len;
 
   g_return_val_if_fail (CTK_IS_CSS_PARSER (parser), FALSE);
   g_return_val_if_fail (value != NULL, FALSE);
 
   result = FALSE;
 
-  enum_class = g_type_class_ref (enum_type);
-
   start = parser->data;
 
-  str = _ctk_css_parser_try_ident (parser, TRUE);
-  if (str == NULL)
-    return FALSE;
+  /* Compare plain identifiers in place, this is called a lot while
+   * trying the alternatives of shorthand properties.
+   */
+  len = ctk_css_parser_get_plain_ident_length (parser);
+  if (len > 0)
+    {
+      str = NULL;
+      parser->data += len;
+    }
+  else
+    {
+      str = _ctk_css_parser_try_ident (parser, FALSE);
+      if (str == NULL)
+        return FALSE;
+    }
+
+  enum_class = g_type_class_ref (enum_type);
 
   if (enum_class->n_values)
     {
@@ -776,8 +897,12 @@ _ctk_css_parser_try_enum (CtkCssParser *parser,
 
       for (enum_value = enum_class->values; enum_value->value_name; enum_value++)
 	{
-	  if (enum_value->value_nick &&
-	      g_ascii_strcasecmp (str, enum_value->value_nick) == 0)
+	  if (enum_value->value_nick == NULL)
+	    continue;
+
+	  if (str ? g_ascii_strcasecmp (str, enum_value->value_nick) == 0
+	          : (strlen (enum_value->value_nick) == len &&
+	             g_ascii_strncasecmp (start, enum_value->value_nick, len) == 0))
 	    {
 	      *value = enum_value->value;
 	      result = TRUE;
@@ -789,7 +914,9 @@ _ctk_css_parser_try_enum (CtkCssParser *parser,
   g_free (str);
   g_type_class_unref (enum_class);
 
-  if (!result)
+  if (result)
+    _ctk_css_parser_skip_whitespace (parser);
+  else
     parser->data = start;
 
   return result;
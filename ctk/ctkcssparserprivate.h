@@ -47,6 +47,7 @@ void            _ctk_css_parser_error_full        (CtkCssParser          *parser
 
 guint           _ctk_css_parser_get_line          (CtkCssParser          *parser);
 guint           _ctk_css_parser_get_position      (CtkCssParser          *parser);
+const char *    _ctk_css_parser_get_data          (CtkCssParser          *parser);
 GFile *         _ctk_css_parser_get_file          (CtkCssParser          *parser);
 GFile *         _ctk_css_parser_get_file_for_path (CtkCssParser          *parser,
                                                    const char            *path);
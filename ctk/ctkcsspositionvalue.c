@@ -65,6 +65,14 @@ ctk_css_value_position_equal (const CtkCssValue *position1,
       && _ctk_css_value_equal (position1->y, position2->y);
 }
 
+static guint
+ctk_css_value_position_hash (const CtkCssValue *position)
+{
+  guint hash = _ctk_css_value_hash (position->x);
+
+  return (hash << 5) - hash + _ctk_css_value_hash (position->y);
+}
+
 static CtkCssValue *
 ctk_css_value_position_transition (CtkCssValue *start,
                                    CtkCssValue *end,
@@ -154,7 +162,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_POSITION = {
   ctk_css_value_position_compute,
   ctk_css_value_position_equal,
   ctk_css_value_position_transition,
-  ctk_css_value_position_print
+  ctk_css_value_position_print,
+  ctk_css_value_position_hash
 };
 
 CtkCssValue *
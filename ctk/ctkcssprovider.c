@@ -27,6 +27,7 @@
 
 #include "ctkbitmaskprivate.h"
 #include "ctkcssarrayvalueprivate.h"
+#include "ctkcsscacheprivate.h"
 #include "ctkcsscolorvalueprivate.h"
 #include "ctkcsskeyframesprivate.h"
 #include "ctkcssparserprivate.h"
@@ -41,6 +42,7 @@
 #include "ctkstyleproviderprivate.h"
 #include "ctkwidgetpath.h"
 #include "ctkbindings.h"
+#include "ctkdebug.h"
 #include "ctkmarshalers.h"
 #include "ctkprivate.h"
 #include "ctkintl.h"
@@ -81,6 +83,7 @@
 
 typedef struct CtkCssRuleset CtkCssRuleset;
 typedef struct _CtkCssScanner CtkCssScanner;
+typedef struct _CtkCssRecorder CtkCssRecorder;
 typedef struct _PropertyValue PropertyValue;
 typedef struct _WidgetPropertyValue WidgetPropertyValue;
 typedef enum ParserScope ParserScope;
@@ -108,6 +111,7 @@ struct CtkCssRuleset
   PropertyValue *styles;
   CtkBitmask *set_styles;
   guint n_styles;
+  guint cache_block;
   guint owns_styles : 1;
   guint owns_widget_style : 1;
 };
@@ -121,6 +125,29 @@ struct _CtkCssScanner
   GSList *state;
 };
 
+/* Collects the source text of everything a theme load parsed, so
+ * the result can be written to the disk cache and replayed later
+ * without going through the stylesheet again.
+ */
+struct _CtkCssRecorder
+{
+  GHashTable *files;            /* GFile => index */
+  GByteArray *file_data;
+  guint       n_files;
+  GHashTable *values;           /* "file:property:text" => index */
+  GByteArray *value_data;
+  guint       n_values;
+  GByteArray *color_data;
+  guint       n_colors;
+  GByteArray *keyframes_data;
+  guint       n_keyframes;
+  GHashTable *blocks;           /* GBytes => index */
+  GPtrArray  *block_list;       /* GBytes, by index */
+  GByteArray *block;            /* declarations of the current ruleset */
+  guint       n_block_declarations;
+  guint       failed : 1;
+};
+
 struct _CtkCssProviderPrivate
 {
   GScanner *scanner;
@@ -132,6 +159,10 @@ struct _CtkCssProviderPrivate
   CtkCssSelectorTree *tree;
   GResource *resource;
   gchar *path;
+
+  CtkCssRecorder *recorder;
+
+  guint keep_selectors : 1;
 };
 
 enum {
@@ -402,6 +433,38 @@ ctk_css_ruleset_add (CtkCssRuleset       *ruleset,
     ruleset->styles[i].section = NULL;
 }
 
+static void
+ctk_css_ruleset_add_parsed (CtkCssRuleset    *ruleset,
+                            CtkStyleProperty *property,
+                            CtkCssValue      *value,
+                            CtkCssSection    *section)
+{
+  if (CTK_IS_CSS_SHORTHAND_PROPERTY (property))
+    {
+      CtkCssShorthandProperty *shorthand = CTK_CSS_SHORTHAND_PROPERTY (property);
+      guint i;
+
+      for (i = 0; i < _ctk_css_shorthand_property_get_n_subproperties (shorthand); i++)
+        {
+          CtkCssStyleProperty *child = _ctk_css_shorthand_property_get_subproperty (shorthand, i);
+          CtkCssValue *sub = _ctk_css_array_value_get_nth (value, i);
+
+          ctk_css_ruleset_add (ruleset, child, _ctk_css_value_ref (sub), section);
+        }
+
+      _ctk_css_value_unref (value);
+    }
+  else if (CTK_IS_CSS_STYLE_PROPERTY (property))
+    {
+      ctk_css_ruleset_add (ruleset, CTK_CSS_STYLE_PROPERTY (property), value, section);
+    }
+  else
+    {
+      g_assert_not_reached ();
+      _ctk_css_value_unref (value);
+    }
+}
+
 static void
 ctk_css_scanner_destroy (CtkCssScanner *scanner)
 {
@@ -418,6 +481,12 @@ ctk_css_style_provider_emit_error (CtkStyleProviderPrivate *provider,
                                    CtkCssSection           *section,
                                    const GError            *error)
 {
+  CtkCssRecorder *recorder = CTK_CSS_PROVIDER (provider)->priv->recorder;
+
+  /* Errors need to be reported on every load, so don't cache the result */
+  if (recorder)
+    recorder->failed = TRUE;
+
   g_signal_emit (provider, css_provider_signals[PARSING_ERROR], 0, section, error);
 }
 
@@ -515,6 +584,239 @@ ctk_css_scanner_pop_section (CtkCssScanner *scanner,
   scanner->section = parent;
 }
 
+static CtkCssRecorder *
+ctk_css_recorder_new (void)
+{
+  CtkCssRecorder *recorder;
+
+  recorder = g_slice_new0 (CtkCssRecorder);
+
+  recorder->files = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                           g_object_unref, NULL);
+  recorder->file_data = g_byte_array_new ();
+  recorder->values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  recorder->value_data = g_byte_array_new ();
+  recorder->color_data = g_byte_array_new ();
+  recorder->keyframes_data = g_byte_array_new ();
+  recorder->blocks = g_hash_table_new (g_bytes_hash, g_bytes_equal);
+  recorder->block_list = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+
+  return recorder;
+}
+
+static void
+ctk_css_recorder_free (CtkCssRecorder *recorder)
+{
+  g_hash_table_unref (recorder->files);
+  g_byte_array_unref (recorder->file_data);
+  g_hash_table_unref (recorder->values);
+  g_byte_array_unref (recorder->value_data);
+  g_byte_array_unref (recorder->color_data);
+  g_byte_array_unref (recorder->keyframes_data);
+  g_hash_table_unref (recorder->blocks);
+  g_ptr_array_unref (recorder->block_list);
+  if (recorder->block)
+    g_byte_array_unref (recorder->block);
+
+  g_slice_free (CtkCssRecorder, recorder);
+}
+
+static void
+ctk_css_recorder_add_file (CtkCssRecorder *recorder,
+                           GFile          *file,
+                           GBytes         *bytes)
+{
+  char *uri, *checksum;
+
+  if (g_hash_table_contains (recorder->files, file))
+    return;
+
+  g_hash_table_insert (recorder->files,
+                       g_object_ref (file),
+                       GUINT_TO_POINTER (recorder->n_files));
+  recorder->n_files++;
+
+  uri = g_file_get_uri (file);
+  checksum = ctk_css_cache_checksum (bytes);
+  ctk_css_cache_write_string (recorder->file_data, uri);
+  ctk_css_cache_write_string (recorder->file_data, checksum);
+  g_free (checksum);
+  g_free (uri);
+}
+
+static guint
+ctk_css_scanner_get_file_index (CtkCssScanner *scanner)
+{
+  CtkCssRecorder *recorder = scanner->provider->priv->recorder;
+  GFile *file;
+  gpointer index;
+
+  file = _ctk_css_parser_get_file (scanner->parser);
+  if (file == NULL ||
+      !g_hash_table_lookup_extended (recorder->files, file, NULL, &index))
+    {
+      /* Can only happen for data that was not loaded from a file,
+       * and we have no way to validate that later.
+       */
+      recorder->failed = TRUE;
+      return 0;
+    }
+
+  return GPOINTER_TO_UINT (index);
+}
+
+static void
+ctk_css_scanner_begin_block (CtkCssScanner *scanner)
+{
+  CtkCssRecorder *recorder = scanner->provider->priv->recorder;
+
+  if (recorder == NULL)
+    return;
+
+  g_assert (recorder->block == NULL);
+
+  recorder->block = g_byte_array_new ();
+  recorder->n_block_declarations = 0;
+}
+
+static guint
+ctk_css_scanner_end_block (CtkCssScanner *scanner)
+{
+  CtkCssRecorder *recorder = scanner->provider->priv->recorder;
+  GByteArray *block;
+  GBytes *bytes;
+  gpointer index;
+
+  if (recorder == NULL)
+    return 0;
+
+  block = g_byte_array_new ();
+  ctk_css_cache_write_uint32 (block, recorder->n_block_declarations);
+  g_byte_array_append (block, recorder->block->data, recorder->block->len);
+  g_byte_array_unref (recorder->block);
+  recorder->block = NULL;
+
+  bytes = g_byte_array_free_to_bytes (block);
+
+  /* Themes repeat the same declarations for lots of selectors, share them */
+  if (g_hash_table_lookup_extended (recorder->blocks, bytes, NULL, &index))
+    {
+      g_bytes_unref (bytes);
+      return GPOINTER_TO_UINT (index);
+    }
+
+  index = GUINT_TO_POINTER (recorder->block_list->len);
+  g_ptr_array_add (recorder->block_list, bytes);
+  g_hash_table_insert (recorder->blocks, bytes, index);
+
+  return GPOINTER_TO_UINT (index);
+}
+
+static void
+ctk_css_scanner_record_value (CtkCssScanner    *scanner,
+                              CtkStyleProperty *property,
+                              const char       *start,
+                              const char       *end)
+{
+  CtkCssRecorder *recorder = scanner->provider->priv->recorder;
+  guint file_index;
+  gpointer index;
+  char *text, *key;
+
+  if (recorder == NULL)
+    return;
+
+  file_index = ctk_css_scanner_get_file_index (scanner);
+  text = g_strndup (start, end - start);
+
+  /* The same value only needs to be parsed once when loading the cache */
+  key = g_strdup_printf ("%u:%s:%s", file_index, property->name, text);
+  if (!g_hash_table_lookup_extended (recorder->values, key, NULL, &index))
+    {
+      index = GUINT_TO_POINTER (recorder->n_values);
+      g_hash_table_insert (recorder->values, key, index);
+      recorder->n_values++;
+
+      ctk_css_cache_write_string (recorder->value_data, property->name);
+      ctk_css_cache_write_uint32 (recorder->value_data, file_index);
+      ctk_css_cache_write_string (recorder->value_data, text);
+    }
+  else
+    g_free (key);
+
+  ctk_css_cache_write_uint32 (recorder->block, 0);
+  ctk_css_cache_write_uint32 (recorder->block, GPOINTER_TO_UINT (index));
+  recorder->n_block_declarations++;
+
+  g_free (text);
+}
+
+static void
+ctk_css_scanner_record_widget_style (CtkCssScanner *scanner,
+                                     const char    *name,
+                                     const char    *value)
+{
+  CtkCssRecorder *recorder = scanner->provider->priv->recorder;
+
+  if (recorder == NULL)
+    return;
+
+  ctk_css_cache_write_uint32 (recorder->block, 1);
+  ctk_css_cache_write_string (recorder->block, name);
+  ctk_css_cache_write_string (recorder->block, value);
+  recorder->n_block_declarations++;
+}
+
+static void
+ctk_css_scanner_record_definition (CtkCssScanner *scanner,
+                                   GByteArray    *data,
+                                   const char    *name,
+                                   const char    *start,
+                                   const char    *end,
+                                   const char    *terminator)
+{
+  char *text;
+
+  text = g_strdup_printf ("%.*s%s", (int) (end - start), start, terminator);
+
+  ctk_css_cache_write_string (data, name);
+  ctk_css_cache_write_uint32 (data, ctk_css_scanner_get_file_index (scanner));
+  ctk_css_cache_write_string (data, text);
+
+  g_free (text);
+}
+
+static void
+ctk_css_scanner_record_color (CtkCssScanner *scanner,
+                              const char    *name,
+                              const char    *start,
+                              const char    *end)
+{
+  CtkCssRecorder *recorder = scanner->provider->priv->recorder;
+
+  if (recorder == NULL)
+    return;
+
+  ctk_css_scanner_record_definition (scanner, recorder->color_data, name, start, end, "");
+  recorder->n_colors++;
+}
+
+static void
+ctk_css_scanner_record_keyframes (CtkCssScanner *scanner,
+                                  const char    *name,
+                                  const char    *start,
+                                  const char    *end)
+{
+  CtkCssRecorder *recorder = scanner->provider->priv->recorder;
+
+  if (recorder == NULL)
+    return;
+
+  /* _ctk_css_keyframes_parse() stops at the closing brace */
+  ctk_css_scanner_record_definition (scanner, recorder->keyframes_data, name, start, end, "}");
+  recorder->n_keyframes++;
+}
+
 static void
 ctk_css_provider_init (CtkCssProvider *css_provider)
 {
@@ -960,6 +1262,8 @@ ctk_css_provider_reset (CtkCssProvider *css_provider)
   g_hash_table_remove_all (priv->symbolic_colors);
   g_hash_table_remove_all (priv->keyframes);
 
+  priv->keep_selectors = FALSE;
+
   for (i = 0; i < priv->rulesets->len; i++)
     ctk_css_ruleset_clear (&g_array_index (priv->rulesets, CtkCssRuleset, i));
   g_array_set_size (priv->rulesets, 0);
@@ -1069,6 +1373,7 @@ static gboolean
 parse_color_definition (CtkCssScanner *scanner)
 {
   CtkCssValue *color;
+  const char *start, *end;
   char *name;
 
   ctk_css_scanner_push_section (scanner, CTK_CSS_SECTION_COLOR_DEFINITION);
@@ -1092,7 +1397,9 @@ parse_color_definition (CtkCssScanner *scanner)
       return TRUE;
     }
 
+  start = _ctk_css_parser_get_data (scanner->parser);
   color = _ctk_css_color_value_parse (scanner->parser);
+  end = _ctk_css_parser_get_data (scanner->parser);
   if (color == NULL)
     {
       g_free (name);
@@ -1116,6 +1423,7 @@ parse_color_definition (CtkCssScanner *scanner)
       return TRUE;
     }
 
+  ctk_css_scanner_record_color (scanner, name, start, end);
   g_hash_table_insert (scanner->provider->priv->symbolic_colors, name, color);
 
   ctk_css_scanner_pop_section (scanner, CTK_CSS_SECTION_COLOR_DEFINITION);
@@ -1136,6 +1444,10 @@ parse_binding_set (CtkCssScanner *scanner)
       return FALSE;
     }
 
+  /* Binding sets are global state, a cached load could not restore them */
+  if (scanner->provider->priv->recorder)
+    scanner->provider->priv->recorder->failed = TRUE;
+
   name = _ctk_css_parser_try_ident (scanner->parser, TRUE);
   if (name == NULL)
     {
@@ -1234,6 +1546,7 @@ static gboolean
 parse_keyframes (CtkCssScanner *scanner)
 {
   CtkCssKeyframes *keyframes;
+  const char *start;
   char *name;
 
   ctk_css_scanner_push_section (scanner, CTK_CSS_SECTION_KEYFRAMES);
@@ -1268,6 +1581,7 @@ parse_keyframes (CtkCssScanner *scanner)
       goto exit;
     }
 
+  start = _ctk_css_parser_get_data (scanner->parser);
   keyframes = _ctk_css_keyframes_parse (scanner->parser);
   if (keyframes == NULL)
     {
@@ -1276,6 +1590,7 @@ parse_keyframes (CtkCssScanner *scanner)
       goto exit;
     }
 
+  ctk_css_scanner_record_keyframes (scanner, name, start, _ctk_css_parser_get_data (scanner->parser));
   g_hash_table_insert (scanner->provider->priv->keyframes, name, keyframes);
 
   if (!_ctk_css_parser_try (scanner->parser, "}", TRUE))
@@ -1465,11 +1780,13 @@ parse_declaration (CtkCssScanner *scanner,
   if (property)
     {
       CtkCssValue *value;
+      const char *start;
 
       g_free (name);
 
       ctk_css_scanner_push_section (scanner, CTK_CSS_SECTION_VALUE);
 
+      start = _ctk_css_parser_get_data (scanner->parser);
       value = _ctk_style_property_parse_value (property,
                                                scanner->parser);
 
@@ -1496,31 +1813,8 @@ parse_declaration (CtkCssScanner *scanner,
           return;
         }
 
-      if (CTK_IS_CSS_SHORTHAND_PROPERTY (property))
-        {
-          CtkCssShorthandProperty *shorthand = CTK_CSS_SHORTHAND_PROPERTY (property);
-          guint i;
-
-          for (i = 0; i < _ctk_css_shorthand_property_get_n_subproperties (shorthand); i++)
-            {
-              CtkCssStyleProperty *child = _ctk_css_shorthand_property_get_subproperty (shorthand, i);
-              CtkCssValue *sub = _ctk_css_array_value_get_nth (value, i);
-              
-              ctk_css_ruleset_add (ruleset, child, _ctk_css_value_ref (sub), scanner->section);
-            }
-          
-            _ctk_css_value_unref (value);
-        }
-      else if (CTK_IS_CSS_STYLE_PROPERTY (property))
-        {
-          ctk_css_ruleset_add (ruleset, CTK_CSS_STYLE_PROPERTY (property), value, scanner->section);
-        }
-      else
-        {
-          g_assert_not_reached ();
-          _ctk_css_value_unref (value);
-        }
-
+      ctk_css_scanner_record_value (scanner, property, start, _ctk_css_parser_get_data (scanner->parser));
+      ctk_css_ruleset_add_parsed (ruleset, property, value, scanner->section);
 
       ctk_css_scanner_pop_section (scanner, CTK_CSS_SECTION_VALUE);
     }
@@ -1537,6 +1831,8 @@ parse_declaration (CtkCssScanner *scanner,
         {
           WidgetPropertyValue *val;
 
+          ctk_css_scanner_record_widget_style (scanner, name, value_str);
+
           val = widget_property_value_new (name, scanner->section);
 	  val->value = value_str;
 
@@ -1612,7 +1908,9 @@ parse_ruleset (CtkCssScanner *scanner)
       return;
     }
 
+  ctk_css_scanner_begin_block (scanner);
   parse_declarations (scanner, &ruleset);
+  ruleset.cache_block = ctk_css_scanner_end_block (scanner);
 
   if (!_ctk_css_parser_try (scanner->parser, "}", TRUE))
     {
@@ -1704,14 +2002,18 @@ ctk_css_provider_postprocess (CtkCssProvider *css_provider)
   _ctk_css_selector_tree_builder_free (builder);
 
 #ifndef VERIFY_TREE
-  for (i = 0; i < priv->rulesets->len; i++)
+  /* Selectors of data loads are kept to diff them against the next load */
+  if (!priv->keep_selectors)
     {
-      CtkCssRuleset *ruleset;
+      for (i = 0; i < priv->rulesets->len; i++)
+        {
+          CtkCssRuleset *ruleset;
 
-      ruleset = &g_array_index (priv->rulesets, CtkCssRuleset, i);
+          ruleset = &g_array_index (priv->rulesets, CtkCssRuleset, i);
 
-      _ctk_css_selector_free (ruleset->selector);
-      ruleset->selector = NULL;
+          _ctk_css_selector_free (ruleset->selector);
+          ruleset->selector = NULL;
+        }
     }
 #endif
 }
@@ -1744,6 +2046,9 @@ ctk_css_provider_load_internal (CtkCssProvider *css_provider,
       if (free_bytes != NULL)
         {
           text = g_bytes_get_data (free_bytes, NULL);
+
+          if (css_provider->priv->recorder)
+            ctk_css_recorder_add_file (css_provider->priv->recorder, file, free_bytes);
         }
       else
         {
@@ -1810,6 +2115,666 @@ ctk_css_provider_load_internal (CtkCssProvider *css_provider,
   return TRUE;
 }
 
+static gboolean
+ctk_css_provider_use_disk_cache (void)
+{
+  /* The inspector wants sections, which the cache does not keep */
+  if (ctk_keep_css_sections)
+    return FALSE;
+
+  return !CTK_DEBUG_CHECK (NO_CSS_DISK_CACHE);
+}
+
+static void
+ctk_css_provider_save_cache (CtkCssProvider *css_provider,
+                             GFile          *file)
+{
+  CtkCssProviderPrivate *priv = css_provider->priv;
+  CtkCssRecorder *recorder = priv->recorder;
+  GHashTable *match_indices;
+  GByteArray *bytes;
+  GError *error = NULL;
+  char *path;
+  guint i;
+
+  path = ctk_css_cache_get_path (file);
+  if (path == NULL)
+    return;
+
+  bytes = g_byte_array_new ();
+  ctk_css_cache_write_header (bytes);
+
+  ctk_css_cache_write_uint32 (bytes, recorder->n_files);
+  g_byte_array_append (bytes, recorder->file_data->data, recorder->file_data->len);
+  ctk_css_cache_write_uint32 (bytes, recorder->n_values);
+  g_byte_array_append (bytes, recorder->value_data->data, recorder->value_data->len);
+  ctk_css_cache_write_uint32 (bytes, recorder->n_colors);
+  g_byte_array_append (bytes, recorder->color_data->data, recorder->color_data->len);
+  ctk_css_cache_write_uint32 (bytes, recorder->n_keyframes);
+  g_byte_array_append (bytes, recorder->keyframes_data->data, recorder->keyframes_data->len);
+
+  ctk_css_cache_write_uint32 (bytes, recorder->block_list->len);
+  for (i = 0; i < recorder->block_list->len; i++)
+    {
+      gconstpointer data;
+      gsize size;
+
+      data = g_bytes_get_data (g_ptr_array_index (recorder->block_list, i), &size);
+      g_byte_array_append (bytes, data, size);
+    }
+
+  match_indices = g_hash_table_new (NULL, NULL);
+  ctk_css_cache_write_uint32 (bytes, priv->rulesets->len);
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      CtkCssRuleset *ruleset = &g_array_index (priv->rulesets, CtkCssRuleset, i);
+
+      ctk_css_cache_write_uint32 (bytes, ruleset->cache_block);
+      g_hash_table_insert (match_indices, ruleset, GUINT_TO_POINTER (i));
+    }
+
+  _ctk_css_selector_tree_save (priv->tree, bytes, match_indices);
+  g_hash_table_unref (match_indices);
+
+  if (!g_file_set_contents (path, (const char *) bytes->data, bytes->len, &error))
+    {
+      CTK_NOTE (MISC, g_message ("Failed to write CSS cache %s: %s", path, error->message));
+      g_error_free (error);
+    }
+
+  g_byte_array_unref (bytes);
+  g_free (path);
+}
+
+static void
+ctk_css_provider_cache_parser_error (CtkCssParser *parser G_GNUC_UNUSED,
+                                     const GError *error G_GNUC_UNUSED,
+                                     gpointer      user_data)
+{
+  gboolean *failed = user_data;
+
+  *failed = TRUE;
+}
+
+/* Creates a parser for text that parsed without errors when the
+ * cache was written, any error means the cache is out of date.
+ */
+static CtkCssParser *
+ctk_css_provider_cache_parser_new (CtkCssCacheReader *reader,
+                                   GPtrArray         *files,
+                                   gboolean          *failed)
+{
+  const char *text;
+  guint file_index;
+
+  file_index = ctk_css_cache_read_uint32 (reader);
+  text = ctk_css_cache_read_string (reader);
+  if (text == NULL || file_index >= files->len)
+    {
+      reader->failed = TRUE;
+      return NULL;
+    }
+
+  *failed = FALSE;
+
+  return _ctk_css_parser_new (text,
+                              g_ptr_array_index (files, file_index),
+                              ctk_css_provider_cache_parser_error,
+                              failed);
+}
+
+static gboolean
+ctk_css_provider_cache_parser_done (CtkCssParser *parser,
+                                    gboolean      failed)
+{
+  gboolean done;
+
+  _ctk_css_parser_skip_whitespace (parser);
+  done = !failed && _ctk_css_parser_is_eof (parser);
+  _ctk_css_parser_free (parser);
+
+  return done;
+}
+
+static gboolean
+ctk_css_provider_read_cache (CtkCssProvider    *css_provider,
+                             CtkCssCacheReader *reader,
+                             GPtrArray         *files,
+                             GPtrArray         *properties,
+                             GPtrArray         *values,
+                             CtkCssRuleset     *blocks[],
+                             guint             *n_blocks)
+{
+  CtkCssProviderPrivate *priv = css_provider->priv;
+  CtkStyleProperty *property;
+  CtkCssParser *parser;
+  CtkCssValue *value;
+  CtkCssKeyframes *keyframes;
+  CtkCssSelectorTree ***selector_matches;
+  gpointer *matches;
+  const char *name, *checksum;
+  gboolean failed;
+  guint i, j, n, n_declarations, index;
+
+  if (!ctk_css_cache_read_header (reader))
+    return FALSE;
+
+  /* Check that none of the parsed files changed */
+  n = ctk_css_cache_read_uint32 (reader);
+  for (i = 0; i < n && !reader->failed; i++)
+    {
+      GFile *file;
+      GBytes *bytes;
+      char *current;
+
+      name = ctk_css_cache_read_string (reader);
+      checksum = ctk_css_cache_read_string (reader);
+      if (name == NULL || checksum == NULL)
+        return FALSE;
+
+      file = g_file_new_for_uri (name);
+      g_ptr_array_add (files, file);
+
+      bytes = ctk_file_load_bytes (file, NULL, NULL);
+      if (bytes == NULL)
+        return FALSE;
+
+      current = ctk_css_cache_checksum (bytes);
+      failed = strcmp (current, checksum) != 0;
+      g_free (current);
+      g_bytes_unref (bytes);
+
+      if (failed)
+        return FALSE;
+    }
+
+  n = ctk_css_cache_read_uint32 (reader);
+  for (i = 0; i < n && !reader->failed; i++)
+    {
+      name = ctk_css_cache_read_string (reader);
+      parser = ctk_css_provider_cache_parser_new (reader, files, &failed);
+      if (parser == NULL)
+        return FALSE;
+
+      property = name ? _ctk_style_property_lookup (name) : NULL;
+      value = property ? _ctk_style_property_parse_value (property, parser) : NULL;
+
+      if (!ctk_css_provider_cache_parser_done (parser, failed) || value == NULL)
+        {
+          if (value)
+            _ctk_css_value_unref (value);
+          return FALSE;
+        }
+
+      g_ptr_array_add (properties, property);
+      g_ptr_array_add (values, value);
+    }
+
+  n = ctk_css_cache_read_uint32 (reader);
+  for (i = 0; i < n && !reader->failed; i++)
+    {
+      name = ctk_css_cache_read_string (reader);
+      parser = ctk_css_provider_cache_parser_new (reader, files, &failed);
+      if (parser == NULL || name == NULL)
+        {
+          if (parser)
+            _ctk_css_parser_free (parser);
+          return FALSE;
+        }
+
+      value = _ctk_css_color_value_parse (parser);
+
+      if (!ctk_css_provider_cache_parser_done (parser, failed) || value == NULL)
+        {
+          if (value)
+            _ctk_css_value_unref (value);
+          return FALSE;
+        }
+
+      g_hash_table_insert (priv->symbolic_colors, g_strdup (name), value);
+    }
+
+  n = ctk_css_cache_read_uint32 (reader);
+  for (i = 0; i < n && !reader->failed; i++)
+    {
+      name = ctk_css_cache_read_string (reader);
+      parser = ctk_css_provider_cache_parser_new (reader, files, &failed);
+      if (parser == NULL || name == NULL)
+        {
+          if (parser)
+            _ctk_css_parser_free (parser);
+          return FALSE;
+        }
+
+      keyframes = _ctk_css_keyframes_parse (parser);
+      if (keyframes && !_ctk_css_parser_try (parser, "}", TRUE))
+        failed = TRUE;
+
+      if (!ctk_css_provider_cache_parser_done (parser, failed) || keyframes == NULL)
+        {
+          if (keyframes)
+            _ctk_css_keyframes_unref (keyframes);
+          return FALSE;
+        }
+
+      g_hash_table_insert (priv->keyframes, g_strdup (name), keyframes);
+    }
+
+  /* Declaration blocks become template rulesets that the actual rulesets copy */
+  n = ctk_css_cache_read_uint32 (reader);
+  if (reader->failed)
+    return FALSE;
+  *blocks = g_new0 (CtkCssRuleset, n);
+  *n_blocks = n;
+  for (i = 0; i < n && !reader->failed; i++)
+    {
+      CtkCssRuleset *block = &(*blocks)[i];
+
+      n_declarations = ctk_css_cache_read_uint32 (reader);
+      for (j = 0; j < n_declarations && !reader->failed; j++)
+        {
+          if (ctk_css_cache_read_uint32 (reader) == 0)
+            {
+              index = ctk_css_cache_read_uint32 (reader);
+              if (index >= values->len)
+                return FALSE;
+
+              ctk_css_ruleset_add_parsed (block,
+                                          g_ptr_array_index (properties, index),
+                                          _ctk_css_value_ref (g_ptr_array_index (values, index)),
+                                          NULL);
+            }
+          else
+            {
+              const char *text;
+              WidgetPropertyValue *val;
+
+              name = ctk_css_cache_read_string (reader);
+              text = ctk_css_cache_read_string (reader);
+              if (name == NULL || text == NULL)
+                return FALSE;
+
+              val = widget_property_value_new (g_strdup (name), NULL);
+              val->value = g_strdup (text);
+              ctk_css_ruleset_add_style (block, val->name, val);
+            }
+        }
+    }
+
+  n = ctk_css_cache_read_uint32 (reader);
+  for (i = 0; i < n && !reader->failed; i++)
+    {
+      CtkCssRuleset new;
+
+      index = ctk_css_cache_read_uint32 (reader);
+      if (index >= *n_blocks)
+        return FALSE;
+
+      ctk_css_ruleset_init_copy (&new, &(*blocks)[index], NULL);
+      g_array_append_val (priv->rulesets, new);
+    }
+
+  if (reader->failed)
+    return FALSE;
+
+  matches = g_new (gpointer, priv->rulesets->len);
+  selector_matches = g_new (CtkCssSelectorTree **, priv->rulesets->len);
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      CtkCssRuleset *ruleset = &g_array_index (priv->rulesets, CtkCssRuleset, i);
+
+      matches[i] = ruleset;
+      selector_matches[i] = &ruleset->selector_match;
+    }
+
+  priv->tree = _ctk_css_selector_tree_load (reader, matches, selector_matches, priv->rulesets->len);
+
+  g_free (selector_matches);
+  g_free (matches);
+
+  if (reader->failed || reader->data != reader->end)
+    return FALSE;
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      if (g_array_index (priv->rulesets, CtkCssRuleset, i).selector_match == NULL)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+ctk_css_provider_load_cache (CtkCssProvider *css_provider,
+                             GFile          *file)
+{
+  CtkCssCacheReader reader;
+  GMappedFile *mapped;
+  GPtrArray *files, *properties, *values;
+  CtkCssRuleset *blocks = NULL;
+  guint i, n_blocks = 0;
+  gboolean result;
+  char *path;
+
+  path = ctk_css_cache_get_path (file);
+  if (path == NULL)
+    return FALSE;
+
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  g_free (path);
+  if (mapped == NULL)
+    return FALSE;
+
+  ctk_css_cache_reader_init (&reader,
+                             (const guint8 *) g_mapped_file_get_contents (mapped),
+                             g_mapped_file_get_length (mapped));
+
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+  properties = g_ptr_array_new ();
+  values = g_ptr_array_new_with_free_func ((GDestroyNotify) _ctk_css_value_unref);
+
+  result = ctk_css_provider_read_cache (css_provider, &reader, files, properties, values, &blocks, &n_blocks);
+
+  for (i = 0; i < n_blocks; i++)
+    ctk_css_ruleset_clear (&blocks[i]);
+  g_free (blocks);
+  g_ptr_array_unref (values);
+  g_ptr_array_unref (properties);
+  g_ptr_array_unref (files);
+  g_mapped_file_unref (mapped);
+
+  if (!result)
+    ctk_css_provider_reset (css_provider);
+
+  return result;
+}
+
+/* Loads a theme stylesheet, using the disk cache when possible */
+static void
+ctk_css_provider_load_theme (CtkCssProvider *css_provider,
+                             GFile          *file)
+{
+  CtkCssProviderPrivate *priv = css_provider->priv;
+
+  ctk_css_provider_reset (css_provider);
+
+  if (!ctk_css_provider_use_disk_cache ())
+    {
+      ctk_css_provider_load_internal (css_provider, NULL, file, NULL, NULL);
+    }
+  else if (!ctk_css_provider_load_cache (css_provider, file))
+    {
+      priv->recorder = ctk_css_recorder_new ();
+
+      ctk_css_provider_load_internal (css_provider, NULL, file, NULL, NULL);
+
+      if (!priv->recorder->failed)
+        ctk_css_provider_save_cache (css_provider, file);
+
+      ctk_css_recorder_free (priv->recorder);
+      priv->recorder = NULL;
+    }
+
+  _ctk_style_provider_private_changed (CTK_STYLE_PROVIDER_PRIVATE (css_provider));
+}
+
+/* Reloading style sheets from data is commonly used for small runtime
+ * tweaks. Instead of restyling everything, the new rulesets are diffed
+ * against the previous ones and only nodes that may match a ruleset
+ * that was added, removed or modified are invalidated.
+ */
+
+/* Rulesets that need more edits are just restyled completely */
+#define MAX_RULESET_EDITS 128
+
+static gboolean
+widget_property_value_list_equal (const WidgetPropertyValue *a,
+                                  const WidgetPropertyValue *b)
+{
+  while (a && b)
+    {
+      if (!g_str_equal (a->name, b->name) ||
+          g_strcmp0 (a->value, b->value) != 0)
+        return FALSE;
+
+      a = a->next;
+      b = b->next;
+    }
+
+  return a == b;
+}
+
+static gboolean
+ctk_css_ruleset_equal (const CtkCssRuleset *a,
+                       const CtkCssRuleset *b)
+{
+  guint i;
+
+  if (a->n_styles != b->n_styles ||
+      !_ctk_css_selector_equal (a->selector, b->selector) ||
+      !widget_property_value_list_equal (a->widget_style, b->widget_style))
+    return FALSE;
+
+  for (i = 0; i < a->n_styles; i++)
+    {
+      if (a->styles[i].property != b->styles[i].property ||
+          !_ctk_css_value_equal (a->styles[i].value, b->styles[i].value))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+ctk_css_provider_colors_equal (GHashTable *a,
+                               GHashTable *b)
+{
+  GHashTableIter iter;
+  gpointer name, value;
+
+  if (g_hash_table_size (a) != g_hash_table_size (b))
+    return FALSE;
+
+  g_hash_table_iter_init (&iter, a);
+  while (g_hash_table_iter_next (&iter, &name, &value))
+    {
+      CtkCssValue *other = g_hash_table_lookup (b, name);
+
+      if (other == NULL || !_ctk_css_value_equal (value, other))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Finds the longest common subsequence of @old and @new with Myers'
+ * algorithm and marks the rulesets in it as kept. Rulesets that are
+ * kept stay in the same order, so they keep overriding each other the
+ * same way. Returns %FALSE if there are too many edits.
+ */
+static gboolean
+ctk_css_provider_diff_rulesets (GArray   *old,
+                                GArray   *new,
+                                gboolean *old_kept,
+                                gboolean *new_kept)
+{
+  const CtkCssRuleset *a, *b;
+  gint n, m, start, d, k, x, y;
+  gint *v, *prev_v, **trace;
+  gboolean found = FALSE;
+
+  n = old->len;
+  m = new->len;
+
+  /* Common prefix and suffix */
+  for (start = 0; start < n && start < m; start++)
+    {
+      if (!ctk_css_ruleset_equal (&g_array_index (old, CtkCssRuleset, start),
+                                  &g_array_index (new, CtkCssRuleset, start)))
+        break;
+      old_kept[start] = new_kept[start] = TRUE;
+    }
+  while (n > start && m > start &&
+         ctk_css_ruleset_equal (&g_array_index (old, CtkCssRuleset, n - 1),
+                                &g_array_index (new, CtkCssRuleset, m - 1)))
+    {
+      n--;
+      m--;
+      old_kept[n] = new_kept[m] = TRUE;
+    }
+
+  a = &g_array_index (old, CtkCssRuleset, start);
+  b = &g_array_index (new, CtkCssRuleset, start);
+  n -= start;
+  m -= start;
+  old_kept += start;
+  new_kept += start;
+
+  /* v[k] is the furthest x reached on diagonal k, offset so that
+   * k - 1 and k + 1 are valid for all k in [-d, d] */
+#define V(v, k) (v)[(k) + MAX_RULESET_EDITS + 1]
+  v = g_new0 (gint, 2 * MAX_RULESET_EDITS + 3);
+  trace = g_new0 (gint *, MAX_RULESET_EDITS + 1);
+
+  for (d = 0; d <= MAX_RULESET_EDITS && !found; d++)
+    {
+      trace[d] = g_memdup2 (v, (2 * MAX_RULESET_EDITS + 3) * sizeof (gint));
+
+      for (k = -d; k <= d; k += 2)
+        {
+          if (k == -d || (k != d && V (v, k - 1) < V (v, k + 1)))
+            x = V (v, k + 1);
+          else
+            x = V (v, k - 1) + 1;
+          y = x - k;
+
+          while (x < n && y < m && ctk_css_ruleset_equal (&a[x], &b[y]))
+            {
+              x++;
+              y++;
+            }
+
+          V (v, k) = x;
+
+          if (x >= n && y >= m)
+            {
+              found = TRUE;
+              break;
+            }
+        }
+    }
+
+  if (found)
+    {
+      x = n;
+      y = m;
+
+      for (d = d - 1; d >= 0; d--)
+        {
+          gint prev_k, prev_x, prev_y;
+
+          prev_v = trace[d];
+          k = x - y;
+
+          if (k == -d || (k != d && V (prev_v, k - 1) < V (prev_v, k + 1)))
+            prev_k = k + 1;
+          else
+            prev_k = k - 1;
+
+          prev_x = V (prev_v, prev_k);
+          prev_y = prev_x - prev_k;
+
+          while (x > prev_x && y > prev_y)
+            {
+              x--;
+              y--;
+              old_kept[x] = new_kept[y] = TRUE;
+            }
+
+          x = prev_x;
+          y = prev_y;
+        }
+    }
+#undef V
+
+  for (d = 0; d <= MAX_RULESET_EDITS; d++)
+    g_free (trace[d]);
+  g_free (trace);
+  g_free (v);
+
+  return found;
+}
+
+/* Emits ::-gtk-private-changed for going from @old_rulesets and
+ * @old_colors to the currently loaded style sheet.
+ */
+static void
+ctk_css_provider_changed_from (CtkCssProvider *css_provider,
+                               GArray         *old_rulesets,
+                               GHashTable     *old_colors)
+{
+  CtkCssProviderPrivate *priv = css_provider->priv;
+  CtkCssSelectorTreeBuilder *builder;
+  CtkCssSelectorTree *selectors;
+  gboolean *old_kept, *new_kept;
+  guint i, n_changed;
+
+  /* Colors and keyframes are referenced by name from anywhere */
+  if (g_hash_table_size (priv->keyframes) > 0 ||
+      !ctk_css_provider_colors_equal (old_colors, priv->symbolic_colors))
+    {
+      _ctk_style_provider_private_changed (CTK_STYLE_PROVIDER_PRIVATE (css_provider));
+      return;
+    }
+
+  old_kept = g_new0 (gboolean, old_rulesets->len);
+  new_kept = g_new0 (gboolean, priv->rulesets->len);
+
+  if (!ctk_css_provider_diff_rulesets (old_rulesets, priv->rulesets, old_kept, new_kept))
+    {
+      g_free (old_kept);
+      g_free (new_kept);
+      _ctk_style_provider_private_changed (CTK_STYLE_PROVIDER_PRIVATE (css_provider));
+      return;
+    }
+
+  /* The matches are never looked at, they just need to be non-NULL */
+  builder = _ctk_css_selector_tree_builder_new ();
+  n_changed = 0;
+  for (i = 0; i < old_rulesets->len; i++)
+    {
+      if (old_kept[i])
+        continue;
+
+      n_changed++;
+      _ctk_css_selector_tree_builder_add (builder,
+                                            g_array_index (old_rulesets, CtkCssRuleset, i).selector,
+                                            NULL,
+                                            css_provider);
+    }
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      if (new_kept[i])
+        continue;
+
+      n_changed++;
+      _ctk_css_selector_tree_builder_add (builder,
+                                            g_array_index (priv->rulesets, CtkCssRuleset, i).selector,
+                                            NULL,
+                                            css_provider);
+    }
+  selectors = _ctk_css_selector_tree_builder_build (builder);
+  _ctk_css_selector_tree_builder_free (builder);
+
+  CTK_NOTE (MISC, g_message ("CtkCssProvider %p: %u rulesets changed", css_provider, n_changed));
+
+  _ctk_style_provider_private_changed_selectors (CTK_STYLE_PROVIDER_PRIVATE (css_provider), selectors);
+
+  _ctk_css_selector_tree_free (selectors);
+  g_free (old_kept);
+  g_free (new_kept);
+}
+
 /**
  * ctk_css_provider_load_from_data:
  * @css_provider: a #CtkCssProvider
@@ -1833,12 +2798,18 @@ ctk_css_provider_load_from_data (CtkCssProvider  *css_provider,
                                  gssize           length,
                                  GError         **error)
 {
+  CtkCssProviderPrivate *priv;
+  GArray *old_rulesets;
+  GHashTable *old_colors;
   char *free_data;
   gboolean ret;
+  guint i;
 
   g_return_val_if_fail (CTK_IS_CSS_PROVIDER (css_provider), FALSE);
   g_return_val_if_fail (data != NULL, FALSE);
 
+  priv = css_provider->priv;
+
   if (length < 0)
     {
       length = strlen (data);
@@ -1850,13 +2821,41 @@ ctk_css_provider_load_from_data (CtkCssProvider  *css_provider,
       data = free_data;
     }
 
+  /* Keep the previous rulesets around to find out what changed */
+  if ((priv->keep_selectors || priv->rulesets->len == 0) &&
+      g_hash_table_size (priv->keyframes) == 0)
+    {
+      old_rulesets = priv->rulesets;
+      priv->rulesets = g_array_new (FALSE, FALSE, sizeof (CtkCssRuleset));
+      old_colors = priv->symbolic_colors;
+      priv->symbolic_colors = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                     (GDestroyNotify) g_free,
+                                                     (GDestroyNotify) _ctk_css_value_unref);
+    }
+  else
+    {
+      old_rulesets = NULL;
+      old_colors = NULL;
+    }
+
   ctk_css_provider_reset (css_provider);
+  priv->keep_selectors = TRUE;
 
   ret = ctk_css_provider_load_internal (css_provider, NULL, NULL, data, error);
 
   g_free (free_data);
 
-  _ctk_style_provider_private_changed (CTK_STYLE_PROVIDER_PRIVATE (css_provider));
+  if (old_rulesets)
+    {
+      ctk_css_provider_changed_from (css_provider, old_rulesets, old_colors);
+
+      for (i = 0; i < old_rulesets->len; i++)
+        ctk_css_ruleset_clear (&g_array_index (old_rulesets, CtkCssRuleset, i));
+      g_array_free (old_rulesets, TRUE);
+      g_hash_table_unref (old_colors);
+    }
+  else
+    _ctk_style_provider_private_changed (CTK_STYLE_PROVIDER_PRIVATE (css_provider));
 
   return ret;
 }
@@ -1941,16 +2940,12 @@ ctk_css_provider_load_from_path (CtkCssProvider  *css_provider,
  *
  * Since: 3.16
  */
-void
-ctk_css_provider_load_from_resource (CtkCssProvider *css_provider,
-			             const gchar    *resource_path)
+static GFile *
+ctk_css_provider_file_for_resource (const gchar *resource_path)
 {
   GFile *file;
   gchar *uri, *escaped;
 
-  g_return_if_fail (CTK_IS_CSS_PROVIDER (css_provider));
-  g_return_if_fail (resource_path != NULL);
-
   escaped = g_uri_escape_string (resource_path,
 				 G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
   uri = g_strconcat ("resource://", escaped, NULL);
@@ -1959,6 +2954,20 @@ ctk_css_provider_load_from_resource (CtkCssProvider *css_provider,
   file = g_file_new_for_uri (uri);
   g_free (uri);
 
+  return file;
+}
+
+void
+ctk_css_provider_load_from_resource (CtkCssProvider *css_provider,
+			             const gchar    *resource_path)
+{
+  GFile *file;
+
+  g_return_if_fail (CTK_IS_CSS_PROVIDER (css_provider));
+  g_return_if_fail (resource_path != NULL);
+
+  file = ctk_css_provider_file_for_resource (resource_path);
+
   ctk_css_provider_load_from_file (css_provider, file, NULL);
 
   g_object_unref (file);
@@ -2142,7 +3151,11 @@ _ctk_css_provider_load_named (CtkCssProvider *provider,
 
   if (g_resources_get_info (resource_path, 0, NULL, NULL, NULL))
     {
-      ctk_css_provider_load_from_resource (provider, resource_path);
+      GFile *file;
+
+      file = ctk_css_provider_file_for_resource (resource_path);
+      ctk_css_provider_load_theme (provider, file);
+      g_object_unref (file);
       g_free (resource_path);
       return;
     }
@@ -2154,6 +3167,7 @@ _ctk_css_provider_load_named (CtkCssProvider *provider,
     {
       char *dir, *resource_file;
       GResource *resource;
+      GFile *file;
 
       dir = g_path_get_dirname (path);
       resource_file = g_build_filename (dir, "ctk.gresource", NULL);
@@ -2163,9 +3177,11 @@ _ctk_css_provider_load_named (CtkCssProvider *provider,
       if (resource != NULL)
         g_resources_register (resource);
 
-      ctk_css_provider_load_from_path (provider, path, NULL);
+      file = g_file_new_for_path (path);
+      ctk_css_provider_load_theme (provider, file);
+      g_object_unref (file);
 
-      /* Only set this after load, as load_from_path will clear it */
+      /* Only set this after load, as loading will clear it */
       provider->priv->resource = resource;
       provider->priv->path = dir;
 
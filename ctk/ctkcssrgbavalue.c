@@ -50,6 +50,12 @@ ctk_css_value_rgba_equal (const CtkCssValue *rgba1,
   return cdk_rgba_equal (&rgba1->rgba, &rgba2->rgba);
 }
 
+static guint
+ctk_css_value_rgba_hash (const CtkCssValue *rgba)
+{
+  return cdk_rgba_hash (&rgba->rgba);
+}
+
 static inline double
 transition (double start,
             double end,
@@ -102,7 +108,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_RGBA = {
   ctk_css_value_rgba_compute,
   ctk_css_value_rgba_equal,
   ctk_css_value_rgba_transition,
-  ctk_css_value_rgba_print
+  ctk_css_value_rgba_print,
+  ctk_css_value_rgba_hash
 };
 
 CtkCssValue *
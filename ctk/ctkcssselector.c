@@ -22,6 +22,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "ctkcsscacheprivate.h"
+#include "ctkcssnodeprivate.h"
 #include "ctkcssprovider.h"
 #include "ctkstylecontextprivate.h"
 
@@ -1433,6 +1435,22 @@ _ctk_css_selector_compare (const CtkCssSelector *a,
   return a_elements - b_elements;
 }
 
+gboolean
+_ctk_css_selector_equal (const CtkCssSelector *a,
+                         const CtkCssSelector *b)
+{
+  while (a && b)
+    {
+      if (!ctk_css_selector_equal (a, b))
+        return FALSE;
+
+      a = ctk_css_selector_previous (a);
+      b = ctk_css_selector_previous (b);
+    }
+
+  return a == b;
+}
+
 CtkCssChange
 _ctk_css_selector_get_change (const CtkCssSelector *selector)
 {
@@ -1512,23 +1530,106 @@ ctk_css_selectors_skip_initial_selector (CtkCssSelector *selector, const CtkCssS
   return (CtkCssSelector *)ctk_css_selector_previous (selector);
 }
 
+typedef struct {
+  GPtrArray               *array;
+  const CtkCssBloomFilter *filter;
+  guint                    n_checks;
+  guint                    n_rejects;
+} CtkCssSelectorTreeMatch;
+
+/* The filter of the ancestors of the nodes currently being validated */
+static const CtkCssBloomFilter *ancestor_filter;
+
+/* Matching may happen on multiple threads, see ctkcssnode.c */
+static guint n_descendant_checks;
+static guint n_descendant_rejects;
+
+void
+_ctk_css_selector_tree_set_ancestor_filter (const CtkCssBloomFilter *filter)
+{
+  ancestor_filter = filter;
+}
+
+const CtkCssBloomFilter *
+_ctk_css_selector_tree_get_ancestor_filter (void)
+{
+  return ancestor_filter;
+}
+
+void
+_ctk_css_selector_tree_get_filter_counts (guint64 *n_checks,
+                                          guint64 *n_rejects)
+{
+  *n_checks = (guint) g_atomic_int_get (&n_descendant_checks);
+  *n_rejects = (guint) g_atomic_int_get (&n_descendant_rejects);
+}
+
+static gboolean
+ctk_css_selector_tree_may_match_ancestor (const CtkCssSelectorTree *tree,
+                                          const CtkCssBloomFilter  *filter)
+{
+  const CtkCssSelector *selector = &tree->selector;
+
+  if (selector->class == &CTK_CSS_SELECTOR_NAME)
+    return ctk_css_bloom_filter_may_contain (filter, GPOINTER_TO_SIZE (selector->name.name));
+  else if (selector->class == &CTK_CSS_SELECTOR_CLASS)
+    return ctk_css_bloom_filter_may_contain (filter, selector->style_class.style_class);
+  else if (selector->class == &CTK_CSS_SELECTOR_ID)
+    return ctk_css_bloom_filter_may_contain (filter, GPOINTER_TO_SIZE (selector->id.name));
+  else
+    return TRUE;
+}
+
+/* Checks if none of the selectors required of an ancestor by the
+ * descendant combinator @tree can match any ancestor. */
+static gboolean
+ctk_css_selector_tree_reject_descendant (const CtkCssSelectorTree *tree,
+                                         CtkCssSelectorTreeMatch  *match)
+{
+  const CtkCssSelectorTree *prev;
+
+  if (match->filter == NULL ||
+      tree->selector.class != &CTK_CSS_SELECTOR_DESCENDANT)
+    return FALSE;
+
+  match->n_checks++;
+
+  for (prev = ctk_css_selector_tree_get_previous (tree);
+       prev != NULL;
+       prev = ctk_css_selector_tree_get_sibling (prev))
+    {
+      if (ctk_css_selector_tree_may_match_ancestor (prev, match->filter))
+        return FALSE;
+    }
+
+  match->n_rejects++;
+
+  return TRUE;
+}
+
 static gboolean
 ctk_css_selector_tree_match_foreach (const CtkCssSelector *selector,
                                      const CtkCssMatcher  *matcher,
                                      gpointer              res)
 {
   const CtkCssSelectorTree *tree = (const CtkCssSelectorTree *) selector;
+  CtkCssSelectorTreeMatch *match = res;
   const CtkCssSelectorTree *prev;
 
   if (!ctk_css_selector_match (selector, matcher))
     return FALSE;
 
-  ctk_css_selector_tree_found_match (tree, res);
+  ctk_css_selector_tree_found_match (tree, &match->array);
 
   for (prev = ctk_css_selector_tree_get_previous (tree);
        prev != NULL;
        prev = ctk_css_selector_tree_get_sibling (prev))
-    ctk_css_selector_foreach (&prev->selector, matcher, ctk_css_selector_tree_match_foreach, res);
+    {
+      if (ctk_css_selector_tree_reject_descendant (prev, match))
+        continue;
+
+      ctk_css_selector_foreach (&prev->selector, matcher, ctk_css_selector_tree_match_foreach, res);
+    }
 
   return FALSE;
 }
@@ -1537,13 +1638,26 @@ GPtrArray *
 _ctk_css_selector_tree_match_all (const CtkCssSelectorTree *tree,
 				  const CtkCssMatcher *matcher)
 {
-  GPtrArray *array = NULL;
+  CtkCssSelectorTreeMatch match = { NULL, NULL, 0, 0 };
+
+  /* The filter only knows the ancestors of the nodes being validated,
+   * as seen by node matchers. */
+  if (ancestor_filter != NULL &&
+      _ctk_css_matcher_is_node (matcher) &&
+      ctk_css_node_get_parent (matcher->node.node) == ancestor_filter->node)
+    match.filter = ancestor_filter;
 
   for (; tree != NULL;
        tree = ctk_css_selector_tree_get_sibling (tree))
-    ctk_css_selector_foreach (&tree->selector, matcher, ctk_css_selector_tree_match_foreach, &array);
+    ctk_css_selector_foreach (&tree->selector, matcher, ctk_css_selector_tree_match_foreach, &match);
+
+  if (match.n_checks)
+    {
+      g_atomic_int_add (&n_descendant_checks, match.n_checks);
+      g_atomic_int_add (&n_descendant_rejects, match.n_rejects);
+    }
 
-  return array;
+  return match.array;
 }
 
 /* When checking for changes via the tree we need to know if a rule further
@@ -1614,6 +1728,24 @@ _ctk_css_selector_tree_get_change_all (const CtkCssSelectorTree *tree,
   return change & ~CTK_CSS_CHANGE_RESERVED_BIT;
 }
 
+/* Checks if any selector in @tree may match the node described by
+ * @matcher. Use a superset matcher to also catch selectors that only
+ * match in other states.
+ */
+gboolean
+_ctk_css_selector_tree_may_match (const CtkCssSelectorTree *tree,
+                                  const CtkCssMatcher      *matcher)
+{
+  for (; tree != NULL;
+       tree = ctk_css_selector_tree_get_sibling (tree))
+    {
+      if (ctk_css_selector_tree_get_change (tree, matcher))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 #ifdef PRINT_TREE
 static void
 _ctk_css_selector_tree_print (const CtkCssSelectorTree *tree, GString *str, char *prefix)
@@ -1939,3 +2071,284 @@ _ctk_css_selector_tree_builder_build (CtkCssSelectorTreeBuilder *builder)
 
   return tree;
 }
+
+/******************** SelectorTree caching *****************/
+
+/* The on-disk cache stores the tree structurally, not as a memory dump:
+ * selector classes are referenced by their index in this table, names and
+ * style classes by their string and matches by the index the caller gives
+ * them, so the result is independent of addresses and pointer size.
+ */
+static const CtkCssSelectorClass *selector_classes[] = {
+  &CTK_CSS_SELECTOR_DESCENDANT,
+  &CTK_CSS_SELECTOR_CHILD,
+  &CTK_CSS_SELECTOR_SIBLING,
+  &CTK_CSS_SELECTOR_ADJACENT,
+  &CTK_CSS_SELECTOR_ANY,
+  &CTK_CSS_SELECTOR_NOT_ANY,
+  &CTK_CSS_SELECTOR_NAME,
+  &CTK_CSS_SELECTOR_NOT_NAME,
+  &CTK_CSS_SELECTOR_CLASS,
+  &CTK_CSS_SELECTOR_NOT_CLASS,
+  &CTK_CSS_SELECTOR_ID,
+  &CTK_CSS_SELECTOR_NOT_ID,
+  &CTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &CTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &CTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &CTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION
+};
+
+static guint
+ctk_css_selector_class_get_index (const CtkCssSelectorClass *class)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (selector_classes); i++)
+    {
+      if (selector_classes[i] == class)
+        return i;
+    }
+
+  g_assert_not_reached ();
+  return 0;
+}
+
+static void
+ctk_css_selector_tree_save_list (const CtkCssSelectorTree *tree,
+                                 GByteArray               *bytes,
+                                 GHashTable               *match_indices)
+{
+  const CtkCssSelectorTree *iter;
+  const CtkCssSelector *selector;
+  gpointer *matches;
+  guint i, n;
+
+  n = 0;
+  for (iter = tree; iter != NULL; iter = ctk_css_selector_tree_get_sibling (iter))
+    n++;
+  ctk_css_cache_write_uint32 (bytes, n);
+
+  for (iter = tree; iter != NULL; iter = ctk_css_selector_tree_get_sibling (iter))
+    {
+      selector = &iter->selector;
+      ctk_css_cache_write_uint32 (bytes, ctk_css_selector_class_get_index (selector->class));
+
+      if (selector->class == &CTK_CSS_SELECTOR_NAME ||
+          selector->class == &CTK_CSS_SELECTOR_NOT_NAME)
+        ctk_css_cache_write_string (bytes, selector->name.name);
+      else if (selector->class == &CTK_CSS_SELECTOR_ID ||
+               selector->class == &CTK_CSS_SELECTOR_NOT_ID)
+        ctk_css_cache_write_string (bytes, selector->id.name);
+      else if (selector->class == &CTK_CSS_SELECTOR_CLASS ||
+               selector->class == &CTK_CSS_SELECTOR_NOT_CLASS)
+        ctk_css_cache_write_string (bytes, g_quark_to_string (selector->style_class.style_class));
+      else if (selector->class == &CTK_CSS_SELECTOR_PSEUDOCLASS_STATE ||
+               selector->class == &CTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        ctk_css_cache_write_uint32 (bytes, selector->state.state);
+      else if (selector->class == &CTK_CSS_SELECTOR_PSEUDOCLASS_POSITION ||
+               selector->class == &CTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION)
+        {
+          ctk_css_cache_write_uint32 (bytes, selector->position.type);
+          ctk_css_cache_write_int64 (bytes, selector->position.a);
+          ctk_css_cache_write_int64 (bytes, selector->position.b);
+        }
+
+      matches = ctk_css_selector_tree_get_matches (iter);
+      n = 0;
+      if (matches)
+        {
+          while (matches[n] != NULL)
+            n++;
+        }
+      ctk_css_cache_write_uint32 (bytes, n);
+      for (i = 0; i < n; i++)
+        ctk_css_cache_write_uint32 (bytes, GPOINTER_TO_UINT (g_hash_table_lookup (match_indices, matches[i])));
+
+      ctk_css_selector_tree_save_list (ctk_css_selector_tree_get_previous (iter), bytes, match_indices);
+    }
+}
+
+/**
+ * _ctk_css_selector_tree_save:
+ * @tree: (allow-none): the tree to save
+ * @bytes: array to append the serialized tree to
+ * @match_indices: maps every match pointer of @tree to an index
+ *
+ * Serializes @tree for CtkCssProvider's disk cache. Use
+ * _ctk_css_selector_tree_load() with a matches array ordered
+ * by the same indices to recreate it.
+ **/
+void
+_ctk_css_selector_tree_save (const CtkCssSelectorTree *tree,
+                             GByteArray               *bytes,
+                             GHashTable               *match_indices)
+{
+  ctk_css_selector_tree_save_list (tree, bytes, match_indices);
+}
+
+typedef struct {
+  gint32 tree_offset;
+  guint  match;
+} CtkCssSelectorTreeLoadMatch;
+
+static gint32
+ctk_css_selector_tree_load_list (CtkCssCacheReader *reader,
+                                 GByteArray        *array,
+                                 gint32             parent_offset,
+                                 gpointer          *matches,
+                                 guint              n_matches,
+                                 GArray            *loaded_matches)
+{
+  CtkCssSelectorTree *tree;
+  gint32 first_offset, last_offset, tree_offset, res;
+  guint i, j, n, n_tree_matches, index;
+  const char *name;
+
+  first_offset = last_offset = CTK_CSS_SELECTOR_TREE_EMPTY_OFFSET;
+
+  n = ctk_css_cache_read_uint32 (reader);
+  for (i = 0; i < n && !reader->failed; i++)
+    {
+      tree = alloc_tree (array, &tree_offset);
+      tree->parent_offset = parent_offset;
+      tree->previous_offset = CTK_CSS_SELECTOR_TREE_EMPTY_OFFSET;
+      tree->sibling_offset = CTK_CSS_SELECTOR_TREE_EMPTY_OFFSET;
+      tree->matches_offset = CTK_CSS_SELECTOR_TREE_EMPTY_OFFSET;
+
+      index = ctk_css_cache_read_uint32 (reader);
+      if (index >= G_N_ELEMENTS (selector_classes))
+        {
+          reader->failed = TRUE;
+          break;
+        }
+      tree->selector.class = selector_classes[index];
+
+      if (tree->selector.class == &CTK_CSS_SELECTOR_NAME ||
+          tree->selector.class == &CTK_CSS_SELECTOR_NOT_NAME)
+        {
+          name = ctk_css_cache_read_string (reader);
+          tree->selector.name.name = name ? g_intern_string (name) : NULL;
+        }
+      else if (tree->selector.class == &CTK_CSS_SELECTOR_ID ||
+               tree->selector.class == &CTK_CSS_SELECTOR_NOT_ID)
+        {
+          name = ctk_css_cache_read_string (reader);
+          tree->selector.id.name = name ? g_intern_string (name) : NULL;
+        }
+      else if (tree->selector.class == &CTK_CSS_SELECTOR_CLASS ||
+               tree->selector.class == &CTK_CSS_SELECTOR_NOT_CLASS)
+        {
+          name = ctk_css_cache_read_string (reader);
+          tree->selector.style_class.style_class = name ? g_quark_from_string (name) : 0;
+        }
+      else if (tree->selector.class == &CTK_CSS_SELECTOR_PSEUDOCLASS_STATE ||
+               tree->selector.class == &CTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        {
+          tree->selector.state.state = ctk_css_cache_read_uint32 (reader);
+        }
+      else if (tree->selector.class == &CTK_CSS_SELECTOR_PSEUDOCLASS_POSITION ||
+               tree->selector.class == &CTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION)
+        {
+          tree->selector.position.type = ctk_css_cache_read_uint32 (reader);
+          tree->selector.position.a = ctk_css_cache_read_int64 (reader);
+          tree->selector.position.b = ctk_css_cache_read_int64 (reader);
+        }
+
+      n_tree_matches = ctk_css_cache_read_uint32 (reader);
+      if (n_tree_matches > 0)
+        {
+          gpointer end = NULL;
+
+          res = array->len;
+          for (j = 0; j < n_tree_matches; j++)
+            {
+              CtkCssSelectorTreeLoadMatch match;
+
+              index = ctk_css_cache_read_uint32 (reader);
+              if (reader->failed || index >= n_matches)
+                {
+                  reader->failed = TRUE;
+                  break;
+                }
+
+              g_byte_array_append (array, (guint8 *) &matches[index], sizeof (gpointer));
+
+              match.tree_offset = tree_offset;
+              match.match = index;
+              g_array_append_val (loaded_matches, match);
+            }
+          g_byte_array_append (array, (guint8 *) &end, sizeof (gpointer));
+          get_tree (array, tree_offset)->matches_offset = res;
+        }
+
+      res = ctk_css_selector_tree_load_list (reader, array, tree_offset, matches, n_matches, loaded_matches);
+      get_tree (array, tree_offset)->previous_offset = res;
+
+      if (last_offset == CTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+        first_offset = tree_offset;
+      else
+        get_tree (array, last_offset)->sibling_offset = tree_offset;
+      last_offset = tree_offset;
+    }
+
+  return first_offset;
+}
+
+/**
+ * _ctk_css_selector_tree_load:
+ * @reader: reader positioned at a tree written by _ctk_css_selector_tree_save()
+ * @matches: (array length=n_matches): the match pointers, by index
+ * @selector_matches: (array length=n_matches): where to store the tree node
+ *   for each match, like the @selector_match argument of
+ *   _ctk_css_selector_tree_builder_add()
+ * @n_matches: number of matches
+ *
+ * Recreates a tree saved with _ctk_css_selector_tree_save(). If the data
+ * is corrupt, @reader is marked as failed and %NULL is returned.
+ *
+ * Returns: the tree, free it with _ctk_css_selector_tree_free()
+ **/
+CtkCssSelectorTree *
+_ctk_css_selector_tree_load (CtkCssCacheReader   *reader,
+                             gpointer            *matches,
+                             CtkCssSelectorTree **selector_matches[],
+                             guint                n_matches)
+{
+  CtkCssSelectorTree *tree;
+  GByteArray *array;
+  GArray *loaded_matches;
+  guint8 *data;
+  guint i, len;
+
+  array = g_byte_array_new ();
+  loaded_matches = g_array_new (FALSE, FALSE, sizeof (CtkCssSelectorTreeLoadMatch));
+
+  ctk_css_selector_tree_load_list (reader, array, CTK_CSS_SELECTOR_TREE_EMPTY_OFFSET,
+                                   matches, n_matches, loaded_matches);
+
+  if (reader->failed || array->len == 0)
+    {
+      g_byte_array_free (array, TRUE);
+      g_array_free (loaded_matches, TRUE);
+      return NULL;
+    }
+
+  len = array->len;
+  data = g_byte_array_free (array, FALSE);
+  data = g_realloc (data, len);
+
+  tree = (CtkCssSelectorTree *) data;
+
+  fixup_offsets (tree, data);
+
+  for (i = 0; i < loaded_matches->len; i++)
+    {
+      CtkCssSelectorTreeLoadMatch *match = &g_array_index (loaded_matches, CtkCssSelectorTreeLoadMatch, i);
+
+      *selector_matches[match->match] = (CtkCssSelectorTree *) (data + match->tree_offset);
+    }
+
+  g_array_free (loaded_matches, TRUE);
+
+  return tree;
+}
@@ -18,6 +18,8 @@
 #ifndef __CTK_CSS_SELECTOR_PRIVATE_H__
 #define __CTK_CSS_SELECTOR_PRIVATE_H__
 
+#include "ctk/ctkcssbloomfilterprivate.h"
+#include "ctk/ctkcsscacheprivate.h"
 #include "ctk/ctkcssmatcherprivate.h"
 #include "ctk/ctkcssparserprivate.h"
 
@@ -39,15 +41,25 @@ gboolean          _ctk_css_selector_matches         (const CtkCssSelector   *sel
 CtkCssChange      _ctk_css_selector_get_change      (const CtkCssSelector   *selector);
 int               _ctk_css_selector_compare         (const CtkCssSelector   *a,
                                                      const CtkCssSelector   *b);
+gboolean          _ctk_css_selector_equal           (const CtkCssSelector   *a,
+                                                     const CtkCssSelector   *b);
 
 void         _ctk_css_selector_tree_free             (CtkCssSelectorTree       *tree);
 GPtrArray *  _ctk_css_selector_tree_match_all        (const CtkCssSelectorTree *tree,
 						      const CtkCssMatcher      *matcher);
 CtkCssChange _ctk_css_selector_tree_get_change_all   (const CtkCssSelectorTree *tree,
 						      const CtkCssMatcher *matcher);
+gboolean     _ctk_css_selector_tree_may_match        (const CtkCssSelectorTree *tree,
+						      const CtkCssMatcher      *matcher);
 void         _ctk_css_selector_tree_match_print      (const CtkCssSelectorTree *tree,
 						      GString                  *str);
 
+void         _ctk_css_selector_tree_set_ancestor_filter (const CtkCssBloomFilter *filter);
+const CtkCssBloomFilter *
+             _ctk_css_selector_tree_get_ancestor_filter (void);
+void         _ctk_css_selector_tree_get_filter_counts   (guint64                 *n_checks,
+                                                         guint64                 *n_rejects);
+
 
 CtkCssSelectorTreeBuilder *_ctk_css_selector_tree_builder_new   (void);
 void                       _ctk_css_selector_tree_builder_add   (CtkCssSelectorTreeBuilder *builder,
@@ -57,6 +69,14 @@ void                       _ctk_css_selector_tree_builder_add   (CtkCssSelectorT
 CtkCssSelectorTree *       _ctk_css_selector_tree_builder_build (CtkCssSelectorTreeBuilder *builder);
 void                       _ctk_css_selector_tree_builder_free  (CtkCssSelectorTreeBuilder *builder);
 
+void                _ctk_css_selector_tree_save (const CtkCssSelectorTree   *tree,
+                                                 GByteArray                 *bytes,
+                                                 GHashTable                 *match_indices);
+CtkCssSelectorTree *_ctk_css_selector_tree_load (CtkCssCacheReader          *reader,
+                                                 gpointer                   *matches,
+                                                 CtkCssSelectorTree        **selector_matches[],
+                                                 guint                       n_matches);
+
 const char *ctk_css_pseudoclass_name (CtkStateFlags flags);
 
 G_END_DECLS
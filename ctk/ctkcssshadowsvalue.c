@@ -113,6 +113,18 @@ ctk_css_value_shadows_equal (const CtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+ctk_css_value_shadows_hash (const CtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->len;
+  for (i = 0; i < value->len; i++)
+    hash = (hash << 5) - hash + _ctk_css_value_hash (value->values[i]);
+
+  return hash;
+}
+
 static CtkCssValue *
 ctk_css_value_shadows_transition (CtkCssValue *start,
                                   CtkCssValue *end,
@@ -204,7 +216,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_SHADOWS = {
   ctk_css_value_shadows_compute,
   ctk_css_value_shadows_equal,
   ctk_css_value_shadows_transition,
-  ctk_css_value_shadows_print
+  ctk_css_value_shadows_print,
+  ctk_css_value_shadows_hash
 };
 
 static CtkCssValue none_singleton = { &CTK_CSS_VALUE_SHADOWS, 1, 0, { NULL } };
@@ -28,11 +28,13 @@
 #include "ctkstylecontextprivate.h"
 #include "ctkrenderprivate.h"
 #include "ctkpango.h"
+#include "ctkrendercacheprivate.h"
 
 #include "fallback-c89.c"
 #include <float.h>
 
-#define CORNER_MASK_CACHE_MAX_SIZE 2000U
+#define PANGO_SHADOW_CACHE_SIZE (4 * 1024 * 1024)
+#define CORNER_MASK_CACHE_SIZE (2 * 1024 * 1024)
 
 struct _CtkCssValue {
   CTK_CSS_VALUE_BASE
@@ -110,6 +112,20 @@ ctk_css_value_shadow_equal (const CtkCssValue *shadow1,
       && _ctk_css_value_equal (shadow1->color, shadow2->color);
 }
 
+static guint
+ctk_css_value_shadow_hash (const CtkCssValue *shadow)
+{
+  guint hash;
+
+  hash = _ctk_css_value_hash (shadow->hoffset);
+  hash = (hash << 5) - hash + _ctk_css_value_hash (shadow->voffset);
+  hash = (hash << 5) - hash + _ctk_css_value_hash (shadow->radius);
+  hash = (hash << 5) - hash + _ctk_css_value_hash (shadow->spread);
+  hash = (hash << 5) - hash + _ctk_css_value_hash (shadow->color);
+
+  return hash ^ shadow->inset;
+}
+
 static CtkCssValue *
 ctk_css_value_shadow_transition (CtkCssValue *start,
                                  CtkCssValue *end,
@@ -160,7 +176,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_SHADOW = {
   ctk_css_value_shadow_compute,
   ctk_css_value_shadow_equal,
   ctk_css_value_shadow_transition,
-  ctk_css_value_shadow_print
+  ctk_css_value_shadow_print,
+  ctk_css_value_shadow_hash
 };
 
 static CtkCssValue *
@@ -433,33 +450,81 @@ ctk_css_shadow_value_finish_drawing (const CtkCssValue *shadow,
   return original_cr;
 }
 
-static const cairo_user_data_key_t radius_key;
-static const cairo_user_data_key_t layout_serial_key;
+/* Blurred text is cached per layout. The layout serial changes
+ * whenever the layout does, so stale surfaces are never used. */
+typedef struct {
+  PangoLayout *layout;
+  guint        serial;
+  double       radius;
+  double       x_scale;
+  double       y_scale;
+} PangoShadowKey;
+
+static CtkRenderCache *pango_shadow_cache;
 
 G_DEFINE_QUARK (CtkCssShadowValue pango_cached_blurred_surface, pango_cached_blurred_surface)
 
-static cairo_surface_t *
-get_cached_pango_surface (PangoLayout       *layout,
-                          const CtkCssValue *shadow)
+static guint
+pango_shadow_key_hash (gconstpointer item)
 {
-  cairo_surface_t *cached_surface = g_object_get_qdata (G_OBJECT (layout), pango_cached_blurred_surface_quark ());
-  guint cached_radius, cached_serial;
-  guint radius, serial;
+  const PangoShadowKey *key = item;
 
-  if (!cached_surface)
-    return NULL;
+  return g_direct_hash (key->layout) ^ key->serial << 8;
+}
 
-  radius = _ctk_css_number_value_get (shadow->radius, 0);
-  cached_radius = GPOINTER_TO_UINT (cairo_surface_get_user_data (cached_surface, &radius_key));
-  if (radius != cached_radius)
-    return NULL;
+static gboolean
+pango_shadow_key_equal (gconstpointer item1,
+                        gconstpointer item2)
+{
+  const PangoShadowKey *key1 = item1;
+  const PangoShadowKey *key2 = item2;
+
+  return key1->layout == key2->layout &&
+         key1->serial == key2->serial &&
+         key1->radius == key2->radius &&
+         key1->x_scale == key2->x_scale &&
+         key1->y_scale == key2->y_scale;
+}
 
-  serial = pango_layout_get_serial (layout);
-  cached_serial = GPOINTER_TO_UINT (cairo_surface_get_user_data (cached_surface, &layout_serial_key));
-  if (serial != cached_serial)
-    return NULL;
+static CtkRenderCache *
+get_pango_shadow_cache (void)
+{
+  if (pango_shadow_cache == NULL)
+    pango_shadow_cache = ctk_render_cache_new ("Text shadows",
+                                               PANGO_SHADOW_CACHE_SIZE,
+                                               pango_shadow_key_hash,
+                                               pango_shadow_key_equal,
+                                               g_free);
+
+  return pango_shadow_cache;
+}
 
-  return cached_surface;
+static gboolean
+pango_shadow_key_has_layout (gpointer key,
+                             gpointer value,
+                             gpointer layout)
+{
+  return ((PangoShadowKey *) key)->layout == layout;
+}
+
+static gboolean
+pango_shadow_key_is_outdated (gpointer key,
+                              gpointer value,
+                              gpointer current)
+{
+  const PangoShadowKey *key1 = key;
+  const PangoShadowKey *key2 = current;
+
+  return key1->layout == key2->layout &&
+         key1->serial != key2->serial;
+}
+
+/* Called when the layout is finalized, so no later layout at the same
+ * address can pick up its surfaces */
+static void
+forget_pango_layout (gpointer layout)
+{
+  ctk_render_cache_remove_matching (pango_shadow_cache, pango_shadow_key_has_layout, layout);
 }
 
 static cairo_surface_t *
@@ -503,25 +568,38 @@ get_blurred_pango_surface (cairo_t           *cr,
                            PangoLayout       *layout,
                            const CtkCssValue *shadow)
 {
+  CtkRenderCache *cache;
   cairo_surface_t *surface;
-  guint radius, serial;
+  PangoShadowKey key;
 
-  surface = get_cached_pango_surface (layout, shadow);
-  if (!surface)
-    {
-      surface = make_blurred_pango_surface (cr, layout, shadow);
+  cache = get_pango_shadow_cache ();
+
+  key.layout = layout;
+  key.serial = pango_layout_get_serial (layout);
+  key.radius = _ctk_css_number_value_get (shadow->radius, 0);
+  key.x_scale = key.y_scale = 1;
+  cairo_surface_get_device_scale (cairo_get_target (cr), &key.x_scale, &key.y_scale);
 
-      /* Cache the surface on the PangoLayout */
-      radius = _ctk_css_number_value_get (shadow->radius, 0);
-      cairo_surface_set_user_data (surface, &radius_key, GUINT_TO_POINTER (radius), NULL);
+  surface = ctk_render_cache_lookup (cache, &key);
+  if (surface)
+    return cairo_surface_reference (surface);
 
-      serial = pango_layout_get_serial (layout);
-      cairo_surface_set_user_data (surface, &layout_serial_key, GUINT_TO_POINTER (serial), NULL);
+  surface = make_blurred_pango_surface (cr, layout, shadow);
 
+  if (g_object_get_qdata (G_OBJECT (layout), pango_cached_blurred_surface_quark ()))
+    {
+      /* Surfaces from before the layout changed are of no use anymore,
+       * the ones for other radii or scales still are */
+      ctk_render_cache_remove_matching (cache, pango_shadow_key_is_outdated, &key);
+    }
+  else
+    {
       g_object_set_qdata_full (G_OBJECT (layout), pango_cached_blurred_surface_quark (),
-                               surface, (GDestroyNotify) cairo_surface_destroy);
+                               layout, forget_pango_layout);
     }
 
+  ctk_render_cache_insert (cache, g_memdup2 (&key, sizeof (key)), surface);
+
   return surface;
 }
 
@@ -553,6 +631,7 @@ _ctk_css_shadow_value_paint_layout (const CtkCssValue *shadow,
 
       cdk_cairo_set_source_rgba (cr, _ctk_css_rgba_value_get_rgba (shadow->color));
       cairo_mask_surface (cr, blurred_surface, 0, 0);
+      cairo_surface_destroy (blurred_surface);
     }
   else
     {
@@ -674,6 +753,8 @@ typedef struct {
   gint corner_vertical;
 } CornerMask;
 
+static CtkRenderCache *corner_mask_cache;
+
 static guint
 corner_mask_hash (CornerMask *mask)
 {
@@ -692,6 +773,19 @@ corner_mask_equal (CornerMask *mask1,
     mask1->corner_vertical == mask2->corner_vertical;
 }
 
+static CtkRenderCache *
+get_corner_mask_cache (void)
+{
+  if (corner_mask_cache == NULL)
+    corner_mask_cache = ctk_render_cache_new ("Shadow corners",
+                                              CORNER_MASK_CACHE_SIZE,
+                                              (GHashFunc) corner_mask_hash,
+                                              (GEqualFunc) corner_mask_equal,
+                                              g_free);
+
+  return corner_mask_cache;
+}
+
 static gint
 truncate_to_int (double val)
 {
@@ -733,7 +827,6 @@ draw_shadow_corner (const CtkCssValue   *shadow,
   cairo_pattern_t *pattern;
   cairo_matrix_t matrix;
   double sx, sy;
-  static GHashTable *corner_mask_cache = NULL;
   double max_other;
   CornerMask key;
   gboolean overlapped;
@@ -822,17 +915,16 @@ draw_shadow_corner (const CtkCssValue   *shadow,
    * mask, so we cache rendered masks based on the blur radius and the
    * corner radius.
    */
-  if (corner_mask_cache == NULL)
-    corner_mask_cache = g_hash_table_new_full ((GHashFunc)corner_mask_hash,
-                                               (GEqualFunc)corner_mask_equal,
-                                               g_free, (GDestroyNotify)cairo_surface_destroy);
-
   key.radius = quantize_to_int (radius);
   key.corner_horizontal = quantize_to_int (box->corner[corner].horizontal);
   key.corner_vertical = quantize_to_int (box->corner[corner].vertical);
 
-  mask = g_hash_table_lookup (corner_mask_cache, &key);
-  if (mask == NULL)
+  mask = ctk_render_cache_lookup (get_corner_mask_cache (), &key);
+  if (mask)
+    {
+      cairo_surface_reference (mask);
+    }
+  else
     {
       mask = cairo_surface_create_similar_image (cairo_get_target (cr), CAIRO_FORMAT_A8,
                                                  drawn_rect->width + clip_radius,
@@ -845,17 +937,7 @@ draw_shadow_corner (const CtkCssValue   *shadow,
       _ctk_cairo_blur_surface (mask, radius, CTK_BLUR_X | CTK_BLUR_Y);
       cairo_destroy (mask_cr);
 
-      if (g_hash_table_size (corner_mask_cache) >= CORNER_MASK_CACHE_MAX_SIZE)
-        {
-          GHashTableIter iter;
-          guint i = 0;
-
-          g_hash_table_iter_init (&iter, corner_mask_cache);
-          while (g_hash_table_iter_next (&iter, NULL, NULL))
-            if (i++ % 4 == 0)
-              g_hash_table_iter_remove (&iter);
-        }
-      g_hash_table_insert (corner_mask_cache, g_memdup2 (&key, sizeof (key)), mask);
+      ctk_render_cache_insert (corner_mask_cache, g_memdup2 (&key, sizeof (key)), mask);
     }
 
   cdk_cairo_set_source_rgba (cr, _ctk_css_rgba_value_get_rgba (shadow->color));
@@ -866,6 +948,7 @@ draw_shadow_corner (const CtkCssValue   *shadow,
   cairo_pattern_set_matrix (pattern, &matrix);
   cairo_mask (cr, pattern);
   cairo_pattern_destroy (pattern);
+  cairo_surface_destroy (mask);
 }
 
 static void
@@ -21,6 +21,8 @@
 
 #include "ctkcssstaticstyleprivate.h"
 
+#include <string.h>
+
 #include "ctkcssanimationprivate.h"
 #include "ctkcssarrayvalueprivate.h"
 #include "ctkcssenumvalueprivate.h"
@@ -33,6 +35,7 @@
 #include "ctkcssstylepropertyprivate.h"
 #include "ctkcsstransitionprivate.h"
 #include "ctkprivate.h"
+#include "ctkrenderboxprivate.h"
 #include "ctksettings.h"
 #include "ctkstyleanimationprivate.h"
 #include "ctkstylepropertyprivate.h"
@@ -40,11 +43,251 @@
 
 G_DEFINE_TYPE (CtkCssStaticStyle, ctk_css_static_style, CTK_TYPE_CSS_STYLE)
 
+struct _CtkCssValueGroup {
+  guint        ref_count;
+  guint        group :8;
+  guint        shared :1;
+  guint        cached :1;
+  CtkCssValue *values[1];
+};
+
+static const guint core_properties[] = {
+  CTK_CSS_PROPERTY_COLOR,
+  CTK_CSS_PROPERTY_DPI,
+  CTK_CSS_PROPERTY_FONT_SIZE,
+  CTK_CSS_PROPERTY_FONT_FAMILY,
+  CTK_CSS_PROPERTY_FONT_STYLE,
+  CTK_CSS_PROPERTY_FONT_VARIANT,
+  CTK_CSS_PROPERTY_FONT_WEIGHT,
+  CTK_CSS_PROPERTY_FONT_STRETCH,
+  CTK_CSS_PROPERTY_LETTER_SPACING,
+  CTK_CSS_PROPERTY_TEXT_DECORATION_LINE,
+  CTK_CSS_PROPERTY_TEXT_DECORATION_COLOR,
+  CTK_CSS_PROPERTY_TEXT_DECORATION_STYLE,
+  CTK_CSS_PROPERTY_TEXT_SHADOW,
+  CTK_CSS_PROPERTY_OPACITY,
+  CTK_CSS_PROPERTY_ENGINE,
+  CTK_CSS_PROPERTY_CTK_KEY_BINDINGS,
+  CTK_CSS_PROPERTY_CARET_COLOR,
+  CTK_CSS_PROPERTY_SECONDARY_CARET_COLOR,
+  CTK_CSS_PROPERTY_FONT_FEATURE_SETTINGS
+};
+
+static const guint size_properties[] = {
+  CTK_CSS_PROPERTY_MARGIN_TOP,
+  CTK_CSS_PROPERTY_MARGIN_LEFT,
+  CTK_CSS_PROPERTY_MARGIN_BOTTOM,
+  CTK_CSS_PROPERTY_MARGIN_RIGHT,
+  CTK_CSS_PROPERTY_PADDING_TOP,
+  CTK_CSS_PROPERTY_PADDING_LEFT,
+  CTK_CSS_PROPERTY_PADDING_BOTTOM,
+  CTK_CSS_PROPERTY_PADDING_RIGHT,
+  CTK_CSS_PROPERTY_MIN_WIDTH,
+  CTK_CSS_PROPERTY_MIN_HEIGHT
+};
+
+static const guint background_properties[] = {
+  CTK_CSS_PROPERTY_BACKGROUND_COLOR,
+  CTK_CSS_PROPERTY_BOX_SHADOW,
+  CTK_CSS_PROPERTY_BACKGROUND_CLIP,
+  CTK_CSS_PROPERTY_BACKGROUND_ORIGIN,
+  CTK_CSS_PROPERTY_BACKGROUND_SIZE,
+  CTK_CSS_PROPERTY_BACKGROUND_POSITION,
+  CTK_CSS_PROPERTY_BACKGROUND_REPEAT,
+  CTK_CSS_PROPERTY_BACKGROUND_IMAGE,
+  CTK_CSS_PROPERTY_BACKGROUND_BLEND_MODE
+};
+
+static const guint border_properties[] = {
+  CTK_CSS_PROPERTY_BORDER_TOP_STYLE,
+  CTK_CSS_PROPERTY_BORDER_TOP_WIDTH,
+  CTK_CSS_PROPERTY_BORDER_LEFT_STYLE,
+  CTK_CSS_PROPERTY_BORDER_LEFT_WIDTH,
+  CTK_CSS_PROPERTY_BORDER_BOTTOM_STYLE,
+  CTK_CSS_PROPERTY_BORDER_BOTTOM_WIDTH,
+  CTK_CSS_PROPERTY_BORDER_RIGHT_STYLE,
+  CTK_CSS_PROPERTY_BORDER_RIGHT_WIDTH,
+  CTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS,
+  CTK_CSS_PROPERTY_BORDER_TOP_RIGHT_RADIUS,
+  CTK_CSS_PROPERTY_BORDER_BOTTOM_RIGHT_RADIUS,
+  CTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS,
+  CTK_CSS_PROPERTY_BORDER_TOP_COLOR,
+  CTK_CSS_PROPERTY_BORDER_RIGHT_COLOR,
+  CTK_CSS_PROPERTY_BORDER_BOTTOM_COLOR,
+  CTK_CSS_PROPERTY_BORDER_LEFT_COLOR,
+  CTK_CSS_PROPERTY_BORDER_IMAGE_SOURCE,
+  CTK_CSS_PROPERTY_BORDER_IMAGE_REPEAT,
+  CTK_CSS_PROPERTY_BORDER_IMAGE_SLICE,
+  CTK_CSS_PROPERTY_BORDER_IMAGE_WIDTH
+};
+
+static const guint outline_properties[] = {
+  CTK_CSS_PROPERTY_OUTLINE_STYLE,
+  CTK_CSS_PROPERTY_OUTLINE_WIDTH,
+  CTK_CSS_PROPERTY_OUTLINE_OFFSET,
+  CTK_CSS_PROPERTY_OUTLINE_TOP_LEFT_RADIUS,
+  CTK_CSS_PROPERTY_OUTLINE_TOP_RIGHT_RADIUS,
+  CTK_CSS_PROPERTY_OUTLINE_BOTTOM_RIGHT_RADIUS,
+  CTK_CSS_PROPERTY_OUTLINE_BOTTOM_LEFT_RADIUS,
+  CTK_CSS_PROPERTY_OUTLINE_COLOR
+};
+
+static const guint icon_properties[] = {
+  CTK_CSS_PROPERTY_ICON_THEME,
+  CTK_CSS_PROPERTY_ICON_PALETTE,
+  CTK_CSS_PROPERTY_ICON_SOURCE,
+  CTK_CSS_PROPERTY_ICON_SHADOW,
+  CTK_CSS_PROPERTY_ICON_STYLE,
+  CTK_CSS_PROPERTY_ICON_TRANSFORM,
+  CTK_CSS_PROPERTY_ICON_EFFECT
+};
+
+static const guint animation_properties[] = {
+  CTK_CSS_PROPERTY_TRANSITION_PROPERTY,
+  CTK_CSS_PROPERTY_TRANSITION_DURATION,
+  CTK_CSS_PROPERTY_TRANSITION_TIMING_FUNCTION,
+  CTK_CSS_PROPERTY_TRANSITION_DELAY,
+  CTK_CSS_PROPERTY_ANIMATION_NAME,
+  CTK_CSS_PROPERTY_ANIMATION_DURATION,
+  CTK_CSS_PROPERTY_ANIMATION_TIMING_FUNCTION,
+  CTK_CSS_PROPERTY_ANIMATION_ITERATION_COUNT,
+  CTK_CSS_PROPERTY_ANIMATION_DIRECTION,
+  CTK_CSS_PROPERTY_ANIMATION_PLAY_STATE,
+  CTK_CSS_PROPERTY_ANIMATION_DELAY,
+  CTK_CSS_PROPERTY_ANIMATION_FILL_MODE
+};
+
+static const struct {
+  const guint *properties;
+  guint        n_properties;
+} value_groups[CTK_CSS_VALUE_GROUP_N_GROUPS] = {
+  [CTK_CSS_VALUE_GROUP_CORE] = { core_properties, G_N_ELEMENTS (core_properties) },
+  [CTK_CSS_VALUE_GROUP_SIZE] = { size_properties, G_N_ELEMENTS (size_properties) },
+  [CTK_CSS_VALUE_GROUP_BACKGROUND] = { background_properties, G_N_ELEMENTS (background_properties) },
+  [CTK_CSS_VALUE_GROUP_BORDER] = { border_properties, G_N_ELEMENTS (border_properties) },
+  [CTK_CSS_VALUE_GROUP_OUTLINE] = { outline_properties, G_N_ELEMENTS (outline_properties) },
+  [CTK_CSS_VALUE_GROUP_ICON] = { icon_properties, G_N_ELEMENTS (icon_properties) },
+  [CTK_CSS_VALUE_GROUP_ANIMATION] = { animation_properties, G_N_ELEMENTS (animation_properties) }
+};
+
+/* Maps property ids to their group and their index in the group */
+static guint8 property_group[CTK_CSS_PROPERTY_N_PROPERTIES];
+static guint8 property_index[CTK_CSS_PROPERTY_N_PROPERTIES];
+
+/* Groups that are shared between styles, not holding a reference */
+static GHashTable *shared_groups;
+
+static guint
+ctk_css_value_group_hash (gconstpointer item)
+{
+  const CtkCssValueGroup *group = item;
+  guint i, hash;
+
+  hash = group->group;
+  for (i = 0; i < value_groups[group->group].n_properties; i++)
+    hash = (hash << 5) - hash + g_direct_hash (group->values[i]);
+
+  return hash;
+}
+
+static gboolean
+ctk_css_value_group_equal (gconstpointer item1,
+                           gconstpointer item2)
+{
+  const CtkCssValueGroup *group1 = item1;
+  const CtkCssValueGroup *group2 = item2;
+
+  if (group1->group != group2->group)
+    return FALSE;
+
+  /* Computed values are interned, so comparing pointers finds
+   * almost all equal groups without calling into the values.
+   */
+  return memcmp (group1->values,
+                 group2->values,
+                 value_groups[group1->group].n_properties * sizeof (CtkCssValue *)) == 0;
+}
+
+static CtkCssValueGroup *
+ctk_css_value_group_new (guint group_id)
+{
+  CtkCssValueGroup *group;
+
+  group = g_malloc0 (sizeof (CtkCssValueGroup) +
+                     (value_groups[group_id].n_properties - 1) * sizeof (CtkCssValue *));
+  group->ref_count = 1;
+  group->group = group_id;
+
+  return group;
+}
+
+static CtkCssValueGroup *
+ctk_css_value_group_ref (CtkCssValueGroup *group)
+{
+  group->ref_count++;
+
+  return group;
+}
+
+static void
+ctk_css_value_group_unref (CtkCssValueGroup *group)
+{
+  guint i;
+
+  group->ref_count--;
+  if (group->ref_count > 0)
+    return;
+
+  if (group->shared)
+    g_hash_table_remove (shared_groups, group);
+  if (group->cached)
+    ctk_css_style_render_box_cache_evict (group);
+
+  for (i = 0; i < value_groups[group->group].n_properties; i++)
+    {
+      if (group->values[i])
+        _ctk_css_value_unref (group->values[i]);
+    }
+
+  g_free (group);
+}
+
+/* Replaces the freshly computed groups of @style with identical
+ * groups of other styles where possible. */
+static void
+ctk_css_static_style_share_groups (CtkCssStaticStyle *style)
+{
+  CtkCssValueGroup *shared;
+  guint i;
+
+  if (shared_groups == NULL)
+    shared_groups = g_hash_table_new (ctk_css_value_group_hash, ctk_css_value_group_equal);
+
+  for (i = 0; i < CTK_CSS_VALUE_GROUP_N_GROUPS; i++)
+    {
+      if (style->groups[i] == NULL)
+        continue;
+
+      shared = g_hash_table_lookup (shared_groups, style->groups[i]);
+      if (shared)
+        {
+          ctk_css_value_group_unref (style->groups[i]);
+          style->groups[i] = ctk_css_value_group_ref (shared);
+        }
+      else
+        {
+          style->groups[i]->shared = TRUE;
+          g_hash_table_add (shared_groups, style->groups[i]);
+        }
+    }
+}
+
 static CtkCssValue *
 ctk_css_static_style_get_value (CtkCssStyle *style,
                                 guint        id)
 {
   CtkCssStaticStyle *sstyle = CTK_CSS_STATIC_STYLE (style);
+  CtkCssValueGroup *group;
 
   if (G_UNLIKELY (id >= CTK_CSS_PROPERTY_N_PROPERTIES))
     {
@@ -53,7 +296,11 @@ ctk_css_static_style_get_value (CtkCssStyle *style,
       return _ctk_css_style_property_get_initial_value (prop);
     }
 
-  return sstyle->values[id];
+  group = sstyle->groups[property_group[id]];
+  if (group == NULL)
+    return NULL;
+
+  return group->values[property_index[id]];
 }
 
 static CtkCssSection *
@@ -75,11 +322,8 @@ ctk_css_static_style_dispose (GObject *object)
   CtkCssStaticStyle *style = CTK_CSS_STATIC_STYLE (object);
   guint i;
 
-  for (i = 0; i < CTK_CSS_PROPERTY_N_PROPERTIES; i++)
-    {
-      if (style->values[i])
-        _ctk_css_value_unref (style->values[i]);
-    }
+  for (i = 0; i < CTK_CSS_VALUE_GROUP_N_GROUPS; i++)
+    g_clear_pointer (&style->groups[i], ctk_css_value_group_unref);
   if (style->sections)
     {
       g_ptr_array_unref (style->sections);
@@ -94,11 +338,26 @@ ctk_css_static_style_class_init (CtkCssStaticStyleClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   CtkCssStyleClass *style_class = CTK_CSS_STYLE_CLASS (klass);
+  guint i, j, n_properties;
 
   object_class->dispose = ctk_css_static_style_dispose;
 
   style_class->get_value = ctk_css_static_style_get_value;
   style_class->get_section = ctk_css_static_style_get_section;
+
+  n_properties = 0;
+  for (i = 0; i < CTK_CSS_VALUE_GROUP_N_GROUPS; i++)
+    {
+      for (j = 0; j < value_groups[i].n_properties; j++)
+        {
+          property_group[value_groups[i].properties[j]] = i;
+          property_index[value_groups[i].properties[j]] = j;
+        }
+      n_properties += value_groups[i].n_properties;
+    }
+
+  /* Every property needs to be in exactly one group */
+  g_assert (n_properties == CTK_CSS_PROPERTY_N_PROPERTIES);
 }
 
 static void
@@ -119,9 +378,23 @@ ctk_css_static_style_set_value (CtkCssStaticStyle *style,
                                 CtkCssValue       *value,
                                 CtkCssSection     *section)
 {
-  if (style->values[id])
-    _ctk_css_value_unref (style->values[id]);
-  style->values[id] = _ctk_css_value_ref (value);
+  CtkCssValueGroup *group;
+  guint index;
+
+  group = style->groups[property_group[id]];
+  if (group == NULL)
+    {
+      group = ctk_css_value_group_new (property_group[id]);
+      style->groups[property_group[id]] = group;
+    }
+
+  /* Groups are only shared once the style is computed */
+  g_assert (!group->shared);
+
+  index = property_index[id];
+  if (group->values[index])
+    _ctk_css_value_unref (group->values[index]);
+  group->values[index] = _ctk_css_value_ref (value);
 
   if (style->sections && style->sections->len > id && g_ptr_array_index (style->sections, id))
     {
@@ -171,14 +444,18 @@ ctk_css_static_style_get_default (void)
   return default_style;
 }
 
-CtkCssStyle *
-ctk_css_static_style_new_compute (CtkStyleProviderPrivate *provider,
-                                  const CtkCssMatcher     *matcher,
-                                  CtkCssStyle             *parent)
+/* Looks up the specified values for @matcher. This only reads the
+ * style providers and the node tree and does not touch any reference
+ * counts, so it may run on other threads while the main thread waits.
+ */
+CtkCssLookup *
+ctk_css_static_style_lookup (CtkStyleProviderPrivate *provider,
+                             const CtkCssMatcher     *matcher,
+                             CtkCssChange            *change)
 {
-  CtkCssStaticStyle *result;
   CtkCssLookup *lookup;
-  CtkCssChange change = CTK_CSS_CHANGE_ANY_SELF | CTK_CSS_CHANGE_ANY_SIBLING | CTK_CSS_CHANGE_ANY_PARENT;
+
+  *change = CTK_CSS_CHANGE_ANY_SELF | CTK_CSS_CHANGE_ANY_SIBLING | CTK_CSS_CHANGE_ANY_PARENT;
 
   lookup = _ctk_css_lookup_new (NULL);
 
@@ -186,7 +463,19 @@ ctk_css_static_style_new_compute (CtkStyleProviderPrivate *provider,
     _ctk_style_provider_private_lookup (provider,
                                         matcher,
                                         lookup,
-                                        &change);
+                                        change);
+
+  return lookup;
+}
+
+/* Takes ownership of @lookup */
+CtkCssStyle *
+ctk_css_static_style_new_from_lookup (CtkStyleProviderPrivate *provider,
+                                      CtkCssLookup            *lookup,
+                                      CtkCssChange             change,
+                                      CtkCssStyle             *parent)
+{
+  CtkCssStaticStyle *result;
 
   result = g_object_new (CTK_TYPE_CSS_STATIC_STYLE, NULL);
 
@@ -199,9 +488,24 @@ ctk_css_static_style_new_compute (CtkStyleProviderPrivate *provider,
 
   _ctk_css_lookup_free (lookup);
 
+  ctk_css_static_style_share_groups (result);
+
   return CTK_CSS_STYLE (result);
 }
 
+CtkCssStyle *
+ctk_css_static_style_new_compute (CtkStyleProviderPrivate *provider,
+                                  const CtkCssMatcher     *matcher,
+                                  CtkCssStyle             *parent)
+{
+  CtkCssLookup *lookup;
+  CtkCssChange change;
+
+  lookup = ctk_css_static_style_lookup (provider, matcher, &change);
+
+  return ctk_css_static_style_new_from_lookup (provider, lookup, change, parent);
+}
+
 void
 ctk_css_static_style_compute_value (CtkCssStaticStyle       *style,
                                     CtkStyleProviderPrivate *provider,
@@ -235,6 +539,8 @@ ctk_css_static_style_compute_value (CtkCssStaticStyle       *style,
     _ctk_css_value_ref (specified);
 
   value = _ctk_css_value_compute (specified, id, provider, CTK_CSS_STYLE (style), parent_style);
+  /* Lots of styles compute the same colors and sizes, share them */
+  value = _ctk_css_value_intern (value);
 
   ctk_css_static_style_set_value (style, id, value, section);
 
@@ -249,3 +555,24 @@ ctk_css_static_style_get_change (CtkCssStaticStyle *style)
 
   return style->change;
 }
+
+/* Returns the group holding the values of @group_id. Equal groups are
+ * shared between styles, so the group identifies the values.
+ */
+CtkCssValueGroup *
+ctk_css_static_style_get_value_group (CtkCssStaticStyle  *style,
+                                      CtkCssValueGroupId  group_id)
+{
+  g_return_val_if_fail (CTK_IS_CSS_STATIC_STYLE (style), NULL);
+
+  return style->groups[group_id];
+}
+
+/* Marks @group as used as a key in the box render cache, so entries
+ * using it get dropped once no style holds the values anymore.
+ */
+void
+ctk_css_value_group_set_cached (CtkCssValueGroup *group)
+{
+  group->cached = TRUE;
+}
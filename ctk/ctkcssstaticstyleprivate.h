@@ -34,12 +34,26 @@ G_BEGIN_DECLS
 
 typedef struct _CtkCssStaticStyle           CtkCssStaticStyle;
 typedef struct _CtkCssStaticStyleClass      CtkCssStaticStyleClass;
+typedef struct _CtkCssValueGroup            CtkCssValueGroup;
+
+/* Properties are stored in groups of related properties, and styles
+ * with identical values for a group share it */
+typedef enum {
+  CTK_CSS_VALUE_GROUP_CORE,
+  CTK_CSS_VALUE_GROUP_SIZE,
+  CTK_CSS_VALUE_GROUP_BACKGROUND,
+  CTK_CSS_VALUE_GROUP_BORDER,
+  CTK_CSS_VALUE_GROUP_OUTLINE,
+  CTK_CSS_VALUE_GROUP_ICON,
+  CTK_CSS_VALUE_GROUP_ANIMATION,
+  CTK_CSS_VALUE_GROUP_N_GROUPS
+} CtkCssValueGroupId;
 
 struct _CtkCssStaticStyle
 {
   CtkCssStyle parent;
 
-  CtkCssValue           *values[CTK_CSS_PROPERTY_N_PROPERTIES]; /* the values */
+  CtkCssValueGroup      *groups[CTK_CSS_VALUE_GROUP_N_GROUPS]; /* the values */
   GPtrArray             *sections;             /* sections the values are defined in */
 
   CtkCssChange           change;               /* change as returned by value lookup */
@@ -56,6 +70,13 @@ CtkCssStyle *           ctk_css_static_style_get_default        (void);
 CtkCssStyle *           ctk_css_static_style_new_compute        (CtkStyleProviderPrivate *provider,
                                                                  const CtkCssMatcher    *matcher,
                                                                  CtkCssStyle            *parent);
+struct _CtkCssLookup *  ctk_css_static_style_lookup             (CtkStyleProviderPrivate *provider,
+                                                                 const CtkCssMatcher    *matcher,
+                                                                 CtkCssChange           *change);
+CtkCssStyle *           ctk_css_static_style_new_from_lookup    (CtkStyleProviderPrivate *provider,
+                                                                 struct _CtkCssLookup   *lookup,
+                                                                 CtkCssChange            change,
+                                                                 CtkCssStyle            *parent);
 
 void                    ctk_css_static_style_compute_value      (CtkCssStaticStyle      *style,
                                                                  CtkStyleProviderPrivate*provider,
@@ -65,6 +86,10 @@ void                    ctk_css_static_style_compute_value      (CtkCssStaticSty
                                                                  CtkCssSection          *section);
 
 CtkCssChange            ctk_css_static_style_get_change         (CtkCssStaticStyle      *style);
+CtkCssValueGroup *      ctk_css_static_style_get_value_group    (CtkCssStaticStyle      *style,
+                                                                 CtkCssValueGroupId      group_id);
+
+void                    ctk_css_value_group_set_cached          (CtkCssValueGroup       *group);
 
 G_END_DECLS
 
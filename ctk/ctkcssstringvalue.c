@@ -50,6 +50,12 @@ ctk_css_value_string_equal (const CtkCssValue *value1,
   return g_strcmp0 (value1->string, value2->string) == 0;
 }
 
+static guint
+ctk_css_value_string_hash (const CtkCssValue *value)
+{
+  return value->string ? g_str_hash (value->string) : 0;
+}
+
 static CtkCssValue *
 ctk_css_value_string_transition (CtkCssValue *start G_GNUC_UNUSED,
                                  CtkCssValue *end G_GNUC_UNUSED,
@@ -121,7 +127,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_STRING = {
   ctk_css_value_string_compute,
   ctk_css_value_string_equal,
   ctk_css_value_string_transition,
-  ctk_css_value_string_print
+  ctk_css_value_string_print,
+  ctk_css_value_string_hash
 };
 
 static const CtkCssValueClass CTK_CSS_VALUE_IDENT = {
@@ -129,7 +136,8 @@ static const CtkCssValueClass CTK_CSS_VALUE_IDENT = {
   ctk_css_value_string_compute,
   ctk_css_value_string_equal,
   ctk_css_value_string_transition,
-  ctk_css_value_ident_print
+  ctk_css_value_ident_print,
+  ctk_css_value_string_hash
 };
 
 CtkCssValue *
@@ -19,8 +19,43 @@
 
 #include "ctkcssstylechangeprivate.h"
 
+#include "ctkcssanimatedstyleprivate.h"
 #include "ctkcssstylepropertyprivate.h"
 
+/* Animation ticks replace an animated style with one for the same base
+ * style, so only the animated properties can have changed. Returns
+ * those or NULL if all properties need to be compared.
+ */
+static CtkBitmask *
+ctk_css_style_change_get_candidates (CtkCssStyle *old_style,
+                                     CtkCssStyle *new_style)
+{
+  CtkCssStyle *old_base, *new_base;
+  CtkBitmask *candidates;
+
+  if (CTK_IS_CSS_ANIMATED_STYLE (old_style))
+    old_base = CTK_CSS_ANIMATED_STYLE (old_style)->style;
+  else
+    old_base = old_style;
+
+  if (CTK_IS_CSS_ANIMATED_STYLE (new_style))
+    new_base = CTK_CSS_ANIMATED_STYLE (new_style)->style;
+  else
+    new_base = new_style;
+
+  if (old_base != new_base)
+    return NULL;
+
+  candidates = _ctk_bitmask_new ();
+
+  if (old_style != old_base)
+    candidates = ctk_css_animated_style_add_animated_properties (CTK_CSS_ANIMATED_STYLE (old_style), candidates);
+  if (new_style != new_base)
+    candidates = ctk_css_animated_style_add_animated_properties (CTK_CSS_ANIMATED_STYLE (new_style), candidates);
+
+  return candidates;
+}
+
 void
 ctk_css_style_change_init (CtkCssStyleChange *change,
                            CtkCssStyle       *old_style,
@@ -30,6 +65,7 @@ ctk_css_style_change_init (CtkCssStyleChange *change,
   change->new_style = g_object_ref (new_style);
 
   change->n_compared = 0;
+  change->candidates = NULL;
 
   change->affects = 0;
   change->changes = _ctk_bitmask_new ();
@@ -37,6 +73,8 @@ ctk_css_style_change_init (CtkCssStyleChange *change,
   /* Make sure we don't do extra work if old and new are equal. */
   if (old_style == new_style)
     change->n_compared = CTK_CSS_PROPERTY_N_PROPERTIES;
+  else
+    change->candidates = ctk_css_style_change_get_candidates (old_style, new_style);
 }
 
 void
@@ -45,6 +83,8 @@ ctk_css_style_change_finish (CtkCssStyleChange *change)
   g_object_unref (change->old_style);
   g_object_unref (change->new_style);
   _ctk_bitmask_free (change->changes);
+  if (change->candidates)
+    _ctk_bitmask_free (change->candidates);
 }
 
 CtkCssStyle *
@@ -65,7 +105,9 @@ ctk_css_style_compare_next_value (CtkCssStyleChange *change)
   if (change->n_compared == CTK_CSS_PROPERTY_N_PROPERTIES)
     return FALSE;
 
-  if (!_ctk_css_value_equal (ctk_css_style_get_value (change->old_style, change->n_compared),
+  if ((change->candidates == NULL ||
+       _ctk_bitmask_get (change->candidates, change->n_compared)) &&
+      !_ctk_css_value_equal (ctk_css_style_get_value (change->old_style, change->n_compared),
                              ctk_css_style_get_value (change->new_style, change->n_compared)))
     {
       change->affects |= _ctk_css_style_property_get_affects (_ctk_css_style_property_lookup_by_id (change->n_compared));
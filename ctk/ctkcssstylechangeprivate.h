@@ -29,6 +29,7 @@ struct _CtkCssStyleChange {
   CtkCssStyle   *new_style;
 
   guint          n_compared;
+  CtkBitmask    *candidates;    /* properties that may differ, NULL if any may */
 
   CtkCssAffects  affects;
   CtkBitmask    *changes;
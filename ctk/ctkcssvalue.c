@@ -29,6 +29,10 @@ struct _CtkCssValue {
 
 G_DEFINE_BOXED_TYPE (CtkCssValue, _ctk_css_value, _ctk_css_value_ref, _ctk_css_value_unref)
 
+/* Interned values, not holding a reference */
+static GHashTable *interned_values;
+static guint n_interned_total;
+
 CtkCssValue *
 _ctk_css_value_alloc (const CtkCssValueClass *klass,
                       gsize                   size)
@@ -63,6 +67,11 @@ _ctk_css_value_unref (CtkCssValue *value)
   if (value->ref_count > 0)
     return;
 
+  if (value->class->hash != NULL &&
+      interned_values != NULL &&
+      g_hash_table_lookup (interned_values, value) == value)
+    g_hash_table_remove (interned_values, value);
+
   value->class->free (value);
 }
 
@@ -127,6 +136,84 @@ _ctk_css_value_equal0 (const CtkCssValue *value1,
   return _ctk_css_value_equal (value1, value2);
 }
 
+guint
+_ctk_css_value_hash (const CtkCssValue *value)
+{
+  ctk_internal_return_val_if_fail (value != NULL, 0);
+
+  /* Values of the same class can always be told apart with equal() */
+  if (value->class->hash == NULL)
+    return GPOINTER_TO_UINT (value->class);
+
+  return value->class->hash (value);
+}
+
+static gboolean
+ctk_css_value_intern_equal (gconstpointer value1,
+                            gconstpointer value2)
+{
+  return _ctk_css_value_equal (value1, value2);
+}
+
+static guint
+ctk_css_value_intern_hash (gconstpointer value)
+{
+  return _ctk_css_value_hash (value);
+}
+
+/**
+ * _ctk_css_value_intern:
+ * @value: (transfer full): the value to intern
+ *
+ * Looks for an existing value equal to @value and returns that one
+ * instead, so that styles computing equal values share them. Values
+ * whose class has no hash function are returned unchanged.
+ *
+ * Returns: (transfer full): the interned value
+ **/
+CtkCssValue *
+_ctk_css_value_intern (CtkCssValue *value)
+{
+  CtkCssValue *interned;
+
+  ctk_internal_return_val_if_fail (value != NULL, NULL);
+
+  if (value->class->hash == NULL)
+    return value;
+
+  if (interned_values == NULL)
+    interned_values = g_hash_table_new (ctk_css_value_intern_hash,
+                                        ctk_css_value_intern_equal);
+
+  n_interned_total++;
+
+  interned = g_hash_table_lookup (interned_values, value);
+  if (interned == value)
+    return value;
+
+  if (interned != NULL)
+    {
+      _ctk_css_value_ref (interned);
+      _ctk_css_value_unref (value);
+      return interned;
+    }
+
+  g_hash_table_add (interned_values, value);
+
+  return value;
+}
+
+/* @n_total counts all values that were ever interned, @n_unique
+ * the distinct ones that are currently alive.
+ */
+void
+_ctk_css_value_get_intern_counts (guint *n_total,
+                                  guint *n_unique)
+{
+  *n_total = n_interned_total;
+  *n_unique = interned_values ? g_hash_table_size (interned_values) : 0;
+}
+
 CtkCssValue *
 _ctk_css_value_transition (CtkCssValue *start,
                            CtkCssValue *end,
@@ -53,6 +53,8 @@ struct _CtkCssValueClass {
                                                        double                      progress);
   void          (* print)                             (const CtkCssValue          *value,
                                                        GString                    *string);
+  /* optional, values without a hash function are not interned */
+  guint         (* hash)                              (const CtkCssValue          *value);
 };
 
 GType        _ctk_css_value_get_type                  (void) G_GNUC_CONST;
@@ -73,6 +75,10 @@ gboolean     _ctk_css_value_equal                     (const CtkCssValue
                                                        const CtkCssValue          *value2);
 gboolean     _ctk_css_value_equal0                    (const CtkCssValue          *value1,
                                                        const CtkCssValue          *value2);
+guint        _ctk_css_value_hash                      (const CtkCssValue          *value);
+CtkCssValue *_ctk_css_value_intern                    (CtkCssValue                *value);
+void         _ctk_css_value_get_intern_counts         (guint                      *n_total,
+                                                       guint                      *n_unique);
 CtkCssValue *_ctk_css_value_transition                (CtkCssValue                *start,
                                                        CtkCssValue                *end,
                                                        guint                       property_id,
@@ -82,6 +88,16 @@ char *       _ctk_css_value_to_string                 (const CtkCssValue
 void         _ctk_css_value_print                     (const CtkCssValue          *value,
                                                        GString                    *string);
 
+/* Hashes doubles so that values comparing equal, like 0.0 and -0.0, hash equal */
+static inline guint
+_ctk_css_hash_double (double d)
+{
+  if (d == 0.0)
+    return 0;
+
+  return g_double_hash (&d);
+}
+
 G_END_DECLS
 
 #endif /* __CTK_CSS_VALUE_PRIVATE_H__ */
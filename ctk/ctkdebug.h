@@ -56,7 +56,9 @@ typedef enum {
   CTK_DEBUG_TOUCHSCREEN     = 1 << 18,
   CTK_DEBUG_ACTIONS         = 1 << 19,
   CTK_DEBUG_RESIZE          = 1 << 20,
-  CTK_DEBUG_LAYOUT          = 1 << 21
+  CTK_DEBUG_LAYOUT          = 1 << 21,
+  CTK_DEBUG_NO_CSS_DISK_CACHE = 1 << 22,
+  CTK_DEBUG_RENDER_CACHE    = 1 << 23
 } CtkDebugFlag;
 
 #ifdef G_ENABLE_DEBUG
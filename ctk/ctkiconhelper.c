@@ -22,6 +22,7 @@
 #include "ctkiconhelperprivate.h"
 
 #include <math.h>
+#include <string.h>
 
 #include "ctkcssenumvalueprivate.h"
 #include "ctkcssiconthemevalueprivate.h"
@@ -427,6 +428,151 @@ ensure_surface_for_icon_set (CtkIconHelper    *self,
   return surface;
 }
 
+/* Surfaces of themed icons are shared between all icon helpers showing
+ * the same icon in the same way, lists often show lots of them. The
+ * cache doesn't hold a reference, a surface leaves it when the last
+ * helper using it lets go.
+ */
+typedef struct {
+  GIcon              *gicon;
+  CtkIconTheme       *icon_theme;
+  gint                width;
+  gint                height;
+  gint                scale;
+  CtkIconLookupFlags  flags;
+  CtkCssIconEffect    icon_effect;
+  CdkRGBA             colors[4];        /* fg, success, warning, error */
+} IconSurfaceKey;
+
+static GHashTable *icon_surfaces; /* IconSurfaceKey => cairo_surface_t */
+static const cairo_user_data_key_t icon_surface_key_key;
+static const cairo_user_data_key_t icon_surface_symbolic_key;
+
+static guint
+icon_surface_key_hash (gconstpointer item)
+{
+  const IconSurfaceKey *key = item;
+  guint hash;
+
+  hash = g_icon_hash ((gpointer) key->gicon);
+  hash = (hash << 5) - hash + g_direct_hash (key->icon_theme);
+  hash = (hash << 5) - hash + key->width;
+  hash = (hash << 5) - hash + key->height;
+  hash = (hash << 5) - hash + key->scale;
+  hash = (hash << 5) - hash + cdk_rgba_hash (&key->colors[0]);
+
+  return hash;
+}
+
+static gboolean
+icon_surface_key_equal (gconstpointer item1,
+                        gconstpointer item2)
+{
+  const IconSurfaceKey *key1 = item1;
+  const IconSurfaceKey *key2 = item2;
+  guint i;
+
+  if (key1->icon_theme != key2->icon_theme ||
+      key1->width != key2->width ||
+      key1->height != key2->height ||
+      key1->scale != key2->scale ||
+      key1->flags != key2->flags ||
+      key1->icon_effect != key2->icon_effect)
+    return FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS (key1->colors); i++)
+    {
+      if (!cdk_rgba_equal (&key1->colors[i], &key2->colors[i]))
+        return FALSE;
+    }
+
+  return g_icon_equal (key1->gicon, key2->gicon);
+}
+
+/* Called when the surface is destroyed */
+static void
+icon_surface_key_free (gpointer data)
+{
+  IconSurfaceKey *key = data;
+  gpointer orig_key;
+
+  /* The surface may have been dropped from the cache already and
+   * replaced by a new one for the same key */
+  if (g_hash_table_lookup_extended (icon_surfaces, key, &orig_key, NULL) &&
+      orig_key == key)
+    g_hash_table_remove (icon_surfaces, key);
+
+  g_object_unref (key->gicon);
+  g_slice_free (IconSurfaceKey, key);
+}
+
+static gboolean
+icon_surface_key_has_theme (gpointer key,
+                            gpointer value,
+                            gpointer icon_theme)
+{
+  return ((IconSurfaceKey *) key)->icon_theme == icon_theme;
+}
+
+/* Surfaces still in use by helpers stay alive until the helpers
+ * reload them, they just can't be found anymore */
+static void
+icon_surfaces_forget_theme (CtkIconTheme *icon_theme)
+{
+  g_hash_table_foreach_remove (icon_surfaces, icon_surface_key_has_theme, icon_theme);
+}
+
+static void
+icon_surfaces_watch_theme (CtkIconTheme *icon_theme)
+{
+  if (g_object_get_data (G_OBJECT (icon_theme), "ctk-icon-helper-surfaces"))
+    return;
+
+  g_object_set_data (G_OBJECT (icon_theme), "ctk-icon-helper-surfaces", GINT_TO_POINTER (TRUE));
+  g_signal_connect (icon_theme, "changed", G_CALLBACK (icon_surfaces_forget_theme), NULL);
+  g_object_weak_ref (G_OBJECT (icon_theme), (GWeakNotify) icon_surfaces_forget_theme, icon_theme);
+}
+
+static cairo_surface_t *
+icon_surfaces_lookup (const IconSurfaceKey *key,
+                      gboolean             *symbolic)
+{
+  cairo_surface_t *surface;
+
+  if (icon_surfaces == NULL)
+    return NULL;
+
+  surface = g_hash_table_lookup (icon_surfaces, key);
+  if (surface == NULL)
+    return NULL;
+
+  *symbolic = cairo_surface_get_user_data (surface, &icon_surface_symbolic_key) != NULL;
+
+  return cairo_surface_reference (surface);
+}
+
+static void
+icon_surfaces_insert (const IconSurfaceKey *key,
+                      cairo_surface_t      *surface,
+                      gboolean              symbolic)
+{
+  IconSurfaceKey *copy;
+
+  if (icon_surfaces == NULL)
+    icon_surfaces = g_hash_table_new (icon_surface_key_hash, icon_surface_key_equal);
+
+  icon_surfaces_watch_theme (key->icon_theme);
+
+  copy = g_slice_dup (IconSurfaceKey, key);
+  g_object_ref (copy->gicon);
+
+  if (symbolic)
+    cairo_surface_set_user_data (surface, &icon_surface_symbolic_key, GINT_TO_POINTER (TRUE), NULL);
+  cairo_surface_set_user_data (surface, &icon_surface_key_key, copy, icon_surface_key_free);
+
+  g_hash_table_replace (icon_surfaces, copy, surface);
+}
+
 static cairo_surface_t *
 ensure_surface_for_gicon (CtkIconHelper    *self,
                           CtkCssStyle      *style,
@@ -442,6 +588,7 @@ ensure_surface_for_gicon (CtkIconHelper    *self,
   cairo_surface_t *surface;
   GdkPixbuf *destination;
   gboolean symbolic;
+  IconSurfaceKey key;
 
   icon_theme = ctk_css_icon_theme_value_get_icon_theme
     (ctk_css_style_get_value (style, CTK_CSS_PROPERTY_ICON_THEME));
@@ -449,6 +596,25 @@ ensure_surface_for_gicon (CtkIconHelper    *self,
 
   ensure_icon_size (self, &width, &height);
 
+  memset (&key, 0, sizeof (IconSurfaceKey));
+  key.gicon = gicon;
+  key.icon_theme = icon_theme;
+  key.width = width;
+  key.height = height;
+  key.scale = scale;
+  key.flags = flags;
+  key.icon_effect = _ctk_css_icon_effect_value_get (ctk_css_style_get_value (style, CTK_CSS_PROPERTY_ICON_EFFECT));
+  ctk_icon_theme_lookup_symbolic_colors (style, &key.colors[0], &key.colors[1], &key.colors[2], &key.colors[3]);
+
+  surface = icon_surfaces_lookup (&key, &symbolic);
+  if (surface)
+    {
+      if (symbolic)
+        priv->rendered_surface_is_symbolic = TRUE;
+
+      return surface;
+    }
+
   info = ctk_icon_theme_lookup_by_gicon_for_scale (icon_theme,
                                                    gicon,
                                                    MIN (width, height),
@@ -459,13 +625,9 @@ ensure_surface_for_gicon (CtkIconHelper    *self,
 
       if (symbolic)
         {
-          CdkRGBA fg, success_color, warning_color, error_color;
-
-          ctk_icon_theme_lookup_symbolic_colors (style, &fg, &success_color, &warning_color, &error_color);
-
           destination = ctk_icon_info_load_symbolic (info,
-                                                     &fg, &success_color,
-                                                     &warning_color, &error_color,
+                                                     &key.colors[0], &key.colors[1],
+                                                     &key.colors[2], &key.colors[3],
                                                      NULL,
                                                      NULL);
         }
@@ -500,10 +662,7 @@ ensure_surface_for_gicon (CtkIconHelper    *self,
 
   if (!symbolic)
     {
-      CtkCssIconEffect icon_effect;
-
-      icon_effect = _ctk_css_icon_effect_value_get (ctk_css_style_get_value (style, CTK_CSS_PROPERTY_ICON_EFFECT));
-      ctk_css_icon_effect_apply (icon_effect, surface);
+      ctk_css_icon_effect_apply (key.icon_effect, surface);
     }
   else
     {
@@ -512,6 +671,8 @@ ensure_surface_for_gicon (CtkIconHelper    *self,
 
   g_object_unref (destination);
 
+  icon_surfaces_insert (&key, surface, symbolic);
+
   return surface;
 }
 
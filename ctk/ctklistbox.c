@@ -127,6 +127,18 @@ typedef struct
   CtkListBoxCreateWidgetFunc create_widget_func;
   gpointer create_widget_func_data;
   GDestroyNotify create_widget_func_data_destroy;
+
+  /* Only set for ctk_list_box_bind_model_virtualized() */
+  CtkListBoxBindWidgetFunc bind_widget_func;
+  guint virtual_first;          /* model position of the first row */
+  gint virtual_y;               /* where the first row is */
+  gint virtual_width;           /* that the rows were last allocated */
+  guint64 virtual_height_sum;   /* of all rows that were bound */
+  guint virtual_n_measured;
+  GPtrArray *recycled_rows;
+  GHashTable *selected_items;
+  guint virtual_tick_id;
+  gboolean in_virtual_update;
 } CtkListBoxPrivate;
 
 typedef struct
@@ -137,10 +149,12 @@ typedef struct
   CtkActionHelper *action_helper;
   gint y;
   gint height;
+  GObject *item;                /* in virtualized list boxes */
   guint visible     :1;
   guint selected    :1;
   guint activatable :1;
   guint selectable  :1;
+  guint wraps_child :1;         /* the box created the row for its child */
 } CtkListBoxRowPrivate;
 
 enum {
@@ -304,6 +318,9 @@ static void                 ctk_list_box_bound_model_changed            (GListMo
                                                                          gpointer             user_data);
 
 static void                 ctk_list_box_check_model_compat             (CtkListBox          *box);
+static void                 ctk_list_box_queue_virtual_update           (CtkListBox          *box);
+static gint                 ctk_list_box_get_virtual_height             (CtkListBox          *box);
+static void                 ctk_list_box_stop_virtualizing              (CtkListBox          *box);
 
 static void     ctk_list_box_measure    (CtkCssGadget        *gadget,
                                           CtkOrientation       orientation,
@@ -404,6 +421,9 @@ ctk_list_box_finalize (GObject *obj)
   if (priv->update_header_func_target_destroy_notify != NULL)
     priv->update_header_func_target_destroy_notify (priv->update_header_func_target);
 
+  if (priv->adjustment)
+    g_signal_handlers_disconnect_by_func (priv->adjustment,
+                                          ctk_list_box_queue_virtual_update, obj);
   g_clear_object (&priv->adjustment);
   g_clear_object (&priv->drag_highlighted_row);
   g_clear_object (&priv->multipress_gesture);
@@ -436,6 +456,13 @@ ctk_list_box_dispose (GObject *object)
       priv->placeholder = NULL;
     }
 
+  /* No rows must be created for a box that goes away */
+  if (priv->bind_widget_func)
+    {
+      g_signal_handlers_disconnect_by_func (priv->bound_model, ctk_list_box_bound_model_changed, object);
+      ctk_list_box_stop_virtualizing (CTK_LIST_BOX (object));
+    }
+
   G_OBJECT_CLASS (ctk_list_box_parent_class)->dispose (object);
 }
 
@@ -742,11 +769,20 @@ CtkListBoxRow *
 ctk_list_box_get_row_at_index (CtkListBox *box,
                                gint        index_)
 {
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
   GSequenceIter *iter;
 
   g_return_val_if_fail (CTK_IS_LIST_BOX (box), NULL);
 
-  iter = g_sequence_get_iter_at_pos (BOX_PRIV (box)->children, index_);
+  /* Only the rows around the view exist in virtualized boxes */
+  if (priv->bind_widget_func)
+    {
+      if (index_ < (gint) priv->virtual_first)
+        return NULL;
+      index_ -= priv->virtual_first;
+    }
+
+  iter = g_sequence_get_iter_at_pos (priv->children, index_);
   if (!g_sequence_iter_is_end (iter))
     return g_sequence_get (iter);
 
@@ -1046,8 +1082,23 @@ ctk_list_box_set_adjustment (CtkListBox    *box,
   if (adjustment)
     g_object_ref_sink (adjustment);
   if (priv->adjustment)
-    g_object_unref (priv->adjustment);
+    {
+      g_signal_handlers_disconnect_by_func (priv->adjustment,
+                                            ctk_list_box_queue_virtual_update, box);
+      g_object_unref (priv->adjustment);
+    }
   priv->adjustment = adjustment;
+
+  /* Virtualized boxes create the rows in view when it scrolls */
+  if (adjustment)
+    {
+      g_signal_connect_swapped (adjustment, "value-changed",
+                                G_CALLBACK (ctk_list_box_queue_virtual_update), box);
+      g_signal_connect_swapped (adjustment, "changed",
+                                G_CALLBACK (ctk_list_box_queue_virtual_update), box);
+    }
+
+  ctk_list_box_queue_virtual_update (box);
 }
 
 /**
@@ -1589,6 +1640,8 @@ ctk_list_box_row_set_selected (CtkListBoxRow *row,
 
   if (ROW_PRIV (row)->selected != selected)
     {
+      CtkListBox *box = ctk_list_box_row_get_box (row);
+
       ROW_PRIV (row)->selected = selected;
       if (selected)
         ctk_widget_set_state_flags (CTK_WIDGET (row),
@@ -1597,6 +1650,17 @@ ctk_list_box_row_set_selected (CtkListBoxRow *row,
         ctk_widget_unset_state_flags (CTK_WIDGET (row),
                                       CTK_STATE_FLAG_SELECTED);
 
+      /* Virtualized boxes remember it for when the row is gone */
+      if (box && BOX_PRIV (box)->selected_items && ROW_PRIV (row)->item)
+        {
+          if (selected)
+            g_hash_table_add (BOX_PRIV (box)->selected_items,
+                              g_object_ref (ROW_PRIV (row)->item));
+          else
+            g_hash_table_remove (BOX_PRIV (box)->selected_items,
+                                 ROW_PRIV (row)->item);
+        }
+
       return TRUE;
     }
 
@@ -1621,6 +1685,13 @@ ctk_list_box_unselect_all_internal (CtkListBox *box)
       dirty |= ctk_list_box_row_set_selected (row, FALSE);
     }
 
+  if (BOX_PRIV (box)->selected_items &&
+      g_hash_table_size (BOX_PRIV (box)->selected_items) > 0)
+    {
+      g_hash_table_remove_all (BOX_PRIV (box)->selected_items);
+      dirty = TRUE;
+    }
+
   BOX_PRIV (box)->selected_row = NULL;
 
   return dirty;
@@ -2754,6 +2825,9 @@ ctk_list_box_measure (CtkCssGadget   *gadget,
           *minimum += row_min;
         }
 
+      if (priv->bind_widget_func)
+        *minimum += ctk_list_box_get_virtual_height (CTK_LIST_BOX (widget));
+
       /* We always allocate the minimum height, since handling expanding rows
        * is way too costly, and unlikely to be used, as lists are generally put
        * inside a scrolling window anyway.
@@ -2827,6 +2901,19 @@ ctk_list_box_allocate (CtkCssGadget        *gadget,
       child_allocation.y += child_min;
     }
 
+  if (priv->bind_widget_func)
+    {
+      child_allocation.y += priv->virtual_y;
+
+      /* Rows may need a different height now */
+      if (priv->virtual_width != allocation->width)
+        {
+          priv->virtual_width = allocation->width;
+          if (ctk_widget_get_realized (widget))
+            ctk_list_box_queue_virtual_update (CTK_LIST_BOX (widget));
+        }
+    }
+
   for (iter = g_sequence_get_begin_iter (priv->children);
        !g_sequence_iter_is_end (iter);
        iter = g_sequence_iter_next (iter))
@@ -2935,6 +3022,7 @@ ctk_list_box_insert (CtkListBox *box,
       row = CTK_LIST_BOX_ROW (ctk_list_box_row_new ());
       ctk_widget_show (CTK_WIDGET (row));
       ctk_container_add (CTK_CONTAINER (row), child);
+      ROW_PRIV (row)->wraps_child = TRUE;
     }
 
   if (priv->sort_func != NULL)
@@ -3564,7 +3652,14 @@ ctk_list_box_row_get_index (CtkListBoxRow *row)
   priv = ROW_PRIV (row);
 
   if (priv->iter != NULL)
-    return g_sequence_iter_get_position (priv->iter);
+    {
+      CtkListBox *box = ctk_list_box_row_get_box (row);
+
+      if (box && BOX_PRIV (box)->bind_widget_func)
+        return BOX_PRIV (box)->virtual_first + g_sequence_iter_get_position (priv->iter);
+
+      return g_sequence_iter_get_position (priv->iter);
+    }
 
   return -1;
 }
@@ -3826,6 +3921,7 @@ ctk_list_box_row_actionable_iface_init (CtkActionableInterface *iface)
 static void
 ctk_list_box_row_finalize (GObject *obj)
 {
+  g_clear_object (&ROW_PRIV (CTK_LIST_BOX_ROW (obj))->item);
   g_clear_object (&ROW_PRIV (CTK_LIST_BOX_ROW (obj))->header);
   g_clear_object (&ROW_PRIV (CTK_LIST_BOX_ROW (obj))->gadget);
 
@@ -3979,6 +4075,495 @@ ctk_list_box_buildable_interface_init (CtkBuildableIface *iface)
   iface->add_child = ctk_list_box_buildable_add_child;
 }
 
+/* Virtualized list boxes
+ *
+ * With ctk_list_box_bind_model_virtualized(), rows only exist for the
+ * items in view of the adjustment, and for some overscan above and
+ * below it, so that rows are there before they scroll in. The rows are
+ * contiguous: the one at position i in the sequence shows the item at
+ * virtual_first + i. Rows that scroll out of the overscan are taken
+ * out and kept in recycled_rows, and the bind function gives them a
+ * new item when they are needed again.
+ *
+ * Items without a row are estimated to be as high as the rows that
+ * were bound so far on average, so the first row is at virtual_y =
+ * virtual_first × that estimate. When the rows change, the adjustment
+ * is moved so that the row at the top of the view stays where it was
+ * on screen, however far off the estimate is.
+ *
+ * The estimate is capped so that the box doesn't get higher than
+ * VIRTUAL_MAX_HEIGHT, because cairo only has 24 bits for the integer
+ * part of coordinates.
+ */
+
+#define VIRTUAL_OVERSCAN 0.5            /* in pages, above and below */
+#define VIRTUAL_DEFAULT_PAGE 1000       /* before the adjustment is set up */
+#define VIRTUAL_DEFAULT_ROW_HEIGHT 32   /* before any row was measured */
+#define VIRTUAL_MAX_HEIGHT (1 << 22)
+
+static double
+ctk_list_box_get_virtual_pitch (CtkListBox *box,
+                                guint       n_items)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  double pitch;
+
+  if (priv->virtual_n_measured > 0)
+    pitch = (double) priv->virtual_height_sum / priv->virtual_n_measured;
+  else
+    pitch = VIRTUAL_DEFAULT_ROW_HEIGHT;
+
+  if (n_items > 0)
+    pitch = MIN (pitch, (double) VIRTUAL_MAX_HEIGHT / n_items);
+
+  return pitch;
+}
+
+/* The estimated height of the items above and below the rows */
+static gint
+ctk_list_box_get_virtual_height (CtkListBox *box)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  guint n_items, n_rows, n_after;
+
+  n_items = g_list_model_get_n_items (priv->bound_model);
+  n_rows = g_sequence_get_length (priv->children);
+  n_after = n_items > priv->virtual_first + n_rows ? n_items - priv->virtual_first - n_rows : 0;
+
+  return priv->virtual_y + (gint) (n_after * ctk_list_box_get_virtual_pitch (box, n_items) + 0.5);
+}
+
+static gint
+get_height_for_width (CtkWidget *widget,
+                      gint       width)
+{
+  gint height;
+
+  if (width > 0)
+    ctk_widget_get_preferred_height_for_width (widget, width, &height, NULL);
+  else
+    ctk_widget_get_preferred_height (widget, &height, NULL);
+
+  return height;
+}
+
+/* The height that ctk_list_box_allocate() will give @row and its header */
+static gint
+ctk_list_box_get_row_height (CtkListBox    *box,
+                             CtkListBoxRow *row)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  gint height = 0;
+
+  if (!row_is_visible (row))
+    return 0;
+
+  if (ROW_PRIV (row)->header != NULL)
+    height += get_height_for_width (ROW_PRIV (row)->header, priv->virtual_width);
+
+  return height + get_height_for_width (CTK_WIDGET (row), priv->virtual_width);
+}
+
+static void
+ctk_list_box_trim_recycled_rows (CtkListBox *box,
+                                 guint       max_rows)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+
+  while (priv->recycled_rows->len > max_rows)
+    {
+      CtkWidget *row;
+
+      row = g_ptr_array_remove_index_fast (priv->recycled_rows, priv->recycled_rows->len - 1);
+      ctk_widget_destroy (row);
+      g_object_unref (row);
+    }
+}
+
+static void
+ctk_list_box_recycle_row (CtkListBox    *box,
+                          CtkListBoxRow *row)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  CtkListBoxRowPrivate *row_priv = ROW_PRIV (row);
+
+  /* The item stays selected, only the row goes */
+  if (row_priv->selected)
+    {
+      row_priv->selected = FALSE;
+      ctk_widget_unset_state_flags (CTK_WIDGET (row), CTK_STATE_FLAG_SELECTED);
+    }
+
+  g_object_ref (row);
+  ctk_container_remove (CTK_CONTAINER (box), CTK_WIDGET (row));
+  row_priv->iter = NULL;
+  g_clear_object (&row_priv->item);
+
+  g_ptr_array_add (priv->recycled_rows, row);
+}
+
+/* Creates or recycles a row for the item at @position, and inserts
+ * it at @index_ in the sequence */
+static CtkListBoxRow *
+ctk_list_box_bind_row (CtkListBox *box,
+                       guint       position,
+                       gint        index_)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  CtkListBoxRow *row;
+  CtkWidget *widget;
+  GObject *item;
+
+  item = g_list_model_get_item (priv->bound_model, position);
+
+  if (priv->recycled_rows->len > 0)
+    {
+      row = g_ptr_array_remove_index_fast (priv->recycled_rows, priv->recycled_rows->len - 1);
+
+      if (ROW_PRIV (row)->wraps_child)
+        widget = ctk_bin_get_child (CTK_BIN (row));
+      else
+        widget = CTK_WIDGET (row);
+      priv->bind_widget_func (widget, item, priv->create_widget_func_data);
+
+      ctk_list_box_insert (box, CTK_WIDGET (row), index_);
+      g_object_unref (row);
+    }
+  else
+    {
+      widget = priv->create_widget_func (item, priv->create_widget_func_data);
+
+      /* See ctk_list_box_bound_model_changed() */
+      if (g_object_is_floating (widget))
+        g_object_ref_sink (widget);
+
+      ctk_widget_show (widget);
+      ctk_list_box_insert (box, widget, index_);
+
+      if (CTK_IS_LIST_BOX_ROW (widget))
+        row = CTK_LIST_BOX_ROW (widget);
+      else
+        row = CTK_LIST_BOX_ROW (ctk_widget_get_parent (widget));
+      g_object_unref (widget);
+    }
+
+  ROW_PRIV (row)->item = item;
+  if (g_hash_table_contains (priv->selected_items, item) &&
+      ctk_list_box_row_set_selected (row, TRUE) &&
+      priv->selection_mode != CTK_SELECTION_MULTIPLE)
+    priv->selected_row = row;
+
+  priv->virtual_height_sum += ctk_list_box_get_row_height (box, row);
+  priv->virtual_n_measured++;
+
+  return row;
+}
+
+static CtkListBoxRow *
+ctk_list_box_get_virtual_row (CtkListBox *box,
+                              guint       position)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+
+  return g_sequence_get (g_sequence_get_iter_at_pos (priv->children,
+                                                     position - priv->virtual_first));
+}
+
+static void
+ctk_list_box_update_virtual_rows (CtkListBox *box)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  GSequenceIter *iter, *anchor_iter;
+  guint n_items, n_rows, anchor, first, pos;
+  double top, page, overscan, offset, above, below, pitch, value;
+  gint y, anchor_y, old_y;
+  gboolean at_end;
+
+  priv->in_virtual_update = TRUE;
+
+  n_items = g_list_model_get_n_items (priv->bound_model);
+  n_rows = g_sequence_get_length (priv->children);
+
+  top = 0;
+  page = 0;
+  if (priv->adjustment)
+    {
+      top = ctk_adjustment_get_value (priv->adjustment);
+      page = ctk_adjustment_get_page_size (priv->adjustment);
+    }
+  if (page <= 0)
+    page = VIRTUAL_DEFAULT_PAGE;
+  overscan = page * VIRTUAL_OVERSCAN;
+
+  if (n_items == 0)
+    {
+      while (n_rows-- > 0)
+        ctk_list_box_recycle_row (box, g_sequence_get (g_sequence_get_begin_iter (priv->children)));
+      priv->virtual_first = 0;
+      priv->virtual_y = 0;
+      goto out;
+    }
+
+  /* Find the item at the top of the view as it is now */
+  pitch = ctk_list_box_get_virtual_pitch (box, n_items);
+  anchor_iter = NULL;
+  anchor_y = 0;
+  y = priv->virtual_y;
+  for (iter = g_sequence_get_begin_iter (priv->children);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    {
+      gint height = ctk_list_box_get_row_height (box, g_sequence_get (iter));
+
+      if (anchor_iter == NULL && top >= y && top < y + height)
+        {
+          anchor_iter = iter;
+          anchor_y = y;
+        }
+
+      y += height;
+    }
+
+  at_end = top + page >= y + (gint) ((n_items - priv->virtual_first - n_rows) * pitch + 0.5);
+  if (at_end)
+    {
+      /* Estimates are off, so when scrolled to the end after a jump,
+       * line the last row up with the bottom of the view */
+      anchor = n_items - 1;
+    }
+  else if (anchor_iter != NULL)
+    {
+      anchor = priv->virtual_first + g_sequence_iter_get_position (anchor_iter);
+      y = anchor_y;
+    }
+  else if (top < priv->virtual_y || n_rows == 0)
+    {
+      anchor = MIN (top / pitch, n_items - 1);
+      y = anchor * pitch;
+    }
+  else
+    {
+      anchor = MIN (priv->virtual_first + n_rows + (top - y) / pitch, n_items - 1);
+      y += (anchor - priv->virtual_first - n_rows) * pitch;
+    }
+
+  if (anchor < priv->virtual_first || anchor >= priv->virtual_first + n_rows)
+    {
+      while (n_rows > 0)
+        {
+          ctk_list_box_recycle_row (box, g_sequence_get (g_sequence_get_begin_iter (priv->children)));
+          n_rows--;
+        }
+      ctk_list_box_bind_row (box, anchor, -1);
+      priv->virtual_first = anchor;
+      n_rows = 1;
+    }
+
+  if (at_end)
+    offset = ctk_list_box_get_row_height (box, ctk_list_box_get_virtual_row (box, anchor)) - page;
+  else
+    offset = MAX (top - y, 0);
+
+  /* Rows above the view */
+  above = 0;
+  pos = anchor;
+  while (pos > 0 && offset + above < overscan)
+    {
+      CtkListBoxRow *row;
+
+      pos--;
+      if (pos < priv->virtual_first)
+        {
+          row = ctk_list_box_bind_row (box, pos, 0);
+          priv->virtual_first = pos;
+          n_rows++;
+        }
+      else
+        row = ctk_list_box_get_virtual_row (box, pos);
+
+      above += ctk_list_box_get_row_height (box, row);
+    }
+  first = pos;
+
+  /* Rows in the view and below it */
+  below = - offset;
+  pos = anchor;
+  do
+    {
+      CtkListBoxRow *row;
+
+      if (pos >= priv->virtual_first + n_rows)
+        {
+          row = ctk_list_box_bind_row (box, pos, -1);
+          n_rows++;
+        }
+      else
+        row = ctk_list_box_get_virtual_row (box, pos);
+
+      below += ctk_list_box_get_row_height (box, row);
+      pos++;
+    }
+  while (pos < n_items && below < page + overscan);
+
+  while (priv->virtual_first + n_rows > pos)
+    {
+      ctk_list_box_recycle_row (box, g_sequence_get (g_sequence_iter_prev (g_sequence_get_end_iter (priv->children))));
+      n_rows--;
+    }
+  while (priv->virtual_first < first)
+    {
+      ctk_list_box_recycle_row (box, g_sequence_get (g_sequence_get_begin_iter (priv->children)));
+      priv->virtual_first++;
+      n_rows--;
+    }
+
+  ctk_list_box_trim_recycled_rows (box, n_rows);
+
+  /* Keep the top row where it is on screen */
+  old_y = priv->virtual_y;
+  priv->virtual_y = (gint) (first * ctk_list_box_get_virtual_pitch (box, n_items) + 0.5);
+  if (priv->virtual_y != old_y)
+    ctk_widget_queue_resize (CTK_WIDGET (box));
+
+  value = MAX (priv->virtual_y + above + offset, 0);
+  if (priv->adjustment && value != top)
+    ctk_adjustment_configure (priv->adjustment,
+                              value,
+                              ctk_adjustment_get_lower (priv->adjustment),
+                              MAX (ctk_adjustment_get_upper (priv->adjustment),
+                                   value + ctk_adjustment_get_page_size (priv->adjustment)),
+                              ctk_adjustment_get_step_increment (priv->adjustment),
+                              ctk_adjustment_get_page_increment (priv->adjustment),
+                              ctk_adjustment_get_page_size (priv->adjustment));
+
+out:
+  priv->in_virtual_update = FALSE;
+}
+
+static gboolean
+ctk_list_box_virtual_tick (CtkWidget     *widget,
+                           CdkFrameClock *frame_clock G_GNUC_UNUSED,
+                           gpointer       data G_GNUC_UNUSED)
+{
+  BOX_PRIV (widget)->virtual_tick_id = 0;
+  ctk_list_box_update_virtual_rows (CTK_LIST_BOX (widget));
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ctk_list_box_queue_virtual_update (CtkListBox *box)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+
+  if (priv->bind_widget_func == NULL ||
+      priv->in_virtual_update ||
+      priv->virtual_tick_id != 0)
+    return;
+
+  /* The adjustment changes while the parent is allocated, where
+   * children can't be added, so the rows are updated before the next
+   * layout instead */
+  if (ctk_widget_get_realized (CTK_WIDGET (box)))
+    priv->virtual_tick_id = ctk_widget_add_tick_callback (CTK_WIDGET (box),
+                                                          ctk_list_box_virtual_tick,
+                                                          NULL, NULL);
+  else
+    ctk_list_box_update_virtual_rows (box);
+}
+
+static void
+ctk_list_box_stop_virtualizing (CtkListBox *box)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+
+  priv->bind_widget_func = NULL;
+  priv->virtual_first = 0;
+  priv->virtual_y = 0;
+
+  if (priv->virtual_tick_id != 0)
+    {
+      ctk_widget_remove_tick_callback (CTK_WIDGET (box), priv->virtual_tick_id);
+      priv->virtual_tick_id = 0;
+    }
+
+  ctk_list_box_trim_recycled_rows (box, 0);
+  g_clear_pointer (&priv->recycled_rows, g_ptr_array_unref);
+  g_clear_pointer (&priv->selected_items, g_hash_table_unref);
+}
+
+/* The model has no removed items anymore, so the selected ones that
+ * were removed are found by looking for the others. Returns whether
+ * any selected item was dropped. */
+static gboolean
+ctk_list_box_forget_removed_items (CtkListBox *box)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  GHashTable *kept;
+  guint i, n_items;
+  gboolean dropped;
+
+  if (g_hash_table_size (priv->selected_items) == 0)
+    return FALSE;
+
+  kept = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+  n_items = g_list_model_get_n_items (priv->bound_model);
+
+  for (i = 0; i < n_items && g_hash_table_size (priv->selected_items) > 0; i++)
+    {
+      GObject *item;
+
+      item = g_list_model_get_item (priv->bound_model, i);
+      /* Takes over the reference of the old table */
+      if (g_hash_table_steal (priv->selected_items, item))
+        g_hash_table_add (kept, item);
+      g_object_unref (item);
+    }
+
+  dropped = g_hash_table_size (priv->selected_items) > 0;
+
+  g_hash_table_unref (priv->selected_items);
+  priv->selected_items = kept;
+
+  return dropped;
+}
+
+static void
+ctk_list_box_virtual_items_changed (CtkListBox *box,
+                                    guint       position,
+                                    guint       removed,
+                                    guint       added)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+  guint n_rows, keep;
+
+  n_rows = g_sequence_get_length (priv->children);
+
+  if (position + removed <= priv->virtual_first)
+    {
+      /* The rows stay, only their items moved */
+      priv->virtual_first = priv->virtual_first - removed + added;
+    }
+  else if (position < priv->virtual_first + n_rows)
+    {
+      keep = position > priv->virtual_first ? position - priv->virtual_first : 0;
+      while (n_rows > keep)
+        {
+          ctk_list_box_recycle_row (box, g_sequence_get (g_sequence_iter_prev (g_sequence_get_end_iter (priv->children))));
+          n_rows--;
+        }
+    }
+
+  ctk_widget_queue_resize (CTK_WIDGET (box));
+  ctk_list_box_queue_virtual_update (box);
+
+  if (removed > 0 && ctk_list_box_forget_removed_items (box))
+    {
+      g_signal_emit (box, signals[ROW_SELECTED], 0, NULL);
+      g_signal_emit (box, signals[SELECTED_ROWS_CHANGED], 0);
+    }
+}
+
 static void
 ctk_list_box_bound_model_changed (GListModel *list,
                                   guint       position,
@@ -3990,6 +4575,12 @@ ctk_list_box_bound_model_changed (GListModel *list,
   CtkListBoxPrivate *priv = BOX_PRIV (user_data);
   guint i;
 
+  if (priv->bind_widget_func)
+    {
+      ctk_list_box_virtual_items_changed (box, position, removed, added);
+      return;
+    }
+
   while (removed--)
     {
       CtkListBoxRow *row;
@@ -4034,6 +4625,59 @@ ctk_list_box_check_model_compat (CtkListBox *box)
     g_warning ("CtkListBox with a model will ignore sort and filter functions");
 }
 
+static void
+ctk_list_box_bind_model_internal (CtkListBox                 *box,
+                                  GListModel                 *model,
+                                  CtkListBoxCreateWidgetFunc  create_widget_func,
+                                  CtkListBoxBindWidgetFunc    bind_widget_func,
+                                  gpointer                    user_data,
+                                  GDestroyNotify              user_data_free_func)
+{
+  CtkListBoxPrivate *priv = BOX_PRIV (box);
+
+  if (priv->bound_model)
+    {
+      if (priv->create_widget_func_data_destroy)
+        priv->create_widget_func_data_destroy (priv->create_widget_func_data);
+
+      g_signal_handlers_disconnect_by_func (priv->bound_model, ctk_list_box_bound_model_changed, box);
+      g_clear_object (&priv->bound_model);
+    }
+
+  if (priv->bind_widget_func)
+    ctk_list_box_stop_virtualizing (box);
+
+  ctk_list_box_forall (CTK_CONTAINER (box), FALSE, (CtkCallback) ctk_widget_destroy, NULL);
+
+  if (model == NULL)
+    return;
+
+  priv->bound_model = g_object_ref (model);
+  priv->create_widget_func = create_widget_func;
+  priv->create_widget_func_data = user_data;
+  priv->create_widget_func_data_destroy = user_data_free_func;
+
+  ctk_list_box_check_model_compat (box);
+
+  g_signal_connect (priv->bound_model, "items-changed", G_CALLBACK (ctk_list_box_bound_model_changed), box);
+
+  if (bind_widget_func)
+    {
+      priv->bind_widget_func = bind_widget_func;
+      priv->virtual_first = 0;
+      priv->virtual_y = 0;
+      priv->virtual_height_sum = 0;
+      priv->virtual_n_measured = 0;
+      priv->recycled_rows = g_ptr_array_new ();
+      priv->selected_items = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+
+      ctk_widget_queue_resize (CTK_WIDGET (box));
+      ctk_list_box_queue_virtual_update (box);
+    }
+  else
+    ctk_list_box_bound_model_changed (model, 0, 0, g_list_model_get_n_items (model), box);
+}
+
 /**
  * ctk_list_box_bind_model:
  * @box: a #CtkListBox
@@ -4060,6 +4704,8 @@ ctk_list_box_check_model_compat (CtkListBox *box)
  * functionality in CtkListBox. When using a model, filtering and sorting
  * should be implemented by the model.
  *
+ * For large models, see ctk_list_box_bind_model_virtualized().
+ *
  * Since: 3.16
  */
 void
@@ -4069,33 +4715,60 @@ ctk_list_box_bind_model (CtkListBox                 *box,
                          gpointer                    user_data,
                          GDestroyNotify              user_data_free_func)
 {
-  CtkListBoxPrivate *priv = BOX_PRIV (box);
-
   g_return_if_fail (CTK_IS_LIST_BOX (box));
   g_return_if_fail (model == NULL || G_IS_LIST_MODEL (model));
   g_return_if_fail (model == NULL || create_widget_func != NULL);
 
-  if (priv->bound_model)
-    {
-      if (priv->create_widget_func_data_destroy)
-        priv->create_widget_func_data_destroy (priv->create_widget_func_data);
-
-      g_signal_handlers_disconnect_by_func (priv->bound_model, ctk_list_box_bound_model_changed, box);
-      g_clear_object (&priv->bound_model);
-    }
-
-  ctk_list_box_forall (CTK_CONTAINER (box), FALSE, (CtkCallback) ctk_widget_destroy, NULL);
-
-  if (model == NULL)
-    return;
-
-  priv->bound_model = g_object_ref (model);
-  priv->create_widget_func = create_widget_func;
-  priv->create_widget_func_data = user_data;
-  priv->create_widget_func_data_destroy = user_data_free_func;
+  ctk_list_box_bind_model_internal (box, model,
+                                    create_widget_func, NULL,
+                                    user_data, user_data_free_func);
+}
 
-  ctk_list_box_check_model_compat (box);
+/**
+ * ctk_list_box_bind_model_virtualized:
+ * @box: a #CtkListBox
+ * @model: (nullable): the #GListModel to be bound to @box
+ * @create_widget_func: (nullable): a function that creates widgets for items
+ *   or %NULL in case you also passed %NULL as @model
+ * @bind_widget_func: (nullable): a function that makes a widget show
+ *   another item, or %NULL in case you also passed %NULL as @model
+ * @user_data: user data passed to @create_widget_func and @bind_widget_func
+ * @user_data_free_func: function for freeing @user_data
+ *
+ * Binds @model to @box like ctk_list_box_bind_model(), but only creates
+ * rows for the items that are in view of the adjustment of @box, see
+ * ctk_list_box_set_adjustment(). This makes models with many items
+ * cheap, but @box needs to be in a #CtkScrolledWindow.
+ *
+ * When the view scrolls, rows that scroll out are reused for the items
+ * that scroll in: @bind_widget_func is called with a widget that
+ * @create_widget_func returned before, and the item it should show now.
+ * The height of the items that have no row is estimated from the rows
+ * that were shown so far.
+ *
+ * Only the rows that exist are children of @box, so functions like
+ * ctk_list_box_get_row_at_index() return %NULL for other items, and
+ * ctk_list_box_select_all() only selects the rows that exist. Items
+ * stay selected when their rows go, and the row is selected again when
+ * the item comes back into view. Header functions see the rows that
+ * exist only, too.
+ *
+ * Since: 3.24
+ */
+void
+ctk_list_box_bind_model_virtualized (CtkListBox                 *box,
+                                     GListModel                 *model,
+                                     CtkListBoxCreateWidgetFunc  create_widget_func,
+                                     CtkListBoxBindWidgetFunc    bind_widget_func,
+                                     gpointer                    user_data,
+                                     GDestroyNotify              user_data_free_func)
+{
+  g_return_if_fail (CTK_IS_LIST_BOX (box));
+  g_return_if_fail (model == NULL || G_IS_LIST_MODEL (model));
+  g_return_if_fail (model == NULL || create_widget_func != NULL);
+  g_return_if_fail (model == NULL || bind_widget_func != NULL);
 
-  g_signal_connect (priv->bound_model, "items-changed", G_CALLBACK (ctk_list_box_bound_model_changed), box);
-  ctk_list_box_bound_model_changed (model, 0, 0, g_list_model_get_n_items (model), box);
+  ctk_list_box_bind_model_internal (box, model,
+                                    create_widget_func, bind_widget_func,
+                                    user_data, user_data_free_func);
 }
@@ -189,6 +189,22 @@ typedef void (*CtkListBoxUpdateHeaderFunc) (CtkListBoxRow *row,
 typedef CtkWidget * (*CtkListBoxCreateWidgetFunc) (gpointer item,
                                                    gpointer user_data);
 
+/**
+ * CtkListBoxBindWidgetFunc:
+ * @widget: a widget that @create_widget_func returned before
+ * @item: (type GObject): the item from the model that @widget should show now
+ * @user_data: (closure): user data
+ *
+ * Called for list boxes that are bound to a #GListModel with
+ * ctk_list_box_bind_model_virtualized() when the row of @widget
+ * is reused for @item.
+ *
+ * Since: 3.24
+ */
+typedef void (*CtkListBoxBindWidgetFunc) (CtkWidget *widget,
+                                          gpointer   item,
+                                          gpointer   user_data);
+
 CDK_AVAILABLE_IN_3_10
 GType      ctk_list_box_row_get_type      (void) G_GNUC_CONST;
 CDK_AVAILABLE_IN_3_10
@@ -312,6 +328,13 @@ void           ctk_list_box_bind_model                   (CtkListBox
                                                           CtkListBoxCreateWidgetFunc    create_widget_func,
                                                           gpointer                      user_data,
                                                           GDestroyNotify                user_data_free_func);
+CDK_AVAILABLE_IN_3_24
+void           ctk_list_box_bind_model_virtualized       (CtkListBox                   *box,
+                                                          GListModel                   *model,
+                                                          CtkListBoxCreateWidgetFunc    create_widget_func,
+                                                          CtkListBoxBindWidgetFunc      bind_widget_func,
+                                                          gpointer                      user_data,
+                                                          GDestroyNotify                user_data_free_func);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(CtkListBox, g_object_unref)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(CtkListBoxRow, g_object_unref)
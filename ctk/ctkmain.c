@@ -190,7 +190,9 @@ static const GDebugKey ctk_debug_keys[] = {
   { "touchscreen", CTK_DEBUG_TOUCHSCREEN },
   { "actions", CTK_DEBUG_ACTIONS },
   { "resize", CTK_DEBUG_RESIZE },
-  { "layout", CTK_DEBUG_LAYOUT }
+  { "layout", CTK_DEBUG_LAYOUT },
+  { "no-css-disk-cache", CTK_DEBUG_NO_CSS_DISK_CACHE },
+  { "render-cache", CTK_DEBUG_RENDER_CACHE }
 };
 #endif /* G_ENABLE_DEBUG */
 
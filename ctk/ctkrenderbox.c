@@ -0,0 +1,360 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ctkrenderboxprivate.h"
+
+#include "ctkcssarrayvalueprivate.h"
+#include "ctkcsscornervalueprivate.h"
+#include "ctkcssimagelinearprivate.h"
+#include "ctkcssimageradialprivate.h"
+#include "ctkcssimagevalueprivate.h"
+#include "ctkcssshadowsvalueprivate.h"
+#include "ctkcssstyleprivate.h"
+#include "ctkdebug.h"
+#include "ctkrenderbackgroundprivate.h"
+#include "ctkrenderborderprivate.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Backgrounds and borders of static styles are rendered once per size
+ * into an image surface and then just copied on later draws. Shadows,
+ * gradients and rounded corners are expensive to draw, and most widget
+ * chrome looks the same from one frame to the next.
+ *
+ * The values are identified by the value groups of the style: equal
+ * groups are shared between styles, so two styles drawing the same
+ * box have the same groups. When a group is freed, entries using it
+ * are dropped with it.
+ */
+
+#define RENDER_BOX_CACHE_SIZE (8 * 1024 * 1024)
+/* Don't let a few huge boxes like window backgrounds push out all the
+ * small ones, they are cheap to draw relative to their size anyway */
+#define RENDER_BOX_MAX_ENTRY_SIZE (RENDER_BOX_CACHE_SIZE / 16)
+
+static const CtkCssValueGroupId key_groups[] = {
+  CTK_CSS_VALUE_GROUP_SIZE,       /* padding, for the content box */
+  CTK_CSS_VALUE_GROUP_BACKGROUND,
+  CTK_CSS_VALUE_GROUP_BORDER
+};
+
+typedef struct {
+  CtkCssValueGroup *groups[G_N_ELEMENTS (key_groups)];
+  int               width;
+  int               height;
+  int               scale;
+  CtkJunctionSides  junction;
+} CtkRenderBoxKey;
+
+static CtkRenderCache *box_cache;
+
+static guint
+ctk_render_box_key_hash (gconstpointer item)
+{
+  const CtkRenderBoxKey *key = item;
+  guint i, hash;
+
+  hash = key->width;
+  hash = (hash << 5) - hash + key->height;
+  hash = (hash << 5) - hash + key->scale;
+  hash = (hash << 5) - hash + key->junction;
+  for (i = 0; i < G_N_ELEMENTS (key->groups); i++)
+    hash = (hash << 5) - hash + g_direct_hash (key->groups[i]);
+
+  return hash;
+}
+
+static gboolean
+ctk_render_box_key_equal (gconstpointer item1,
+                          gconstpointer item2)
+{
+  const CtkRenderBoxKey *key1 = item1;
+  const CtkRenderBoxKey *key2 = item2;
+
+  return memcmp (key1, key2, sizeof (CtkRenderBoxKey)) == 0;
+}
+
+CtkRenderCache *
+ctk_css_style_render_box_get_cache (void)
+{
+  if (box_cache == NULL)
+    box_cache = ctk_render_cache_new ("Backgrounds and borders",
+                                      RENDER_BOX_CACHE_SIZE,
+                                      ctk_render_box_key_hash,
+                                      ctk_render_box_key_equal,
+                                      g_free);
+
+  return box_cache;
+}
+
+static gboolean
+ctk_render_box_key_uses_group (gpointer key,
+                               gpointer value,
+                               gpointer group)
+{
+  CtkRenderBoxKey *box_key = key;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (box_key->groups); i++)
+    {
+      if (box_key->groups[i] == group)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+void
+ctk_css_style_render_box_cache_evict (CtkCssValueGroup *group)
+{
+  if (box_cache == NULL)
+    return;
+
+  ctk_render_cache_remove_matching (box_cache, ctk_render_box_key_uses_group, group);
+}
+
+static gboolean
+is_integer (double d)
+{
+  return d == floor (d);
+}
+
+/* Checks that drawing the style is both worth caching and can be
+ * cached: the contents must only depend on the values and the size.
+ */
+static gboolean
+ctk_css_style_render_box_is_cacheable (CtkCssStyle *style)
+{
+  CtkCssValue *background_image;
+  gboolean worth_it;
+  guint i;
+
+  if (!CTK_IS_CSS_STATIC_STYLE (style))
+    return FALSE;
+
+  if (_ctk_css_image_value_get_image (ctk_css_style_get_value (style, CTK_CSS_PROPERTY_BORDER_IMAGE_SOURCE)))
+    return FALSE;
+
+  worth_it = !_ctk_css_shadows_value_is_none (ctk_css_style_get_value (style, CTK_CSS_PROPERTY_BOX_SHADOW));
+
+  background_image = ctk_css_style_get_value (style, CTK_CSS_PROPERTY_BACKGROUND_IMAGE);
+  for (i = 0; i < _ctk_css_array_value_get_n_values (background_image); i++)
+    {
+      CtkCssImage *image = _ctk_css_image_value_get_image (_ctk_css_array_value_get_nth (background_image, i));
+
+      if (image == NULL)
+        continue;
+
+      /* Other images may change without the value changing, or are
+       * already backed by a surface */
+      if (!CTK_IS_CSS_IMAGE_LINEAR (image) && !CTK_IS_CSS_IMAGE_RADIAL (image))
+        return FALSE;
+
+      worth_it = TRUE;
+    }
+
+  if (worth_it)
+    return TRUE;
+
+  /* Plain rectangles are filled faster than copied */
+  for (i = CTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS; i <= CTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS; i++)
+    {
+      CtkCssValue *corner = ctk_css_style_get_value (style, i);
+
+      if (_ctk_css_corner_value_get_x (corner, 100) > 0 ||
+          _ctk_css_corner_value_get_y (corner, 100) > 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+ctk_css_style_render_box_uncached (CtkCssStyle      *style,
+                                   cairo_t          *cr,
+                                   gdouble           x,
+                                   gdouble           y,
+                                   gdouble           width,
+                                   gdouble           height,
+                                   CtkJunctionSides  junction)
+{
+  ctk_css_style_render_background (style, cr, x, y, width, height, junction);
+  ctk_css_style_render_border (style, cr, x, y, width, height, 0, junction);
+}
+
+/* Fills @key if the box can be drawn from the cache onto @cr, which
+ * requires the surface pixels to line up with the device pixels. */
+static gboolean
+ctk_css_style_render_box_init_key (CtkRenderBoxKey  *key,
+                                   CtkCssStyle      *style,
+                                   cairo_t          *cr,
+                                   gdouble           x,
+                                   gdouble           y,
+                                   gdouble           width,
+                                   gdouble           height,
+                                   CtkJunctionSides  junction)
+{
+  int scale;
+  guint i;
+
+  if (width <= 0 || height <= 0 ||
+      !is_integer (width) || !is_integer (height))
+    return FALSE;
+
+  if (cairo_get_operator (cr) != CAIRO_OPERATOR_OVER)
+    return FALSE;
+
+  if (!ctk_render_cache_is_pixel_aligned (cr, x, y, width, height, &scale))
+    return FALSE;
+
+  if (!ctk_css_style_render_box_is_cacheable (style))
+    return FALSE;
+
+  memset (key, 0, sizeof (CtkRenderBoxKey));
+  for (i = 0; i < G_N_ELEMENTS (key_groups); i++)
+    {
+      key->groups[i] = ctk_css_static_style_get_value_group (CTK_CSS_STATIC_STYLE (style), key_groups[i]);
+      if (key->groups[i] == NULL)
+        return FALSE;
+    }
+  key->width = width;
+  key->height = height;
+  key->scale = scale;
+  key->junction = junction;
+
+  return TRUE;
+}
+
+static cairo_surface_t *
+ctk_css_style_render_box_to_surface (CtkCssStyle      *style,
+                                     cairo_t          *cr,
+                                     const CtkBorder  *extents,
+                                     int               width,
+                                     int               height,
+                                     int               scale,
+                                     CtkJunctionSides  junction)
+{
+  cairo_surface_t *surface;
+  cairo_t *surface_cr;
+
+  surface = cairo_surface_create_similar_image (cairo_get_group_target (cr),
+                                                CAIRO_FORMAT_ARGB32,
+                                                (extents->left + width + extents->right) * scale,
+                                                (extents->top + height + extents->bottom) * scale);
+  cairo_surface_set_device_scale (surface, scale, scale);
+
+  surface_cr = cairo_create (surface);
+  ctk_css_style_render_box_uncached (style, surface_cr,
+                                     extents->left, extents->top,
+                                     width, height,
+                                     junction);
+  cairo_destroy (surface_cr);
+
+  return surface;
+}
+
+static void
+ctk_css_style_render_box_debug (cairo_t  *cr,
+                                gdouble   x,
+                                gdouble   y,
+                                gdouble   width,
+                                gdouble   height,
+                                gboolean  hit)
+{
+#ifdef G_ENABLE_DEBUG
+  if (!CTK_DEBUG_CHECK (RENDER_CACHE))
+    return;
+
+  /* Tint boxes copied from the cache green and freshly drawn ones red */
+  cairo_save (cr);
+  if (hit)
+    cairo_set_source_rgba (cr, 0, 1, 0, 0.2);
+  else
+    cairo_set_source_rgba (cr, 1, 0, 0, 0.2);
+  cairo_rectangle (cr, x, y, width, height);
+  cairo_fill (cr);
+  cairo_restore (cr);
+#endif
+}
+
+/* Draws the background and the border of @style, the same as calling
+ * ctk_css_style_render_background() and ctk_css_style_render_border()
+ * in a row, but reuses what was drawn before where possible.
+ */
+void
+ctk_css_style_render_box (CtkCssStyle      *style,
+                          cairo_t          *cr,
+                          gdouble           x,
+                          gdouble           y,
+                          gdouble           width,
+                          gdouble           height,
+                          CtkJunctionSides  junction)
+{
+  CtkRenderCache *cache;
+  CtkRenderBoxKey key;
+  CtkBorder extents;
+  cairo_surface_t *surface;
+  gboolean hit;
+  guint i;
+
+  if (!ctk_css_style_render_box_init_key (&key, style, cr, x, y, width, height, junction))
+    {
+      ctk_css_style_render_box_uncached (style, cr, x, y, width, height, junction);
+      return;
+    }
+
+  _ctk_css_shadows_value_get_extents (ctk_css_style_get_value (style, CTK_CSS_PROPERTY_BOX_SHADOW), &extents);
+
+  if ((gsize) (extents.left + key.width + extents.right) * key.scale *
+      (extents.top + key.height + extents.bottom) * key.scale * 4 > RENDER_BOX_MAX_ENTRY_SIZE)
+    {
+      ctk_css_style_render_box_uncached (style, cr, x, y, width, height, junction);
+      return;
+    }
+
+  cache = ctk_css_style_render_box_get_cache ();
+  surface = ctk_render_cache_lookup (cache, &key);
+  hit = surface != NULL;
+  if (hit)
+    {
+      cairo_surface_reference (surface);
+    }
+  else
+    {
+      surface = ctk_css_style_render_box_to_surface (style, cr, &extents,
+                                                     key.width, key.height, key.scale,
+                                                     junction);
+      for (i = 0; i < G_N_ELEMENTS (key.groups); i++)
+        ctk_css_value_group_set_cached (key.groups[i]);
+      ctk_render_cache_insert (cache, g_memdup2 (&key, sizeof (CtkRenderBoxKey)), surface);
+    }
+
+  cairo_save (cr);
+  cairo_set_source_surface (cr, surface, x - extents.left, y - extents.top);
+  cairo_rectangle (cr,
+                   x - extents.left, y - extents.top,
+                   extents.left + width + extents.right,
+                   extents.top + height + extents.bottom);
+  cairo_fill (cr);
+  cairo_restore (cr);
+
+  ctk_css_style_render_box_debug (cr, x, y, width, height, hit);
+
+  cairo_surface_destroy (surface);
+}
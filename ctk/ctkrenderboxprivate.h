@@ -0,0 +1,43 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CTK_RENDER_BOX_PRIVATE_H__
+#define __CTK_RENDER_BOX_PRIVATE_H__
+
+#include <glib-object.h>
+#include <cairo.h>
+
+#include "ctkcssstaticstyleprivate.h"
+#include "ctkcsstypesprivate.h"
+#include "ctkrendercacheprivate.h"
+#include "ctktypes.h"
+
+G_BEGIN_DECLS
+
+void            ctk_css_style_render_box                        (CtkCssStyle          *style,
+                                                                 cairo_t              *cr,
+                                                                 gdouble               x,
+                                                                 gdouble               y,
+                                                                 gdouble               width,
+                                                                 gdouble               height,
+                                                                 CtkJunctionSides      junction);
+
+CtkRenderCache *ctk_css_style_render_box_get_cache              (void);
+void            ctk_css_style_render_box_cache_evict            (CtkCssValueGroup     *group);
+
+G_END_DECLS
+
+#endif /* __CTK_RENDER_BOX_PRIVATE_H__ */
@@ -0,0 +1,260 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ctkrendercacheprivate.h"
+
+#include <math.h>
+
+/* A cache of rendered image surfaces with a fixed budget of pixel memory.
+ * When an insertion would exceed the budget, the least recently used
+ * surfaces are dropped until it fits again.
+ *
+ * The caches are only used from the main thread.
+ */
+
+typedef struct _CtkRenderCacheEntry CtkRenderCacheEntry;
+
+struct _CtkRenderCacheEntry {
+  gpointer         key;
+  cairo_surface_t *surface;
+  gsize            size;
+  GList            link;        /* in the LRU queue, data points to the entry */
+};
+
+struct _CtkRenderCache {
+  char           *name;
+  GHashTable     *entries;      /* key => CtkRenderCacheEntry */
+  GQueue          lru;          /* most recently used first */
+  GDestroyNotify  key_destroy_func;
+
+  gsize           size;
+  gsize           max_size;
+
+  guint64         hits;
+  guint64         misses;
+  guint64         evictions;
+};
+
+static GSList *all_caches;
+
+static gsize
+ctk_render_cache_get_surface_size (cairo_surface_t *surface)
+{
+  return (gsize) cairo_image_surface_get_stride (surface) *
+         cairo_image_surface_get_height (surface);
+}
+
+static void
+ctk_render_cache_entry_free (gpointer data)
+{
+  CtkRenderCacheEntry *entry = data;
+
+  cairo_surface_destroy (entry->surface);
+  g_slice_free (CtkRenderCacheEntry, entry);
+}
+
+CtkRenderCache *
+ctk_render_cache_new (const char     *name,
+                      gsize           max_size,
+                      GHashFunc       hash_func,
+                      GEqualFunc      equal_func,
+                      GDestroyNotify  key_destroy_func)
+{
+  CtkRenderCache *cache;
+
+  cache = g_new0 (CtkRenderCache, 1);
+  cache->name = g_strdup (name);
+  cache->entries = g_hash_table_new_full (hash_func, equal_func,
+                                          key_destroy_func,
+                                          ctk_render_cache_entry_free);
+  g_queue_init (&cache->lru);
+  cache->key_destroy_func = key_destroy_func;
+  cache->max_size = max_size;
+
+  all_caches = g_slist_append (all_caches, cache);
+
+  return cache;
+}
+
+/* Returns all caches that were created, for the inspector */
+GSList *
+ctk_render_cache_get_all (void)
+{
+  return all_caches;
+}
+
+static void
+ctk_render_cache_remove_entry (CtkRenderCache      *cache,
+                               CtkRenderCacheEntry *entry)
+{
+  g_queue_unlink (&cache->lru, &entry->link);
+  cache->size -= entry->size;
+  /* frees the entry */
+  g_hash_table_remove (cache->entries, entry->key);
+}
+
+cairo_surface_t *
+ctk_render_cache_lookup (CtkRenderCache *cache,
+                         gconstpointer   key)
+{
+  CtkRenderCacheEntry *entry;
+
+  entry = g_hash_table_lookup (cache->entries, key);
+  if (entry == NULL)
+    {
+      cache->misses++;
+      return NULL;
+    }
+
+  cache->hits++;
+
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+
+  return entry->surface;
+}
+
+/* Takes ownership of @key, adds a reference to @surface, which must
+ * be an image surface. */
+void
+ctk_render_cache_insert (CtkRenderCache  *cache,
+                         gpointer         key,
+                         cairo_surface_t *surface)
+{
+  CtkRenderCacheEntry *entry;
+  gsize size;
+
+  g_return_if_fail (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE);
+
+  size = ctk_render_cache_get_surface_size (surface);
+  if (size > cache->max_size)
+    {
+      if (cache->key_destroy_func)
+        cache->key_destroy_func (key);
+      return;
+    }
+
+  entry = g_hash_table_lookup (cache->entries, key);
+  if (entry)
+    ctk_render_cache_remove_entry (cache, entry);
+
+  while (cache->size + size > cache->max_size)
+    {
+      ctk_render_cache_remove_entry (cache, g_queue_peek_tail (&cache->lru));
+      cache->evictions++;
+    }
+
+  entry = g_slice_new0 (CtkRenderCacheEntry);
+  entry->key = key;
+  entry->surface = cairo_surface_reference (surface);
+  entry->size = size;
+  entry->link.data = entry;
+
+  g_hash_table_insert (cache->entries, key, entry);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  cache->size += size;
+}
+
+/* Drops all entries for which @func returns %TRUE. @func is passed
+ * the key and the surface of each entry. */
+void
+ctk_render_cache_remove_matching (CtkRenderCache *cache,
+                                  GHRFunc         func,
+                                  gpointer        user_data)
+{
+  GList *l, *next;
+
+  for (l = cache->lru.head; l; l = next)
+    {
+      CtkRenderCacheEntry *entry = l->data;
+
+      next = l->next;
+
+      if (func (entry->key, entry->surface, user_data))
+        {
+          ctk_render_cache_remove_entry (cache, entry);
+          cache->evictions++;
+        }
+    }
+}
+
+void
+ctk_render_cache_clear (CtkRenderCache *cache)
+{
+  while (cache->lru.head)
+    ctk_render_cache_remove_entry (cache, cache->lru.head->data);
+}
+
+const char *
+ctk_render_cache_get_name (CtkRenderCache *cache)
+{
+  return cache->name;
+}
+
+void
+ctk_render_cache_get_stats (CtkRenderCache      *cache,
+                            CtkRenderCacheStats *stats)
+{
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  stats->evictions = cache->evictions;
+  stats->size = cache->size;
+  stats->max_size = cache->max_size;
+  stats->n_entries = g_hash_table_size (cache->entries);
+}
+
+static gboolean
+is_integer (double d)
+{
+  return d == floor (d);
+}
+
+/* Checks whether a rectangle drawn at @x, @y in the user space of @cr
+ * covers whole device pixels, so that a surface rendered for it can
+ * be copied without resampling. Returns the device scale in @scale.
+ */
+gboolean
+ctk_render_cache_is_pixel_aligned (cairo_t *cr,
+                                   double   x,
+                                   double   y,
+                                   double   width,
+                                   double   height,
+                                   int     *scale)
+{
+  cairo_matrix_t matrix;
+  double x_scale, y_scale;
+
+  cairo_get_matrix (cr, &matrix);
+  if (matrix.xx != 1.0 || matrix.yy != 1.0 ||
+      matrix.xy != 0.0 || matrix.yx != 0.0)
+    return FALSE;
+
+  cairo_surface_get_device_scale (cairo_get_group_target (cr), &x_scale, &y_scale);
+  if (x_scale != y_scale || !is_integer (x_scale) || x_scale < 1)
+    return FALSE;
+
+  if (!is_integer ((matrix.x0 + x) * x_scale) ||
+      !is_integer ((matrix.y0 + y) * y_scale) ||
+      !is_integer (width * x_scale) ||
+      !is_integer (height * y_scale))
+    return FALSE;
+
+  *scale = x_scale;
+
+  return TRUE;
+}
@@ -0,0 +1,67 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CTK_RENDER_CACHE_PRIVATE_H__
+#define __CTK_RENDER_CACHE_PRIVATE_H__
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+typedef struct _CtkRenderCache CtkRenderCache;
+typedef struct _CtkRenderCacheStats CtkRenderCacheStats;
+
+struct _CtkRenderCacheStats {
+  guint64 hits;
+  guint64 misses;
+  guint64 evictions;
+  gsize   size;         /* bytes of pixel data currently held */
+  gsize   max_size;
+  guint   n_entries;
+};
+
+CtkRenderCache *        ctk_render_cache_new            (const char             *name,
+                                                         gsize                   max_size,
+                                                         GHashFunc               hash_func,
+                                                         GEqualFunc              equal_func,
+                                                         GDestroyNotify          key_destroy_func);
+GSList *                ctk_render_cache_get_all        (void);
+
+cairo_surface_t *       ctk_render_cache_lookup         (CtkRenderCache         *cache,
+                                                         gconstpointer           key);
+void                    ctk_render_cache_insert         (CtkRenderCache         *cache,
+                                                         gpointer                key,
+                                                         cairo_surface_t        *surface);
+void                    ctk_render_cache_remove_matching (CtkRenderCache        *cache,
+                                                         GHRFunc                 func,
+                                                         gpointer                user_data);
+void                    ctk_render_cache_clear          (CtkRenderCache         *cache);
+
+const char *            ctk_render_cache_get_name       (CtkRenderCache         *cache);
+void                    ctk_render_cache_get_stats      (CtkRenderCache         *cache,
+                                                         CtkRenderCacheStats    *stats);
+
+gboolean                ctk_render_cache_is_pixel_aligned (cairo_t              *cr,
+                                                         double                  x,
+                                                         double                  y,
+                                                         double                  width,
+                                                         double                  height,
+                                                         int                    *scale);
+
+G_END_DECLS
+
+#endif /* __CTK_RENDER_CACHE_PRIVATE_H__ */
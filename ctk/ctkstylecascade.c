@@ -333,14 +333,14 @@ _ctk_style_cascade_set_parent (CtkStyleCascade *cascade,
       g_object_ref (parent);
       g_signal_connect_swapped (parent,
                                 "-gtk-private-changed",
-                                G_CALLBACK (_ctk_style_provider_private_changed),
+                                G_CALLBACK (_ctk_style_provider_private_forward_changed),
                                 cascade);
     }
 
   if (cascade->parent)
     {
       g_signal_handlers_disconnect_by_func (cascade->parent, 
-                                            _ctk_style_provider_private_changed,
+                                            _ctk_style_provider_private_forward_changed,
                                             cascade);
       g_object_unref (cascade->parent);
     }
@@ -364,7 +364,7 @@ _ctk_style_cascade_add_provider (CtkStyleCascade  *cascade,
   data.priority = priority;
   data.changed_signal_id = g_signal_connect_swapped (provider,
                                                      "-gtk-private-changed",
-                                                     G_CALLBACK (_ctk_style_provider_private_changed),
+                                                     G_CALLBACK (_ctk_style_provider_private_forward_changed),
                                                      cascade);
 
   /* ensure it gets removed first */
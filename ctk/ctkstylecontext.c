@@ -299,7 +299,12 @@ static void
 ctk_style_context_cascade_changed (CtkStyleCascade *cascade G_GNUC_UNUSED,
                                    CtkStyleContext *context)
 {
-  ctk_css_node_invalidate_style_provider (ctk_style_context_get_root (context));
+  const CtkCssSelectorTree *selectors;
+
+  if (!_ctk_style_provider_private_get_changed_selectors (&selectors))
+    ctk_css_node_invalidate_style_provider (ctk_style_context_get_root (context));
+  else if (selectors != NULL)
+    ctk_css_node_invalidate_style_provider_selectors (ctk_style_context_get_root (context), selectors);
 }
 
 static void
@@ -332,7 +337,7 @@ ctk_style_context_set_cascade (CtkStyleContext *context,
   priv->cascade = cascade;
 
   if (cascade && priv->cssnode != NULL)
-    ctk_style_context_cascade_changed (cascade, context);
+    ctk_css_node_invalidate_style_provider (ctk_style_context_get_root (context));
 }
 
 static void
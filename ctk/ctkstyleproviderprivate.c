@@ -31,6 +31,7 @@ enum {
 G_DEFINE_INTERFACE (CtkStyleProviderPrivate, _ctk_style_provider_private, CTK_TYPE_STYLE_PROVIDER)
 
 static guint signals[LAST_SIGNAL];
+static guint changed_generation;
 
 static void
 _ctk_style_provider_private_default_init (CtkStyleProviderPrivateInterface *iface)
@@ -105,12 +106,86 @@ _ctk_style_provider_private_lookup (CtkStyleProviderPrivate *provider,
   iface->lookup (provider, matcher, lookup, out_change);
 }
 
+/* While a provider emits ::-gtk-private-changed, this describes what
+ * changed: either everything, or only the rules matching the selectors
+ * in changed_selectors.
+ */
+static gboolean changed_targeted;
+static const CtkCssSelectorTree *changed_selectors;
+
+static void
+ctk_style_provider_private_emit_changed (CtkStyleProviderPrivate  *provider,
+                                         gboolean                  targeted,
+                                         const CtkCssSelectorTree *selectors)
+{
+  const CtkCssSelectorTree *saved_selectors;
+  gboolean saved_targeted;
+
+  changed_generation++;
+
+  saved_targeted = changed_targeted;
+  saved_selectors = changed_selectors;
+  changed_targeted = targeted;
+  changed_selectors = selectors;
+
+  g_signal_emit (provider, signals[CHANGED], 0);
+
+  changed_targeted = saved_targeted;
+  changed_selectors = saved_selectors;
+}
+
 void
 _ctk_style_provider_private_changed (CtkStyleProviderPrivate *provider)
 {
   ctk_internal_return_if_fail (CTK_IS_STYLE_PROVIDER_PRIVATE (provider));
 
-  g_signal_emit (provider, signals[CHANGED], 0);
+  ctk_style_provider_private_emit_changed (provider, FALSE, NULL);
+}
+
+/* Like _ctk_style_provider_private_changed(), but only rules with
+ * selectors in @selectors were added, removed or modified. Nodes that
+ * can't match any of them don't need to be restyled. @selectors may be
+ * %NULL if nothing changed at all.
+ */
+void
+_ctk_style_provider_private_changed_selectors (CtkStyleProviderPrivate  *provider,
+                                               const CtkCssSelectorTree *selectors)
+{
+  ctk_internal_return_if_fail (CTK_IS_STYLE_PROVIDER_PRIVATE (provider));
+
+  ctk_style_provider_private_emit_changed (provider, TRUE, selectors);
+}
+
+/* Re-emits the change that is currently being emitted by another
+ * provider on @provider, for providers that aggregate others. */
+void
+_ctk_style_provider_private_forward_changed (CtkStyleProviderPrivate *provider)
+{
+  ctk_internal_return_if_fail (CTK_IS_STYLE_PROVIDER_PRIVATE (provider));
+
+  ctk_style_provider_private_emit_changed (provider, changed_targeted, changed_selectors);
+}
+
+/* To be called from ::-gtk-private-changed handlers. Returns %TRUE
+ * if only the rules with selectors in @selectors changed, %FALSE
+ * if everything needs to be restyled.
+ */
+gboolean
+_ctk_style_provider_private_get_changed_selectors (const CtkCssSelectorTree **selectors)
+{
+  *selectors = changed_selectors;
+
+  return changed_targeted;
+}
+
+/* Returns a number that changes whenever any style provider
+ * changes, so caches of computed styles can detect that they
+ * are out of date without connecting to every provider.
+ */
+guint
+_ctk_style_provider_private_get_generation (void)
+{
+  return changed_generation;
 }
 
 CtkSettings *
@@ -22,6 +22,7 @@
 #include "ctk/ctkcsskeyframesprivate.h"
 #include "ctk/ctkcsslookupprivate.h"
 #include "ctk/ctkcssmatcherprivate.h"
+#include "ctk/ctkcssselectorprivate.h"
 #include "ctk/ctkcssvalueprivate.h"
 #include <ctk/ctktypes.h>
 
@@ -70,6 +71,14 @@ void                    _ctk_style_provider_private_lookup       (CtkStyleProvid
                                                                   CtkCssChange            *out_change);
 
 void                    _ctk_style_provider_private_changed      (CtkStyleProviderPrivate *provider);
+void                    _ctk_style_provider_private_changed_selectors
+                                                                 (CtkStyleProviderPrivate  *provider,
+                                                                  const CtkCssSelectorTree *selectors);
+void                    _ctk_style_provider_private_forward_changed
+                                                                 (CtkStyleProviderPrivate *provider);
+gboolean                _ctk_style_provider_private_get_changed_selectors
+                                                                 (const CtkCssSelectorTree **selectors);
+guint                   _ctk_style_provider_private_get_generation (void);
 
 void                    _ctk_style_provider_private_emit_error   (CtkStyleProviderPrivate *provider,
                                                                   CtkCssSection           *section,
@@ -27,6 +27,7 @@
 #include "prop-editor.h"
 
 #include "ctktreemodelcssnode.h"
+#include "ctktreemodelsort.h"
 #include "ctktreeview.h"
 #include "ctklabel.h"
 #include "ctkpopover.h"
@@ -51,6 +52,9 @@ enum {
   COLUMN_NODE_CLASSES,
   COLUMN_NODE_ID,
   COLUMN_NODE_STATE,
+  COLUMN_NODE_RESTYLES,
+  COLUMN_NODE_CACHE_HITS,
+  COLUMN_NODE_LAST_CHANGE,
   /* add more */
   N_NODE_COLUMNS
 };
@@ -66,6 +70,7 @@ struct _CtkInspectorCssNodeTreePrivate
 {
   CtkWidget *node_tree;
   CtkTreeModel *node_model;
+  CtkTreeModel *node_sort_model;
   CtkTreeViewColumn *node_name_column;
   CtkTreeViewColumn *node_id_column;
   CtkTreeViewColumn *node_classes_column;
@@ -85,6 +90,17 @@ typedef struct {
   CtkInspectorCssNodeTree *cnt;
 } NodePropEditor;
 
+static CtkCssNode *
+get_node_from_sort_iter (CtkInspectorCssNodeTree *cnt,
+                         CtkTreeIter             *sort_iter)
+{
+  CtkTreeIter iter;
+
+  ctk_tree_model_sort_convert_iter_to_child_iter (CTK_TREE_MODEL_SORT (cnt->priv->node_sort_model), &iter, sort_iter);
+
+  return ctk_tree_model_css_node_get_node_from_iter (CTK_TREE_MODEL_CSS_NODE (cnt->priv->node_model), &iter);
+}
+
 static void
 show_node_prop_editor (NodePropEditor *npe)
 {
@@ -127,8 +143,8 @@ row_activated (CtkTreeView             *tv,
   else
     return;
 
-  ctk_tree_model_get_iter (cnt->priv->node_model, &iter, path);
-  npe.node = ctk_tree_model_css_node_get_node_from_iter (CTK_TREE_MODEL_CSS_NODE (cnt->priv->node_model), &iter);
+  ctk_tree_model_get_iter (cnt->priv->node_sort_model, &iter, path);
+  npe.node = get_node_from_sort_iter (cnt, &iter);
   ctk_tree_view_get_cell_area (tv, path, col, &npe.rect);
   ctk_tree_view_convert_bin_window_to_widget_coords (tv, npe.rect.x, npe.rect.y, &npe.rect.x, &npe.rect.y);
 
@@ -148,7 +164,7 @@ selection_changed (CtkTreeSelection *selection, CtkInspectorCssNodeTree *cnt)
   if (!ctk_tree_selection_get_selected (selection, NULL, &iter))
     return;
 
-  node = ctk_tree_model_css_node_get_node_from_iter (CTK_TREE_MODEL_CSS_NODE (cnt->priv->node_model), &iter);
+  node = get_node_from_sort_iter (cnt, &iter);
   ctk_inspector_css_node_tree_set_node (cnt, node);
 }
 
@@ -300,6 +316,18 @@ ctk_inspector_css_node_tree_get_node_value (CtkTreeModelCssNode *model G_GNUC_UN
       g_value_take_string (value, format_state_flags (ctk_css_node_get_state (node)));
       break;
 
+    case COLUMN_NODE_RESTYLES:
+      g_value_set_uint (value, ctk_css_node_get_n_restyles (node));
+      break;
+
+    case COLUMN_NODE_CACHE_HITS:
+      g_value_set_uint (value, ctk_css_node_get_n_style_cache_hits (node));
+      break;
+
+    case COLUMN_NODE_LAST_CHANGE:
+      g_value_take_string (value, ctk_css_change_to_string (ctk_css_node_get_last_change (node)));
+      break;
+
     default:
       g_assert_not_reached ();
       break;
@@ -322,9 +350,15 @@ ctk_inspector_css_node_tree_init (CtkInspectorCssNodeTree *cnt)
                                                   G_TYPE_BOOLEAN,
                                                   G_TYPE_STRING,
                                                   G_TYPE_STRING,
+                                                  G_TYPE_STRING,
+                                                  G_TYPE_UINT,
+                                                  G_TYPE_UINT,
                                                   G_TYPE_STRING);
-  ctk_tree_view_set_model (CTK_TREE_VIEW (priv->node_tree), priv->node_model);
+  /* Sorting by restyles finds the hot nodes of each family */
+  priv->node_sort_model = ctk_tree_model_sort_new_with_model (priv->node_model);
   g_object_unref (priv->node_model);
+  ctk_tree_view_set_model (CTK_TREE_VIEW (priv->node_tree), priv->node_sort_model);
+  g_object_unref (priv->node_sort_model);
 
   ctk_tree_sortable_set_sort_column_id (CTK_TREE_SORTABLE (cnt->priv->prop_model),
                                         COLUMN_PROP_NAME,
@@ -355,7 +389,7 @@ ctk_inspector_css_node_tree_set_object (CtkInspectorCssNodeTree *cnt,
   CtkInspectorCssNodeTreePrivate *priv;
   CtkCssNode *node, *root;
   CtkTreePath *path;
-  CtkTreeIter iter;
+  CtkTreeIter iter, sort_iter;
 
   g_return_if_fail (CTK_INSPECTOR_IS_CSS_NODE_TREE (cnt));
 
@@ -376,7 +410,8 @@ ctk_inspector_css_node_tree_set_object (CtkInspectorCssNodeTree *cnt,
   ctk_tree_model_css_node_set_root_node (CTK_TREE_MODEL_CSS_NODE (priv->node_model), root);
 
   ctk_tree_model_css_node_get_iter_from_node (CTK_TREE_MODEL_CSS_NODE (priv->node_model), &iter, node);
-  path = ctk_tree_model_get_path (priv->node_model, &iter);
+  ctk_tree_model_sort_convert_child_iter_to_iter (CTK_TREE_MODEL_SORT (priv->node_sort_model), &sort_iter, &iter);
+  path = ctk_tree_model_get_path (priv->node_sort_model, &sort_iter);
 
   ctk_tree_view_expand_to_path (CTK_TREE_VIEW (priv->node_tree), path);
   ctk_tree_view_set_cursor (CTK_TREE_VIEW (priv->node_tree), path, NULL, FALSE);
@@ -26,6 +26,7 @@
 #include "ctkswitch.h"
 #include "ctklistbox.h"
 #include "ctkprivate.h"
+#include "ctkrendercacheprivate.h"
 #include "ctksizegroup.h"
 #include "ctkimage.h"
 #include "ctkadjustment.h"
@@ -60,6 +61,7 @@ struct _CtkInspectorGeneralPrivate
   CtkWidget *display_box;
   CtkWidget *gl_box;
   CtkWidget *device_box;
+  CtkWidget *cache_box;
   CtkWidget *ctk_version;
   CtkWidget *cdk_backend;
   CtkWidget *gl_version;
@@ -76,6 +78,7 @@ struct _CtkInspectorGeneralPrivate
   CtkWidget *display_composited;
   CtkSizeGroup *labels;
   CtkAdjustment *focus_adjustment;
+  guint update_caches_id;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (CtkInspectorGeneral, ctk_inspector_general, CTK_TYPE_SCROLLED_WINDOW)
@@ -642,6 +645,78 @@ init_device (CtkInspectorGeneral *gen)
   populate_seats (gen);
 }
 
+static gboolean
+update_caches (gpointer data)
+{
+  CtkInspectorGeneral *gen = data;
+  GList *list, *l;
+  GSList *caches, *c;
+
+  list = ctk_container_get_children (CTK_CONTAINER (gen->priv->cache_box));
+  for (l = list; l; l = l->next)
+    ctk_widget_destroy (CTK_WIDGET (l->data));
+  g_list_free (list);
+
+  caches = ctk_render_cache_get_all ();
+  if (caches == NULL)
+    add_label_row (gen, CTK_LIST_BOX (gen->priv->cache_box), "Render caches", C_("render caches", "None"), 0);
+
+  for (c = caches; c; c = c->next)
+    {
+      CtkRenderCacheStats stats;
+      char *size, *max_size, *value;
+
+      ctk_render_cache_get_stats (c->data, &stats);
+
+      size = g_format_size (stats.size);
+      max_size = g_format_size (stats.max_size);
+      value = g_strdup_printf ("%u surfaces, %s of %s", stats.n_entries, size, max_size);
+      add_label_row (gen, CTK_LIST_BOX (gen->priv->cache_box), ctk_render_cache_get_name (c->data), value, 0);
+      g_free (value);
+      g_free (max_size);
+      g_free (size);
+
+      value = g_strdup_printf ("%" G_GUINT64_FORMAT, stats.hits);
+      add_label_row (gen, CTK_LIST_BOX (gen->priv->cache_box), "Hits", value, 10);
+      g_free (value);
+
+      value = g_strdup_printf ("%" G_GUINT64_FORMAT, stats.misses);
+      add_label_row (gen, CTK_LIST_BOX (gen->priv->cache_box), "Misses", value, 10);
+      g_free (value);
+
+      value = g_strdup_printf ("%" G_GUINT64_FORMAT, stats.evictions);
+      add_label_row (gen, CTK_LIST_BOX (gen->priv->cache_box), "Evictions", value, 10);
+      g_free (value);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+ctk_inspector_general_map (CtkWidget *widget)
+{
+  CtkInspectorGeneral *gen = CTK_INSPECTOR_GENERAL (widget);
+
+  CTK_WIDGET_CLASS (ctk_inspector_general_parent_class)->map (widget);
+
+  update_caches (gen);
+  gen->priv->update_caches_id = cdk_threads_add_timeout_seconds (1, update_caches, gen);
+}
+
+static void
+ctk_inspector_general_unmap (CtkWidget *widget)
+{
+  CtkInspectorGeneral *gen = CTK_INSPECTOR_GENERAL (widget);
+
+  if (gen->priv->update_caches_id)
+    {
+      g_source_remove (gen->priv->update_caches_id);
+      gen->priv->update_caches_id = 0;
+    }
+
+  CTK_WIDGET_CLASS (ctk_inspector_general_parent_class)->unmap (widget);
+}
+
 static void
 ctk_inspector_general_init (CtkInspectorGeneral *gen)
 {
@@ -668,6 +743,10 @@ keynav_failed (CtkWidget *widget, CtkDirectionType direction, CtkInspectorGenera
     next = gen->priv->gl_box;
   else if (direction == CTK_DIR_DOWN && widget == gen->priv->gl_box)
     next = gen->priv->device_box;
+  else if (direction == CTK_DIR_DOWN && widget == gen->priv->device_box)
+    next = gen->priv->cache_box;
+  else if (direction == CTK_DIR_UP && widget == gen->priv->cache_box)
+    next = gen->priv->device_box;
   else if (direction == CTK_DIR_UP && widget == gen->priv->device_box)
     next = gen->priv->gl_box;
   else if (direction == CTK_DIR_UP && widget == gen->priv->gl_box)
@@ -720,6 +799,7 @@ ctk_inspector_general_constructed (GObject *object)
    g_signal_connect (gen->priv->display_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
    g_signal_connect (gen->priv->gl_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
    g_signal_connect (gen->priv->device_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
+   g_signal_connect (gen->priv->cache_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
 }
 
 static void
@@ -730,6 +810,9 @@ ctk_inspector_general_class_init (CtkInspectorGeneralClass *klass)
 
   object_class->constructed = ctk_inspector_general_constructed;
 
+  widget_class->map = ctk_inspector_general_map;
+  widget_class->unmap = ctk_inspector_general_unmap;
+
   ctk_widget_class_set_template_from_resource (widget_class, "/org/ctk/libctk/inspector/general.ui");
   ctk_widget_class_bind_template_child_private (widget_class, CtkInspectorGeneral, version_box);
   ctk_widget_class_bind_template_child_private (widget_class, CtkInspectorGeneral, env_box);
@@ -751,6 +834,7 @@ ctk_inspector_general_class_init (CtkInspectorGeneralClass *klass)
   ctk_widget_class_bind_template_child_private (widget_class, CtkInspectorGeneral, display_composited);
   ctk_widget_class_bind_template_child_private (widget_class, CtkInspectorGeneral, display_rgba);
   ctk_widget_class_bind_template_child_private (widget_class, CtkInspectorGeneral, device_box);
+  ctk_widget_class_bind_template_child_private (widget_class, CtkInspectorGeneral, cache_box);
 }
 
 // vim: set et sw=2 ts=2:
@@ -1,5 +1,7 @@
 #include <ctk/ctkcairoblurprivate.h>
 
+#include <string.h>
+
 static void
 init_surface (cairo_t *cr)
 {
@@ -14,40 +16,101 @@ init_surface (cairo_t *cr)
   cairo_fill (cr);
 }
 
+static double
+time_blur (cairo_t      *cr,
+           int           radius,
+           CtkBlurFlags  flags)
+{
+  GTimer *timer;
+  double msec;
+
+  init_surface (cr);
+
+  timer = g_timer_new ();
+  _ctk_cairo_blur_surface (cairo_get_target (cr), radius, flags);
+  msec = g_timer_elapsed (timer, NULL) * 1000;
+  g_timer_destroy (timer);
+
+  return msec;
+}
+
+/* Checks that the optimized blur gives the same result as the
+ * scalar reference implementation.
+ */
+static gboolean
+check_blur (cairo_t      *cr,
+            cairo_t      *reference_cr,
+            int           radius,
+            CtkBlurFlags  flags)
+{
+  cairo_surface_t *surface = cairo_get_target (cr);
+  cairo_surface_t *reference = cairo_get_target (reference_cr);
+  int stride, height;
+
+  init_surface (cr);
+  init_surface (reference_cr);
+  _ctk_cairo_blur_surface (surface, radius, flags);
+  _ctk_cairo_blur_surface (reference, radius, flags | CTK_BLUR_REFERENCE);
+
+  cairo_surface_flush (surface);
+  cairo_surface_flush (reference);
+  stride = cairo_image_surface_get_stride (surface);
+  height = cairo_image_surface_get_height (surface);
+
+  return memcmp (cairo_image_surface_get_data (surface),
+                 cairo_image_surface_get_data (reference),
+                 stride * height) == 0;
+}
+
 int
 main (int    argc G_GNUC_UNUSED,
       char **argv G_GNUC_UNUSED)
 {
-  cairo_surface_t *surface;
-  cairo_t *cr;
-  GTimer *timer;
-  double msec;
+  cairo_surface_t *surface, *reference;
+  cairo_t *cr, *reference_cr;
+  double msec, reference_msec;
+  gboolean exact = TRUE;
   int i, j;
   int size;
 
-  timer = g_timer_new ();
-
   size = 2000;
 
   surface = cairo_image_surface_create (CAIRO_FORMAT_A8, size, size);
+  reference = cairo_image_surface_create (CAIRO_FORMAT_A8, size, size);
 
   cr = cairo_create (surface);
+  reference_cr = cairo_create (reference);
+
+  for (i = 1; i < 16; i++)
+    {
+      if (!check_blur (cr, reference_cr, i, CTK_BLUR_X) ||
+          !check_blur (cr, reference_cr, i, CTK_BLUR_Y) ||
+          !check_blur (cr, reference_cr, i, CTK_BLUR_X | CTK_BLUR_Y))
+        {
+          g_print ("Radius %2d: result differs from the reference implementation\n", i);
+          exact = FALSE;
+        }
+    }
 
   /* We do everything three times, first two as warmup */
-  for (j = 0; j < 2; j++)
+  for (j = 0; j < 3; j++)
     {
       for (i = 1; i < 16; i++)
 	{
-	  init_surface (cr);
-	  g_timer_start (timer);
-	  _ctk_cairo_blur_surface (surface, i, CTK_BLUR_X | CTK_BLUR_Y);
-	  msec = g_timer_elapsed (timer, NULL) * 1000;
-	  if (j == 1)
-	    g_print ("Radius %2d: %.2f msec, %.2f kpixels/msec:\n", i, msec, size*size/(msec*1000));
+	  msec = time_blur (cr, i, CTK_BLUR_X | CTK_BLUR_Y);
+	  reference_msec = time_blur (cr, i, CTK_BLUR_X | CTK_BLUR_Y | CTK_BLUR_REFERENCE);
+	  if (j == 2)
+	    g_print ("Radius %2d: %.2f msec, %.2f Mpix/s (reference: %.2f msec, %.2f Mpix/s)\n",
+                     i,
+                     msec, size * size / (msec * 1000),
+                     reference_msec, size * size / (reference_msec * 1000));
 	}
     }
 
-  g_timer_destroy (timer);
+  cairo_destroy (cr);
+  cairo_destroy (reference_cr);
+  cairo_surface_destroy (surface);
+  cairo_surface_destroy (reference);
 
-  return 0;
+  return exact ? 0 : 1;
 }
@@ -0,0 +1,353 @@
+/* Measures how cdkbroadwayd copes with many browsers looking at once.
+ *
+ * Usage: broadway-load [--port PORT] [--clients N] [--slow N] [--time SECONDS]
+ *
+ * Start something that keeps drawing on a Broadway display first, like
+ *
+ *   cdkbroadwayd :5 &
+ *   CDK_BACKEND=broadway BROADWAY_DISPLAY=:5 ./animated-resizing
+ *
+ * and point this at port 8085. It connects 1, 2, 4, ... up to N
+ * headless WebSocket clients that read everything the daemon sends,
+ * and reports how many messages per second every client gets, and how
+ * long a ping takes to come back. The daemon answers pings behind
+ * what it queued for the client already, so that is how far behind
+ * the client is.
+ *
+ * The slow clients only read 16 KiB every 100 ms. They should get
+ * fewer frames, but not hold up the others.
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+
+#define WARMUP_TIME (G_USEC_PER_SEC / 2)   /* for the initial resync */
+#define PING_INTERVAL (G_USEC_PER_SEC / 10)
+#define SLOW_CHUNK (16 * 1024)
+#define SLOW_DELAY (G_USEC_PER_SEC / 10)
+
+typedef struct {
+  gboolean slow;
+  GThread *thread;
+
+  gboolean failed;
+  guint64 messages;
+  guint64 bytes;
+  guint64 pings;
+  gint64 ping_total;
+  gint64 ping_max;
+} LoadClient;
+
+static int port = 8080;
+static int max_clients = 8;
+static int n_slow = 0;
+static double run_time = 5;
+
+static GCancellable *cancellable;
+static gint64 start_time;
+
+static GOptionEntry options[] = {
+  { "port", 'p', 0, G_OPTION_ARG_INT, &port, "Port of the daemon", "PORT" },
+  { "clients", 'c', 0, G_OPTION_ARG_INT, &max_clients, "Maximum number of clients", "N" },
+  { "slow", 's', 0, G_OPTION_ARG_INT, &n_slow, "Number of slow clients", "N" },
+  { "time", 't', 0, G_OPTION_ARG_DOUBLE, &run_time, "Time for every number of clients", "SECONDS" },
+  { NULL }
+};
+
+/* Reads the response to the upgrade request, one byte at a time so
+ * that nothing of the first message gets lost */
+static gboolean
+handshake (GIOStream  *stream,
+           GError    **error)
+{
+  static const char request[] =
+    "GET /socket HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "Sec-WebSocket-Protocol: broadway\r\n"
+    "\r\n";
+  GInputStream *in = g_io_stream_get_input_stream (stream);
+  GString *response;
+  gboolean ok;
+  char c;
+
+  if (!g_output_stream_write_all (g_io_stream_get_output_stream (stream),
+                                  request, strlen (request), NULL, cancellable, error))
+    return FALSE;
+
+  response = g_string_new (NULL);
+  while (!g_str_has_suffix (response->str, "\r\n\r\n"))
+    {
+      if (g_input_stream_read (in, &c, 1, cancellable, error) != 1)
+        {
+          g_string_free (response, TRUE);
+          if (error && *error == NULL)
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed");
+          return FALSE;
+        }
+      g_string_append_c (response, c);
+    }
+
+  ok = g_str_has_prefix (response->str, "HTTP/1.1 101");
+  if (!ok)
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Unexpected response: %s", response->str);
+
+  g_string_free (response, TRUE);
+
+  return ok;
+}
+
+static gboolean
+send_ping (GOutputStream  *out,
+           GError        **error)
+{
+  /* Frames from clients are masked, even when there is nothing in them */
+  static const guchar ping[] = { 0x89, 0x80, 0, 0, 0, 0 };
+
+  return g_output_stream_write_all (out, ping, sizeof ping, NULL, cancellable, error);
+}
+
+/* Counts the complete frames in @data and returns their length */
+static gsize
+parse_frames (LoadClient   *client,
+              const guchar *data,
+              gsize         len,
+              gint64       *ping_time)
+{
+  gsize pos = 0;
+
+  while (len - pos >= 2)
+    {
+      const guchar *p = data + pos;
+      guint64 payload_len = p[1] & 0x7f;
+      gsize header_len = 2;
+      gint64 now;
+      int i;
+
+      if (payload_len == 126)
+        {
+          if (len - pos < 4)
+            break;
+          payload_len = (p[2] << 8) | p[3];
+          header_len = 4;
+        }
+      else if (payload_len == 127)
+        {
+          if (len - pos < 10)
+            break;
+          payload_len = 0;
+          for (i = 0; i < 8; i++)
+            payload_len = (payload_len << 8) | p[2 + i];
+          header_len = 10;
+        }
+
+      if (len - pos - header_len < payload_len)
+        break;
+
+      now = g_get_monotonic_time ();
+
+      switch (p[0] & 0x0f)
+        {
+        case 0x2: /* binary */
+          if (now >= start_time)
+            {
+              client->messages++;
+              client->bytes += header_len + payload_len;
+            }
+          break;
+
+        case 0xa: /* pong */
+          if (*ping_time != 0 && now >= start_time)
+            {
+              client->pings++;
+              client->ping_total += now - *ping_time;
+              client->ping_max = MAX (client->ping_max, now - *ping_time);
+            }
+          *ping_time = 0;
+          break;
+
+        default:
+          break;
+        }
+
+      pos += header_len + payload_len;
+    }
+
+  return pos;
+}
+
+static gpointer
+client_thread (gpointer data)
+{
+  LoadClient *client = data;
+  GSocketClient *socket_client;
+  GSocketConnection *connection;
+  GInputStream *in;
+  GOutputStream *out;
+  GByteArray *buffer;
+  guchar *chunk;
+  gsize chunk_size;
+  gint64 ping_time = 0, last_ping = 0;
+  GError *error = NULL;
+
+  socket_client = g_socket_client_new ();
+  connection = g_socket_client_connect_to_host (socket_client, "localhost", port,
+                                                cancellable, &error);
+  g_object_unref (socket_client);
+
+  if (connection == NULL || !handshake (G_IO_STREAM (connection), &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_printerr ("Could not connect: %s\n", error->message);
+      g_error_free (error);
+      g_clear_object (&connection);
+      client->failed = TRUE;
+      return NULL;
+    }
+
+  in = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+  out = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+  chunk_size = client->slow ? SLOW_CHUNK : 256 * 1024;
+  chunk = g_malloc (chunk_size);
+  buffer = g_byte_array_new ();
+
+  while (TRUE)
+    {
+      gint64 now = g_get_monotonic_time ();
+      gssize res;
+      gsize len;
+
+      if (ping_time == 0 && now - last_ping >= PING_INTERVAL)
+        {
+          if (!send_ping (out, &error))
+            break;
+          ping_time = last_ping = now;
+        }
+
+      res = g_input_stream_read (in, chunk, chunk_size, cancellable, &error);
+      if (res <= 0)
+        break;
+
+      g_byte_array_append (buffer, chunk, res);
+      len = parse_frames (client, buffer->data, buffer->len, &ping_time);
+      g_byte_array_remove_range (buffer, 0, len);
+
+      if (client->slow)
+        g_usleep (SLOW_DELAY);
+    }
+
+  if (error == NULL)
+    client->failed = TRUE; /* the daemon closed the connection */
+  else if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_printerr ("Connection failed: %s\n", error->message);
+      client->failed = TRUE;
+    }
+  g_clear_error (&error);
+
+  g_byte_array_unref (buffer);
+  g_free (chunk);
+  g_object_unref (connection);
+
+  return NULL;
+}
+
+static void
+print_results (const char *name,
+               LoadClient *clients,
+               int         n_clients,
+               gboolean    slow)
+{
+  guint64 messages = 0, bytes = 0, pings = 0;
+  gint64 ping_total = 0, ping_max = 0;
+  int i, n = 0;
+
+  for (i = 0; i < n_clients; i++)
+    {
+      if (clients[i].slow != slow || clients[i].failed)
+        continue;
+
+      n++;
+      messages += clients[i].messages;
+      bytes += clients[i].bytes;
+      pings += clients[i].pings;
+      ping_total += clients[i].ping_total;
+      ping_max = MAX (ping_max, clients[i].ping_max);
+    }
+
+  if (n == 0)
+    return;
+
+  g_print ("  %-4s %3d clients: %7.1f messages/s %8.2f MB/s, ping %7.1f ms average, %7.1f ms max\n",
+           name, n,
+           messages / run_time / n,
+           bytes / run_time / n / (1024 * 1024),
+           pings ? ping_total / 1000. / pings : 0,
+           ping_max / 1000.);
+}
+
+static void
+run (int n_clients)
+{
+  LoadClient *clients;
+  int i, n_total, n_failed;
+
+  n_total = n_clients + n_slow;
+  clients = g_new0 (LoadClient, n_total);
+
+  cancellable = g_cancellable_new ();
+  start_time = g_get_monotonic_time () + WARMUP_TIME;
+
+  for (i = 0; i < n_total; i++)
+    {
+      clients[i].slow = i >= n_clients;
+      clients[i].thread = g_thread_new ("client", client_thread, &clients[i]);
+    }
+
+  g_usleep (WARMUP_TIME + run_time * G_USEC_PER_SEC);
+
+  g_cancellable_cancel (cancellable);
+
+  n_failed = 0;
+  for (i = 0; i < n_total; i++)
+    {
+      g_thread_join (clients[i].thread);
+      if (clients[i].failed)
+        n_failed++;
+    }
+
+  g_print ("%d clients%s\n", n_total, n_failed ? " (some failed)" : "");
+  print_results ("fast", clients, n_total, FALSE);
+  print_results ("slow", clients, n_total, TRUE);
+
+  g_object_unref (cancellable);
+  g_free (clients);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  int n;
+
+  context = g_option_context_new (NULL);
+  g_option_context_add_main_entries (context, options, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+
+  g_option_context_free (context);
+
+  for (n = 1; n <= max_clients; n = n < max_clients ? MIN (2 * n, max_clients) : n + 1)
+    run (n);
+
+  return 0;
+}
@@ -0,0 +1,518 @@
+/* Replays a sequence of window frames through the Broadway encoder.
+ *
+ * Usage: broadway-performance [FRAME.png...]
+ *
+ * The frames are the contents of one window in the order they were
+ * drawn, as PNG files. Without arguments, a window that scrolls text and
+ * blinks a cursor is made up. Every frame is encoded against the one
+ * before it, like cdkbroadwayd does, once with the optimized kernels and
+ * once with the plain C ones, which must give the same bytes.
+ *
+ * Then the cursor of the first frame blinks, once encoding the whole
+ * window every time and once only what the client reports as damaged,
+ * which must decode to the same pixels.
+ *
+ * Last, the window switches back and forth between the first frame
+ * and its negative, like between two pages of a notebook, once with
+ * and once without a tile store.
+ */
+
+#include <cdk/broadway/broadway-buffer.h>
+
+#include <cairo.h>
+#include <string.h>
+
+#define N_RUNS 3
+
+static cairo_surface_t *
+load_frame (const char *filename)
+{
+  cairo_surface_t *png, *surface;
+  cairo_t *cr;
+
+  png = cairo_image_surface_create_from_png (filename);
+  if (cairo_surface_status (png) != CAIRO_STATUS_SUCCESS)
+    {
+      g_printerr ("Could not load %s: %s\n", filename,
+                  cairo_status_to_string (cairo_surface_status (png)));
+      cairo_surface_destroy (png);
+      return NULL;
+    }
+
+  /* Broadway gets premultiplied ARGB, whatever the PNG has */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        cairo_image_surface_get_width (png),
+                                        cairo_image_surface_get_height (png));
+  cr = cairo_create (surface);
+  cairo_set_source_surface (cr, png, 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+  cairo_surface_destroy (png);
+
+  return surface;
+}
+
+static cairo_surface_t *
+make_frame (int n)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  int y;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 1200, 900);
+  cr = cairo_create (surface);
+
+  cairo_set_source_rgb (cr, 1, 1, 1);
+  cairo_paint (cr);
+
+  /* Lines of "text", scrolling 3 pixels per frame */
+  cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+  for (y = 40 - (n * 3) % 20; y < 860; y += 20)
+    {
+      int x, line = (y + n * 3) / 20;
+
+      for (x = 20; x < 1180 - (line * 37) % 400; x += 9)
+        if ((x * 7 + line * 13) % 11 != 0)
+          cairo_rectangle (cr, x, y, 6, 12);
+    }
+  cairo_fill (cr);
+
+  /* A toolbar with rounded, antialiased corners */
+  cairo_set_source_rgba (cr, 0.2, 0.4, 0.8, 0.8);
+  cairo_arc (cr, 30, 20, 12, 0, 2 * G_PI);
+  cairo_arc (cr, 1170, 20, 12, 0, 2 * G_PI);
+  cairo_fill (cr);
+  cairo_rectangle (cr, 30, 8, 1140, 24);
+  cairo_fill (cr);
+
+  /* A blinking cursor */
+  if (n % 2)
+    {
+      cairo_set_source_rgb (cr, 0, 0, 0);
+      cairo_rectangle (cr, 400, 400, 2, 16);
+      cairo_fill (cr);
+    }
+
+  cairo_destroy (cr);
+
+  return surface;
+}
+
+static BroadwayBuffer *
+create_buffer (cairo_surface_t *surface)
+{
+  cairo_surface_flush (surface);
+
+  return broadway_buffer_create (cairo_image_surface_get_width (surface),
+                                 cairo_image_surface_get_height (surface),
+                                 cairo_image_surface_get_data (surface),
+                                 cairo_image_surface_get_stride (surface));
+}
+
+/* Decodes @data on top of @old like broadway.js does, but keeping the
+ * pixels in the byte order of the buffer. @tiles has room for
+ * BROADWAY_TILE_STORE_SIZE tiles of 32x32 pixels, or is %NULL.
+ */
+static void
+decode (guint32       *pixels,
+        const guint32 *old,
+        guint32       *tiles,
+        int            width,
+        int            height,
+        const GString *data)
+{
+  const guint32 *p = (const guint32 *) data->str;
+  const guint32 *end = p + data->len / 4;
+  guint32 *dest = pixels;
+  guint32 cmd, len, i;
+
+  if (old)
+    memcpy (pixels, old, width * height * 4);
+
+  while (p < end)
+    {
+      cmd = *p++;
+
+      if (cmd >> 24)
+        {
+          *dest++ = cmd;
+          continue;
+        }
+
+      len = cmd & 0xfffff;
+      switch (cmd >> 20)
+        {
+        case 0: /* transparent pixel */
+          *dest++ = 0;
+          break;
+        case 1: /* delta 0 run */
+          dest += len;
+          break;
+        case 2: /* block reference */
+          {
+            int block_stride = (width + 31) / 32;
+            int src_x = len % block_stride * 32, src_y = len / block_stride * 32;
+            int dest_x = *p >> 16, dest_y = *p & 0xffff;
+            int x, y;
+
+            p++;
+            for (y = 0; y < 32 && src_y + y < height && dest_y + y < height; y++)
+              for (x = 0; x < 32 && src_x + x < width && dest_x + x < width; x++)
+                pixels[(dest_y + y) * width + dest_x + x] = old[(src_y + y) * width + src_x + x];
+          }
+          break;
+        case 5: /* save a tile */
+        case 6: /* tile reference */
+          {
+            guint32 *tile = tiles + len * 32 * 32;
+            int tile_x = *p >> 16, tile_y = *p & 0xffff;
+            int y;
+
+            p++;
+            for (y = 0; y < 32; y++)
+              if (cmd >> 20 == 5)
+                memcpy (tile + y * 32, pixels + (tile_y + y) * width + tile_x, 32 * 4);
+              else
+                memcpy (pixels + (tile_y + y) * width + tile_x, tile + y * 32, 32 * 4);
+          }
+          break;
+        case 3: /* color run */
+          for (i = 0; i < len; i++)
+            *dest++ = *p;
+          p++;
+          break;
+        case 4: /* delta run */
+          for (i = 0; i < len; i++, dest++)
+            *dest = (((*dest & 0x00ff00ff) + (*p & 0x00ff00ff)) & 0x00ff00ff) |
+                    (((*dest & 0xff00ff00) + (*p & 0xff00ff00)) & 0xff00ff00);
+          p++;
+          break;
+        }
+    }
+}
+
+/* Blinks a cursor in @frame, encoding either the whole window or just
+ * the cursor. Returns whether the client would see the same as with
+ * encoding the whole window.
+ */
+static gboolean
+blink_cursor (cairo_surface_t *frame,
+              gboolean         damaged,
+              double          *msec_out,
+              guint64         *bytes_out)
+{
+  cairo_rectangle_int_t cursor = { 400, 400, 2, 16 };
+  cairo_region_t *damage;
+  cairo_surface_t *surface;
+  BroadwayBuffer *prev, *prev_prev, *buffer, *reference;
+  GString *encoded, *reference_encoded;
+  guint32 *pixels, *reference_pixels, *tmp;
+  gboolean exact = TRUE;
+  GTimer *timer;
+  int width, height, n;
+  cairo_t *cr;
+
+  width = cairo_image_surface_get_width (frame);
+  height = cairo_image_surface_get_height (frame);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cr = cairo_create (surface);
+  cairo_set_source_surface (cr, frame, 0, 0);
+  cairo_paint (cr);
+
+  damage = cairo_region_create_rectangle (&cursor);
+  encoded = g_string_new (NULL);
+  reference_encoded = g_string_new (NULL);
+  pixels = g_new0 (guint32, width * height);
+  reference_pixels = g_new0 (guint32, width * height);
+  tmp = g_new0 (guint32, width * height);
+
+  prev = create_buffer (surface);
+  prev_prev = NULL;
+  broadway_buffer_encode (prev, NULL, NULL, encoded);
+  decode (pixels, NULL, NULL, width, height, encoded);
+  *bytes_out = 0;
+  *msec_out = 0;
+
+  timer = g_timer_new ();
+  for (n = 0; n < 100; n++)
+    {
+      cairo_set_source_rgb (cr, n % 2 ? 1 : 0, n % 2 ? 1 : 0, n % 2 ? 1 : 0);
+      cairo_rectangle (cr, cursor.x, cursor.y, cursor.width, cursor.height);
+      cairo_fill (cr);
+      cairo_surface_flush (surface);
+
+      g_string_truncate (encoded, 0);
+      g_timer_start (timer);
+      if (damaged)
+        buffer = broadway_buffer_create_damaged (prev, prev_prev,
+                                                 cairo_image_surface_get_data (surface),
+                                                 cairo_image_surface_get_stride (surface),
+                                                 damage);
+      else
+        buffer = create_buffer (surface);
+      broadway_buffer_encode (buffer, prev, NULL, encoded);
+      *msec_out += g_timer_elapsed (timer, NULL) * 1000;
+      *bytes_out += encoded->len;
+
+      decode (tmp, pixels, NULL, width, height, encoded);
+      memcpy (pixels, tmp, width * height * 4);
+
+      /* What the client would have after a full update */
+      reference = create_buffer (surface);
+      g_string_truncate (reference_encoded, 0);
+      broadway_buffer_encode (reference, NULL, NULL, reference_encoded);
+      decode (reference_pixels, NULL, NULL, width, height, reference_encoded);
+      broadway_buffer_destroy (reference);
+
+      if (memcmp (pixels, reference_pixels, width * height * 4) != 0)
+        exact = FALSE;
+
+      if (damaged)
+        prev_prev = prev;
+      else
+        broadway_buffer_destroy (prev);
+      prev = buffer;
+    }
+  g_timer_destroy (timer);
+
+  if (prev_prev)
+    broadway_buffer_destroy (prev_prev);
+  broadway_buffer_destroy (prev);
+  g_free (pixels);
+  g_free (reference_pixels);
+  g_free (tmp);
+  g_string_free (encoded, TRUE);
+  g_string_free (reference_encoded, TRUE);
+  cairo_region_destroy (damage);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  return exact;
+}
+
+/* Switches between @frame and its negative, encoding every page
+ * against the other one. Returns whether the client sees the right
+ * pixels.
+ */
+static gboolean
+switch_pages (cairo_surface_t *frame,
+              gboolean         use_tiles,
+              double          *msec_out,
+              guint64         *bytes_out)
+{
+  BroadwayTileStore *tiles;
+  cairo_surface_t *pages[2];
+  BroadwayBuffer *prev, *buffer, *reference;
+  GString *encoded;
+  guint32 *pixels, *reference_pixels, *tmp, *tile_pixels;
+  gboolean exact = TRUE;
+  GTimer *timer;
+  int width, height, n;
+  cairo_t *cr;
+
+  width = cairo_image_surface_get_width (frame);
+  height = cairo_image_surface_get_height (frame);
+
+  pages[0] = frame;
+  pages[1] = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cr = cairo_create (pages[1]);
+  cairo_set_source_surface (cr, frame, 0, 0);
+  cairo_paint (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_DIFFERENCE);
+  cairo_set_source_rgb (cr, 1, 1, 1);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  tiles = use_tiles ? broadway_tile_store_new () : NULL;
+  tile_pixels = g_new0 (guint32, BROADWAY_TILE_STORE_SIZE * 32 * 32);
+  encoded = g_string_new (NULL);
+  pixels = g_new0 (guint32, width * height);
+  reference_pixels = g_new0 (guint32, width * height);
+  tmp = g_new0 (guint32, width * height);
+
+  prev = NULL;
+  *bytes_out = 0;
+  *msec_out = 0;
+
+  timer = g_timer_new ();
+  for (n = 0; n < 20; n++)
+    {
+      g_string_truncate (encoded, 0);
+      g_timer_start (timer);
+      buffer = create_buffer (pages[n % 2]);
+      broadway_buffer_encode (buffer, prev, tiles, encoded);
+      /* Showing both pages the first time is the same either way */
+      if (n >= 2)
+        {
+          *msec_out += g_timer_elapsed (timer, NULL) * 1000;
+          *bytes_out += encoded->len;
+        }
+
+      decode (tmp, prev ? pixels : NULL, tile_pixels, width, height, encoded);
+      memcpy (pixels, tmp, width * height * 4);
+
+      g_string_truncate (encoded, 0);
+      reference = create_buffer (pages[n % 2]);
+      broadway_buffer_encode (reference, NULL, NULL, encoded);
+      decode (reference_pixels, NULL, NULL, width, height, encoded);
+      broadway_buffer_destroy (reference);
+
+      if (memcmp (pixels, reference_pixels, width * height * 4) != 0)
+        exact = FALSE;
+
+      if (prev)
+        broadway_buffer_destroy (prev);
+      prev = buffer;
+    }
+  g_timer_destroy (timer);
+
+  broadway_buffer_destroy (prev);
+  if (tiles)
+    broadway_tile_store_free (tiles);
+  g_free (tile_pixels);
+  g_free (pixels);
+  g_free (reference_pixels);
+  g_free (tmp);
+  g_string_free (encoded, TRUE);
+  cairo_surface_destroy (pages[1]);
+
+  return exact;
+}
+
+/* Encodes all frames, appending the output to @out if it is given */
+static double
+replay (GPtrArray *frames,
+        guint64   *bytes_out,
+        GString   *out)
+{
+  BroadwayBuffer *prev = NULL;
+  GString *encoded;
+  GTimer *timer;
+  double msec;
+  guint i;
+
+  encoded = g_string_new (NULL);
+  *bytes_out = 0;
+
+  timer = g_timer_new ();
+  for (i = 0; i < frames->len; i++)
+    {
+      BroadwayBuffer *buffer;
+
+      buffer = create_buffer (g_ptr_array_index (frames, i));
+      g_string_truncate (encoded, 0);
+      broadway_buffer_encode (buffer, prev, NULL, encoded);
+      *bytes_out += encoded->len;
+
+      if (out)
+        g_string_append_len (out, encoded->str, encoded->len);
+
+      if (prev)
+        broadway_buffer_destroy (prev);
+      prev = buffer;
+    }
+  msec = g_timer_elapsed (timer, NULL) * 1000;
+  g_timer_destroy (timer);
+
+  if (prev)
+    broadway_buffer_destroy (prev);
+  g_string_free (encoded, TRUE);
+
+  return msec;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GPtrArray *frames;
+  GString *output, *reference_output;
+  guint64 pixels, bytes, reference_bytes;
+  double msec, reference_msec;
+  gboolean exact;
+  int i;
+
+  frames = g_ptr_array_new_with_free_func ((GDestroyNotify) cairo_surface_destroy);
+
+  if (argc > 1)
+    {
+      for (i = 1; i < argc; i++)
+        {
+          cairo_surface_t *surface = load_frame (argv[i]);
+
+          if (surface == NULL)
+            return 1;
+          g_ptr_array_add (frames, surface);
+        }
+    }
+  else
+    {
+      for (i = 0; i < 60; i++)
+        g_ptr_array_add (frames, make_frame (i));
+    }
+
+  pixels = 0;
+  for (i = 0; i < (int) frames->len; i++)
+    {
+      cairo_surface_t *surface = g_ptr_array_index (frames, i);
+
+      pixels += cairo_image_surface_get_width (surface) * cairo_image_surface_get_height (surface);
+    }
+
+  output = g_string_new (NULL);
+  reference_output = g_string_new (NULL);
+  broadway_buffer_set_reference (FALSE);
+  replay (frames, &bytes, output);
+  broadway_buffer_set_reference (TRUE);
+  replay (frames, &reference_bytes, reference_output);
+
+  exact = output->len == reference_output->len &&
+          memcmp (output->str, reference_output->str, output->len) == 0;
+  if (!exact)
+    g_print ("Output differs from the reference implementation\n");
+
+  g_string_free (output, TRUE);
+  g_string_free (reference_output, TRUE);
+
+  /* The first runs are warmup */
+  for (i = 0; i < N_RUNS; i++)
+    {
+      broadway_buffer_set_reference (FALSE);
+      msec = replay (frames, &bytes, NULL);
+      broadway_buffer_set_reference (TRUE);
+      reference_msec = replay (frames, &reference_bytes, NULL);
+    }
+
+  g_print ("%u frames, %.1f Mpix\n", frames->len, pixels / 1e6);
+  g_print ("%.1f frames/s, %.2f msec/frame (reference: %.1f frames/s, %.2f msec/frame)\n",
+           frames->len * 1000 / msec, msec / frames->len,
+           frames->len * 1000 / reference_msec, reference_msec / frames->len);
+  g_print ("%" G_GUINT64_FORMAT " bytes out, %.1f bytes/frame, %.1f%% of raw\n",
+           bytes, (double) bytes / frames->len, 100.0 * bytes / (pixels * 4));
+
+  broadway_buffer_set_reference (FALSE);
+  if (!blink_cursor (g_ptr_array_index (frames, 0), FALSE, &reference_msec, &reference_bytes) ||
+      !blink_cursor (g_ptr_array_index (frames, 0), TRUE, &msec, &bytes))
+    {
+      g_print ("Damaged updates decode differently\n");
+      exact = FALSE;
+    }
+
+  g_print ("Blinking cursor: %.3f msec/frame, %.1f bytes/frame (whole window: %.3f msec/frame, %.1f bytes/frame)\n",
+           msec / 100, bytes / 100., reference_msec / 100, reference_bytes / 100.);
+
+  if (!switch_pages (g_ptr_array_index (frames, 0), FALSE, &reference_msec, &reference_bytes) ||
+      !switch_pages (g_ptr_array_index (frames, 0), TRUE, &msec, &bytes))
+    {
+      g_print ("Updates with tiles decode differently\n");
+      exact = FALSE;
+    }
+
+  g_print ("Switching pages: %.3f msec/frame, %.1f bytes/frame (without tiles: %.3f msec/frame, %.1f bytes/frame)\n",
+           msec / 18, bytes / 18., reference_msec / 18, reference_bytes / 18.);
+
+  g_ptr_array_unref (frames);
+
+  return exact ? 0 : 1;
+}
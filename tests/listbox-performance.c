@@ -0,0 +1,242 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+
+/* Binds a list box to a large model and scrolls it up and down.
+ *
+ * Usage: listbox-performance [--items N] [--no-virtualize]
+ *
+ * Prints how long binding the model took and how much memory the
+ * process uses once the window is shown, then the frame statistics
+ * while scrolling. CDK_FRAME_STATS=file writes percentiles of the
+ * frame phases on exit.
+ *
+ * Without virtualization, every item gets a row, so try fewer items.
+ */
+
+#include <ctk/ctk.h>
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "frame-stats.h"
+
+#define BENCH_TYPE_ITEM (bench_item_get_type ())
+G_DECLARE_FINAL_TYPE (BenchItem, bench_item, BENCH, ITEM, GObject)
+
+struct _BenchItem
+{
+  GObject parent;
+
+  guint index;
+};
+
+G_DEFINE_TYPE (BenchItem, bench_item, G_TYPE_OBJECT)
+
+static void
+bench_item_init (BenchItem *item G_GNUC_UNUSED) {}
+
+static void
+bench_item_class_init (BenchItemClass *class G_GNUC_UNUSED) {}
+
+/* Makes the items when they are asked for, so the model itself
+ * doesn't count towards the memory */
+#define BENCH_TYPE_MODEL (bench_model_get_type ())
+G_DECLARE_FINAL_TYPE (BenchModel, bench_model, BENCH, MODEL, GObject)
+
+struct _BenchModel
+{
+  GObject parent;
+
+  guint n_items;
+};
+
+static GType
+bench_model_get_item_type (GListModel *list G_GNUC_UNUSED)
+{
+  return BENCH_TYPE_ITEM;
+}
+
+static guint
+bench_model_get_n_items (GListModel *list)
+{
+  return BENCH_MODEL (list)->n_items;
+}
+
+static gpointer
+bench_model_get_item (GListModel *list,
+                      guint       position)
+{
+  BenchItem *item;
+
+  if (position >= BENCH_MODEL (list)->n_items)
+    return NULL;
+
+  item = g_object_new (BENCH_TYPE_ITEM, NULL);
+  item->index = position;
+
+  return item;
+}
+
+static void
+bench_model_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = bench_model_get_item_type;
+  iface->get_n_items = bench_model_get_n_items;
+  iface->get_item = bench_model_get_item;
+}
+
+G_DEFINE_TYPE_WITH_CODE (BenchModel, bench_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, bench_model_list_model_init))
+
+static void
+bench_model_init (BenchModel *model G_GNUC_UNUSED) {}
+
+static void
+bench_model_class_init (BenchModelClass *class G_GNUC_UNUSED) {}
+
+static int n_items = 1000000;
+static gboolean no_virtualize = FALSE;
+
+static GOptionEntry options[] = {
+  { "items", 'n', 0, G_OPTION_ARG_INT, &n_items, "Number of items", "N" },
+  { "no-virtualize", 0, 0, G_OPTION_ARG_NONE, &no_virtualize, "Create a row for every item", NULL },
+  { NULL }
+};
+
+static void
+bind_widget (CtkWidget *widget,
+             gpointer   item,
+             gpointer   user_data G_GNUC_UNUSED)
+{
+  guint index = BENCH_ITEM (item)->index;
+  char *text;
+
+  /* Rows of different heights, to keep the estimate honest */
+  text = g_strdup_printf (index % 7 == 0 ? "Item %u\nwith a second line" : "Item %u", index);
+  ctk_label_set_text (CTK_LABEL (widget), text);
+  g_free (text);
+}
+
+static CtkWidget *
+create_widget (gpointer item,
+               gpointer user_data)
+{
+  CtkWidget *label;
+
+  label = ctk_label_new (NULL);
+  ctk_label_set_xalign (CTK_LABEL (label), 0);
+  bind_widget (label, item, user_data);
+
+  return label;
+}
+
+static double
+get_resident_size (void)
+{
+  unsigned long size, resident;
+  char *contents;
+  double result = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    {
+      if (sscanf (contents, "%lu %lu", &size, &resident) == 2)
+        result = (double) resident * sysconf (_SC_PAGESIZE) / (1024 * 1024);
+      g_free (contents);
+    }
+
+  return result;
+}
+
+static gboolean
+scroll_list (CtkWidget     *list,
+             CdkFrameClock *frame_clock,
+             gpointer       user_data)
+{
+  static gint64 start_time;
+  CtkAdjustment *adjustment = user_data;
+  gint64 now = cdk_frame_clock_get_frame_time (frame_clock);
+  gdouble elapsed, lower, upper, page_size;
+
+  if (start_time == 0)
+    {
+      GList *rows;
+
+      start_time = now;
+
+      rows = ctk_container_get_children (CTK_CONTAINER (list));
+      g_print ("Resident size: %.1f MB, %u rows\n",
+               get_resident_size (), g_list_length (rows));
+      g_list_free (rows);
+    }
+
+  elapsed = (now - start_time) / 1000000.;
+
+  /* A full cycle over the first thousandth of the list, so the rows
+   * keep changing but the view doesn't just jump around */
+  lower = ctk_adjustment_get_lower (adjustment);
+  upper = ctk_adjustment_get_upper (adjustment);
+  page_size = ctk_adjustment_get_page_size (adjustment);
+  ctk_adjustment_set_value (adjustment,
+                            lower + (0.5 - 0.5 * cos (elapsed)) * MAX (upper - lower - page_size, 0) / 1000);
+
+  return G_SOURCE_CONTINUE;
+}
+
+int
+main (int argc, char **argv)
+{
+  CtkWidget *window;
+  CtkWidget *scrolled_window;
+  CtkWidget *list;
+  CtkAdjustment *adjustment;
+  BenchModel *model;
+  GError *error = NULL;
+  gint64 start;
+
+  GOptionContext *context = g_option_context_new (NULL);
+  g_option_context_add_main_entries (context, options, NULL);
+  frame_stats_add_options (g_option_context_get_main_group (context));
+  g_option_context_add_group (context,
+                              ctk_get_option_group (TRUE));
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+
+  window = ctk_window_new (CTK_WINDOW_TOPLEVEL);
+  frame_stats_ensure (CTK_WINDOW (window));
+  ctk_window_set_default_size (CTK_WINDOW (window), 400, 600);
+
+  scrolled_window = ctk_scrolled_window_new (NULL, NULL);
+  ctk_container_add (CTK_CONTAINER (window), scrolled_window);
+
+  list = ctk_list_box_new ();
+  ctk_container_add (CTK_CONTAINER (scrolled_window), list);
+
+  /* The viewport sets the adjustment on the list box */
+  adjustment = ctk_scrolled_window_get_vadjustment (CTK_SCROLLED_WINDOW (scrolled_window));
+
+  model = g_object_new (BENCH_TYPE_MODEL, NULL);
+  model->n_items = MAX (n_items, 0);
+
+  start = g_get_monotonic_time ();
+  if (no_virtualize)
+    ctk_list_box_bind_model (CTK_LIST_BOX (list), G_LIST_MODEL (model),
+                             create_widget, NULL, NULL);
+  else
+    ctk_list_box_bind_model_virtualized (CTK_LIST_BOX (list), G_LIST_MODEL (model),
+                                         create_widget, bind_widget, NULL, NULL);
+  g_print ("Binding %u items: %.1f ms\n", model->n_items,
+           (g_get_monotonic_time () - start) / 1000.);
+  g_object_unref (model);
+
+  ctk_widget_add_tick_callback (list, scroll_list, adjustment, NULL);
+
+  ctk_widget_show_all (window);
+  g_signal_connect (window, "destroy",
+                    G_CALLBACK (ctk_main_quit), NULL);
+  ctk_main ();
+
+  return 0;
+}
@@ -33,6 +33,63 @@ ctk_css_provider_load_data_not_null_terminated (void)
   g_object_unref (p);
 }
 
+static void
+assert_color (CtkWidget  *widget,
+              const char *expected)
+{
+  CtkStyleContext *context;
+  CdkRGBA color, expected_color;
+
+  context = ctk_widget_get_style_context (widget);
+  ctk_style_context_get_color (context, ctk_style_context_get_state (context), &color);
+  cdk_rgba_parse (&expected_color, expected);
+
+  g_assert_true (cdk_rgba_equal (&color, &expected_color));
+}
+
+/* The box gets no style of its own for :hover, only the label depends
+ * on its state */
+static void
+ctk_css_style_ancestor_state_changes (void)
+{
+  CtkCssProvider *provider;
+  CtkStyleContext *context;
+  CtkWidget *box, *label;
+
+  provider = ctk_css_provider_new ();
+  ctk_css_provider_load_from_data (provider,
+                                   "label { color: blue; }"
+                                   ".mybox:hover label { color: red; }",
+                                   -1, NULL);
+  ctk_style_context_add_provider_for_screen (cdk_screen_get_default (),
+                                             CTK_STYLE_PROVIDER (provider),
+                                             CTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  box = ctk_box_new (CTK_ORIENTATION_HORIZONTAL, 0);
+  g_object_ref_sink (box);
+  context = ctk_widget_get_style_context (box);
+  ctk_style_context_add_class (context, "mybox");
+  label = ctk_label_new ("text");
+  ctk_container_add (CTK_CONTAINER (box), label);
+
+  assert_color (label, "blue");
+
+  ctk_style_context_set_state (context, CTK_STATE_FLAG_PRELIGHT);
+  assert_color (label, "red");
+
+  ctk_style_context_set_state (context, CTK_STATE_FLAG_NORMAL);
+  assert_color (label, "blue");
+
+  ctk_style_context_set_state (context, CTK_STATE_FLAG_PRELIGHT);
+  assert_color (label, "red");
+
+  ctk_widget_destroy (box);
+  g_object_unref (box);
+
+  ctk_style_context_remove_provider_for_screen (cdk_screen_get_default (),
+                                                CTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+}
 
 int
 main (int argc, char *argv[])
@@ -41,6 +98,8 @@ main (int argc, char *argv[])
 
   g_test_add_func ("/ctk_css_provider_load_data/not_null_terminated",
       ctk_css_provider_load_data_not_null_terminated);
+  g_test_add_func ("/ctk_css_style/ancestor_state_changes",
+      ctk_css_style_ancestor_state_changes);
 
   return g_test_run ();
 }
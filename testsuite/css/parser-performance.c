@@ -0,0 +1,107 @@
+/* CTK - The GIMP Toolkit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctk/ctk.h>
+
+/* Parses the builtin themes over and over and reports the throughput of
+ * the CSS parser. Run with -m perf.
+ */
+
+#define MIN_SECONDS 1.0
+
+static void
+parse_error_cb (CtkCssProvider *provider,
+                CtkCssSection  *section,
+                const GError   *error,
+                gpointer        user_data)
+{
+  /* The themes are expected to load without errors */
+  if (!g_error_matches (error, CTK_CSS_PROVIDER_ERROR, CTK_CSS_PROVIDER_ERROR_DEPRECATED))
+    g_error ("%s:%u: %s",
+             (const char *) user_data,
+             ctk_css_section_get_start_line (section) + 1,
+             error->message);
+}
+
+static void
+test_parse_theme (gconstpointer data)
+{
+  const char *resource = data;
+  CtkCssProvider *provider;
+  GError *error = NULL;
+  GBytes *bytes;
+  const char *text;
+  gsize size;
+  guint n_runs;
+  gdouble elapsed, mb_per_second;
+
+  bytes = g_resources_lookup_data (resource, 0, &error);
+  g_assert_no_error (error);
+  text = g_bytes_get_data (bytes, &size);
+
+  n_runs = 0;
+  g_test_timer_start ();
+
+  do
+    {
+      /* Use a new provider every time so we measure parsing and not
+       * the handling of reloads.
+       */
+      provider = ctk_css_provider_new ();
+      g_signal_connect (provider, "parsing-error", G_CALLBACK (parse_error_cb), (gpointer) resource);
+      ctk_css_provider_load_from_data (provider, text, size, NULL);
+      g_object_unref (provider);
+
+      n_runs++;
+      elapsed = g_test_timer_elapsed ();
+    }
+  while (elapsed < MIN_SECONDS);
+
+  mb_per_second = (gdouble) size * n_runs / (1024 * 1024) / elapsed;
+
+  g_test_maximized_result (mb_per_second,
+                           "%s: %u runs of %" G_GSIZE_FORMAT " bytes, %.2f MB/s",
+                           resource, n_runs, size, mb_per_second);
+
+  g_bytes_unref (bytes);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *themes[] = {
+    "/org/ctk/libctk/theme/Advaita/ctk-contained.css",
+    "/org/ctk/libctk/theme/Advaita/ctk-contained-dark.css",
+    "/org/ctk/libctk/theme/HighContrast/ctk-contained.css",
+    "/org/ctk/libctk/theme/HighContrast/ctk-contained-inverse.css",
+  };
+  guint i;
+
+  ctk_test_init (&argc, &argv, NULL);
+
+  if (!g_test_perf ())
+    return 0;
+
+  for (i = 0; i < G_N_ELEMENTS (themes); i++)
+    {
+      char *path = g_strconcat ("/css/performance/parse", themes[i], NULL);
+
+      g_test_add_data_func (path, themes[i], test_parse_theme);
+      g_free (path);
+    }
+
+  return g_test_run ();
+}
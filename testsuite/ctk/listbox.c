@@ -435,6 +435,123 @@ test_header (void)
   g_object_unref (list);
 }
 
+static CtkWidget *
+create_label (gpointer item,
+              gpointer data G_GNUC_UNUSED)
+{
+  CtkWidget *label;
+
+  label = ctk_label_new (NULL);
+  g_object_set_data (G_OBJECT (label), "item", item);
+
+  return label;
+}
+
+static void
+bind_label (CtkWidget *label,
+            gpointer   item,
+            gpointer   data)
+{
+  gint *count = data;
+
+  (*count)++;
+  g_object_set_data (G_OBJECT (label), "item", item);
+}
+
+static void
+check_virtual_rows (CtkListBox *list,
+                    GListModel *model)
+{
+  GList *children, *l;
+  gint index;
+
+  children = ctk_container_get_children (CTK_CONTAINER (list));
+  g_assert (children != NULL);
+  g_assert_cmpint (g_list_length (children), <, 100);
+
+  index = ctk_list_box_row_get_index (children->data);
+  for (l = children; l; l = l->next, index++)
+    {
+      CtkListBoxRow *row = l->data;
+      GObject *item;
+
+      g_assert_cmpint (ctk_list_box_row_get_index (row), ==, index);
+      g_assert (ctk_list_box_get_row_at_index (list, index) == row);
+
+      item = g_list_model_get_item (model, index);
+      g_assert (g_object_get_data (G_OBJECT (ctk_bin_get_child (CTK_BIN (row))), "item") == item);
+      g_object_unref (item);
+    }
+  g_list_free (children);
+}
+
+static void
+test_virtualized (void)
+{
+  CtkListBox *list;
+  CtkAdjustment *adjustment;
+  GListStore *store;
+  GObject *item;
+  gint i, count, changed;
+
+  store = g_list_store_new (G_TYPE_OBJECT);
+  for (i = 0; i < 100000; i++)
+    {
+      GObject *item = g_object_new (G_TYPE_OBJECT, NULL);
+      g_list_store_append (store, item);
+      g_object_unref (item);
+    }
+
+  list = CTK_LIST_BOX (ctk_list_box_new ());
+  g_object_ref_sink (list);
+  ctk_widget_show (CTK_WIDGET (list));
+
+  adjustment = g_object_ref_sink (ctk_adjustment_new (0, 0, 0, 10, 100, 100));
+  ctk_list_box_set_adjustment (list, adjustment);
+
+  count = 0;
+  ctk_list_box_bind_model_virtualized (list, G_LIST_MODEL (store),
+                                       create_label, bind_label, &count, NULL);
+
+  check_virtual_rows (list, G_LIST_MODEL (store));
+  g_assert (ctk_list_box_get_row_at_index (list, 0) != NULL);
+  g_assert_cmpint (count, ==, 0);
+
+  /* Far down, the rows are recycled */
+  ctk_adjustment_configure (adjustment, 100000, 0, 1000000, 10, 100, 100);
+  check_virtual_rows (list, G_LIST_MODEL (store));
+  g_assert (ctk_list_box_get_row_at_index (list, 0) == NULL);
+  g_assert_cmpint (count, >, 0);
+
+  /* Removing items above the view moves the rows along */
+  g_list_store_remove (store, 0);
+  check_virtual_rows (list, G_LIST_MODEL (store));
+
+  /* Removed items don't stay selected */
+  ctk_adjustment_configure (adjustment, 0, 0, 1000000, 10, 100, 100);
+  ctk_list_box_set_selection_mode (list, CTK_SELECTION_MULTIPLE);
+  ctk_list_box_select_row (list, ctk_list_box_get_row_at_index (list, 1));
+  item = g_list_model_get_item (G_LIST_MODEL (store), 1);
+
+  changed = 0;
+  g_signal_connect (list, "selected-rows-changed",
+                    G_CALLBACK (on_selected_rows_changed), &changed);
+  g_list_store_remove (store, 1);
+  g_assert_cmpint (changed, ==, 1);
+
+  g_list_store_insert (store, 1, item);
+  check_virtual_rows (list, G_LIST_MODEL (store));
+  g_assert (!ctk_list_box_row_is_selected (ctk_list_box_get_row_at_index (list, 1)));
+  g_object_unref (item);
+
+  ctk_list_box_bind_model (list, NULL, NULL, NULL, NULL);
+  g_assert (ctk_list_box_get_row_at_index (list, 0) == NULL);
+
+  g_object_unref (adjustment);
+  g_object_unref (list);
+  g_object_unref (store);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -445,6 +562,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/listbox/multi-selection", test_multi_selection);
   g_test_add_func ("/listbox/filter", test_filter);
   g_test_add_func ("/listbox/header", test_header);
+  g_test_add_func ("/listbox/virtualized", test_virtualized);
 
   return g_test_run ();
 }
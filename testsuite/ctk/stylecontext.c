@@ -327,6 +327,66 @@ test_widget_path_parent (void)
   g_object_unref (context);
 }
 
+static void
+assert_widget_color (CtkWidget  *widget,
+                     const char *expected)
+{
+  CtkStyleContext *context;
+  CdkRGBA color, ref_color;
+
+  context = ctk_widget_get_style_context (widget);
+  cdk_rgba_parse (&ref_color, expected);
+  ctk_style_context_get_color (context, ctk_style_context_get_state (context), &color);
+
+  g_assert_true (cdk_rgba_equal (&ref_color, &color));
+}
+
+static void
+test_reload_data (void)
+{
+  CtkCssProvider *provider;
+  CtkWidget *box, *label, *button;
+
+  box = ctk_box_new (CTK_ORIENTATION_HORIZONTAL, 0);
+  label = ctk_label_new ("label");
+  button = ctk_button_new ();
+  ctk_container_add (CTK_CONTAINER (box), label);
+  ctk_container_add (CTK_CONTAINER (box), button);
+  g_object_ref_sink (box);
+
+  provider = ctk_css_provider_new ();
+  ctk_style_context_add_provider_for_screen (cdk_screen_get_default (),
+                                             CTK_STYLE_PROVIDER (provider),
+                                             CTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  ctk_css_provider_load_from_data (provider, "label { color: red; } button { color: blue; }", -1, NULL);
+  assert_widget_color (label, "red");
+  assert_widget_color (button, "blue");
+
+  /* Only the label rule changes */
+  ctk_css_provider_load_from_data (provider, "label { color: green; } button { color: blue; }", -1, NULL);
+  assert_widget_color (label, "green");
+  assert_widget_color (button, "blue");
+
+  /* Rules that only match in other states still have to be tracked */
+  ctk_css_provider_load_from_data (provider, "label { color: green; } button { color: blue; } button:active { color: yellow; }", -1, NULL);
+  assert_widget_color (button, "blue");
+  ctk_widget_set_state_flags (button, CTK_STATE_FLAG_ACTIVE, FALSE);
+  assert_widget_color (label, "green");
+  assert_widget_color (button, "yellow");
+  ctk_widget_unset_state_flags (button, CTK_STATE_FLAG_ACTIVE);
+
+  /* Changed colors restyle everything */
+  ctk_css_provider_load_from_data (provider, "@define-color c red; label { color: @c; } button { color: blue; }", -1, NULL);
+  assert_widget_color (label, "red");
+  assert_widget_color (button, "blue");
+
+  ctk_style_context_remove_provider_for_screen (cdk_screen_get_default (),
+                                                CTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+  g_object_unref (box);
+}
+
 static void
 test_style_classes (void)
 {
@@ -588,6 +648,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/style/invalidate-saved", test_invalidate_saved);
   g_test_add_func ("/style/widget-path-parent", test_widget_path_parent);
   g_test_add_func ("/style/classes", test_style_classes);
+  g_test_add_func ("/style/reload-data", test_reload_data);
 
 #define ADD_PRIORITIES_TEST(path, func) \
   g_test_add ("/style/priorities/" path, PrioritiesFixture, NULL, test_style_priorities_setup, \